@@ -0,0 +1,47 @@
+#!/bin/sh
+#
+# Byte-exact check of demo_capture audio (s_offline, src/movie.c).
+#
+# A fixed schedule of synthetic sounds is mixed by the real mixer (snd_mix.c)
+# and captured through the real Movie_MixFrameSound/S_MixSamples, a video frame
+# at a time, for several rates and frame rates. The checksums demo_capture
+# would print must match the stored references, every frame must get its
+# exact share of samples, and mixing the same sounds in other chunks and
+# paint buffer sizes must give the same bytes.
+#
+# usage: misc/snd_check/build.sh [outdir, default $TMPDIR/snd_check]
+#        <outdir>/snd_check [-v]
+# build: EXTRA adds compiler flags (e.g. -mno-sse2 for the plain C mixer)
+
+set -e
+
+here=$(cd "$(dirname "$0")" && pwd)
+src="$here/../../src"
+out=${1:-"${TMPDIR:-/tmp}/snd_check"}
+
+# prints one function of a source file, from its definition to the closing brace
+function_of() {
+	awk -v name="$2" '!p && $0 ~ "^[a-z].*[ *]" name " *\\(" && $0 !~ /;$/ { p = 1 } p { print } p && /^}/ { exit }' "$1"
+}
+
+mkdir -p "$out"
+cd "$out"
+
+cp "$src/snd_mix.c" "$src/qsound.h" "$src/movie.h" "$src/md4.c" .
+{
+	sed -n '/^#define MOVIE_MAX_AUDIO_SAMPLES/,/movie_audio_checksum;/p' "$src/movie.c"
+	function_of "$src/movie.c" Movie_Frametime
+	function_of "$src/movie.c" Movie_MixFrameSound
+	function_of "$src/movie.c" Movie_TransferSound
+	grep -e '^#define SND_OFFLINE_SAMPLES' -e '^static short snd_offline_buffer' "$src/snd_main.c"
+	function_of "$src/snd_main.c" S_MixSamples
+} > capture.inc
+for f in Movie_MixFrameSound Movie_TransferSound S_MixSamples movie_audio_checksum; do
+	grep -q "$f" capture.inc || { echo "$f not found" >&2; exit 1; }
+done
+
+F="-g -O2 -Wall -ffp-contract=off -I. -I$here $EXTRA"
+gcc $F -c snd_mix.c -o snd_mix.o
+gcc $F -c md4.c -o md4.o
+gcc $F -c "$here/main.c" -o main.o
+gcc -g $EXTRA main.o snd_mix.o md4.o -lm -o snd_check
@@ -0,0 +1,277 @@
+#include "quakedef.h"
+#include "qsound.h"
+#include "movie.h"
+
+clientState_t cl;
+cvar_t s_volume = { "volume", "0.7", 0, 0.7f, 0 };
+cvar_t s_raw_volume = { "s_raw_volume", "1", 0, 1, 1 };
+cvar_t s_swapstereo = { "s_swapstereo", "0", 0, 0, 0 };
+cvar_t s_silent_racing = { "s_silent_racing", "0", 0, 0, 0 };
+cvar_t movie_fps = { "demo_capture_fps", "30", 0, 30, 30 };
+soundhw_t *shw;
+channel_t channels[MAX_CHANNELS];
+unsigned int total_channels;
+
+int Cam_TrackNum(void) { return -1; }
+float S_VoipVoiceTransmitVolume(void) { return 1; }
+int Cmd_Argc(void) { return 1; }
+char *Cmd_Argv(int i) { return ""; }
+double Sys_DoubleTime(void) { return 0; }
+qbool Movie_IsCapturing(void) { return true; }
+
+/* everything written to the capture file, one video frame at a time */
+static short *stream;
+static int stream_samples, stream_alloc;
+static int frame_samples[1 << 16], nframes;
+
+static void WAVCaptureFrame(int samples, byte *sample_buffer)
+{
+	if (stream_samples + samples > stream_alloc) {
+		stream_alloc = (stream_samples + samples) * 2;
+		stream = realloc(stream, stream_alloc * 2 * sizeof(short));
+	}
+	memcpy(stream + stream_samples * 2, sample_buffer, samples * 2 * sizeof(short));
+	stream_samples += samples;
+	if (nframes < (int)(sizeof(frame_samples) / sizeof(frame_samples[0]))) {
+		frame_samples[nframes++] = samples;
+	}
+}
+#ifdef _WIN32
+static qbool movie_is_avi;
+static void Capture_WriteAudio(int samples, byte *sample_buffer) { WAVCaptureFrame(samples, sample_buffer); }
+#endif
+
+static void S_RunCommands(void);
+#include "capture.inc"
+
+/* ---------------- synthetic sounds and when they start ---------------- */
+#define NUM_SFX 4
+#define MAX_EVENTS 4096
+static sfx_t sfx[NUM_SFX];
+static unsigned rs;
+static unsigned rnd(void) { rs = rs * 1103515245u + 12345u; return (rs >> 8) & 0xFFFFFF; }
+
+typedef struct { int sample, sfx, channel, lvol, rvol; } event_t;
+static event_t events[MAX_EVENTS];
+static int nevents, next_event;
+
+// integer only waveforms, so every host builds the same sounds
+static void make_sounds(int khz)
+{
+	int i, k;
+
+	for (k = 0; k < NUM_SFX; k++) {
+		static const int ms[NUM_SFX] = { 500, 250, 300, 400 };
+		int len = khz * ms[k] / 1000, width = k == 1 ? 1 : 2;
+		sfxcache_t *sc;
+
+		free(sfx[k].buf);
+		sc = calloc(1, sizeof(*sc) + len * width);
+		sc->format.speed = khz;
+		sc->format.width = width;
+		sc->format.channels = 1;
+		sc->total_length = len;
+		sc->loopstart = k == 1 ? 0 : -1;
+		rs = 77 + k;
+		for (i = 0; i < len; i++) {
+			int period = 40 + i / 64 % 200, t = i % period, v;
+			switch (k) {
+			case 0: v = (t < period / 2 ? t : period - t) * 32000 / period * (len - i) / len; break;	// fading triangle sweep
+			case 1: v = (int)(rnd() & 0xFF) - 128; break;	// 8 bit noise loop
+			case 2: v = t < period / 2 ? 30000 : -30000; break;	// square, clips in the mix
+			default: v = ((int)(rnd() & 0x3FFF) - 0x2000) * (i % 1000) / 1000; break;
+			}
+			if (width == 1) {
+				((signed char *)sc->data)[i] = (signed char)v;
+			}
+			else {
+				((short *)sc->data)[i] = (short)v;
+			}
+		}
+		sfx[k].buf = sc;
+		snprintf(sfx[k].name, sizeof(sfx[k].name), "test%d", k);
+	}
+}
+
+// sounds start on video frames, as the game would start them
+static void make_events(int khz, double fps, int frames)
+{
+	double spf = khz / fps;
+	int n;
+
+	rs = 12345;
+	nevents = 0;
+	events[nevents].sample = 0; events[nevents].sfx = 1; events[nevents].channel = 0;
+	events[nevents].lvol = 90; events[nevents].rvol = 40; nevents++;
+	for (n = 0; n < frames && nevents < MAX_EVENTS; n++) {
+		if (rnd() % 4) {
+			continue;
+		}
+		events[nevents].sample = (int)(0.5 + n * spf);
+		events[nevents].sfx = rnd() % 4 == 0 ? 3 : rnd() % 3 == 0 ? 2 : 0;
+		events[nevents].channel = 1 + rnd() % 24;
+		events[nevents].lvol = rnd() % 256;
+		events[nevents].rvol = rnd() % 256;
+		nevents++;
+	}
+}
+
+static void S_RunCommands(void)
+{
+	while (next_event < nevents && events[next_event].sample <= shw->paintedtime) {
+		event_t *e = &events[next_event++];
+		channel_t *ch = &channels[e->channel];
+		sfxcache_t *sc = sfx[e->sfx].buf;
+
+		memset(ch, 0, sizeof(*ch));
+		ch->sfx = &sfx[e->sfx];
+		ch->leftvol = e->lvol;
+		ch->rightvol = e->rvol;
+		ch->end = e->sample + sc->total_length;
+		ch->flags = e->sfx == 3 ? CHANNEL_FLAG_VOICE : 0;
+	}
+}
+
+static void reset(int khz, int paintbuffer)
+{
+	static soundhw_t hw;
+
+	memset(&hw, 0, sizeof(hw));
+	hw.numchannels = 2;
+	hw.samplebits = 16;
+	hw.khz = khz;
+	shw = &hw;
+	memset(channels, 0, sizeof(channels));
+	total_channels = 32;
+	next_event = 0;
+	stream_samples = nframes = 0;
+	captured_audio_samples = movie_audio_frame = movie_audio_samples = 0;
+	movie_audio_checksum = 0;
+	s_paintbuffersize.value = s_paintbuffersize.integer = paintbuffer;
+	SND_AllocPaintBuffer();
+}
+
+/* ---------------- the runs ---------------- */
+typedef struct { int khz; int fps; int frames; unsigned checksum, stream; } config_t;
+
+// what demo_capture printed for these when the check was written, and the MD4
+// based checksum of the whole stream
+static config_t configs[] = {
+	{ 44100,  30,  300, 0xc637349a, 0x89d147d6 },
+	{ 44100, 144, 1440, 0x20c95782, 0x80d0b602 },
+	{ 48000,   1,   10, 0x059d0800, 0x329af930 },
+	{ 22050,  60,  600, 0x7df8dc1a, 0x52310d1d },
+	{ 11025,  77,  770, 0xad20c2fb, 0xef6db6a1 },
+};
+
+// demo_capture: one Movie_MixFrameSound per video frame
+static void capture(config_t *c, int paintbuffer)
+{
+	int n;
+
+	reset(c->khz, paintbuffer);
+	movie_fps.value = movie_fps.integer = c->fps;
+	for (n = 0; n < c->frames; n++) {
+		Movie_MixFrameSound(S_MixSamples);
+	}
+}
+
+// the same samples mixed in random chunks, split where sounds start
+static void chunked(config_t *c, int paintbuffer, unsigned seed)
+{
+	int total = (int)(0.5 + c->frames * Movie_Frametime() * c->khz);
+
+	reset(c->khz, paintbuffer);
+	rs = seed;
+	while (shw->paintedtime < total) {
+		int chunk = 1 + rnd() % 3000, e = next_event;
+
+		// S_MixSamples starts the sounds due now, stop before the next one
+		while (e < nevents && events[e].sample <= shw->paintedtime) {
+			e++;
+		}
+		if (e < nevents) {
+			chunk = min(chunk, events[e].sample - shw->paintedtime);
+		}
+		chunk = min(chunk, total - shw->paintedtime);
+		S_MixSamples(chunk);
+		WAVCaptureFrame(captured_audio_samples, (byte *)capture_audio_samples);
+		captured_audio_samples = 0;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	static short reference[48000 * 10 * 2 * 2];
+	int verbose = argc > 1 && !strcmp(argv[1], "-v");
+	int i, k, n, fails = 0;
+	size_t bytes;
+
+	for (i = 0; i < (int)(sizeof(configs) / sizeof(configs[0])); i++) {
+		config_t *c = &configs[i];
+		double spf;
+		unsigned checksum, whole;
+
+		make_sounds(c->khz);
+		make_events(c->khz, c->fps, c->frames);
+
+		s_mixer_simd.value = s_mixer_simd.integer = 1;
+		capture(c, 2048);
+		spf = Movie_Frametime() * c->khz;
+		checksum = movie_audio_checksum;
+		bytes = stream_samples * 2 * sizeof(short);
+		whole = Com_BlockChecksum(stream, (int)bytes);
+		memcpy(reference, stream, bytes);
+
+		// every frame gets its share and the total never drifts
+		for (n = 0; n < nframes; n++) {
+			int expect = (int)(0.5 + (n + 1) * spf) - (int)(0.5 + n * spf);
+			if (frame_samples[n] != expect) {
+				printf("%d Hz %d fps: frame %d has %d samples, not %d\n", c->khz, c->fps, n, frame_samples[n], expect);
+				fails++;
+				break;
+			}
+		}
+		if (nframes != c->frames || movie_audio_samples != (int)(0.5 + c->frames * spf)) {
+			printf("%d Hz %d fps: %d samples in %d frames\n", c->khz, c->fps, movie_audio_samples, nframes);
+			fails++;
+		}
+
+		if (c->checksum && (checksum != c->checksum || whole != c->stream)) {
+			printf("%d Hz %d fps: checksum %08x stream %08x, expected %08x %08x\n", c->khz, c->fps, checksum, whole, c->checksum, c->stream);
+			fails++;
+		}
+		else if (!c->checksum || verbose) {
+			printf("%d Hz %d fps: %d samples, checksum %08x stream %08x%s\n", c->khz, c->fps, movie_audio_samples, checksum, whole, c->checksum ? "" : " (no reference)");
+		}
+
+		// neither the mixing kernels nor the chunking may change a single byte
+		for (k = 0; k < 5; k++) {
+			static const int sizes[] = { 256, 2048, 16384 };
+			const char *what;
+
+			if (k == 0) {
+				s_mixer_simd.value = s_mixer_simd.integer = 0;
+				capture(c, 2048);
+				s_mixer_simd.value = s_mixer_simd.integer = 1;
+				what = "plain C mixer";
+			}
+			else if (k == 1) {
+				capture(c, 256);
+				what = "256 sample paint buffer";
+			}
+			else {
+				chunked(c, sizes[k - 2], 1000 + k);
+				what = "random chunks";
+			}
+			if (stream_samples * 2 * sizeof(short) != bytes || memcmp(stream, reference, bytes)) {
+				for (n = 0; n < stream_samples * 2 && stream[n] == reference[n]; n++);
+				printf("%d Hz %d fps: %s differs at sample %d\n", c->khz, c->fps, what, n / 2);
+				fails++;
+			}
+		}
+	}
+
+	printf("%d failures\n", fails);
+	return fails != 0;
+}
@@ -0,0 +1,41 @@
+// just enough of the engine for snd_mix.c and the capture functions
+#ifndef QUAKEDEF_H
+#define QUAKEDEF_H
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+typedef int qbool;
+#define true 1
+#define false 0
+typedef unsigned char byte;
+typedef float vec_t;
+typedef vec_t vec3_t[3];
+typedef unsigned int DWORD;
+#define MAX_QPATH 64
+#define MAX_CLIENTS 32
+#ifndef min
+#define min(a,b) ((a) < (b) ? (a) : (b))
+#define max(a,b) ((a) > (b) ? (a) : (b))
+#endif
+#define bound(a,b,c) ((a) >= (c) ? (a) : (b) < (a) ? (a) : (b) > (c) ? (c) : (b))
+
+#define CVAR_LATCH_SOUND 0
+typedef struct cvar_s { char *name; char *string; int flags; float value; int integer; } cvar_t;
+
+#define Q_malloc(n) calloc(1, (n))
+#define Q_calloc(n, s) calloc((n), (s))
+#define Q_free(p) do { free(p); (p) = NULL; } while (0)
+#define Q_atoi atoi
+#define Com_Printf printf
+
+typedef struct { qbool racing, spectator; int playernum; } clientState_t;
+extern clientState_t cl;
+int Cam_TrackNum(void);
+float S_VoipVoiceTransmitVolume(void);
+int Cmd_Argc(void);
+char *Cmd_Argv(int i);
+double Sys_DoubleTime(void);
+unsigned Com_BlockChecksum(void *buffer, int length);
+#endif
@@ -0,0 +1 @@
+#include "quakedef.h"
@@ -0,0 +1,44 @@
+#!/bin/sh
+#
+# Differential check for the AArch64 QVM compiler (src/vm_aarch64.c).
+#
+# Random bytecode programs are run through the interpreter and through the
+# compiler, whose output runs under a small AArch64 emulator (emu.c), so this
+# works on any 64-bit little endian host. Results, the data segment, the
+# program stack and the syscall log must match, with every vm_rtChecks value.
+# vmcheck.c mirrors the opcode table and the loader/checker from src/vm.c.
+#
+# usage: misc/vm_check/build.sh [outdir, default $TMPDIR/vm_check]
+#        <outdir>/vm_check [first seed] [count] [nesting]
+# env:   ERRTEST=1 runs the runtime check error cases instead, TRACE=1 traces
+#        the emulator, BC=1 prints the bytecode, DUMP=1 writes code.bin,
+#        BENCH=<repeats> only times the interpreter on the same programs
+# build: EXTRA adds compiler flags (e.g. "-O2 -DVM_NO_THREADED_CODE"),
+#        INTERP builds another vm_interpreted.c (e.g. an older revision)
+
+set -e
+
+here=$(cd "$(dirname "$0")" && pwd)
+src="$here/../../src"
+out=${1:-"${TMPDIR:-/tmp}/vm_check"}
+
+mkdir -p "$out"
+cd "$out"
+
+echo '#include "stub.h"' > vm.h
+echo '#include "stub.h"' > qwsvdef.h
+sed -e 's/^#include "vm.h"/#include "stub.h"/' "$src/vm_local.h" > vm_local.h
+cp "${INTERP:-$src/vm_interpreted.c}" vm_interpreted.c
+sed -e 's/vm->codeBase.func();/emu_enter( vm );/' \
+    -e 's/^static void \*VM_Alloc_Compiled( vm_t \*vm, int codeLength, int tableLength );/void emu_enter( vm_t *vm );\n&/' \
+    "$src/vm_aarch64.c" > vm_aarch64.c
+grep -q 'emu_enter( vm );' vm_aarch64.c || { echo "vm_aarch64.c: entry point not found" >&2; exit 1; }
+
+F="-g -O1 -Wall -I. -I$here -DUSE_PR2 -DSERVERONLY $EXTRA"
+gcc $F -c "$here/vmcheck.c" -o vmcheck.o
+gcc $F -std=gnu89 -Didarm64=1 -c vm_aarch64.c -o jit.o
+gcc $F -std=gnu89 -c vm_interpreted.c -o interp.o
+gcc $F -c "$here/emu.c" -o emu.o
+gcc $F -c "$here/main.c" -o main.o
+gcc $F -c "$here/sample.c" -o sample.o
+gcc -g $EXTRA main.o emu.o interp.o jit.o vmcheck.o sample.o -lm -o vm_check
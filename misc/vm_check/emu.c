@@ -0,0 +1,348 @@
+// minimal AArch64 user-mode emulator for the subset emitted by vm_aarch64.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+typedef struct {
+	uint64_t x[32];
+	uint64_t sp;
+	uint32_t v[32];
+	int n, z, c, vf;
+	uint64_t pc;
+} cpu_t;
+
+uint64_t emu_code_lo, emu_code_hi;
+static uint64_t emu_cur_sp;
+static int emu_depth;
+long emu_steps;
+int emu_trace;
+
+#define SENTINEL 0xdead0000ULL
+typedef intptr_t (*hostfn)(intptr_t, intptr_t, intptr_t, intptr_t, intptr_t, intptr_t);
+
+static void die(cpu_t *c, uint32_t i, const char *msg)
+{
+	fprintf(stderr, "EMU: %s at pc +%lx insn %08x\n", msg, (long)(c->pc - emu_code_lo), i);
+	abort();
+}
+
+static uint64_t rx(cpu_t *c, int r) { return r == 31 ? 0 : c->x[r]; }
+static uint64_t rxsp(cpu_t *c, int r) { return r == 31 ? c->sp : c->x[r]; }
+static void wx(cpu_t *c, int r, uint64_t v) { if (r != 31) c->x[r] = v; }
+static void wxsp(cpu_t *c, int r, uint64_t v) { if (r == 31) c->sp = v; else c->x[r] = v; }
+
+static uint64_t addc(cpu_t *c, int sf, uint64_t a, uint64_t b, int cin, int setf)
+{
+	uint64_t r;
+	if (sf) {
+		unsigned __int128 u = (unsigned __int128)a + b + cin;
+		__int128 s = (__int128)(int64_t)a + (int64_t)b + cin;
+		r = (uint64_t)u;
+		if (setf) {
+			c->n = (int64_t)r < 0; c->z = r == 0;
+			c->c = (u >> 64) != 0; c->vf = s != (int64_t)r;
+		}
+	} else {
+		uint64_t u = (uint64_t)(uint32_t)a + (uint32_t)b + cin;
+		int64_t s = (int64_t)(int32_t)a + (int32_t)b + cin;
+		r = (uint32_t)u;
+		if (setf) {
+			c->n = (int32_t)r < 0; c->z = r == 0;
+			c->c = (u >> 32) != 0; c->vf = s != (int32_t)r;
+		}
+	}
+	return r;
+}
+
+static int cond(cpu_t *c, int cc)
+{
+	int r;
+	switch (cc >> 1) {
+	case 0: r = c->z; break;
+	case 1: r = c->c; break;
+	case 2: r = c->n; break;
+	case 3: r = c->vf; break;
+	case 4: r = c->c && !c->z; break;
+	case 5: r = c->n == c->vf; break;
+	case 6: r = c->n == c->vf && !c->z; break;
+	default: return 1;
+	}
+	return (cc & 1) ? !r : r;
+}
+
+static uint64_t shiftv(int sf, uint64_t v, int type, int amt)
+{
+	if (!sf) {
+		uint32_t w = (uint32_t)v;
+		switch (type) {
+		case 0: return (uint32_t)(w << amt);
+		case 1: return w >> amt;
+		case 2: return (uint32_t)((int32_t)w >> amt);
+		default: return amt ? (uint32_t)((w >> amt) | (w << (32 - amt))) : w;
+		}
+	}
+	switch (type) {
+	case 0: return v << amt;
+	case 1: return v >> amt;
+	case 2: return (uint64_t)((int64_t)v >> amt);
+	default: return amt ? (v >> amt) | (v << (64 - amt)) : v;
+	}
+}
+
+static uint64_t extendv(uint64_t v, int option)
+{
+	switch (option) {
+	case 2: return (uint32_t)v;           // uxtw
+	case 6: return (uint64_t)(int64_t)(int32_t)v; // sxtw
+	case 3: case 7: return v;             // uxtx/lsl, sxtx
+	}
+	fprintf(stderr, "EMU: unsupported extend %d\n", option); abort();
+}
+
+static float getf(cpu_t *c, int r) { float f; memcpy(&f, &c->v[r], 4); return f; }
+static void setf(cpu_t *c, int r, float f) { memcpy(&c->v[r], &f, 4); }
+
+static void fcmp(cpu_t *c, float a, float b)
+{
+	if (a != a || b != b) { c->n = 0; c->z = 0; c->c = 1; c->vf = 1; }
+	else if (a == b) { c->n = 0; c->z = 1; c->c = 1; c->vf = 0; }
+	else if (a < b) { c->n = 1; c->z = 0; c->c = 0; c->vf = 0; }
+	else { c->n = 0; c->z = 0; c->c = 1; c->vf = 0; }
+}
+
+static void ldst(cpu_t *c, uint32_t i, uint64_t addr)
+{
+	if (((i >> 5) & 31) == 31 && (c->sp & 15)) die(c, i, "misaligned sp");
+	int size = i >> 30, V = (i >> 26) & 1, opc = (i >> 22) & 3, rt = i & 31;
+	void *p = (void *)(uintptr_t)addr;
+	if (V) {
+		if (size != 2) die(c, i, "simd size");
+		if (opc == 0) memcpy(p, &c->v[rt], 4);
+		else if (opc == 1) memcpy(&c->v[rt], p, 4);
+		else die(c, i, "simd opc");
+		return;
+	}
+	if (opc == 0) {
+		uint64_t v = rx(c, rt);
+		memcpy(p, &v, 1 << size);
+		return;
+	}
+	{
+		uint64_t v = 0;
+		memcpy(&v, p, 1 << size);
+		if (opc >= 2) {
+			int bits = 8 << size;
+			int64_t s = (int64_t)(v << (64 - bits)) >> (64 - bits);
+			v = (uint64_t)s;
+			if (opc == 3) v = (uint32_t)v;
+		}
+		wx(c, rt, v);
+	}
+}
+
+void emu_run(uint64_t entry);
+
+static void hostcall(cpu_t *c, uint64_t target, uint64_t ret)
+{
+	intptr_t r;
+	emu_cur_sp = c->sp;
+	r = ((hostfn)(uintptr_t)target)(c->x[0], c->x[1], c->x[2], c->x[3], c->x[4], c->x[5]);
+	{
+		int k;
+		for (k = 1; k < 19; k++) c->x[k] = 0xbad0bad0bad0bad0ULL + k;
+		for (k = 0; k < 8; k++) c->v[k] = 0x7fc0dead;
+		c->n = c->z = c->c = c->vf = 1;
+	}
+	c->x[0] = (uint64_t)r;
+	c->pc = ret;
+}
+
+static int incode(uint64_t a) { return a >= emu_code_lo && a < emu_code_hi; }
+
+void emu_run(uint64_t entry)
+{
+	static uint64_t stackmem[1 << 16];
+	cpu_t cpu, *c = &cpu;
+	memset(c, 0, sizeof(*c));
+	c->sp = emu_depth ? ((emu_cur_sp - 256) & ~15ULL) : (uint64_t)(uintptr_t)&stackmem[1 << 16];
+	c->x[30] = SENTINEL;
+	c->pc = entry;
+	emu_depth++;
+	for (;;) {
+		uint32_t i;
+		int rd, rn, rm, sf;
+		if (c->pc == SENTINEL) break;
+		if (!incode(c->pc)) die(c, 0, "pc outside code");
+		memcpy(&i, (void *)(uintptr_t)c->pc, 4);
+		emu_steps++;
+		if (emu_trace) fprintf(stderr, "%6lx: %08x sp=%lx x30=%lx x21=%lx w20=%x\n", (long)(c->pc - emu_code_lo), i, (long)(c->sp & 0xffff), (long)(c->x[30] - emu_code_lo), (long)(c->x[21] & 0xffff), (unsigned)c->x[20]);
+		rd = i & 31; rn = (i >> 5) & 31; rm = (i >> 16) & 31; sf = i >> 31;
+		c->pc += 4;
+
+		if ((i & 0x1F800000) == 0x12800000) { // movn/movz/movk
+			int opc = (i >> 29) & 3, hw = (i >> 21) & 3;
+			uint64_t imm = (uint64_t)((i >> 5) & 0xFFFF) << (hw * 16), v;
+			if (opc == 0) v = ~imm;
+			else if (opc == 2) v = imm;
+			else if (opc == 3) v = (rx(c, rd) & ~(0xFFFFULL << (hw * 16))) | imm;
+			else die(c, i, "mov opc");
+			if (!sf) v = (uint32_t)v;
+			wx(c, rd, v);
+		} else if ((i & 0x1F000000) == 0x11000000) { // add/sub imm
+			int op = (i >> 30) & 1, S = (i >> 29) & 1;
+			uint64_t imm = ((i >> 10) & 0xFFF) << (((i >> 22) & 1) ? 12 : 0);
+			uint64_t a = rxsp(c, rn), r;
+			r = op ? addc(c, sf, a, ~imm, 1, S) : addc(c, sf, a, imm, 0, S);
+			if (S) wx(c, rd, r); else wxsp(c, rd, r);
+		} else if ((i & 0x1F200000) == 0x0B000000) { // add/sub shifted
+			int op = (i >> 30) & 1, S = (i >> 29) & 1;
+			uint64_t b = shiftv(sf, rx(c, rm), (i >> 22) & 3, (i >> 10) & 63), r;
+			r = op ? addc(c, sf, rx(c, rn), ~b, 1, S) : addc(c, sf, rx(c, rn), b, 0, S);
+			wx(c, rd, r);
+		} else if ((i & 0x1F200000) == 0x0B200000) { // add/sub extended
+			int op = (i >> 30) & 1, S = (i >> 29) & 1;
+			uint64_t b = extendv(rx(c, rm), (i >> 13) & 7) << ((i >> 10) & 7), r;
+			r = op ? addc(c, sf, rxsp(c, rn), ~b, 1, S) : addc(c, sf, rxsp(c, rn), b, 0, S);
+			if (S) wx(c, rd, r); else wxsp(c, rd, r);
+		} else if ((i & 0x1F000000) == 0x0A000000) { // logical shifted
+			int opc = (i >> 29) & 3;
+			uint64_t b = shiftv(sf, rx(c, rm), (i >> 22) & 3, (i >> 10) & 63), a = rx(c, rn), r;
+			if ((i >> 21) & 1) b = ~b;
+			if (opc == 0 || opc == 3) r = a & b; else if (opc == 1) r = a | b; else r = a ^ b;
+			if (!sf) r = (uint32_t)r;
+			if (opc == 3) { c->n = sf ? (int64_t)r < 0 : (int32_t)r < 0; c->z = r == 0; c->c = 0; c->vf = 0; }
+			wx(c, rd, r);
+		} else if ((i & 0x7F000000) == 0x1B000000) { // madd/msub
+			int ra = (i >> 10) & 31, o0 = (i >> 15) & 1;
+			uint64_t p = rx(c, rn) * rx(c, rm), r;
+			if ((i >> 21) & 7) die(c, i, "mul variant");
+			r = o0 ? rx(c, ra) - p : rx(c, ra) + p;
+			if (!sf) r = (uint32_t)r;
+			wx(c, rd, r);
+		} else if ((i & 0x5FE00000) == 0x1AC00000) { // 2-source
+			int opc = (i >> 10) & 0x3F;
+			uint64_t a = rx(c, rn), b = rx(c, rm), r;
+			if (sf) die(c, i, "64-bit dp2");
+			switch (opc) {
+			case 2: r = (uint32_t)b ? (uint32_t)a / (uint32_t)b : 0; break;
+			case 3:
+				if (!(uint32_t)b) r = 0;
+				else if ((int32_t)a == INT32_MIN && (int32_t)b == -1) r = (uint32_t)INT32_MIN;
+				else r = (uint32_t)((int32_t)a / (int32_t)b);
+				break;
+			case 8: r = (uint32_t)((uint32_t)a << (b & 31)); break;
+			case 9: r = (uint32_t)a >> (b & 31); break;
+			case 10: r = (uint32_t)((int32_t)a >> (b & 31)); break;
+			default: die(c, i, "dp2 opc"); r = 0;
+			}
+			wx(c, rd, r);
+		} else if ((i & 0x1F800000) == 0x13000000) { // bitfield
+			int opc = (i >> 29) & 3, immr = (i >> 16) & 63, imms = (i >> 10) & 63;
+			uint32_t src = (uint32_t)rx(c, rn), r;
+			if (sf) die(c, i, "64-bit bitfield");
+			if (imms >= immr) {
+				int w = imms - immr + 1;
+				uint32_t v = (uint32_t)((uint64_t)src >> immr) & (uint32_t)((1ULL << w) - 1);
+				if (opc == 0 && w < 32 && (v >> (w - 1)) & 1) v |= ~(uint32_t)((1ULL << w) - 1);
+				r = v;
+			} else {
+				int w = imms + 1;
+				uint32_t v = src & (uint32_t)((1ULL << w) - 1);
+				if (opc == 0 && (v >> (w - 1)) & 1) v |= ~(uint32_t)((1ULL << w) - 1);
+				r = v << (32 - immr);
+			}
+			if (opc == 1) die(c, i, "bfm");
+			wx(c, rd, r);
+		} else if ((i & 0x7FC00000) == 0x29000000 || (i & 0x7FC00000) == 0x29400000
+			|| (i & 0x7F800000) == 0x28800000 || (i & 0x7F800000) == 0x29800000) { // ldp/stp
+			int type = (i >> 23) & 3, L = (i >> 22) & 1, rt2 = (i >> 10) & 31, rt = i & 31;
+			int64_t off = (int64_t)((int32_t)(((i >> 15) & 0x7F) << 25) >> 25) * (sf ? 8 : 4);
+			uint64_t base = rxsp(c, rn), addr = type == 1 ? base : base + off;
+			if (rn == 31 && (c->sp & 15)) die(c, i, "misaligned sp");
+			int sz = sf ? 8 : 4;
+			if (!sf) die(c, i, "32-bit pair");
+			if (L) {
+				uint64_t a = 0, b = 0;
+				memcpy(&a, (void *)(uintptr_t)addr, sz); memcpy(&b, (void *)(uintptr_t)(addr + sz), sz);
+				wx(c, rt, a); wx(c, rt2, b);
+			} else {
+				uint64_t a = rx(c, rt), b = rx(c, rt2);
+				memcpy((void *)(uintptr_t)addr, &a, sz); memcpy((void *)(uintptr_t)(addr + sz), &b, sz);
+			}
+			if (type == 1 || type == 3) wxsp(c, rn, base + off);
+		} else if ((i & 0x3B000000) == 0x39000000) { // ldr/str uimm
+			int size = i >> 30;
+			ldst(c, i, rxsp(c, rn) + ((uint64_t)((i >> 10) & 0xFFF) << size));
+		} else if ((i & 0x3B200C00) == 0x38200800) { // ldr/str register
+			int size = i >> 30, S = (i >> 12) & 1;
+			ldst(c, i, rxsp(c, rn) + (extendv(rx(c, rm), (i >> 13) & 7) << (S ? size : 0)));
+		} else if ((i & 0x3B200000) == 0x38000000) { // ldr/str imm9
+			int type = (i >> 10) & 3;
+			int64_t off = (int64_t)((uint64_t)((i >> 12) & 0x1FF) << 55) >> 55;
+			uint64_t base = rxsp(c, rn);
+			if (type == 2) die(c, i, "unpriv");
+			ldst(c, i, type == 1 ? base : base + off);
+			if (type == 1 || type == 3) wxsp(c, rn, base + off);
+		} else if ((i & 0x7C000000) == 0x14000000) { // b/bl
+			uint64_t t = c->pc - 4 + (((int64_t)((uint64_t)(i & 0x3FFFFFF) << 38) >> 38) * 4);
+			if (sf) c->x[30] = c->pc;
+			if (!incode(t)) die(c, i, "b outside code");
+			c->pc = t;
+		} else if ((i & 0xFF000010) == 0x54000000) { // b.cond
+			uint64_t t = c->pc - 4 + (((int64_t)((uint64_t)((i >> 5) & 0x7FFFF) << 45) >> 45) * 4);
+			if (cond(c, i & 15)) c->pc = t;
+		} else if ((i & 0x7E000000) == 0x36000000) { // tbz/tbnz
+			int bit = ((i >> 31) << 5) | ((i >> 19) & 31);
+			uint64_t t = c->pc - 4 + (((int64_t)((uint64_t)((i >> 5) & 0x3FFF) << 50) >> 50) * 4);
+			int set = (rx(c, i & 31) >> bit) & 1;
+			if (set == (int)((i >> 24) & 1)) c->pc = t;
+		} else if ((i & 0xFFFFFC1F) == 0xD61F0000) { // br
+			uint64_t t = rx(c, rn);
+			if (incode(t)) c->pc = t; else hostcall(c, t, c->x[30]);
+		} else if ((i & 0xFFFFFC1F) == 0xD63F0000) { // blr
+			uint64_t t = rx(c, rn);
+			if (incode(t)) { c->x[30] = c->pc; c->pc = t; } else hostcall(c, t, c->pc);
+		} else if ((i & 0xFFFFFC1F) == 0xD65F0000) { // ret
+			c->pc = rx(c, rn);
+		} else if ((i & 0xFFE0001F) == 0xD4200000) {
+			die(c, i, "brk");
+		} else if ((i & 0xFFFFFC00) == 0x1E220000) { // scvtf s, w
+			setf(c, rd, (float)(int32_t)rx(c, rn));
+		} else if ((i & 0xFFFFFC00) == 0x1E380000) { // fcvtzs w, s
+			float f = getf(c, rn); int32_t r;
+			if (f != f) r = 0; else if (f >= 2147483648.0f) r = INT32_MAX; else if (f < -2147483648.0f) r = INT32_MIN; else r = (int32_t)f;
+			wx(c, rd, (uint32_t)r);
+		} else if ((i & 0xFFFFFC00) == 0x1E260000) { // fmov w, s
+			wx(c, rd, c->v[rn]);
+		} else if ((i & 0xFFFFFC00) == 0x1E270000) { // fmov s, w
+			c->v[rd] = (uint32_t)rx(c, rn);
+		} else if ((i & 0xFF20FC07) == 0x1E202000) { // fcmp
+			fcmp(c, getf(c, rn), (i & 8) ? 0.0f : getf(c, rm));
+		} else if ((i & 0xFF207C00) == 0x1E204000) { // fp 1-source
+			int opc = (i >> 15) & 0x3F; float f = getf(c, rn);
+			if (opc == 0) c->v[rd] = c->v[rn];
+			else if (opc == 1) setf(c, rd, fabsf(f));
+			else if (opc == 2) c->v[rd] = c->v[rn] ^ 0x80000000u;
+			else if (opc == 3) setf(c, rd, sqrtf(f));
+			else die(c, i, "fp1");
+		} else if ((i & 0xFF200C00) == 0x1E200800) { // fp 2-source
+			int opc = (i >> 12) & 15; float a = getf(c, rn), b = getf(c, rm), r;
+			volatile float va = a, vb = b;
+			switch (opc) {
+			case 0: r = va * vb; break;
+			case 1: r = va / vb; break;
+			case 2: r = va + vb; break;
+			case 3: r = va - vb; break;
+			default: die(c, i, "fp2"); r = 0;
+			}
+			setf(c, rd, r);
+		} else if (i == 0xD503201F) { // nop
+		} else {
+			die(c, i, "unknown instruction");
+		}
+	}
+	emu_depth--;
+}
+void emu_reset(void) { emu_depth = 0; }
@@ -0,0 +1,615 @@
+#include "vm_local.h"
+#include <math.h>
+#include <time.h>
+
+jmp_buf harness_abort;
+cvar_t vm_rtChecks = { "vm_rtChecks", "15", 15, 15 };
+void *Hunk_AllocName(int size, const char *name) { return calloc(1, size); }
+const char *VM_ValueToSymbol(vm_t *vm, int value) { static char b[32]; sprintf(b, "%d", value); return b; }
+
+extern uint64_t emu_code_lo, emu_code_hi;
+extern long emu_steps;
+extern int emu_trace;
+void emu_run(uint64_t entry);
+void emu_enter(vm_t *vm)
+{
+	uint64_t lo = emu_code_lo, hi = emu_code_hi;
+	emu_code_lo = (uint64_t)(uintptr_t)vm->codeBase.ptr;
+	emu_code_hi = emu_code_lo + vm->codeLength;
+	if (getenv("DUMP")) { FILE *f = fopen("code.bin", "wb"); fwrite(vm->codeBase.ptr, 1, vm->codeLength, f); fclose(f); }
+	emu_run(emu_code_lo);
+	if (lo) { emu_code_lo = lo; emu_code_hi = hi; }
+}
+
+#define DATA_SIZE  0x20000
+#define GLOB       0x100
+#define GLOB_SIZE  0x2000
+#define STACK_BTM  0x8000
+
+/* ---------------- bytecode builder ---------------- */
+static byte cbuf[1 << 24];
+static int clen, icount;
+static unsigned rs;
+static int fentry[8], genpass;
+static int nest;
+
+static unsigned rnd(void) { rs = rs * 1103515245u + 12345u; return (rs >> 8) & 0xFFFFFF; }
+static int R(int n) { return rnd() % n; }
+
+static int emitp(int op, int v)
+{
+	int at;
+	cbuf[clen++] = op;
+	at = clen;
+	if (ops[op].size == 4) { memcpy(cbuf + clen, &v, 4); clen += 4; }
+	else if (ops[op].size == 1) cbuf[clen++] = (byte)v;
+	icount++;
+	return at;
+}
+static int emit(int op, int v) { int n = icount; emitp(op, v); return n; }
+static void patch(int at, int v) { memcpy(cbuf + at, &v, 4); }
+static int F2I(float f) { int i; memcpy(&i, &f, 4); return i; }
+
+/* function frame description */
+typedef struct { int frame; int nargs; int nlocals; int leaf; } fn_t;
+static fn_t *cf;
+
+static int randconst(void)
+{
+	switch (R(6)) {
+	case 0: return R(16);
+	case 1: return R(256) - 128;
+	case 2: return R(65536);
+	case 3: return (int)(rnd() << 8 | R(256));
+	case 4: return -R(100000);
+	default: return R(5000);
+	}
+}
+
+static void iexpr(int d);
+static void fexpr(int d);
+
+static void emit_local_addr(int k) { emit(OP_LOCAL, 64 + 4 * k); }
+static void emit_arg_addr(int k) { emit(OP_LOCAL, cf->frame + 8 + 4 * k); }
+
+static void emit_call(int d)
+{
+	int r = R(cf->leaf ? 2 : 8);
+	switch (r) {
+	case 0: case 1: // syscall 1 (a, b, c)
+		iexpr(d + 1); emit(OP_ARG, 8);
+		iexpr(d + 1); emit(OP_ARG, 12);
+		iexpr(d + 1); emit(OP_ARG, 16);
+		emit(OP_CONST, -2);
+		if (R(2)) { emit(OP_CONST, 0); emit(OP_ADD, 0); }
+		emit(OP_CALL, 0);
+		break;
+	case 2: // leaf function
+		iexpr(d + 1); emit(OP_ARG, 8);
+		iexpr(d + 1); emit(OP_ARG, 12);
+		emit(OP_CONST, fentry[1]);
+		if (R(2)) { emit(OP_CONST, 0); emit(OP_ADD, 0); }
+		emit(OP_CALL, 0);
+		break;
+	case 3: // fib
+		iexpr(d + 1); emit(OP_CONST, 7); emit(OP_BAND, 0); emit(OP_ARG, 8);
+		emit(OP_CONST, fentry[2]);
+		emit(OP_CALL, 0);
+		break;
+	case 4: // sqrt syscall on a float
+		iexpr(d + 1); emit(OP_CONST, 0xFFFF); emit(OP_BAND, 0); emit(OP_CVIF, 0); emit(OP_ARG, 8);
+		emit(OP_CONST, -1 - g_sqrt);
+		emit(OP_CALL, 0);
+		emit(OP_CVFI, 0);
+		break;
+	case 5: // re-entering syscall
+		iexpr(d + 1); emit(OP_CONST, 3); emit(OP_BAND, 0); emit(OP_ARG, 8);
+		emit(OP_CONST, -8);
+		emit(OP_CALL, 0);
+		break;
+	default: // leaf function, dynamic address
+		iexpr(d + 1); emit(OP_ARG, 8);
+		iexpr(d + 1); emit(OP_ARG, 12);
+		iexpr(d + 1); emit(OP_CONST, 0); emit(OP_MULI, 0);
+		emit(OP_CONST, fentry[1]); emit(OP_ADD, 0);
+		emit(OP_CALL, 0);
+		break;
+	}
+}
+
+static void iexpr(int d)
+{
+	int r = d > 4 ? R(5) : R(40);
+	switch (r) {
+	case 0: case 1: emit(OP_CONST, randconst()); break;
+	case 2: case 3: emit_local_addr(R(cf->nlocals)); emit(OP_LOAD4, 0); break;
+	case 4: emit_arg_addr(R(cf->nargs)); emit(OP_LOAD4, 0); break;
+	case 5: emit(OP_CONST, GLOB + 4 * R(GLOB_SIZE / 4)); emit(OP_LOAD4, 0); break;
+	case 6: emit(OP_CONST, GLOB + 2 * R(GLOB_SIZE / 2)); emit(OP_LOAD2, 0); if (R(2)) emit(OP_SEX16, 0); break;
+	case 7: emit(OP_CONST, GLOB + R(GLOB_SIZE)); emit(OP_LOAD1, 0); if (R(2)) emit(OP_SEX8, 0); break;
+	case 8: case 9: // computed address
+		emit(OP_CONST, GLOB); iexpr(d + 1); emit(OP_CONST, 0x7FF); emit(OP_BAND, 0);
+		emit(OP_CONST, 2); emit(OP_LSH, 0); emit(OP_ADD, 0);
+		emit(OP_LOAD4, 0);
+		break;
+	case 10: // computed byte / short address
+		emit(OP_CONST, GLOB); iexpr(d + 1); emit(OP_CONST, 0xFFF); emit(OP_BAND, 0); emit(OP_ADD, 0);
+		if (R(2)) { emit(OP_LOAD1, 0); if (R(2)) emit(OP_SEX8, 0); }
+		else { emit(OP_LOAD2, 0); if (R(2)) emit(OP_SEX16, 0); }
+		break;
+	case 11: case 12: case 13: case 14: case 15: case 16: case 17: case 18: {
+		static const int bin[] = { OP_ADD, OP_SUB, OP_MULI, OP_MULU, OP_BAND, OP_BOR, OP_BXOR, OP_ADD };
+		iexpr(d + 1);
+		if (R(3)) iexpr(d + 1); else emit(OP_CONST, randconst());
+		emit(bin[r - 11], 0);
+		break;
+	}
+	case 19: case 20: { // shifts
+		static const int sh[] = { OP_LSH, OP_RSHI, OP_RSHU };
+		iexpr(d + 1);
+		if (R(2)) emit(OP_CONST, R(32));
+		else { iexpr(d + 1); emit(OP_CONST, 31); emit(OP_BAND, 0); }
+		emit(sh[R(3)], 0);
+		break;
+	}
+	case 21: case 22: { // division
+		static const int dv[] = { OP_DIVI, OP_DIVU, OP_MODI, OP_MODU };
+		iexpr(d + 1);
+		if (R(2)) emit(OP_CONST, 1 + R(1000));
+		else { iexpr(d + 1); emit(OP_CONST, 127); emit(OP_BAND, 0); emit(OP_CONST, 1); emit(OP_BOR, 0); }
+		emit(dv[R(4)], 0);
+		break;
+	}
+	case 23: iexpr(d + 1); emit(OP_NEGI, 0); break;
+	case 24: iexpr(d + 1); emit(OP_BCOM, 0); break;
+	case 25: iexpr(d + 1); emit(R(2) ? OP_SEX8 : OP_SEX16, 0); break;
+	case 26: case 27: fexpr(d + 1); emit(OP_CVFI, 0); break;
+	case 28: case 29: case 30: case 31:
+		if (d < 3) { emit_call(d); break; }
+		emit(OP_CONST, randconst());
+		break;
+	case 32: // float local read as int
+		emit_local_addr(cf->nlocals - 1 - R(4)); emit(OP_LOAD4, 0);
+		break;
+	default:
+		emit_local_addr(R(cf->nlocals)); emit(OP_LOAD4, 0);
+		break;
+	}
+}
+
+/* float expressions stay within +-1.6e9 so CVFI never overflows */
+static int fleaf_noloc;
+static void fleaf(void)
+{
+	int r = R(4);
+	if (fleaf_noloc && r == 2) r = 0;
+	switch (r) {
+	case 0: emit(OP_CONST, F2I((float)(R(400) - 200) + (float)R(8) / 8.0f)); break;
+	case 1: iexpr(4); emit(OP_CONST, 255); emit(OP_BAND, 0); emit(OP_CONST, 100); emit(OP_SUB, 0); emit(OP_CVIF, 0); break;
+	case 2: emit_local_addr(cf->nlocals - 1 - R(4)); emit(OP_LOAD4, 0); break;
+	default: iexpr(4); emit(OP_CONST, 127); emit(OP_BAND, 0); emit(OP_CVIF, 0); if (R(2)) emit(OP_NEGF, 0); break;
+	}
+}
+
+static void fexpr(int d)
+{
+	int r;
+	if (d >= 6 || R(3) == 0) { fleaf(); return; }
+	r = R(6);
+	if (r == 5) { fexpr(6); emit(OP_NEGF, 0); return; }
+	fexpr(6);
+	if (r == 3) { // divide by 1..64
+		if (R(2)) emit(OP_CONST, F2I((float)(1 + R(64))));
+		else { iexpr(5); emit(OP_CONST, 63); emit(OP_BAND, 0); emit(OP_CONST, 1); emit(OP_ADD, 0); emit(OP_CVIF, 0); }
+		emit(OP_DIVF, 0);
+		return;
+	}
+	if (r == 4) { emit(OP_CONST, F2I((float)(R(64) - 32) / 4.0f)); emit(R(2) ? OP_MULF : OP_ADDF, 0); return; }
+	fexpr(6);
+	emit(r == 0 ? OP_ADDF : r == 1 ? OP_SUBF : OP_MULF, 0);
+}
+
+static void stmt(int d);
+
+static void block(int d, int n) { while (n--) stmt(d); }
+
+static void cond_jump_false(int *patchpos)
+{
+	static const int icmp[] = { OP_EQ, OP_NE, OP_LTI, OP_LEI, OP_GTI, OP_GEI, OP_LTU, OP_LEU, OP_GTU, OP_GEU };
+	static const int fcmp[] = { OP_EQF, OP_NEF, OP_LTF, OP_LEF, OP_GTF, OP_GEF };
+	switch (R(4)) {
+	case 0: iexpr(2); iexpr(2); *patchpos = emitp(icmp[R(10)], 0); break;
+	case 1: iexpr(2); emit(OP_CONST, R(2) ? R(64) : randconst()); *patchpos = emitp(icmp[R(10)], 0); break;
+	case 2: fexpr(3); fexpr(3); *patchpos = emitp(fcmp[R(6)], 0); break;
+	default: fexpr(3); emit(OP_CONST, R(2) ? 0 : F2I((float)(R(200) - 100))); *patchpos = emitp(fcmp[R(6)], 0); break;
+	}
+}
+
+static void stmt(int d)
+{
+	int r = R(d > 1 ? 10 : 14);
+	int p, p2, top, i;
+	switch (r) {
+	case 0: case 1:
+		emit_local_addr(R(cf->nlocals - 6)); iexpr(0); emit(OP_STORE4, 0);
+		break;
+	case 2:
+		switch (R(3)) {
+		case 0: emit(OP_CONST, GLOB + 4 * R(GLOB_SIZE / 4)); iexpr(0); emit(OP_STORE4, 0); break;
+		case 1: emit(OP_CONST, GLOB + 2 * R(GLOB_SIZE / 2)); iexpr(0); emit(OP_STORE2, 0); break;
+		default: emit(OP_CONST, GLOB + R(GLOB_SIZE)); iexpr(0); emit(OP_STORE1, 0); break;
+		}
+		break;
+	case 3:
+		emit(OP_CONST, GLOB); iexpr(1); emit(OP_CONST, 0x7FF); emit(OP_BAND, 0);
+		emit(OP_CONST, 2); emit(OP_LSH, 0); emit(OP_ADD, 0);
+		if (R(3)) iexpr(0); else emit(OP_CONST, R(2) ? 0 : randconst());
+		emit(R(4) ? OP_STORE4 : R(2) ? OP_STORE2 : OP_STORE1, 0);
+		break;
+	case 4: // float local
+		emit_local_addr(cf->nlocals - 1 - R(4)); fleaf_noloc = 1; fleaf(); fleaf_noloc = 0; if (R(2)) emit(OP_NEGF, 0); emit(OP_STORE4, 0);
+		break;
+	case 5: { // macro op patterns
+		static const int mop[] = { OP_ADD, OP_SUB, OP_BAND, OP_BOR };
+		int k = R(cf->nlocals - 6);
+		if (R(4) == 0) { emit(OP_CONST, GLOB + 4 * R(GLOB_SIZE / 4)); emit(OP_CONST, GLOB + 4 * R(GLOB_SIZE / 4)); emit(OP_LOAD4, 0); emit(OP_STORE4, 0); break; }
+		emit_local_addr(k); emit_local_addr(k); emit(OP_LOAD4, 0);
+		emit(OP_CONST, randconst()); emit(mop[R(4)], 0); emit(OP_STORE4, 0);
+		break;
+	}
+	case 6: // expression statement
+		iexpr(0); emit(OP_POP, 0);
+		break;
+	case 7: { // block copy
+		int n = 4 * (1 + R(32));
+		if (R(2)) { emit(OP_CONST, GLOB + 4 * R(GLOB_SIZE / 4 - 40)); emit(OP_CONST, GLOB + 4 * R(GLOB_SIZE / 4 - 40)); }
+		else {
+			emit(OP_CONST, GLOB); iexpr(2); emit(OP_CONST, 0x1FC); emit(OP_BAND, 0); emit(OP_ADD, 0);
+			emit_local_addr(0);
+			n = 4 * (1 + R(cf->nlocals < 12 ? cf->nlocals : 12));
+		}
+		emit(OP_BLOCK_COPY, n);
+		break;
+	}
+	case 8: case 9:
+		emit_call(0); emit(OP_POP, 0);
+		break;
+	case 10: // if / else
+		cond_jump_false(&p);
+		block(d + 1, 1 + R(3));
+		if (R(2)) {
+			p2 = emitp(OP_CONST, 0); emit(OP_JUMP, 0);
+			patch(p, icount);
+			block(d + 1, 1 + R(2));
+			patch(p2, icount);
+		} else {
+			patch(p, icount);
+		}
+		// a jump target needs an instruction following it
+		emit(OP_IGNORE, 0);
+		break;
+	case 11: { // counted loop
+		int k = cf->nlocals - 5 - nest;
+		int n = 1 + R(6);
+		if (nest >= 2) { iexpr(0); emit(OP_POP, 0); break; }
+		emit_local_addr(k); emit(OP_CONST, 0); emit(OP_STORE4, 0);
+		top = icount;
+		emit_local_addr(k); emit(OP_LOAD4, 0); emit(OP_CONST, n); p = emitp(OP_GEI, 0);
+		nest++;
+		block(d + 1, 1 + R(3));
+		nest--;
+		emit_local_addr(k); emit_local_addr(k); emit(OP_LOAD4, 0); emit(OP_CONST, 1); emit(OP_ADD, 0); emit(OP_STORE4, 0);
+		emit(OP_CONST, top); emit(OP_JUMP, 0);
+		patch(p, icount);
+		emit(OP_IGNORE, 0);
+		break;
+	}
+	case 12: { // switch through a computed jump
+		int tbl[4], ends[4];
+		iexpr(1); emit(OP_CONST, 3); emit(OP_BAND, 0); emit(OP_CONST, 1); emit(OP_LSH, 0);
+		p = emitp(OP_CONST, 0); emit(OP_ADD, 0); emit(OP_JUMP, 0);
+		patch(p, icount);
+		for (i = 0; i < 4; i++) { tbl[i] = emitp(OP_CONST, 0); emit(OP_JUMP, 0); }
+		for (i = 0; i < 4; i++) {
+			patch(tbl[i], icount);
+			block(d + 1, 1);
+			ends[i] = emitp(OP_CONST, 0); emit(OP_JUMP, 0);
+		}
+		for (i = 0; i < 4; i++) patch(ends[i], icount);
+		emit(OP_IGNORE, 0);
+		break;
+	}
+	default: // early return
+		if (d == 0 && !getenv("NORET")) { cond_jump_false(&p); iexpr(0); emit(OP_LEAVE, cf->frame); patch(p, icount); emit(OP_IGNORE, 0); }
+		else { iexpr(0); emit(OP_POP, 0); }
+		break;
+	}
+}
+
+static void func_end(void)
+{
+	emit(OP_PUSH, 0);
+	emit(OP_LEAVE, cf->frame);
+}
+
+static fn_t fmain = { 192, 3, 24, 0 }, fleaff = { 96, 2, 8, 1 }, ffib = { 32, 1, 0, 1 };
+
+static void gen_program(unsigned seed, int nstmts)
+{
+	int p, p2;
+	clen = icount = 0;
+	rs = seed;
+	nest = 0;
+
+	// vmMain( cmd, a, b )
+	fentry[0] = icount;
+	cf = &fmain;
+	emit(OP_ENTER, cf->frame);
+	// cmd 2: re-entry test, returns sys8( a - 1 ) + a * 2 after writing a global
+	emit_arg_addr(0); emit(OP_LOAD4, 0); emit(OP_CONST, 2); p = emitp(OP_NE, 0);
+	emit(OP_CONST, GLOB + 16); emit_arg_addr(1); emit(OP_LOAD4, 0); emit(OP_STORE4, 0);
+	emit_arg_addr(1); emit(OP_LOAD4, 0); emit(OP_CONST, 1); emit(OP_SUB, 0); emit(OP_ARG, 8);
+	emit(OP_CONST, -8); emit(OP_CALL, 0);
+	emit_arg_addr(1); emit(OP_LOAD4, 0); emit(OP_CONST, 2); emit(OP_MULI, 0); emit(OP_ADD, 0);
+	emit(OP_LEAVE, cf->frame);
+	patch(p, icount);
+	// initialize locals from the args and globals
+	for (p2 = 0; p2 < cf->nlocals; p2++) {
+		emit_local_addr(p2);
+		if (p2 >= cf->nlocals - 4) emit(OP_CONST, F2I((float)(p2 * 3 - 50) / 3.0f));
+		else if (p2 < 3) { emit_arg_addr(p2); emit(OP_LOAD4, 0); }
+		else { emit(OP_CONST, GLOB + 4 * p2); emit(OP_LOAD4, 0); }
+		emit(OP_STORE4, 0);
+	}
+	block(0, nstmts);
+	iexpr(0);
+	emit(OP_LEAVE, cf->frame);
+	func_end();
+
+	// leaf( a, b )
+	fentry[1] = icount;
+	cf = &fleaff;
+	emit(OP_ENTER, cf->frame);
+	for (p2 = 0; p2 < cf->nlocals; p2++) {
+		emit_local_addr(p2);
+		if (p2 >= cf->nlocals - 4) emit(OP_CONST, F2I((float)p2 / 7.0f));
+		else { emit_arg_addr(p2 & 1); emit(OP_LOAD4, 0); }
+		emit(OP_STORE4, 0);
+	}
+	block(2, 1 + R(4));
+	iexpr(1);
+	emit(OP_LEAVE, cf->frame);
+	func_end();
+
+	// fib( n )
+	fentry[2] = icount;
+	cf = &ffib;
+	emit(OP_ENTER, cf->frame);
+	emit_arg_addr(0); emit(OP_LOAD4, 0); emit(OP_CONST, 2); p = emitp(OP_GEI, 0);
+	emit_arg_addr(0); emit(OP_LOAD4, 0); emit(OP_LEAVE, cf->frame);
+	patch(p, icount);
+	emit_arg_addr(0); emit(OP_LOAD4, 0); emit(OP_CONST, 1); emit(OP_SUB, 0); emit(OP_ARG, 8);
+	emit(OP_CONST, fentry[2]); emit(OP_CALL, 0);
+	emit_arg_addr(0); emit(OP_LOAD4, 0); emit(OP_CONST, 2); emit(OP_SUB, 0); emit(OP_ARG, 8);
+	emit(OP_CONST, fentry[2]); emit(OP_CALL, 0);
+	emit(OP_ADD, 0);
+	emit(OP_LEAVE, cf->frame);
+	func_end();
+}
+
+/* ---------------- execution ---------------- */
+static vm_t *curvm;
+static int compiled_mode;
+static unsigned slog[1 << 16];
+static int nslog;
+
+static intptr_t syscalls(intptr_t *args)
+{
+	int n = (int)args[0];
+	if (getenv("SLOG")) printf("sys %d %d %d %d\n", n, (int)args[1], (int)args[2], (int)args[3]);
+	if (n != g_sqrt && nslog + 5 < (int)ARRAY_LEN(slog)) {
+		slog[nslog++] = n; slog[nslog++] = (unsigned)args[1];
+		slog[nslog++] = n == 1 ? (unsigned)args[2] : 0; slog[nslog++] = n == 1 ? (unsigned)args[3] : 0;
+	}
+	switch (n) {
+	case 1: return (int)((unsigned)args[1] * 7u + (unsigned)args[2] - (unsigned)args[3]);
+	case g_sqrt: { floatint_t f; f.i = (int)args[1]; f.f = sqrtf(f.f); return f.i; }
+	case 7: {
+		int a[3], r;
+		if ((int)args[1] <= 0) return 5;
+		a[0] = 2; a[1] = (int)args[1]; a[2] = 0;
+		r = compiled_mode ? VM_CallCompiled(curvm, 3, a) : VM_CallInterpreted2(curvm, 3, a);
+		return r + 1;
+	}
+	}
+	printf("bad syscall %d\n", n);
+	exit(1);
+}
+
+static byte init_image[DATA_SIZE];
+
+static vm_t *make_vm(byte *image)
+{
+	vm_t *vm = calloc(1, sizeof(*vm));
+	vm->name = "test";
+	vm->systemCall = syscalls;
+	vm->dataBase = image;
+	vm->dataMask = DATA_SIZE - 1;
+	vm->dataLength = DATA_SIZE;
+	vm->exactDataLength = DATA_SIZE;
+	vm->dataAlloc = DATA_SIZE;
+	vm->programStack = DATA_SIZE;
+	vm->stackBottom = STACK_BTM;
+	vm->instructionCount = icount;
+	return vm;
+}
+
+static vmHeader_t *make_header(void)
+{
+	vmHeader_t *h = calloc(1, sizeof(*h) + clen + 16);
+	h->vmMagic = VM_MAGIC;
+	h->instructionCount = icount;
+	h->codeOffset = sizeof(*h);
+	h->codeLength = clen;
+	memcpy((byte *)h + sizeof(*h), cbuf, clen);
+	return h;
+}
+
+static int run_one(unsigned seed, int nstmts, int rtchecks, int verbose)
+{
+	static byte img_i[DATA_SIZE + 64], img_c[DATA_SIZE + 64];
+	static unsigned log_i[1 << 16];
+	int nlog_i, ri[4], rc[4], k, cmd, fail = 0;
+	vm_t *vi, *vc;
+	vmHeader_t *h;
+
+	genpass = 0; gen_program(seed, nstmts);
+	genpass = 1; gen_program(seed, nstmts);
+	h = make_header();
+	if (getenv("BC")) {
+		instruction_t *b = calloc(icount + 8, sizeof(*b));
+		VM_LoadInstructions((byte *)h + h->codeOffset, clen, icount, b);
+		for (k = 0; k < icount; k++) printf("%4d: %-12s %d  [%d]\n", k, opname[b[k].op], b[k].value, b[k].opStack);
+	}
+
+	vm_rtChecks.value = vm_rtChecks.integer = rtchecks;
+	for (k = 0; k < DATA_SIZE; k++) init_image[k] = (byte)(k * 131 + seed * 7 + (k >> 7));
+	memcpy(img_i, init_image, DATA_SIZE);
+	memcpy(img_c, init_image, DATA_SIZE);
+
+	vi = make_vm(img_i);
+	vc = make_vm(img_c);
+	vi->forceDataMask = vc->forceDataMask = getenv("FORCEMASK") != NULL || seed % 7 == 3;
+	if (setjmp(harness_abort)) { printf("seed %u: prepare failed\n", seed); return 1; }
+	if (!VM_PrepareInterpreter2(vi, h)) { printf("seed %u: interp prepare failed\n", seed); return 1; }
+	if (!VM_Compile(vc, h)) { printf("seed %u: compile failed\n", seed); return 1; }
+
+	nslog = 0;
+	curvm = vi; compiled_mode = 0;
+	if (setjmp(harness_abort)) { printf("seed %u: interpreter error\n", seed); return 0; }
+	for (cmd = 0; cmd < 4; cmd++) {
+		int args[3];
+		args[0] = cmd == 3 ? 2 : cmd == 2 ? 4 : cmd; args[1] = cmd == 3 ? 5 : 3 + cmd * 1000; args[2] = -cmd;
+		ri[cmd] = VM_CallInterpreted2(vi, 3, args);
+	}
+	nlog_i = nslog; memcpy(log_i, slog, nslog * sizeof(slog[0]));
+
+	nslog = 0;
+	curvm = vc; compiled_mode = 1;
+	if (setjmp(harness_abort)) { printf("seed %u: compiled error\n", seed); return 1; }
+	for (cmd = 0; cmd < 4; cmd++) {
+		int args[3];
+		args[0] = cmd == 3 ? 2 : cmd == 2 ? 4 : cmd; args[1] = cmd == 3 ? 5 : 3 + cmd * 1000; args[2] = -cmd;
+		rc[cmd] = VM_CallCompiled(vc, 3, args);
+	}
+
+	for (cmd = 0; cmd < 4; cmd++)
+		if (ri[cmd] != rc[cmd]) { printf("seed %u rt %d: result %d mismatch %d vs %d\n", seed, rtchecks, cmd, ri[cmd], rc[cmd]); fail = 1; }
+	if (vi->programStack != vc->programStack) { printf("seed %u: programStack %x vs %x\n", seed, vi->programStack, vc->programStack); fail = 1; }
+	if (memcmp(img_i, img_c, STACK_BTM)) {
+		for (k = 0; k < STACK_BTM && img_i[k] == img_c[k]; k++);
+		printf("seed %u rt %d: data mismatch at %x: %08x vs %08x (init %08x)\n", seed, rtchecks, k, *(int *)(img_i + (k & ~3)), *(int *)(img_c + (k & ~3)), *(int *)(init_image + (k & ~3))); fail = 1;
+	}
+	if (nlog_i != nslog || memcmp(log_i, slog, nslog * sizeof(slog[0]))) { printf("seed %u: syscall log mismatch %d vs %d\n", seed, nlog_i, nslog); fail = 1; }
+	if (verbose) printf("seed %u: %d instructions, results %d %d %d %d, %d syscalls\n", seed, icount, rc[0], rc[1], rc[2], rc[3], nslog / 4);
+	if (vc->destroy) vc->destroy(vc);
+	free(h);
+	return fail;
+}
+
+/* times only the interpreter on the same programs, BENCH=<repeats> */
+static double bench_one(unsigned seed, int nstmts, int repeats)
+{
+	static byte img[DATA_SIZE + 64];
+	struct timespec t0, t1;
+	int k, cmd;
+	vm_t *vi;
+	vmHeader_t *h;
+
+	genpass = 0; gen_program(seed, nstmts);
+	genpass = 1; gen_program(seed, nstmts);
+	h = make_header();
+	vm_rtChecks.value = vm_rtChecks.integer = 15;
+	for (k = 0; k < DATA_SIZE; k++) img[k] = (byte)(k * 131 + seed * 7 + (k >> 7));
+	vi = make_vm(img);
+	if (setjmp(harness_abort) || !VM_PrepareInterpreter2(vi, h)) { free(h); return 0; }
+	curvm = vi; compiled_mode = 0;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (k = 0; k < repeats; k++) {
+		for (cmd = 0; cmd < 4; cmd++) {
+			int args[3];
+			args[0] = cmd == 3 ? 2 : cmd == 2 ? 4 : cmd; args[1] = cmd == 3 ? 5 : 3 + cmd * 1000; args[2] = -cmd;
+			nslog = 0;
+			VM_CallInterpreted2(vi, 3, args);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	free(h);
+	return (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+}
+
+void emu_reset(void);
+static void err_test(const char *name, int rt, void (*gen)(void))
+{
+	static byte img[DATA_SIZE + 64];
+	vm_t *vc;
+	vmHeader_t *h;
+	int args[3] = { 0, 0, 0 };
+	clen = icount = 0;
+	gen();
+	h = make_header();
+	vm_rtChecks.value = vm_rtChecks.integer = rt;
+	memset(img, 0, sizeof(img));
+	vc = make_vm(img);
+	emu_reset();
+	if (setjmp(harness_abort)) { printf("  -> %s: caught\n", name); if (vc->destroy) vc->destroy(vc); return; }
+	if (!VM_Compile(vc, h)) { printf("  -> %s: compile rejected\n", name); return; }
+	printf("  -> %s: returned %d (no error)\n", name, VM_CallCompiled(vc, 3, args));
+	vc->destroy(vc);
+}
+static fn_t ferr = { 64, 3, 4, 0 };
+static void g_baddata(void) { cf = &ferr; emit(OP_ENTER, 64); emit(OP_CONST, 0x7000); emit(OP_CONST, 4); emit(OP_LSH, 0); emit(OP_CONST, 5); emit(OP_STORE4, 0); emit(OP_CONST, 1); emit(OP_LEAVE, 64); func_end(); }
+static void g_baddataload(void) { cf = &ferr; emit(OP_ENTER, 64); emit_arg_addr(0); emit(OP_LOAD4, 0); emit(OP_CONST, 0x30000); emit(OP_ADD, 0); emit(OP_LOAD4, 0); emit(OP_LEAVE, 64); func_end(); }
+static void g_badcall(void) { cf = &ferr; emit(OP_ENTER, 64); emit(OP_CONST, 5000); emit(OP_CONST, 0); emit(OP_ADD, 0); emit(OP_CALL, 0); emit(OP_LEAVE, 64); func_end(); }
+static void g_badjump(void) { cf = &ferr; emit(OP_ENTER, 64); emit(OP_CONST, 10); emit(OP_CONST, 0); emit(OP_ADD, 0); emit(OP_JUMP, 0); emit(OP_CONST, 1); emit(OP_LEAVE, 64); func_end();
+	emit(OP_ENTER, 64); emit(OP_CONST, 2); emit(OP_LEAVE, 64); func_end(); }
+static void g_unusedjump(void) { cf = &ferr; emit(OP_ENTER, 64); emit(OP_CONST, 5); emit(OP_CONST, 1); emit(OP_ADD, 0); emit(OP_JUMP, 0); emit(OP_CONST, 1); emit(OP_CONST, 2); emit(OP_ADD, 0); emit(OP_LEAVE, 64); func_end(); }
+static void g_recurse(void) { cf = &ferr; emit(OP_ENTER, 64); emit(OP_CONST, 6); emit(OP_CALL, 0); emit(OP_LEAVE, 64); func_end(); emit(OP_ENTER, 64); emit(OP_CONST, 6); emit(OP_CALL, 0); emit(OP_LEAVE, 64); func_end(); }
+static void g_ok(void) { cf = &ferr; emit(OP_ENTER, 64); emit(OP_CONST, 42); emit(OP_LEAVE, 64); func_end(); }
+
+int main(int argc, char **argv)
+{
+	setbuf(stdout, NULL);
+	if (getenv("ERRTEST")) {
+		int rt;
+		for (rt = 15; rt < 16; rt += 15) {
+			printf("rtChecks %d\n", rt);
+			err_test("ok", rt, g_ok);
+			err_test("store out of data", rt, g_baddata);
+			err_test("load out of data", rt, g_baddataload);
+			err_test("call out of range", rt, g_badcall);
+			err_test("jump out of proc", rt, g_badjump);
+			err_test("jump to merged instruction", rt, g_unusedjump);
+			err_test("endless recursion", rt, g_recurse);
+		}
+		return 0;
+	}
+	unsigned first = argc > 1 ? atoi(argv[1]) : 1, count = argc > 2 ? atoi(argv[2]) : 100, s;
+	int nst = argc > 3 ? atoi(argv[3]) : 20, fails = 0;
+	static const int rts[] = { 15, 0, 7, 8, 1 };
+	emu_trace = getenv("TRACE") != NULL;
+	if (getenv("BENCH")) {
+		int repeats = atoi(getenv("BENCH"));
+		double t = 0;
+		pr_sample_pending = 0;	// the engine only raises it while the sampling profiler runs
+		for (s = first; s < first + count; s++)
+			t += bench_one(s, nst, repeats > 0 ? repeats : 100);
+		printf("interpreter: %.3f s for %u programs\n", t, count);
+		return 0;
+	}
+	for (s = first; s < first + count; s++)
+		fails += run_one(s, nst, rts[s % 5], count == 1);
+	{ extern void smp_report(void); smp_report(); }
+	printf("%d failures, %ld emulated instructions\n", fails, emu_steps);
+	return fails != 0;
+}
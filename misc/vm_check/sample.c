@@ -0,0 +1,24 @@
+#include "qwsvdef.h"
+#include "vm_local.h"
+#include <stdio.h>
+volatile int pr_sample_pending = 1;
+long smp_ok, smp_bad, smp_deep, smp_sys;
+void PR_SampleVM( vm_t *vm, int pc, unsigned int programStack, int syscall )
+{
+	instruction_t *inst = (instruction_t *)vm->codeBase.ptr;
+	int depth = 0, f;
+	pr_sample_pending = 1;
+	if (syscall >= 0) smp_sys++;
+	while (depth < 32) {
+		for (f = pc; f >= 0 && inst[f].op != OP_ENTER; f--) ;
+		if (f < 0) { smp_bad++; return; }
+		depth++;
+		programStack += inst[f].value;
+		if (programStack > vm->dataMask - 3) { smp_bad++; return; }
+		pc = *(int *)&vm->dataBase[programStack];
+		if (pc == -1) { smp_ok++; return; }
+		if ((unsigned)pc >= (unsigned)vm->instructionCount) { smp_bad++; return; }
+	}
+	smp_deep++;
+}
+void smp_report(void) { fprintf(stderr, "samples ok %ld bad %ld deep %ld syscall %ld\n", smp_ok, smp_bad, smp_deep, smp_sys); }
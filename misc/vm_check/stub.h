@@ -0,0 +1,29 @@
+#ifndef STUB_H
+#define STUB_H
+#define QDECL
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <setjmp.h>
+typedef int qbool;
+#define true 1
+#define false 0
+typedef unsigned char byte;
+#define ARRAY_LEN(x) (sizeof(x)/sizeof(*(x)))
+#define bound(a,b,c) ((a) >= (c) ? (a) : (b) < (a) ? (a) : (b) > (c) ? (c) : (b))
+#define Con_Printf printf
+extern jmp_buf harness_abort;
+#define SV_Error(...) (printf("SV_Error: "), printf(__VA_ARGS__), printf("\n"), longjmp(harness_abort, 1))
+#define Q_malloc(n) calloc(1, (n))
+#define Q_free free
+#define LittleLong(x) (x)
+typedef struct { char *name; char *string; float value; int integer; } cvar_t;
+typedef int vmIndex_t; typedef int vmInterpret_t; typedef void* dllSyscall_t;
+typedef union { float f; int i; unsigned int u; } floatint_t;
+typedef intptr_t (*syscall_t)(intptr_t *);
+void *Hunk_AllocName(int size, const char *name);
+extern volatile int pr_sample_pending;
+enum { g_sqrt = 80, g_sin, g_cos, g_strlcpy = 120 };
+#endif
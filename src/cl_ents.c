@@ -28,6 +28,14 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "rulesets.h"
 #include "teamplay.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ENTLERP_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define ENTLERP_NEON
+#endif
+
 static int MVD_TranslateFlags(int src);
 void TP_ParsePlayerInfo(player_state_t *, player_state_t *, player_info_t *info);	
 
@@ -36,7 +44,7 @@ extern cvar_t cl_predict_half, cl_predict_scale, cl_predict_lerp;
 extern cvar_t cl_debug_remote_prediction_errors;
 extern cvar_t cl_model_bobbing;		
 extern cvar_t cl_model_height;
-extern cvar_t cl_nolerp, cl_lerp_monsters, cl_newlerp;
+extern cvar_t cl_nolerp, cl_lerp_monsters, cl_newlerp, cl_entlerp_simd;
 extern cvar_t r_drawvweps;		
 extern  unsigned int     cl_dlight_active[MAX_DLIGHTS/32];       
 
@@ -74,6 +82,8 @@ static struct predicted_player {
 char *cl_modelnames[cl_num_modelindices];
 int cl_modelindices[cl_num_modelindices];
 
+static void CL_EntLerpBenchmark_f(void);
+
 void CL_InitEnts(void) {
 	int i;
 
@@ -172,6 +182,8 @@ void CL_InitEnts(void) {
 		}
 	}
 
+	Cmd_AddCommand("cl_entlerp_benchmark", CL_EntLerpBenchmark_f);
+
 	CL_ClearScene();
 }
 
@@ -939,6 +951,226 @@ static qbool CL_SetAlphaByDistance(entity_t* ent)
 	return true;
 }
 
+// Interpolated packet entity origins and angles for the frame being linked.
+// Kept as structure-of-arrays so that the blend loops vectorize, the per-entity
+// link pass then only reads the results.
+typedef struct packet_entity_lerp_s {
+	int count;
+
+	float origin_frac[MAX_MVD_PACKET_ENTITIES];
+	float origin_base[3][MAX_MVD_PACKET_ENTITIES];
+	float origin_delta[3][MAX_MVD_PACKET_ENTITIES];
+	float origin[3][MAX_MVD_PACKET_ENTITIES];
+
+	float angles_frac[MAX_MVD_PACKET_ENTITIES];
+	float angles_base[3][MAX_MVD_PACKET_ENTITIES];
+	float angles_delta[3][MAX_MVD_PACKET_ENTITIES];
+	float angles[3][MAX_MVD_PACKET_ENTITIES];
+} packet_entity_lerp_t;
+
+static packet_entity_lerp_t cl_packet_lerp;
+
+// set by cl_entlerp_benchmark to time the plain C path
+static qbool cl_entlerp_simd_disabled;
+
+static qbool CL_EntLerpSIMDEnabled(void)
+{
+#if defined(ENTLERP_SSE2) || defined(ENTLERP_NEON)
+	return cl_entlerp_simd.integer && !cl_entlerp_simd_disabled;
+#else
+	return false;
+#endif
+}
+
+// out = base + frac * delta, same arithmetic as VectorInterpolate/VectorMA.
+// The SIMD paths multiply and add separately, so the results are identical.
+static void CL_BlendPacketEntityLerp(int count, float* out, const float* base, const float* delta, const float* frac)
+{
+	int i = 0;
+
+	if (CL_EntLerpSIMDEnabled()) {
+#if defined(ENTLERP_SSE2)
+		for (; i + 4 <= count; i += 4) {
+			__m128 product = _mm_mul_ps(_mm_loadu_ps(frac + i), _mm_loadu_ps(delta + i));
+
+			_mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(base + i), product));
+		}
+#elif defined(ENTLERP_NEON)
+		for (; i + 4 <= count; i += 4) {
+			float32x4_t product = vmulq_f32(vld1q_f32(frac + i), vld1q_f32(delta + i));
+
+			vst1q_f32(out + i, vaddq_f32(vld1q_f32(base + i), product));
+		}
+#endif
+	}
+
+	for (; i < count; i++) {
+		out[i] = base[i] + frac[i] * delta[i];
+	}
+}
+
+static float CL_AngleDelta(float from, float to)
+{
+	float delta = to - from;
+
+	if (delta > 180) {
+		delta -= 360;
+	}
+	else if (delta < -180) {
+		delta += 360;
+	}
+	return delta;
+}
+
+// Reduces every entity's interpolation to base + frac * delta, then blends them all at once
+static void CL_InterpolatePacketEntities(packet_entities_t* pack)
+{
+	extern qbool cl_nolerp_on_entity_flag;
+	packet_entity_lerp_t* l = &cl_packet_lerp;
+	double time = cls.mvdplayback ? cls.demotime : cl.time;
+	entity_state_t* state;
+	centity_t* cent;
+	float lerp;
+	int pnum, j;
+
+	l->count = min(pack->num_entities, MAX_MVD_PACKET_ENTITIES);
+
+	for (pnum = 0; pnum < l->count; pnum++) {
+		state = &pack->entities[pnum];
+		cent = &cl_entities[state->number];
+
+		if (((cl_nolerp.value || cl_nolerp_on_entity_flag) && !cls.mvdplayback && !is_monster(state->modelindex))
+			|| cent->deltalerp <= 0)
+		{
+			lerp = -1;
+			l->origin_frac[pnum] = 0;
+			for (j = 0; j < 3; j++) {
+				l->origin_base[j][pnum] = cent->current.origin[j];
+				l->origin_delta[j][pnum] = 0;
+			}
+		}
+		else
+		{
+			lerp = (time - cent->startlerp) / (cent->deltalerp);
+			lerp = min(lerp, 1);
+
+			if (NewLerp_AbleModel(cent->current.modelindex))
+			{
+				float d = time - cent->startlerp;
+
+				if (d >= 2 * cent->deltalerp) {
+					// Seems enitity stopped move.
+					l->origin_frac[pnum] = 0;
+					for (j = 0; j < 3; j++) {
+						l->origin_base[j][pnum] = cent->lerp_origin[j];
+						l->origin_delta[j][pnum] = 0;
+					}
+				}
+				else {
+					// extrapolate along velocity
+					l->origin_frac[pnum] = d;
+					for (j = 0; j < 3; j++) {
+						l->origin_base[j][pnum] = cent->old_origin[j];
+						l->origin_delta[j][pnum] = cent->velocity[j];
+					}
+				}
+			}
+			else
+			{
+				l->origin_frac[pnum] = lerp;
+				for (j = 0; j < 3; j++) {
+					l->origin_base[j][pnum] = cent->old_origin[j];
+					l->origin_delta[j][pnum] = cent->current.origin[j] - cent->old_origin[j];
+				}
+			}
+		}
+
+		if (lerp != -1) {
+			l->angles_frac[pnum] = lerp;
+			for (j = 0; j < 3; j++) {
+				l->angles_base[j][pnum] = cent->old_angles[j];
+				l->angles_delta[j][pnum] = CL_AngleDelta(cent->old_angles[j], cent->current.angles[j]);
+			}
+		}
+		else {
+			l->angles_frac[pnum] = 0;
+			for (j = 0; j < 3; j++) {
+				l->angles_base[j][pnum] = cent->current.angles[j];
+				l->angles_delta[j][pnum] = 0;
+			}
+		}
+	}
+
+	for (j = 0; j < 3; j++) {
+		CL_BlendPacketEntityLerp(l->count, l->origin[j], l->origin_base[j], l->origin_delta[j], l->origin_frac);
+		CL_BlendPacketEntityLerp(l->count, l->angles[j], l->angles_base[j], l->angles_delta[j], l->angles_frac);
+	}
+}
+
+// Times the interpolation pass with and without SIMD over every frame still held in
+// cl.frames, so during demo playback it measures recorded frames, and checks they agree.
+static void CL_EntLerpBenchmark_f(void)
+{
+	static float origin[2][3][MAX_MVD_PACKET_ENTITIES], angles[2][3][MAX_MVD_PACKET_ENTITIES];
+	packet_entities_t* packs[UPDATE_BACKUP];
+	int i, f, j, pass, npacks = 0, entities = 0, mismatch = 0, iterations = 1000;
+	double time[2], start;
+
+	if (cls.state != ca_active || !cl.validsequence) {
+		Com_Printf("Must be connected or playing a demo\n");
+		return;
+	}
+
+	if (Cmd_Argc() > 1) {
+		iterations = bound(1, Q_atoi(Cmd_Argv(1)), 1000000);
+	}
+
+	for (f = 0; f < UPDATE_BACKUP; f++) {
+		frame_t* frame = &cl.frames[(cl.validsequence - f) & UPDATE_MASK];
+
+		if (!frame->invalid && frame->packet_entities.num_entities > 0) {
+			packs[npacks++] = &frame->packet_entities;
+			entities += frame->packet_entities.num_entities;
+		}
+	}
+	if (!npacks) {
+		Com_Printf("No packet entities in the frame history\n");
+		return;
+	}
+
+	for (pass = 0; pass < 2; pass++) {
+		cl_entlerp_simd_disabled = !pass;
+
+		start = Sys_DoubleTime();
+		for (i = 0; i < iterations; i++) {
+			for (f = 0; f < npacks; f++) {
+				CL_InterpolatePacketEntities(packs[f]);
+			}
+		}
+		time[pass] = Sys_DoubleTime() - start;
+
+		// keep the results of the newest frame to compare the two paths
+		CL_InterpolatePacketEntities(packs[0]);
+		memcpy(origin[pass], cl_packet_lerp.origin, sizeof(origin[pass]));
+		memcpy(angles[pass], cl_packet_lerp.angles, sizeof(angles[pass]));
+	}
+	cl_entlerp_simd_disabled = false;
+
+	for (j = 0; j < 3; j++) {
+		for (i = 0; i < cl_packet_lerp.count; i++) {
+			mismatch |= origin[0][j][i] != origin[1][j][i] || angles[0][j][i] != angles[1][j][i];
+		}
+	}
+
+	Com_Printf("%d frames, %d entities, %d iterations\n", npacks, entities, iterations);
+	Com_Printf("%-10s %11s %11s\n", "", "scalar", "simd");
+	Com_Printf("%-10s %8.3f us %8.3f us  %s\n", "per frame", time[0] * 1000000.0 / (iterations * npacks),
+		time[1] * 1000000.0 / (iterations * npacks), mismatch ? "MISMATCH" : "ok");
+	if (!CL_EntLerpSIMDEnabled()) {
+		Com_Printf("No SIMD path in use%s, both columns time plain C\n", cl_entlerp_simd.integer ? "" : " (cl_entlerp_simd is 0)");
+	}
+}
+
 // TODO: OMG SPLIT THIS UP!
 void CL_LinkPacketEntities(void) 
 {
@@ -947,11 +1179,10 @@ void CL_LinkPacketEntities(void)
 	packet_entities_t *pack;
 	entity_state_t *state;
 	model_t *model;
-	double time;
-	float autorotate, lerp;
+	float autorotate;
 	int i, pnum, flicker;
 	customlight_t cst_lt = {0};
-	extern qbool cl_nolerp_on_entity_flag;
+	qbool link_world = CL_MultiviewLinkWorld();
 
 	pack = &cl.frames[cl.validsequence & UPDATE_MASK].packet_entities;
 
@@ -959,13 +1190,18 @@ void CL_LinkPacketEntities(void)
 
 	memset(&ent, 0, sizeof(ent));
 
-	for (pnum = 0; pnum < pack->num_entities; pnum++) 
+	// Other multiview views reuse the first view's interpolation, world state hasn't changed
+	if (link_world || cl_packet_lerp.count != min(pack->num_entities, MAX_MVD_PACKET_ENTITIES)) {
+		CL_InterpolatePacketEntities(pack);
+	}
+
+	for (pnum = 0; pnum < cl_packet_lerp.count; pnum++) 
 	{
 		state = &pack->entities[pnum];
 		cent = &cl_entities[state->number];
 
 		// Control powerup glow for bots.
-		if (state->modelindex != cl_modelindices[mi_player] || r_powerupglow.value) 
+		if (link_world && (state->modelindex != cl_modelindices[mi_player] || r_powerupglow.value))
 		{
 			flicker = r_lightflicker.value ? (rand() & 31) : 0;
 			
@@ -1117,32 +1353,9 @@ void CL_LinkPacketEntities(void)
 			ent.scoreboard = NULL;
 		}
 	
-		if (((cl_nolerp.value || cl_nolerp_on_entity_flag) && !cls.mvdplayback && !is_monster(state->modelindex))
-			|| cent->deltalerp <= 0)
-		{
-			lerp = -1;
-			VectorCopy(cent->current.origin, ent.origin);
-		} 
-		else 
-		{
-			time = cls.mvdplayback ? cls.demotime : cl.time;
-			lerp = (time - cent->startlerp) / (cent->deltalerp);
-			lerp = min(lerp, 1);
-
-			if (NewLerp_AbleModel(cent->current.modelindex))
-			{
-				float d = time - cent->startlerp;
-
-				if (d >= 2 * cent->deltalerp) // Seems enitity stopped move.
-					VectorCopy(cent->lerp_origin, ent.origin);
-				else // interpolate
-					VectorMA(cent->old_origin, d, cent->velocity, ent.origin);
-			}
-			else
-			{
-				VectorInterpolate(cent->old_origin, lerp, cent->current.origin, ent.origin);
-			}
-		}
+		ent.origin[0] = cl_packet_lerp.origin[0][pnum];
+		ent.origin[1] = cl_packet_lerp.origin[1][pnum];
+		ent.origin[2] = cl_packet_lerp.origin[2][pnum];
 #if defined(FTE_PEXT_TRANS)
 		// set trans, 0 and 255 are both opaque, represented by alpha 0.
 		ent.alpha = state->trans == 255 ? 0.0f : (float)state->trans / 254.0f;
@@ -1178,14 +1391,9 @@ void CL_LinkPacketEntities(void)
 		} 
 		else 
 		{
-			if (lerp != -1) 
-			{
-				AngleInterpolate(cent->old_angles, lerp, cent->current.angles, ent.angles);
-			}
-			else 
-			{
-				VectorCopy(cent->current.angles, ent.angles);
-			}
+			ent.angles[0] = cl_packet_lerp.angles[0][pnum];
+			ent.angles[1] = cl_packet_lerp.angles[1][pnum];
+			ent.angles[2] = cl_packet_lerp.angles[2][pnum];
 		}
 
 		if (qmb_initialized) 
@@ -1196,7 +1404,9 @@ void CL_LinkPacketEntities(void)
 
 				if (gl_part_inferno.value) 
 				{
-					QMB_InfernoFlame (ent.origin);
+					if (link_world) {
+						QMB_InfernoFlame (ent.origin);
+					}
 					continue;
 				}
 			}
@@ -1206,7 +1416,9 @@ void CL_LinkPacketEntities(void)
 				extern cvar_t gl_part_bubble;
 
 				if (gl_part_bubble.value) {
-					QMB_StaticBubble(&ent);
+					if (link_world) {
+						QMB_StaticBubble(&ent);
+					}
 					continue;
 				}
 			}
@@ -1214,7 +1426,7 @@ void CL_LinkPacketEntities(void)
 
 		// Add trails
 		VectorCopy(ent.origin, cent->lerp_origin);
-		if ((model->flags & ~EF_ROTATE) || model->modhint) {
+		if (link_world && ((model->flags & ~EF_ROTATE) || model->modhint)) {
 			CL_AddParticleTrail(&ent, cent, &cst_lt, state);
 		}
 
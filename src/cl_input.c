@@ -1185,6 +1185,73 @@ void CL_SendClientCommand(qbool reliable, char* format, ...)
 
 int cmdtime_msec = 0;
 
+// Wall-clock spacing of outgoing movement packets, see cl_cmdstats
+static struct {
+	int packets;
+	double last_sent;
+	double interval_sum;
+	double interval_sqsum;
+	double interval_max;
+	int catchup_packets;	// usercmds sent late by cl_physfps_catchup
+	double catchup_lag_sum;
+	double catchup_lag_max;
+	double dropped_time;	// missed time beyond cl_physfps_catchup that was never sent
+} cmd_cadence;
+
+void CL_CmdStatsCatchup(double lag)
+{
+	cmd_cadence.catchup_packets++;
+	cmd_cadence.catchup_lag_sum += lag;
+	cmd_cadence.catchup_lag_max = max(cmd_cadence.catchup_lag_max, lag);
+}
+
+void CL_CmdStatsDropped(double time)
+{
+	cmd_cadence.dropped_time += time;
+}
+
+static void CL_RecordCmdCadence(void)
+{
+	double now = Sys_DoubleTime();
+	double interval = now - cmd_cadence.last_sent;
+
+	// Don't count gaps across disconnects, pauses etc
+	if (cmd_cadence.last_sent && interval < 1.0) {
+		cmd_cadence.packets++;
+		cmd_cadence.interval_sum += interval;
+		cmd_cadence.interval_sqsum += interval * interval;
+		cmd_cadence.interval_max = max(cmd_cadence.interval_max, interval);
+	}
+	cmd_cadence.last_sent = now;
+}
+
+static void CL_CmdStats_f(void)
+{
+	double mean, deviation;
+
+	if (Cmd_Argc() == 2 && !strcmp(Cmd_Argv(1), "reset")) {
+		memset(&cmd_cadence, 0, sizeof(cmd_cadence));
+		return;
+	}
+
+	if (!cmd_cadence.packets) {
+		Com_Printf("No movement packets sent\n");
+		return;
+	}
+
+	mean = cmd_cadence.interval_sum / cmd_cadence.packets;
+	deviation = sqrt(max(0, cmd_cadence.interval_sqsum / cmd_cadence.packets - mean * mean));
+	Com_Printf("Movement packets: %d (%.1f/s)\n", cmd_cadence.packets, mean > 0 ? 1 / mean : 0);
+	Com_Printf("Interval: avg %.3f ms, stddev %.3f ms, max %.3f ms\n", mean * 1000.0, deviation * 1000.0, cmd_cadence.interval_max * 1000.0);
+	if (cmd_cadence.catchup_packets) {
+		Com_Printf("Catch-up: %d sent late, avg %.3f ms, max %.3f ms\n", cmd_cadence.catchup_packets,
+			cmd_cadence.catchup_lag_sum * 1000.0 / cmd_cadence.catchup_packets, cmd_cadence.catchup_lag_max * 1000.0);
+	}
+	if (cmd_cadence.dropped_time > 0) {
+		Com_Printf("Dropped: %.3f ms of missed time beyond cl_physfps_catchup\n", cmd_cadence.dropped_time * 1000.0);
+	}
+}
+
 static void CL_PrintSafestrafeFrames(const usercmd_t *cmd)
 {
 	static int last_enabled = 0;
@@ -1481,6 +1548,8 @@ void CL_SendCmd(void)
 
 	// deliver the message
 	Netchan_Transmit(&cls.netchan, buf.cursize, buf.data);
+
+	CL_RecordCmdCadence();
 }
 
 void CL_InitInput(void)
@@ -1528,6 +1597,7 @@ void CL_InitInput(void)
 	Cmd_AddCommand("+mlook", IN_MLookDown);
 	Cmd_AddCommand("-mlook", IN_MLookUp);
 	Cmd_AddCommand("rotate", CL_Rotate_f);
+	Cmd_AddCommand("cl_cmdstats", CL_CmdStats_f);
 
 	Cvar_SetCurrentGroup(CVAR_GROUP_INPUT_KEYBOARD);
 
@@ -158,6 +158,7 @@ cvar_t	cl_maxfps	= {"cl_maxfps", "0"};
 cvar_t	cl_maxfps_menu	= {"cl_maxfps_menu", "0"};
 cvar_t	cl_physfps	= {"cl_physfps", "0"};	//#fps
 cvar_t	cl_physfps_spectator = {"cl_physfps_spectator", "77"};
+cvar_t	cl_physfps_catchup = {"cl_physfps_catchup", "0"};
 cvar_t  cl_independentPhysics = {"cl_independentPhysics", "1", 0, Rulesets_OnChange_indphys};
 
 cvar_t	cl_predict_players = {"cl_predict_players", "1"};
@@ -214,6 +215,7 @@ cvar_t cl_window_caption_delimiter = {"cl_window_caption_delimiter", " | "};
 cvar_t cl_model_bobbing		= {"cl_model_bobbing", "1"};
 cvar_t cl_model_height		= {"cl_model_height", "0"};
 cvar_t cl_nolerp			= {"cl_nolerp", "0"}; // 0 is good for indep-phys, 1 is good for old-phys
+cvar_t cl_entlerp_simd		= {"cl_entlerp_simd", "1"};
 
 //this var has effect only if cl_nolerp is 1 and indep-phys enabled
 //setting it to 0 removes jerking when standing on platforms
@@ -245,6 +247,7 @@ cvar_t r_shaftalpha             = {"r_shaftalpha", "1"};
 cvar_t r_lightdecayrate         = {"r_lightdecayrate", "2"}; // default 2, as CL_DecayLights() used to get called twice per frame
 cvar_t r_lightmap_lateupload    = {"r_lightmap_lateupload", "0"};
 cvar_t r_lightmap_packbytexture = {"r_lightmap_packbytexture", "2"};
+cvar_t r_lightmap_cache         = {"r_lightmap_cache", "0"};
 
 // info mirrors
 cvar_t  password                = {"password", "", CVAR_USERINFO};
@@ -1918,6 +1921,7 @@ static void CL_InitLocal(void)
 	Cvar_Register(&cl_model_height);
 	Cvar_Register(&cl_nolerp);
 	Cvar_Register(&cl_nolerp_on_entity);
+	Cvar_Register(&cl_entlerp_simd);
 	Cvar_Register(&cl_newlerp);
 	Cvar_Register(&cl_lerp_monsters);
 	Cvar_Register(&demo_spawnwarn);
@@ -1929,6 +1933,7 @@ static void CL_InitLocal(void)
 	Cvar_Register(&hud_frametime_max_reset_interval);
 	Cvar_Register(&hud_performance_average);
 	Cvar_Register(&cl_physfps_spectator);
+	Cvar_Register(&cl_physfps_catchup);
 	Cvar_Register(&cl_independentPhysics);
 	Cvar_Register(&cl_deadbodyfilter);
 	Cvar_Register(&cl_gibfilter);
@@ -1942,6 +1947,7 @@ static void CL_InitLocal(void)
 	Cvar_Register(&r_lightflicker);
 	Cvar_Register(&r_lightmap_lateupload);
 	Cvar_Register(&r_lightmap_packbytexture);
+	Cvar_Register(&r_lightmap_cache);
 	Cvar_Register(&r_rockettrail);
 	Cvar_Register(&r_grenadetrail);
 	Cvar_Register(&r_railtrail);
@@ -2250,6 +2256,7 @@ void CL_Init (void)
 	Ignore_Init();
 	Log_Init();
 	Movie_Init();
+	FS_HotReload_Init();
 
 #ifdef _DEBUG
 	if (Expr_Run_Unit_Tests() != 0) {
@@ -2499,11 +2506,58 @@ static void CL_ServerFrame(double frametime)
 #endif
 }
 
+// Samples input, runs the local server and sends one usercmd, cl_independentPhysics only
+static void CL_PhysicsFrame(void)
+{
+	Sys_SendKeyEvents();
+
+	// allow mice or other external controllers to add commands
+	IN_Commands();
+
+	// process console commands
+	Cbuf_Execute();
+	CL_CheckAutoPause ();
+
+#ifndef CLIENTONLY
+	CL_ServerFrame(physframetime);
+#endif
+
+	// Fetch results from server
+	CL_ReadPackets();
+
+	TP_UpdateSkins();
+
+	// Gather MVD stats and interpolate.
+	if (cls.mvdplayback && !cls.demoseeking)
+	{
+		MVD_Interpolate();
+		MVD_Mainhook();
+
+		if (!cl.standby && physframe) {
+			StatsGrid_Gather();
+		}
+	}
+
+	// process stuffed commands
+	Cbuf_ExecuteEx(&cbuf_svc);
+
+	CL_SendToServer();
+
+	// We need to move the mouse also when disconnected
+	if (cls.state == ca_disconnected) {
+		usercmd_t dummy;
+		IN_Move(&dummy);
+	}
+
+	Sys_SendDeferredKeyEvents();
+}
+
 void CL_Frame(double time)
 {
 	static double extratime = 0.001;
 	double minframetime;
 	static double	extraphysframetime;	//#fps
+	static int physframes_backlog;	// missed physics frames still to be sent, see cl_physfps_catchup
 	qbool need_server_frame = false;
 
 	extratime += time;
@@ -2560,6 +2614,10 @@ void CL_Frame(double time)
 	{
 		double minphysframetime = MinPhysFrameTime();
 
+		if (cl_physfps_catchup.integer <= 0) {
+			physframes_backlog = 0;
+		}
+
 		extraphysframetime += cls.frametime;
 		if (extraphysframetime < minphysframetime) {
 			physframe = false;
@@ -2567,19 +2625,38 @@ void CL_Frame(double time)
 		else {
 			physframe = true;
 
+			if (cl_physfps_catchup.integer > 0 && minphysframetime > 0) {
+				int missed;
+
+				// Keep usercmd duration fixed and queue the whole frames we missed instead
+				// of sending one long usercmd.  They go out one per rendered frame below.
+				physframetime = minphysframetime;
+				extraphysframetime -= physframetime;
+				missed = (int)(extraphysframetime / minphysframetime);
+				extraphysframetime -= missed * minphysframetime;
+				physframes_backlog += missed;
+
+				// Don't build up a backlog after long stalls (map load etc), that time is lost
+				if (physframes_backlog > cl_physfps_catchup.integer) {
+					CL_CmdStatsDropped((physframes_backlog - cl_physfps_catchup.integer) * minphysframetime);
+					physframes_backlog = cl_physfps_catchup.integer;
+				}
+			}
 			// FIXME: this is for the case when actual fps is too low.  Dunno how to do it right
-			if (extraphysframetime > minphysframetime * 2) {
+			else if (extraphysframetime > minphysframetime * 2) {
 				physframetime = extraphysframetime;
+				extraphysframetime -= physframetime;
 			}
 			else {
 				physframetime = minphysframetime;
+				extraphysframetime -= physframetime;
 			}
-			extraphysframetime -= physframetime;
 		}
 	} 
 	else {
 		// this vars SHOULD NOT be used in case of cl_independentPhysics == 0, so we just reset it for sanity
 		physframetime = extraphysframetime = 0;
+		physframes_backlog = 0;
 		// this var actually used
 		physframe = true;
 	}
@@ -2672,47 +2749,24 @@ void CL_Frame(double time)
 	else 
 	{
 		if (physframe) {
-			Sys_SendKeyEvents();
-
-			// allow mice or other external controllers to add commands
-			IN_Commands();
-
-			// process console commands
-			Cbuf_Execute();
-			CL_CheckAutoPause ();
-
-#ifndef CLIENTONLY
-			CL_ServerFrame(physframetime);
-#endif
-
-			// Fetch results from server
-			CL_ReadPackets();
-
-			TP_UpdateSkins();
-
-			// Gather MVD stats and interpolate.
-			if (cls.mvdplayback && !cls.demoseeking)
-			{
-				MVD_Interpolate();
-				MVD_Mainhook();
-
-				if (!cl.standby && physframe) {
-					StatsGrid_Gather();
-				}
+			CL_PhysicsFrame();
+
+			// Render frame took longer than a physics frame, send one of the usercmds we missed.
+			// Sending them all at once would put a burst of packets with the same timestamp on
+			// the wire, so the rest is spread over the following rendered frames.
+			if (physframes_backlog > 0) {
+				CL_CmdStatsCatchup(physframes_backlog * physframetime);
+				physframes_backlog--;
+				CL_PhysicsFrame();
 			}
-
-			// process stuffed commands
-			Cbuf_ExecuteEx(&cbuf_svc);
-
-			CL_SendToServer();
-
-			// We need to move the mouse also when disconnected
-			if (cls.state == ca_disconnected) {
-				usercmd_t dummy;
-				IN_Move(&dummy);
-			}
-
-			Sys_SendDeferredKeyEvents();
+		}
+		else if (physframes_backlog > 0) {
+			// No physics frame due, use the rendered frame to send a missed usercmd
+			physframe = true;
+			physframetime = MinPhysFrameTime();
+			CL_CmdStatsCatchup(physframes_backlog * physframetime);
+			physframes_backlog--;
+			CL_PhysicsFrame();
 		}
 		else {
 			if (need_server_frame && PROCESS_SERVERPACKETS_IMMEDIATELY) {
@@ -2771,6 +2825,7 @@ void CL_Frame(double time)
 	buffers.StartFrame();
 
 	CachePics_AtlasFrame();
+	Mod_LazySkinsFrame();
 
 	CL_MultiviewPreUpdateScreen();
 
@@ -2865,6 +2920,7 @@ void CL_Frame(double time)
 	CL_CalcFPS();
 
 	VFS_TICK(); // VFS hook for updating some systems
+	FS_HotReload_Frame();
 
 	Sys_ReadIPC();
 
@@ -2899,6 +2955,7 @@ void CL_Shutdown (void)
 	S_Shutdown();
 	IN_Shutdown ();
 	Log_Shutdown();
+	FS_HotReload_Shutdown();
 	if (host_basepal) {
 		VID_Shutdown(false);
 	}
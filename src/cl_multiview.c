@@ -56,6 +56,7 @@ static int rewind_duel_track1 = 0;
 static int rewind_duel_track2 = 0;
 
 static int next_spec_track = -1;
+static qbool world_linked = false;       // view-independent entity work already done this frame
 extern cvar_t gl_polyblend;
 extern cvar_t gl_clear;
 
@@ -1440,6 +1441,24 @@ int CL_MultiviewActiveViews (void)
 void CL_MultiviewFrameStart (void)
 {
 	next_spec_track = -1;
+	world_linked = false;
+}
+
+// Entities are linked once per view, but interpolation, particle trails and dlights
+// only depend on the world state. Returns true if the caller should do that work,
+// i.e. for the first view of the frame (or always without multiview).
+qbool CL_MultiviewLinkWorld (void)
+{
+	if (!CL_MultiviewEnabled ()) {
+		return true;
+	}
+
+	if (world_linked) {
+		return false;
+	}
+
+	world_linked = true;
+	return true;
 }
 
 void CL_MultiviewFrameFinish (void)
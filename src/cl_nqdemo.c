@@ -566,6 +566,7 @@ static void NQD_ParseServerData(void)
 		}
 	}
 
+	S_BeginPrecache();
 	for (i = 1; i < numsounds; i++) {
 		cl.sound_precache[i] = S_PrecacheSound(cl.sound_name[i]);
 	}
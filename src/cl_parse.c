@@ -605,6 +605,9 @@ static void CL_TransmitModelCrc (int index, char *info_key)
 
 void CL_Prespawn (void)
 {
+	// everything precached is loaded by now
+	FS_PrefetchClear();
+
 	cl.worldmodel = cl.model_precache[1];
 	if (!cl.worldmodel)
 		Host_Error ("Model_NextDownload: NULL worldmodel");
@@ -799,6 +802,7 @@ void Sound_NextDownload (void)
 			return;		// started a download
 	}
 
+	S_BeginPrecache();
 	for (i = 1; i < MAX_SOUNDS; i++) 
 	{
 		if (!cl.sound_name[i][0])
@@ -1756,6 +1760,11 @@ void CL_ParseSoundlist (void)
 		} while (*str);
 	}
 
+	// start reading the sounds while the modellist is on its way
+	FS_PrefetchClear();
+	for (n = 1; n < MAX_SOUNDS && cl.sound_name[n][0]; n++)
+		FS_PrefetchQueue(va("sound/%s", cl.sound_name[n]));
+
 	// AFTER we got the soundlist, request the modellist (older FTE servers will send it right away anyway)
 	// done with sounds, request models now
 	memset (cl.model_precache, 0, sizeof(cl.model_precache));
@@ -1857,6 +1866,15 @@ void CL_ParseModellist (qbool extended)
 				}
 		} while (*str);
 	}
+	// models load after the sounds, which gives the map time to be read;
+	// it is queued twice as CM_LoadMap and Mod_ForName both open it
+	FS_PrefetchQueue(cl.model_name[1]);
+	for (n = 1; n < MAX_MODELS && cl.model_name[n][0]; n++)
+	{
+		if (cl.model_name[n][0] != '*')
+			FS_PrefetchQueue(cl.model_name[n]);
+	}
+
 	// We now get here after having received both soundlist and modellist, but no
 	// sounds have been downloaded yet, we must do that first, when that is finished
 	// it will call for model download 
@@ -35,6 +35,7 @@ cvar_t	cl_predict_projectiles = { "cl_predict_projectiles", "1" };
 cvar_t	cl_predict_explosions = { "cl_predict_explosions", "1" };
 cvar_t	cl_predict_sound = { "cl_predict_sound", "1" };
 cvar_t	cl_predict_buffer = { "cl_predict_buffer", "1" };
+cvar_t	cl_predict_incremental = { "cl_predict_incremental", "0" };
 
 qbool CL_PredictProjectilesEnabled(void)
 {
@@ -101,6 +102,34 @@ extern cvar_t cl_predict_buffer;
 static qbool nolerp[2];
 static qbool nolerp_nextpos;
 
+// Predicted states from the previous replay, keyed by outgoing sequence, so the
+// next replay can resume from them.  When a new server frame arrives its player
+// state is compared with the one predicted for it; if they agree (within the
+// precision the server sends) the frames after it are kept, up to the first one
+// that comes near a solid entity or player that has moved since.  Prediction
+// also reads the weapon, ammo, items, jump and water state and the movevars, so
+// any difference there replays everything.
+typedef struct predicted_state_cache_s {
+	int				sequence;
+	player_state_t	state;
+} predicted_state_cache_t;
+
+static predicted_state_cache_t predict_cache[UPDATE_BACKUP];
+static qbool predict_cache_used;
+
+static int predict_cache_base = -1;	// cl.validsequence the last replay started from
+static int predict_cache_nopred_weapon;
+static movevars_t predict_cache_movevars;
+static int predict_cache_numphysent;
+static physent_t predict_cache_physents[MAX_PHYSENTS];	// the world the cached frames were predicted in
+
+#define PREDICT_CACHE_ORIGIN_EPSILON	0.125f	// coords are sent in 1/8 units
+#define PREDICT_CACHE_VELOCITY_EPSILON	1.0f	// velocity is sent in whole units
+#define PREDICT_CACHE_MARGIN			32.0f	// step ups, ground checks and nudges around the move
+
+int cl_predict_pmoves;		// pmoves run by the last prediction replay
+int cl_predict_reused;		// frames the last replay took from the cache
+
 #define CSQC_SMOOTH_MIN_ERROR 1.0f
 #define CSQC_SMOOTH_SNAP_ERROR 160.0f
 #define CSQC_SMOOTH_MAX_OFFSET 96.0f
@@ -641,8 +670,261 @@ void CL_PlayEvents(void)
 	}
 }
 
+static void CL_PredictCacheClear(void)
+{
+	int i;
+
+	for (i = 0; i < UPDATE_BACKUP; i++) {
+		predict_cache[i].sequence = -1;
+	}
+	predict_cache_base = -1;
+	predict_cache_used = false;
+}
+
+static qbool CL_PredictCacheStateMatches(const player_state_t *server, const player_state_t *cached)
+{
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		if (fabs(server->origin[i] - cached->origin[i]) > PREDICT_CACHE_ORIGIN_EPSILON
+			|| fabs(server->velocity[i] - cached->velocity[i]) > PREDICT_CACHE_VELOCITY_EPSILON) {
+			return false;
+		}
+	}
+
+	if (server->pm_type != cached->pm_type || server->jump_held != cached->jump_held
+		|| server->waterjumptime != cached->waterjumptime) {
+		return false;
+	}
+	// pmove only reads these with pground and without Z_EXT_PM_TYPE
+	if (movevars.pground && server->onground != cached->onground) {
+		return false;
+	}
+	if (!(cl.z_ext & Z_EXT_PM_TYPE) && server->jump_msec != cached->jump_msec) {
+		return false;
+	}
+
+	// carried through every move unchanged, so the cached frames must have the server's
+	return server->weapon_index == cached->weapon_index && server->weaponframe == cached->weaponframe
+		&& server->weapon == cached->weapon && server->items == cached->items && server->impulse == cached->impulse
+		&& server->ammo_shells == cached->ammo_shells && server->ammo_nails == cached->ammo_nails
+		&& server->ammo_rockets == cached->ammo_rockets && server->ammo_cells == cached->ammo_cells
+		&& server->client_time == cached->client_time && server->attack_finished == cached->attack_finished
+		&& server->client_nextthink == cached->client_nextthink && server->client_thinkindex == cached->client_thinkindex
+		&& server->client_ping == cached->client_ping && server->client_predflags == cached->client_predflags;
+}
+
+static qbool CL_PredictCachePhysentIn(const physent_t *pe, const physent_t *list, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (pe->model == list[i].model && pe->info == list[i].info
+			&& VectorCompare(pe->origin, list[i].origin)
+			&& VectorCompare(pe->mins, list[i].mins)
+			&& VectorCompare(pe->maxs, list[i].maxs)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void CL_PredictCachePhysentBounds(const physent_t *pe, vec3_t mins, vec3_t maxs)
+{
+	if (pe->model) {
+		VectorAdd(pe->origin, pe->model->mins, mins);
+		VectorAdd(pe->origin, pe->model->maxs, maxs);
+	}
+	else {
+		VectorAdd(pe->origin, pe->mins, mins);
+		VectorAdd(pe->origin, pe->maxs, maxs);
+	}
+}
+
+// Bounds of the physents that are not in both the cached world and the current
+// one, so both where a moved entity was and where it is now count
+static int CL_PredictCacheChangedPhysents(vec3_t *mins, vec3_t *maxs)
+{
+	int i, count = 0;
+
+	for (i = 0; i < pmove.numphysent; i++) {
+		if (!CL_PredictCachePhysentIn(&pmove.physents[i], predict_cache_physents, predict_cache_numphysent)) {
+			CL_PredictCachePhysentBounds(&pmove.physents[i], mins[count], maxs[count]);
+			count++;
+		}
+	}
+	for (i = 0; i < predict_cache_numphysent; i++) {
+		if (!CL_PredictCachePhysentIn(&predict_cache_physents[i], pmove.physents, pmove.numphysent)) {
+			CL_PredictCachePhysentBounds(&predict_cache_physents[i], mins[count], maxs[count]);
+			count++;
+		}
+	}
+
+	return count;
+}
+
+// Could the move from one predicted state to the next have touched any of the changed physents?
+static qbool CL_PredictCacheMoveTouches(player_state_t *from, player_state_t *to, const usercmd_t *cmd, int changed, vec3_t *changed_mins, vec3_t *changed_maxs)
+{
+	extern vec3_t player_mins, player_maxs;
+	vec3_t mins, maxs;
+	float margin;
+	int i, j;
+
+	margin = PREDICT_CACHE_MARGIN + max(VectorLength(from->velocity), VectorLength(to->velocity)) * cmd->msec * 0.001;
+	for (i = 0; i < 3; i++) {
+		mins[i] = min(from->origin[i], to->origin[i]) + player_mins[i] - margin;
+		maxs[i] = max(from->origin[i], to->origin[i]) + player_maxs[i] + margin;
+	}
+
+	for (j = 0; j < changed; j++) {
+		for (i = 0; i < 3; i++) {
+			if (mins[i] > changed_maxs[j][i] || maxs[i] < changed_mins[j][i]) {
+				break;
+			}
+		}
+		if (i == 3) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Returns the first frame offset from cl.validsequence that has to be simulated.
+// Earlier frames are restored from the cache: the last replay must have predicted
+// the same state the server now sends for cl.validsequence, and the frames stop at
+// the first one near a physent that has changed since.  The newest frame is always
+// simulated so pmove is left in the same state a full replay would leave it in.
+static int CL_PredictCacheRestore(void)
+{
+	static vec3_t changed_mins[2 * MAX_PHYSENTS], changed_maxs[2 * MAX_PHYSENTS];
+	predicted_state_cache_t *entry;
+	player_state_t *from;
+	int i, changed;
+
+	if (!cl_predict_incremental.integer || CL_EZCSQC_Active()) {
+		return 1;
+	}
+
+	if (predict_cache_base < 0 || predict_cache_base > cl.validsequence) {
+		return 1;
+	}
+
+	// the replay sets these before every move
+	movevars.entgravity = cl.entgravity;
+	movevars.maxspeed = cl.maxspeed;
+	movevars.bunnyspeedcap = cl.bunnyspeedcap;
+	if (predict_cache_nopred_weapon != pmove_nopred_weapon
+		|| memcmp(&predict_cache_movevars, &movevars, sizeof(movevars))) {
+		return 1;
+	}
+
+	from = &cl.frames[cl.validsequence & UPDATE_MASK].playerstate[cl.playernum];
+	if (cl.validsequence != predict_cache_base) {
+		entry = &predict_cache[cl.validsequence & UPDATE_MASK];
+		if (entry->sequence != cl.validsequence || !CL_PredictCacheStateMatches(from, &entry->state)) {
+			return 1;
+		}
+	}
+
+	changed = CL_PredictCacheChangedPhysents(changed_mins, changed_maxs);
+
+	for (i = 1; i < UPDATE_BACKUP - 1 && cl.validsequence + i < cls.netchan.outgoing_sequence - 1; i++) {
+		int sequence = cl.validsequence + i;
+		frame_t *frame = &cl.frames[sequence & UPDATE_MASK];
+
+		entry = &predict_cache[sequence & UPDATE_MASK];
+		if (entry->sequence != sequence) {
+			break;
+		}
+		if (changed && CL_PredictCacheMoveTouches(from, &entry->state, &frame->cmd, changed, changed_mins, changed_maxs)) {
+			break;
+		}
+		frame->playerstate[cl.playernum] = entry->state;
+		from = &entry->state;
+	}
+
+	return i;
+}
+
+// Remembers what the cached frames were predicted with, after a replay
+static void CL_PredictCacheSetWorld(void)
+{
+	predict_cache_base = cl.validsequence;
+	predict_cache_nopred_weapon = pmove_nopred_weapon;
+	predict_cache_movevars = movevars;
+	predict_cache_numphysent = pmove.numphysent;
+	memcpy(predict_cache_physents, pmove.physents, pmove.numphysent * sizeof(pmove.physents[0]));
+}
+
+static void CL_PredictCacheStore(int sequence, const player_state_t *state)
+{
+	predicted_state_cache_t *entry = &predict_cache[sequence & UPDATE_MASK];
+
+	entry->sequence = sequence;
+	entry->state = *state;
+	predict_cache_used = true;
+}
+
+// Drops prediction events that will be generated again by this replay, along
+// with those for frames the server has already acknowledged.
+static void CL_PredictClearEvents(int first_frame)
+{
+	prediction_event_sound_t **link = &p_event_sound;
+
+	while (*link != NULL) {
+		prediction_event_sound_t *s_event = *link;
+
+		if (s_event->frame_num >= first_frame || s_event->frame_num <= cl.validsequence) {
+			*link = s_event->next;
+			free(s_event);
+		}
+		else {
+			link = &s_event->next;
+		}
+	}
+}
+
+// Compares the frame the last replay ended on with what this replay predicted for
+// it, and nudges the view by the difference
+static void CL_PredictCheckError(player_state_t *state, player_state_t *server_state, qbool smoothview_enabled)
+{
+	// if our origin is significantly wrong, add it to our nudge vector
+	vec3_t diff;
+	float error;
+	VectorSubtract(cl.simerr_org, state->origin, diff);
+	error = VectorLength(diff);
+	if (CL_PredictSmoothView_SkipError(server_state)) {
+		// Do not carry an old nudge across respawns, teleports, or PM type changes.
+		VectorClear(cl.simerr_nudge);
+	}
+	else {
+		if (cl_debug_local_prediction_errors.value > 0 && error >= cl_debug_local_prediction_errors.value) {
+			Com_Printf("Local prediction error: distance=%.2f\n",
+				error);
+		}
+		if (smoothview_enabled && CL_EZCSQC_Active())
+		{
+			CL_PredictSmoothView_AddCSQCError(diff);
+		}
+		else if (smoothview_enabled && error > 4 && error < 64)
+		{
+			float mult;
+			mult = 1 - min(0.013 / cls.latency, 1);
+			VectorScale(diff, mult, diff);
+			VectorAdd(diff, cl.simerr_nudge, cl.simerr_nudge);
+		}
+
+		// we missed some weapon state change, replay all the sounds since then
+		if (smoothview_enabled && (cl.simerr_wep != state->weapon || cl.simerr_wepframe != state->weaponframe))
+			pmove.effect_frame = cl.validsequence;
+	}
+}
+
 void CL_PredictMove (qbool physframe) {
-	int i, oldphysent;
+	int i, first, oldphysent;
 	frame_t *from = NULL, *to;
 	qbool angles_lerp = false;
 
@@ -657,8 +939,13 @@ void CL_PredictMove (qbool physframe) {
 	if (cls.nqdemoplayback)
 		return;
 
-	if (!cl.validsequence)
+	if (!cl.validsequence) {
+		// sequences restart with the connection, forget the old replay
+		if (predict_cache_used) {
+			CL_PredictCacheClear();
+		}
 		return;
+	}
 
 	if (cls.netchan.outgoing_sequence - cl.validsequence >= UPDATE_BACKUP - 1)
 		return;
@@ -711,17 +998,26 @@ void CL_PredictMove (qbool physframe) {
 		pmove_playeffects = false;
 		pmove_nopred_weapon = (cl_nopred_weapon.integer || pmove.client_predflags == PRDFL_FORCEOFF || cl.spectator);
 
-		///*
-		// cleanup all pred events
-		while (p_event_sound != NULL)
-		{
-			prediction_event_sound_t *s_event = p_event_sound;
-			p_event_sound = NULL;// s_event->next;
-			free(s_event);
+		// resume from the first frame the previous replay may have predicted differently
+		first = CL_PredictCacheRestore();
+		if (first > 1) {
+			to = &cl.frames[(cl.validsequence + first - 1) & UPDATE_MASK];
+
+			// the frame the last replay ended on is checked even if it was reused
+			if (cl.simerr_frame > cl.validsequence && cl.simerr_frame < cl.validsequence + first) {
+				player_state_t *state = &cl.frames[cl.simerr_frame & UPDATE_MASK].playerstate[cl.playernum];
+
+				CL_PredictCheckError(state, state, smoothview_enabled);
+			}
 		}
+		cl_predict_reused = first - 1;
+		cl_predict_pmoves = 0;
+
+		// cleanup pred events of the frames we are about to run
+		CL_PredictClearEvents(cl.validsequence + first);
 
 		// run frames
-		for (i = 1; i < UPDATE_BACKUP - 1 && cl.validsequence + i < cls.netchan.outgoing_sequence; i++) {
+		for (i = first; i < UPDATE_BACKUP - 1 && cl.validsequence + i < cls.netchan.outgoing_sequence; i++) {
 			player_state_t server_state;
 
 			pmove.frame_current = (cl.validsequence + i);
@@ -732,42 +1028,16 @@ void CL_PredictMove (qbool physframe) {
 			to = &cl.frames[(cl.validsequence + i) & UPDATE_MASK];
 			server_state = to->playerstate[cl.playernum];
 			CL_PredictUsercmd (&from->playerstate[cl.playernum], &to->playerstate[cl.playernum], &to->cmd, true);
+			CL_PredictCacheStore(cl.validsequence + i, &to->playerstate[cl.playernum]);
+			cl_predict_pmoves++;
 
-			if ((cl.validsequence + i) == cl.simerr_frame)
-			{
-				// if our origin is significantly wrong, add it to our nudge vector
-				vec3_t diff;
-				float error;
-				VectorSubtract(cl.simerr_org, to->playerstate[cl.playernum].origin, diff);
-				error = VectorLength(diff);
-				if (CL_PredictSmoothView_SkipError(&server_state)) {
-					// Do not carry an old nudge across respawns, teleports, or PM type changes.
-					VectorClear(cl.simerr_nudge);
-				}
-				else {
-					if (cl_debug_local_prediction_errors.value > 0 && error >= cl_debug_local_prediction_errors.value) {
-						Com_Printf("Local prediction error: distance=%.2f\n",
-							error);
-					}
-					if (smoothview_enabled && CL_EZCSQC_Active())
-					{
-						CL_PredictSmoothView_AddCSQCError(diff);
-					}
-					else if (smoothview_enabled && error > 4 && error < 64)
-					{
-						float mult;
-						mult = 1 - min(0.013 / cls.latency, 1);
-						VectorScale(diff, mult, diff);
-						VectorAdd(diff, cl.simerr_nudge, cl.simerr_nudge);
-					}
-
-					// we missed some weapon state change, replay all the sounds since then
-					if (smoothview_enabled && (cl.simerr_wep != pmove.weapon || cl.simerr_wepframe != pmove.weaponframe))
-						pmove.effect_frame = cl.validsequence;
-				}
+			if ((cl.validsequence + i) == cl.simerr_frame) {
+				CL_PredictCheckError(&to->playerstate[cl.playernum], &server_state, smoothview_enabled);
 			}
 		}
 
+		CL_PredictCacheSetWorld();
+
 		CL_PlayEvents();
 
 		pmove.numphysent = oldphysent;
@@ -886,8 +1156,11 @@ void CL_InitPrediction(void)
 	Cvar_Register(&cl_predict_explosions);
 	Cvar_Register(&cl_predict_sound);
 	Cvar_Register(&cl_predict_buffer);
+	Cvar_Register(&cl_predict_incremental);
 	Cvar_ResetCurrentGroup();
 
+	CL_PredictCacheClear();
+
 	CL_InitWepSounds();
 
 #ifdef JSS_CAM
@@ -676,12 +676,23 @@ static void SCR_VoiceMeter(void)
 	int		w1, w2;
 	int		w = 100;												// random.
 	int     h = 8;
-	int     x, y;
+	int     x, y, i, line_y;
+	float   decode_ms;
+	int     buffered_ms;
 
 	if (!S_Voip_ShowMeter (&x, &y)) {
 		return;
 	}
 
+	// who is talking, above the meter
+	line_y = y;
+	for (i = 0; i < MAX_CLIENTS; i++) {
+		if (S_Voip_SpeakerStats(i, &decode_ms, &buffered_ms)) {
+			line_y -= 10;
+			Draw_String (x, line_y, va("%-15.15s %5.2fms %4dms", cl.players[i].name, decode_ms, buffered_ms));
+		}
+	}
+
 	loudness = S_Voip_Loudness();
 
 	if (loudness < 0)
@@ -100,6 +100,10 @@ typedef struct prediction_event_sound_s
 extern prediction_event_sound_t		*p_event_sound;
 extern int							cl_last_predicted_movement_sound_frame;
 extern int							cl_last_predicted_movement_sound_chan;
+
+// prediction replay statistics, shown in the net hud
+extern int							cl_predict_pmoves;
+extern int							cl_predict_reused;
 extern struct sfx_s				*cl_last_predicted_movement_sound_sample;
 extern int							cl_predicted_movement_sound_frame;
 extern double						cl_last_self_movement_impact_sound_time;
@@ -905,6 +909,7 @@ extern cvar_t r_flagcolor;
 extern cvar_t r_lightflicker;
 extern cvar_t r_lightmap_lateupload;
 extern cvar_t r_lightmap_packbytexture;
+extern cvar_t r_lightmap_cache;
 extern cvar_t r_telesplash;
 extern cvar_t r_shaftalpha;
 
@@ -1267,6 +1272,7 @@ void CL_MultiviewFrameStart (void);
 void CL_MultiviewPreUpdateScreen (void);
 qbool CL_MultiviewAdvanceView (void);
 void CL_MultiviewFrameFinish (void);
+qbool CL_MultiviewLinkWorld (void);
 void CL_MultiviewDemoStart (void);
 void CL_MultiviewDemoFinish (void);
 void CL_MultiviewDemoStartRewind (void);
@@ -1310,6 +1316,9 @@ void S_Voip_Transmit(unsigned char clc, sizebuf_t *buf);
 qbool S_Voip_ShowMeter(int* x, int* y);
 qbool S_Voip_Speaking (unsigned int player);
 void S_Capture_Shutdown(void);
+void S_Voip_Shutdown(void);
+void S_Voip_Update(void);
+qbool S_Voip_SpeakerStats(unsigned int plno, float *decode_ms, int *buffered_ms);
 int S_Voip_Loudness(void);
 void S_Voip_MapChange(void);
 void S_Voip_Parse(void);
@@ -340,6 +340,7 @@ void CachePics_MarkAtlasDirty(void);
 void Atlas_SolidTextureCoordinates(texture_ref* ref, float* s, float* t);
 qbool Draw_IsConsoleBackground(mpic_t* pic);
 qbool Draw_KeepOffAtlas(const char* path);
+void Draw_PicFileChanged(const char *path);
 mpic_t* Mod_SimpleTextureForHint(int model_hint, int skinnum);
 
 #endif // __DRAW_H__
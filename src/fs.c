@@ -92,6 +92,7 @@ int fs_hash_dups;
 int fs_hash_files;
 
 cvar_t fs_cache = {"fs_cache", "1"};
+cvar_t fs_index_cache = {"fs_index_cache", "1"};
 static cvar_t fs_savegame_home = { "fs_savegame_home", "1" };
 
 static void FS_CreatePathRelative(const char *pname, int relativeto);
@@ -319,6 +320,199 @@ int FS_FOpenPathFile (const char *filename, FILE **file) {
 	return -1;
 }
 
+//============================================================================
+// Map change prefetch
+//============================================================================
+// The client knows every model and sound of a map as soon as the precache
+// lists arrive, long before it loads them one by one. Those files are read
+// (and inflated, for zips) on a background thread into a bounded memory
+// cache, so the loaders mostly find them in RAM. Only search paths with a
+// PrefetchFile function take part, as the read must not touch the state the
+// main thread uses for its open files.
+
+#define FS_PREFETCH_MAX 1024
+
+typedef struct fs_prefetch_s {
+	char name[MAX_QPATH];
+	flocation_t loc;
+	byte *data;
+	qbool done;		// read by the thread, data is NULL if that failed
+	qbool taken;	// handed out or loaded by the main thread
+} fs_prefetch_t;
+
+cvar_t fs_prefetch = {"fs_prefetch", "1"};
+cvar_t fs_prefetch_size = {"fs_prefetch_size", "64"};
+
+static fs_prefetch_t fs_prefetch_files[FS_PREFETCH_MAX];
+static int fs_prefetch_count;	// queued files
+static int fs_prefetch_next;	// next file for the thread
+static int fs_prefetch_used;	// files served from memory
+static size_t fs_prefetch_bytes;	// memory held by files not yet taken
+static size_t fs_prefetch_limit;
+static qbool fs_prefetch_quit;
+static SDL_Thread *fs_prefetch_thread;
+static SDL_mutex *fs_prefetch_mutex;
+static SDL_cond *fs_prefetch_cond;
+
+static int FS_PrefetchThread(void *unused)
+{
+	fs_prefetch_t *p;
+	byte *data;
+	qbool ok;
+
+	SDL_LockMutex(fs_prefetch_mutex);
+	while (!fs_prefetch_quit) {
+		if (fs_prefetch_next >= fs_prefetch_count) {
+			SDL_CondWait(fs_prefetch_cond, fs_prefetch_mutex);
+			continue;
+		}
+
+		p = &fs_prefetch_files[fs_prefetch_next];
+		if (p->taken) {
+			// the main thread got there first
+			fs_prefetch_next++;
+			continue;
+		}
+		if (fs_prefetch_bytes && fs_prefetch_bytes + p->loc.len > fs_prefetch_limit) {
+			// wait for the loaders to catch up
+			SDL_CondWait(fs_prefetch_cond, fs_prefetch_mutex);
+			continue;
+		}
+
+		fs_prefetch_next++;
+		fs_prefetch_bytes += p->loc.len;
+		SDL_UnlockMutex(fs_prefetch_mutex);
+
+		data = Q_malloc(p->loc.len + 1);
+		ok = p->loc.search->funcs->PrefetchFile(p->loc.search->handle, &p->loc, data);
+		data[p->loc.len] = 0;
+
+		SDL_LockMutex(fs_prefetch_mutex);
+		if (!ok) {
+			Q_free(data);
+			fs_prefetch_bytes -= p->loc.len;
+		}
+		p->data = data;
+		p->done = true;
+		SDL_CondBroadcast(fs_prefetch_cond);
+	}
+	SDL_UnlockMutex(fs_prefetch_mutex);
+
+	return 0;
+}
+
+// Asks for a file to be read in the background, the name is as it will be loaded.
+void FS_PrefetchQueue(const char *filename)
+{
+	fs_prefetch_t *p;
+	flocation_t loc;
+
+	if (!fs_prefetch.integer || fs_prefetch_count >= FS_PREFETCH_MAX || Sys_PathProtection(filename)) {
+		return;
+	}
+
+	FS_FLocateFile(filename, FSLFRT_IFFOUND, &loc);
+	if (!loc.search || !loc.search->funcs->PrefetchFile || loc.len <= 0) {
+		return;
+	}
+
+	if (!fs_prefetch_mutex) {
+		fs_prefetch_mutex = SDL_CreateMutex();
+		fs_prefetch_cond = SDL_CreateCond();
+	}
+
+	SDL_LockMutex(fs_prefetch_mutex);
+	p = &fs_prefetch_files[fs_prefetch_count];
+	memset(p, 0, sizeof(*p));
+	strlcpy(p->name, filename, sizeof(p->name));
+	p->loc = loc;
+	fs_prefetch_limit = (size_t)max(1, fs_prefetch_size.integer) * 1024 * 1024;
+	fs_prefetch_count++;
+	SDL_CondBroadcast(fs_prefetch_cond);
+	SDL_UnlockMutex(fs_prefetch_mutex);
+
+	if (!fs_prefetch_thread) {
+		fs_prefetch_quit = false;
+		fs_prefetch_thread = Sys_CreateThread(FS_PrefetchThread, NULL);
+	}
+}
+
+// Returns the file from memory if it was prefetched from the same location.
+static vfsfile_t *FS_PrefetchOpen(const char *filename, flocation_t *loc)
+{
+	fs_prefetch_t *p = NULL;
+	vfsfile_t *vfs;
+	byte *data;
+	int i;
+
+	if (!fs_prefetch_count || !loc->search) {
+		return NULL;
+	}
+
+	SDL_LockMutex(fs_prefetch_mutex);
+	for (i = 0; i < fs_prefetch_count; i++) {
+		p = &fs_prefetch_files[i];
+		if (!p->taken && p->loc.search == loc->search && p->loc.index == loc->index && !strcmp(p->name, filename)) {
+			break;
+		}
+	}
+	if (i == fs_prefetch_count || !fs_prefetch_thread) {
+		SDL_UnlockMutex(fs_prefetch_mutex);
+		return NULL;
+	}
+
+	p->taken = true;
+	if (i >= fs_prefetch_next) {
+		// not started yet, cheaper to read it here than to wait
+		SDL_UnlockMutex(fs_prefetch_mutex);
+		return NULL;
+	}
+	while (!p->done) {
+		SDL_CondWait(fs_prefetch_cond, fs_prefetch_mutex);
+	}
+	data = p->data;
+	p->data = NULL;
+	if (data) {
+		fs_prefetch_bytes -= p->loc.len;
+		fs_prefetch_used++;
+	}
+	SDL_CondBroadcast(fs_prefetch_cond);
+	SDL_UnlockMutex(fs_prefetch_mutex);
+
+	if (!data) {
+		return NULL;
+	}
+
+	vfs = FSMMAP_OpenVFS(data, loc->len);
+	vfs->copyprotected = loc->search->copyprotected;
+	return vfs;
+}
+
+// Stops the thread and drops whatever was not used, must be called before search paths go away.
+void FS_PrefetchClear(void)
+{
+	int i;
+
+	if (fs_prefetch_thread) {
+		SDL_LockMutex(fs_prefetch_mutex);
+		fs_prefetch_quit = true;
+		SDL_CondBroadcast(fs_prefetch_cond);
+		SDL_UnlockMutex(fs_prefetch_mutex);
+		SDL_WaitThread(fs_prefetch_thread, NULL);
+		fs_prefetch_thread = NULL;
+	}
+
+	if (fs_prefetch_count) {
+		Com_DPrintf("fs_prefetch: %d of %d files loaded from memory\n", fs_prefetch_used, fs_prefetch_count);
+	}
+
+	for (i = 0; i < fs_prefetch_count; i++) {
+		Q_free(fs_prefetch_files[i].data);
+	}
+	fs_prefetch_count = fs_prefetch_next = fs_prefetch_used = 0;
+	fs_prefetch_bytes = 0;
+}
+
 //Finds the file in the search path.
 //Sets fs_netpath and one of handle or file
 //Sets fs_filepos to 0 for non paks, and to beging of file in pak file
@@ -346,7 +540,10 @@ static byte *FS_LoadFile (const char *path, int usehunk, int *file_length)
 	// VFS-FIXME: This only checks the pak files, not the base dir's
     FS_FLocateFile(path, FSLFRT_LENGTH, &loc);
 	if (loc.search) {
-		f = loc.search->funcs->OpenVFS(loc.search->handle, &loc, "rb");
+		f = FS_PrefetchOpen(path, &loc);
+		if (!f) {
+			f = loc.search->funcs->OpenVFS(loc.search->handle, &loc, "rb");
+		}
 	} else {
 		f = FS_OpenVFS(path, "rb", FS_ANY);
 	} 
@@ -612,6 +809,7 @@ void FS_SetGamedir(char* dir, qbool force)
 	strlcpy(com_gamedirfile, dir, sizeof(com_gamedirfile));
 
 	// Free up any current game dir info.
+	FS_PrefetchClear();
 	FS_FlushFSHash();
 
 	// free up any current game dir info
@@ -641,6 +839,10 @@ void FS_SetGamedir(char* dir, qbool force)
 	Draw_InitConback();
 
 	FS_AddUserDirectory(dir);
+
+#ifdef WITH_ZIP
+	FSZIP_IndexSave();
+#endif
 }
 
 char *FS_NextPath (char *prevpath)
@@ -816,6 +1018,10 @@ void FS_InitFilesystemEx( qbool guess_cwd ) {
 		i = COM_FindParm("+gamedir");
 	if (i && i < COM_Argc() - 1)
 		FS_SetGamedir (COM_Argv(i + 1), true);
+
+#ifdef WITH_ZIP
+	FSZIP_IndexSave();
+#endif
 }
 
 void FS_InitFilesystem( void ) {
@@ -926,6 +1132,11 @@ void VFS_FLUSH (struct vfsfile_s *vf) {
 		vf->Flush(vf);
 }
 
+qbool VFS_STAMP (struct vfsfile_s *vf, char *stamp, int size) {
+	assert(vf);
+	return vf->Stamp && vf->Stamp(vf, stamp, size);
+}
+
 // return null terminated string
 char *VFS_GETS(struct vfsfile_s *vf, char *buffer, int buflen)
 {
@@ -1098,6 +1309,8 @@ vfsfile_t *FS_OpenVFS(const char *filename, char *mode, relativeto_t relativeto)
 
 	if (loc.search)
 	{
+		if (!strcmp(mode, "rb") && (vfs = FS_PrefetchOpen(filename, &loc)))
+			return vfs;
 		return loc.search->funcs->OpenVFS(loc.search->handle, &loc, mode);
 		//return VFS_Filter(filename, loc.search->funcs->OpenVFS(loc.search->handle, &loc, mode));
 	}
@@ -1963,6 +2176,9 @@ void FS_InitModuleFS (void)
 
 	Cvar_SetCurrentGroup(CVAR_GROUP_FILESYSTEM);
 	Cvar_Register(&fs_cache);
+	Cvar_Register(&fs_index_cache);
+	Cvar_Register(&fs_prefetch);
+	Cvar_Register(&fs_prefetch_size);
 	Cvar_Register(&fs_savegame_home);
 	Cvar_ResetCurrentGroup();
 
@@ -2999,6 +3215,7 @@ void FS_ReloadPackFilesFlags(FS_Load_File_Types reloadflags)
 		CL_Reconnect_f();
 	}
 
+	FS_PrefetchClear();
 	FS_FlushFSHash();
 
 	oldpaths = fs_searchpaths;
@@ -3036,6 +3253,10 @@ void FS_ReloadPackFilesFlags(FS_Load_File_Types reloadflags)
 
 	if (!fs_base_searchpaths)
 		fs_base_searchpaths = fs_searchpaths;
+
+#ifdef WITH_ZIP
+	FSZIP_IndexSave();
+#endif
 }
 
 void FS_UnloadPackFiles(void)
@@ -3222,6 +3443,7 @@ void FS_Shutdown(void)
 	searchpath_t* path;
 	searchpath_t* next;
 
+	FS_PrefetchClear();
 	Hash_ShutdownTable(filesystemhash);
 	filesystemhash = NULL;
 
@@ -55,6 +55,7 @@ typedef struct vfsfile_s {
 	unsigned long (*GetLen) (struct vfsfile_s *file);	// Could give some lag
 	void (*Close) (struct vfsfile_s *file);
 	void (*Flush) (struct vfsfile_s *file);
+	qbool (*Stamp) (struct vfsfile_s *file, char *stamp, int size);	// Can be NULL, see VFS_STAMP
 	qbool seekingisabadplan;
 	qbool copyprotected;							// File found was in a pak
 } vfsfile_t;
@@ -81,6 +82,9 @@ int				VFS_WRITE  (struct vfsfile_s *vf, const void *buffer, int bytestowrite);
 void			VFS_FLUSH  (struct vfsfile_s *vf);
 char		   *VFS_GETS   (struct vfsfile_s *vf, char *buffer, int buflen); 
 				// return null terminated string
+qbool			VFS_STAMP  (struct vfsfile_s *vf, char *stamp, int size);
+				// names the contents by the disk file holding them, where they are in
+				// it and its modification time, without reading them; false if unknown
 
 void			VFS_TICK   (void);  // fill in/out our internall buffers 
 									// (do read/write on socket)
@@ -93,6 +97,15 @@ vfsfile_t *FS_OpenVFS(const char *filename, char *mode,relativeto_t relativeto);
 // TCP VFS file
 vfsfile_t *FS_OpenTCP(char *name);
 
+// read files on a background thread ahead of loading them
+void FS_PrefetchQueue(const char *filename);
+void FS_PrefetchClear(void);
+
+// fs_hotreload.c, client only
+void FS_HotReload_Init(void);
+void FS_HotReload_Frame(void);
+void FS_HotReload_Shutdown(void);
+
 typedef enum {
 	FS_LOAD_NONE     = 1,
 	FS_LOAD_FILE_PAK = 2,
@@ -0,0 +1,292 @@
+/*
+Copyright (C) 2026 unezQuake team
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+// Watches the directories of the search paths and reloads the textures, HUD
+// pictures and loc files whose file was rewritten, instead of a vid_restart or
+// fs_restart. Only loose files are watched, not the contents of packs.
+
+#include "quakedef.h"
+#include "fs.h"
+#include "vfs.h"
+#include "r_texture.h"
+#include "draw.h"
+#include "teamplay.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+cvar_t fs_hotreload = {"fs_hotreload", "0"};
+
+#ifdef __linux__
+
+#define HOTRELOAD_MAX_WATCHES   1024
+#define HOTRELOAD_MAX_DEPTH     4     // gfx/, textures/<map>/ and so on
+#define HOTRELOAD_MAX_CHANGES   64    // distinct files handled per frame
+
+typedef struct hotreload_watch_s {
+	int wd;
+	char *root;         // search path the directory belongs to
+	char *relpath;      // directory relative to root, "" or ending in '/'
+} hotreload_watch_t;
+
+extern searchpath_t *fs_searchpaths;
+
+static int hotreload_fd = -1;
+static hotreload_watch_t hotreload_watches[HOTRELOAD_MAX_WATCHES];
+static int hotreload_watch_count;
+static unsigned int hotreload_paths_key;    // which search paths are being watched
+
+static void FS_HotReload_Close(void)
+{
+	int i;
+
+	for (i = 0; i < hotreload_watch_count; ++i) {
+		Q_free(hotreload_watches[i].root);
+		Q_free(hotreload_watches[i].relpath);
+	}
+	hotreload_watch_count = 0;
+	hotreload_paths_key = 0;
+
+	if (hotreload_fd >= 0) {
+		close(hotreload_fd);
+		hotreload_fd = -1;
+	}
+}
+
+static hotreload_watch_t *FS_HotReload_FindWatch(int wd)
+{
+	int i;
+
+	for (i = 0; i < hotreload_watch_count; ++i) {
+		if (hotreload_watches[i].wd == wd) {
+			return &hotreload_watches[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void FS_HotReload_AddWatch(const char *root, const char *relpath, int depth)
+{
+	char ospath[MAX_OSPATH], childpath[MAX_OSPATH];
+	hotreload_watch_t *watch;
+	struct dirent *ent;
+	DIR *dir;
+	int wd;
+
+	if (hotreload_watch_count >= HOTRELOAD_MAX_WATCHES) {
+		return;
+	}
+
+	snprintf(ospath, sizeof(ospath), "%s/%s", root, relpath);
+	wd = inotify_add_watch(hotreload_fd, ospath, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR);
+	if (wd < 0) {
+		return;
+	}
+
+	// the same directory can be reached twice, inotify hands back the same descriptor
+	if (FS_HotReload_FindWatch(wd)) {
+		return;
+	}
+
+	watch = &hotreload_watches[hotreload_watch_count++];
+	watch->wd = wd;
+	watch->root = Q_strdup(root);
+	watch->relpath = Q_strdup(relpath);
+
+	if (depth >= HOTRELOAD_MAX_DEPTH || !(dir = opendir(ospath))) {
+		return;
+	}
+
+	while ((ent = readdir(dir))) {
+		struct stat st;
+
+		if (ent->d_name[0] == '.') {
+			continue;
+		}
+
+		if (ent->d_type == DT_DIR || (ent->d_type == DT_UNKNOWN && !stat(va("%s/%s", ospath, ent->d_name), &st) && S_ISDIR(st.st_mode))) {
+			snprintf(childpath, sizeof(childpath), "%s%s/", relpath, ent->d_name);
+			FS_HotReload_AddWatch(root, childpath, depth + 1);
+		}
+	}
+
+	closedir(dir);
+}
+
+// Identifies the current set of directory search paths, to notice gamedir changes
+static unsigned int FS_HotReload_PathsKey(void)
+{
+	searchpath_t *search;
+	unsigned int key = 1;
+
+	for (search = fs_searchpaths; search; search = search->next) {
+		if (search->funcs == &osfilefuncs) {
+			key = key * 31 + Com_HashKey((const char *)search->handle);
+		}
+	}
+
+	return key;
+}
+
+static void FS_HotReload_Open(unsigned int key)
+{
+	searchpath_t *search;
+
+	FS_HotReload_Close();
+
+	if ((hotreload_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
+		Com_Printf("fs_hotreload: inotify not available, file watching disabled\n");
+		Cvar_SetValue(&fs_hotreload, 0);
+		return;
+	}
+
+	for (search = fs_searchpaths; search; search = search->next) {
+		if (search->funcs == &osfilefuncs) {
+			FS_HotReload_AddWatch((char *)search->handle, "", 0);
+		}
+	}
+
+	hotreload_paths_key = key;
+	Com_DPrintf("fs_hotreload: watching %d directories\n", hotreload_watch_count);
+}
+
+static void FS_HotReload_Dispatch(const char *path)
+{
+	const char *ext = COM_FileExtension(path);
+
+	if (!strcasecmp(ext, "png") || !strcasecmp(ext, "tga") || !strcasecmp(ext, "jpg") || !strcasecmp(ext, "pcx")) {
+		R_ImageFileChanged(path);
+		Draw_PicFileChanged(path);
+	}
+	else if (!strcasecmp(ext, "loc")) {
+		TP_LocFiles_FileChanged(path);
+	}
+}
+
+void FS_HotReload_Frame(void)
+{
+	char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	char changes[HOTRELOAD_MAX_CHANGES][MAX_QPATH];
+	int i, len, change_count = 0;
+	unsigned int key;
+
+	if (!fs_hotreload.integer) {
+		if (hotreload_fd >= 0) {
+			FS_HotReload_Close();
+		}
+		return;
+	}
+
+	key = FS_HotReload_PathsKey();
+	if (hotreload_fd < 0 || key != hotreload_paths_key) {
+		FS_HotReload_Open(key);
+		if (hotreload_fd < 0) {
+			return;
+		}
+	}
+
+	// drain everything first, editors tend to write a file several times per save
+	while ((len = read(hotreload_fd, buffer, sizeof(buffer))) > 0) {
+		char *p;
+
+		for (p = buffer; p < buffer + len; p += sizeof(struct inotify_event) + ((struct inotify_event *)p)->len) {
+			struct inotify_event *event = (struct inotify_event *)p;
+			hotreload_watch_t *watch;
+			char path[MAX_QPATH];
+
+			if (event->mask & IN_Q_OVERFLOW) {
+				// lost track of what changed, let the file system find out itself
+				filesystemchanged = true;
+				continue;
+			}
+
+			if (!event->len || event->name[0] == '.' || !(watch = FS_HotReload_FindWatch(event->wd))) {
+				continue;
+			}
+
+			snprintf(path, sizeof(path), "%s%s", watch->relpath, event->name);
+
+			if (event->mask & IN_ISDIR) {
+				if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+					char relpath[MAX_OSPATH];
+
+					snprintf(relpath, sizeof(relpath), "%s/", path);
+					FS_HotReload_AddWatch(watch->root, relpath, 1);
+					filesystemchanged = true;
+				}
+				continue;
+			}
+
+			if (event->mask & IN_CREATE) {
+				// only new names need the hash rebuilt, rewrites are found where they were
+				if (!FS_FLocateFile(path, FSLFRT_IFFOUND, NULL)) {
+					filesystemchanged = true;
+				}
+				continue;
+			}
+
+			if (event->mask & IN_MOVED_TO && !FS_FLocateFile(path, FSLFRT_IFFOUND, NULL)) {
+				filesystemchanged = true;
+			}
+
+			for (i = 0; i < change_count; ++i) {
+				if (!strcasecmp(changes[i], path)) {
+					break;
+				}
+			}
+			if (i == change_count && change_count < HOTRELOAD_MAX_CHANGES) {
+				strlcpy(changes[change_count++], path, sizeof(changes[0]));
+			}
+		}
+	}
+
+	for (i = 0; i < change_count; ++i) {
+		Com_DPrintf("fs_hotreload: %s changed\n", changes[i]);
+		FS_HotReload_Dispatch(changes[i]);
+	}
+}
+
+void FS_HotReload_Shutdown(void)
+{
+	FS_HotReload_Close();
+}
+
+#else // __linux__
+
+void FS_HotReload_Frame(void)
+{
+}
+
+void FS_HotReload_Shutdown(void)
+{
+}
+
+#endif // __linux__
+
+void FS_HotReload_Init(void)
+{
+	Cvar_SetCurrentGroup(CVAR_GROUP_FILESYSTEM);
+	Cvar_Register(&fs_hotreload);
+	Cvar_ResetCurrentGroup();
+}
@@ -552,6 +552,10 @@ typedef struct model_s {
 	// additional model data
 	void*               cached_data;
 
+	// external skins of an alias model that wait for its first draw, see Mod_LazySkinsTouch
+	int                 lazy_skins;
+	qbool               lazy_skins_wanted;
+
 	texture_ref         texture_arrays[MAX_TEXTURE_ARRAYS_PER_MODEL];
 	float               texture_arrays_scale_s[MAX_TEXTURE_ARRAYS_PER_MODEL];
 	float               texture_arrays_scale_t[MAX_TEXTURE_ARRAYS_PER_MODEL];
@@ -590,6 +594,8 @@ void	Mod_TouchModel (char *name);
 void	Mod_TouchModels (void); // for vid_restart
 void Mod_ReloadModels(qbool vid_restart);
 void Mod_FreeAllCachedData(void);
+void Mod_LazySkinsTouch(model_t *mod);
+void Mod_LazySkinsFrame(void);
 
 mleaf_t *Mod_PointInLeaf(vec3_t p, model_t *model);
 byte	*Mod_LeafPVS(mleaf_t *leaf, model_t *model);
@@ -43,7 +43,7 @@ void SCR_HUD_DrawNetStats(hud_t *hud)
 	}
 
 	width = FontFixedWidth(16, hud_net_scale->value, false, hud_net_proportional->integer);
-	height = (12 + 8 + 8 + 8 + 8 + 16 + 8 + 8 + 8 + 8 + 16 + 8 + 8 + 8) * hud_net_scale->value;
+	height = (12 + 8 + 8 + 8 + 8 + 16 + 8 + 8 + 8 + 8 + 16 + 8 + 8 + 8 + 16 + 8 + 8) * hud_net_scale->value;
 
 	if (HUD_PrepareDraw(hud, width, height, &x, &y)) {
 		float period = hud_net_period->value;
@@ -199,6 +199,19 @@ void SCR_HUD_DrawNetStats(hud_t *hud)
 		Draw_SString(x, y, "total", hud_net_scale->value, hud_net_proportional->integer);
 		snprintf(line, sizeof(line), "%3d %5d", size_all, bandwidth_all);
 		Draw_SString(x + width - Draw_StringLength(line, -1, hud_net_scale->value, hud_net_proportional->integer), y, line, hud_net_scale->value, hud_net_proportional->integer);
+		y += 12 * hud_net_scale->value;
+
+		Draw_Alt_String(x + (width - Draw_StringLength("prediction", 10, hud_net_scale->value, hud_net_proportional->integer)) / 2, y, "prediction", hud_net_scale->value, hud_net_proportional->integer);
+		y += 12 * hud_net_scale->value;
+
+		Draw_SString(x, y, "pmoves", hud_net_scale->value, hud_net_proportional->integer);
+		snprintf(line, sizeof(line), "%3d", cl_predict_pmoves);
+		Draw_SString(x + width - Draw_StringLength(line, -1, hud_net_scale->value, hud_net_proportional->integer), y, line, hud_net_scale->value, hud_net_proportional->integer);
+		y += 8 * hud_net_scale->value;
+
+		Draw_SString(x, y, "cached", hud_net_scale->value, hud_net_proportional->integer);
+		snprintf(line, sizeof(line), "%3d", cl_predict_reused);
+		Draw_SString(x + width - Draw_StringLength(line, -1, hud_net_scale->value, hud_net_proportional->integer), y, line, hud_net_scale->value, hud_net_proportional->integer);
 		y += 8 * hud_net_scale->value;
 	}
 }
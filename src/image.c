@@ -23,6 +23,14 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "quakedef.h"
 #include "image.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IMAGE_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define IMAGE_NEON
+#endif
+
 #ifdef WITH_PNG
 #include "png.h"
 /*#ifdef _WIN32
@@ -48,12 +56,129 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 cvar_t image_png_compression_level = {"image_png_compression_level", "1"};
 cvar_t image_jpeg_quality_level = {"image_jpeg_quality_level", "75"};
+cvar_t image_simd = {"image_simd", "1"};
+
+// set by image_benchmark to time the plain C paths
+static qbool image_simd_disabled;
+
+// Loader messages of the current thread go here instead of the console when set,
+// see Image_CaptureMessages
+static SDL_TLSID image_messages_tls;
+
+void Image_CaptureMessages(image_messages_t *messages)
+{
+	if (messages) {
+		messages->text[0] = messages->dtext[0] = 0;
+		messages->fatal = false;
+	}
+	SDL_TLSSet(image_messages_tls, messages, NULL);
+}
+
+void Image_PrintMessages(image_messages_t *messages)
+{
+	if (messages->fatal) {
+		Sys_Error("%s", messages->text);
+	}
+	if (messages->text[0]) {
+		Com_Printf("%s", messages->text);
+	}
+	if (messages->dtext[0]) {
+		Com_DPrintf("%s", messages->dtext);
+	}
+}
+
+static image_messages_t *Image_CapturingMessages(void)
+{
+	return image_messages_tls ? (image_messages_t *) SDL_TLSGet(image_messages_tls) : NULL;
+}
+
+// Com_Printf for the image loaders, Com_DPrintf with developer set
+static void Image_Printf(qbool developer, const char *fmt, ...)
+{
+	image_messages_t *messages = Image_CapturingMessages();
+	char text[256];
+	va_list argptr;
+
+	va_start(argptr, fmt);
+	vsnprintf(text, sizeof(text), fmt, argptr);
+	va_end(argptr);
+
+	if (messages) {
+		strlcat(developer ? messages->dtext : messages->text, text, developer ? sizeof(messages->dtext) : sizeof(messages->text));
+	}
+	else if (developer) {
+		Com_DPrintf("%s", text);
+	}
+	else {
+		Com_Printf("%s", text);
+	}
+}
+
+static qbool Image_SIMDEnabled(void)
+{
+#if defined(IMAGE_SSE2) || defined(IMAGE_NEON)
+	return image_simd.integer && !image_simd_disabled;
+#else
+	return false;
+#endif
+}
 
 /***************************** IMAGE RESAMPLING ******************************/
 
+// out = row1 + (((row2 - row1) * lerp) >> 16) for count bytes
+static void Image_LerpRows(const byte *row1, const byte *row2, byte *out, int count, int lerp)
+{
+	int i = 0, r;
+
+	if (Image_SIMDEnabled()) {
+#if defined(IMAGE_SSE2)
+		// mulhi is signed, so a lerp above 32767 is multiplied as lerp - 65536
+		// and the missing (diff * 65536) >> 16 is added back
+		__m128i zero = _mm_setzero_si128();
+		__m128i weight = _mm_set1_epi16((short)lerp);
+		__m128i carry = _mm_set1_epi16(lerp >= 32768 ? -1 : 0);
+
+		for (; i + 16 <= count; i += 16) {
+			__m128i a = _mm_loadu_si128((const __m128i *)(row1 + i));
+			__m128i b = _mm_loadu_si128((const __m128i *)(row2 + i));
+			__m128i a_lo = _mm_unpacklo_epi8(a, zero), a_hi = _mm_unpackhi_epi8(a, zero);
+			__m128i d_lo = _mm_sub_epi16(_mm_unpacklo_epi8(b, zero), a_lo);
+			__m128i d_hi = _mm_sub_epi16(_mm_unpackhi_epi8(b, zero), a_hi);
+			__m128i o_lo = _mm_add_epi16(_mm_mulhi_epi16(d_lo, weight), _mm_and_si128(d_lo, carry));
+			__m128i o_hi = _mm_add_epi16(_mm_mulhi_epi16(d_hi, weight), _mm_and_si128(d_hi, carry));
+
+			o_lo = _mm_add_epi16(o_lo, a_lo);
+			o_hi = _mm_add_epi16(o_hi, a_hi);
+			_mm_storeu_si128((__m128i *)(out + i), _mm_packus_epi16(o_lo, o_hi));
+		}
+#elif defined(IMAGE_NEON)
+		int32x4_t weight = vdupq_n_s32(lerp);
+
+		for (; i + 8 <= count; i += 8) {
+			int16x8_t a = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(row1 + i)));
+			int16x8_t d = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(row2 + i))), a);
+			int32x4_t lo = vshrq_n_s32(vmulq_s32(vmovl_s16(vget_low_s16(d)), weight), 16);
+			int32x4_t hi = vshrq_n_s32(vmulq_s32(vmovl_s16(vget_high_s16(d)), weight), 16);
+			int16x8_t o = vaddq_s16(vcombine_s16(vmovn_s32(lo), vmovn_s32(hi)), a);
+
+			vst1_u8(out + i, vqmovun_s16(o));
+		}
+#endif
+	}
+
+	for (; i < count; i++) {
+		r = row1[i];
+		out[i] = (byte) ((((row2[i] - r) * lerp) >> 16) + r);
+	}
+}
+
 static void Image_Resample32LerpLine (byte *in, byte *out, int inwidth, int outwidth) 
 {
 	int j, xi, oldx = 0, f, fstep, endx, lerp;
+#if defined(IMAGE_SSE2)
+	qbool simd = Image_SIMDEnabled();
+	__m128i zero = _mm_setzero_si128();
+#endif
 
 	fstep = (int) (inwidth * 65536.0f / outwidth);
 	endx = (inwidth - 1);
@@ -65,6 +190,23 @@ static void Image_Resample32LerpLine (byte *in, byte *out, int inwidth, int outw
 		}
 		if (xi < endx) {
 			lerp = f & 0xFFFF;
+#if defined(IMAGE_SSE2)
+			if (simd) {
+				// both pixels in one register, see Image_LerpRows for the weight trick
+				__m128i p = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)in), zero);
+				__m128i d = _mm_sub_epi16(_mm_srli_si128(p, 8), p);
+				__m128i o = _mm_mulhi_epi16(d, _mm_set1_epi16((short)lerp));
+				int pixel;
+
+				if (lerp >= 32768) {
+					o = _mm_add_epi16(o, d);
+				}
+				pixel = _mm_cvtsi128_si32(_mm_packus_epi16(_mm_add_epi16(o, p), zero));
+				memcpy(out, &pixel, 4);
+				out += 4;
+				continue;
+			}
+#endif
 			*out++ = (byte) ((((in[4] - in[0]) * lerp) >> 16) + in[0]);
 			*out++ = (byte) ((((in[5] - in[1]) * lerp) >> 16) + in[1]);
 			*out++ = (byte) ((((in[6] - in[2]) * lerp) >> 16) + in[2]);
@@ -103,7 +245,6 @@ static void Image_Resample24LerpLine (byte *in, byte *out, int inwidth, int outw
 	}
 }
 
-#define LERPBYTE(i) r = row1[i]; out[i] = (byte) ((((row2[i] - r) * lerp) >> 16) + r)
 #define NOLERPBYTE(i) *out++ = inrow[f + i]
 
 static void Image_Resample32 (void *indata, int inwidth, int inheight,
@@ -111,7 +252,7 @@ static void Image_Resample32 (void *indata, int inwidth, int inheight,
 {
 	if (quality) 
 	{
-		int i, j, r, yi, oldy, f, fstep, endy = (inheight - 1), lerp;
+		int i, yi, oldy, f, fstep, endy = (inheight - 1), lerp;
 		int inwidth4 = inwidth * 4, outwidth4 = outwidth * 4;
 		byte *inrow, *out, *row1, *row2, *memalloc;
 
@@ -145,38 +286,8 @@ static void Image_Resample32 (void *indata, int inwidth, int inheight,
 					oldy = yi;
 				}
 
-				j = outwidth - 4;
-
-				while(j >= 0)
-				{
-					LERPBYTE(0); LERPBYTE(1); LERPBYTE(2); LERPBYTE(3);
-					LERPBYTE(4); LERPBYTE(5); LERPBYTE(6); LERPBYTE(7);
-					LERPBYTE(8); LERPBYTE(9); LERPBYTE(10); LERPBYTE(11);
-					LERPBYTE(12); LERPBYTE(13); LERPBYTE(14); LERPBYTE(15);
-					out += 16;
-					row1 += 16;
-					row2 += 16;
-					j -= 4;
-				}
-
-				if (j & 2) 
-				{
-					LERPBYTE(0); LERPBYTE(1); LERPBYTE(2); LERPBYTE(3);
-					LERPBYTE(4); LERPBYTE(5); LERPBYTE(6); LERPBYTE(7);
-					out += 8;
-					row1 += 8;
-					row2 += 8;
-				}
-
-				if (j & 1)
-				{
-					LERPBYTE(0); LERPBYTE(1); LERPBYTE(2); LERPBYTE(3);
-					out += 4;
-					row1 += 4;
-					row2 += 4;
-				}
-				row1 -= outwidth4;
-				row2 -= outwidth4;
+				Image_LerpRows(row1, row2, out, outwidth4, lerp);
+				out += outwidth4;
 			} 
 			else 
 			{
@@ -240,7 +351,7 @@ static void Image_Resample24 (void *indata, int inwidth, int inheight,
 {
 	if (quality)
 	{
-		int i, j, r, yi, oldy, f, fstep, endy = (inheight - 1), lerp;
+		int i, yi, oldy, f, fstep, endy = (inheight - 1), lerp;
 		int inwidth3 = inwidth * 3, outwidth3 = outwidth * 3;
 		byte *inrow, *out, *row1, *row2, *memalloc;
 
@@ -271,38 +382,8 @@ static void Image_Resample24 (void *indata, int inwidth, int inheight,
 					oldy = yi;
 				}
 
-				j = outwidth - 4;
-
-				while(j >= 0)
-				{
-					LERPBYTE(0); LERPBYTE(1); LERPBYTE(2);
-					LERPBYTE(3); LERPBYTE(4); LERPBYTE(5);
-					LERPBYTE(6); LERPBYTE(7); LERPBYTE(8);
-					LERPBYTE(9); LERPBYTE(10); LERPBYTE(11);
-					out += 12;
-					row1 += 12;
-					row2 += 12;
-					j -= 4;
-				}
-
-				if (j & 2) 
-				{
-					LERPBYTE(0); LERPBYTE(1); LERPBYTE(2);
-					LERPBYTE(3); LERPBYTE(4); LERPBYTE(5);
-					out += 6;
-					row1 += 6;
-					row2 += 6;
-				}
-
-				if (j & 1) 
-				{
-					LERPBYTE(0); LERPBYTE(1); LERPBYTE(2);
-					out += 3;
-					row1 += 3;
-					row2 += 3;
-				}
-				row1 -= outwidth3;
-				row2 -= outwidth3;
+				Image_LerpRows(row1, row2, out, outwidth3, lerp);
+				out += outwidth3;
 			} 
 			else
 			{
@@ -373,6 +454,112 @@ void Image_Resample (void *indata, int inwidth, int inheight,
 		Sys_Error("Image_Resample: unsupported bpp (%d)", bpp);
 }
 
+// Averages 2x2 blocks of 32-bit pixels, returns the number of output pixels done.
+static int Image_MipReduce32Row(const byte *in, byte *out, int width, int nextrow)
+{
+	int x = 0;
+
+	if (!Image_SIMDEnabled()) {
+		return 0;
+	}
+
+#if defined(IMAGE_SSE2)
+	{
+		__m128i zero = _mm_setzero_si128();
+
+		for (; x + 4 <= width; x += 4, in += 32, out += 16) {
+			__m128i a0 = _mm_loadu_si128((const __m128i *)in);
+			__m128i a1 = _mm_loadu_si128((const __m128i *)(in + 16));
+			__m128i b0 = _mm_loadu_si128((const __m128i *)(in + nextrow));
+			__m128i b1 = _mm_loadu_si128((const __m128i *)(in + nextrow + 16));
+			// s0 holds pixels 0 and 1 summed over both rows, s1 pixels 2 and 3...
+			__m128i s0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+			__m128i s1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+			__m128i s2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+			__m128i s3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+			// ...then add neighbouring pixels
+			__m128i q0 = _mm_add_epi16(_mm_unpacklo_epi64(s0, s1), _mm_unpackhi_epi64(s0, s1));
+			__m128i q1 = _mm_add_epi16(_mm_unpacklo_epi64(s2, s3), _mm_unpackhi_epi64(s2, s3));
+
+			_mm_storeu_si128((__m128i *)out, _mm_packus_epi16(_mm_srli_epi16(q0, 2), _mm_srli_epi16(q1, 2)));
+		}
+	}
+#elif defined(IMAGE_NEON)
+	for (; x + 4 <= width; x += 4, in += 32, out += 16) {
+		// split even and odd pixels, then add them up across both rows
+		uint32x4x2_t a = vuzpq_u32(vreinterpretq_u32_u8(vld1q_u8(in)), vreinterpretq_u32_u8(vld1q_u8(in + 16)));
+		uint32x4x2_t b = vuzpq_u32(vreinterpretq_u32_u8(vld1q_u8(in + nextrow)), vreinterpretq_u32_u8(vld1q_u8(in + nextrow + 16)));
+		uint8x16_t a_even = vreinterpretq_u8_u32(a.val[0]), a_odd = vreinterpretq_u8_u32(a.val[1]);
+		uint8x16_t b_even = vreinterpretq_u8_u32(b.val[0]), b_odd = vreinterpretq_u8_u32(b.val[1]);
+		uint16x8_t lo = vaddq_u16(vaddl_u8(vget_low_u8(a_even), vget_low_u8(a_odd)), vaddl_u8(vget_low_u8(b_even), vget_low_u8(b_odd)));
+		uint16x8_t hi = vaddq_u16(vaddl_u8(vget_high_u8(a_even), vget_high_u8(a_odd)), vaddl_u8(vget_high_u8(b_even), vget_high_u8(b_odd)));
+
+		vst1q_u8(out, vcombine_u8(vshrn_n_u16(lo, 2), vshrn_n_u16(hi, 2)));
+	}
+#endif
+
+	return x;
+}
+
+#if defined(IMAGE_NEON)
+static uint8x16_t Image_NEONBrighten(uint8x16_t v)
+{
+	// floor(4 * v / 3), with 43691 / 2^17 standing in for 1/3
+	uint16x4_t third = vdup_n_u16(43691);
+	uint16x8_t lo = vshll_n_u8(vget_low_u8(v), 2), hi = vshll_n_u8(vget_high_u8(v), 2);
+
+	lo = vshrq_n_u16(vcombine_u16(vshrn_n_u32(vmull_u16(vget_low_u16(lo), third), 16), vshrn_n_u32(vmull_u16(vget_high_u16(lo), third), 16)), 1);
+	hi = vshrq_n_u16(vcombine_u16(vshrn_n_u32(vmull_u16(vget_low_u16(hi), third), 16), vshrn_n_u32(vmull_u16(vget_high_u16(hi), third), 16)), 1);
+
+	return vcombine_u8(vqmovn_u16(lo), vqmovn_u16(hi));
+}
+#endif
+
+// Scales the colour of 32-bit pixels by 4/3, leaving alpha alone.
+void Image_Brighten32(byte *data, int size)
+{
+	byte *p;
+	int i = 0;
+
+	if (Image_SIMDEnabled()) {
+#if defined(IMAGE_SSE2)
+		// p * 2.0 / 1.5 truncated is floor(4p / 3), done as (4p * 43691) >> 17
+		__m128i zero = _mm_setzero_si128();
+		__m128i third = _mm_set1_epi16((short)43691);
+		__m128i alpha = _mm_set1_epi32(0xFF000000);
+
+		for (; i + 16 <= size; i += 16) {
+			__m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+			__m128i lo = _mm_slli_epi16(_mm_unpacklo_epi8(v, zero), 2);
+			__m128i hi = _mm_slli_epi16(_mm_unpackhi_epi8(v, zero), 2);
+			__m128i o;
+
+			lo = _mm_srli_epi16(_mm_mulhi_epu16(lo, third), 1);
+			hi = _mm_srli_epi16(_mm_mulhi_epu16(hi, third), 1);
+			o = _mm_packus_epi16(lo, hi);
+			_mm_storeu_si128((__m128i *)(data + i), _mm_or_si128(_mm_andnot_si128(alpha, o), _mm_and_si128(alpha, v)));
+		}
+#elif defined(IMAGE_NEON)
+		for (; i + 64 <= size; i += 64) {
+			uint8x16x4_t v = vld4q_u8(data + i);
+
+			v.val[0] = Image_NEONBrighten(v.val[0]);
+			v.val[1] = Image_NEONBrighten(v.val[1]);
+			v.val[2] = Image_NEONBrighten(v.val[2]);
+			vst4q_u8(data + i, v);
+		}
+#endif
+	}
+
+	p = data + i;
+	for (i /= 4; i < size / 4; i++) {
+		p[0] = min(p[0] * 2.0 / 1.5, 255);
+		p[1] = min(p[1] * 2.0 / 1.5, 255);
+		p[2] = min(p[2] * 2.0 / 1.5, 255);
+		p += 4;
+	}
+}
+
 void Image_MipReduce (const byte *in, byte *out, int *width, int *height, int bpp) 
 {
 	const byte *inrow;
@@ -394,7 +581,8 @@ void Image_MipReduce (const byte *in, byte *out, int *width, int *height, int bp
 			{
 				for (y = 0; y < *height; y++, inrow += nextrow * 2)
 				{
-					for (in = inrow, x = 0; x < *width; x++)
+					x = Image_MipReduce32Row(inrow, out, *width, nextrow);
+					for (in = inrow + x * 8, out += x * 4; x < *width; x++)
 					{
 						out[0] = (byte) ((in[0] + in[4] + in[nextrow] + in[nextrow + 4]) >> 2);
 						out[1] = (byte) ((in[1] + in[5] + in[nextrow + 1] + in[nextrow + 5]) >> 2);
@@ -607,6 +795,7 @@ static qbool PNG_HasHeader (vfsfile_t *fin)
 static void Image_PngErrorHandler(png_structp png_ptr, png_const_charp error_msg)
 {
 	const char* filename = (const char*)png_get_error_ptr(png_ptr);
+	image_messages_t *messages;
 
 	if (filename == NULL || !filename[0]) {
 		filename = "(unknown path)";
@@ -615,6 +804,13 @@ static void Image_PngErrorHandler(png_structp png_ptr, png_const_charp error_msg
 		error_msg = "unknown error";
 	}
 
+	if ((messages = Image_CapturingMessages())) {
+		// not on the main thread, give up on this file and fail there instead
+		snprintf(messages->text, sizeof(messages->text), "Invalid PNG detected: %s (%s)\n", filename, error_msg);
+		messages->fatal = true;
+		longjmp(png_jmpbuf(png_ptr), 1);
+	}
+
 	Sys_Error("Invalid PNG detected: %s (%s)\n", filename, error_msg);
 }
 
@@ -632,13 +828,13 @@ static void Image_PngWarningHandler(png_structp png_ptr, png_const_charp error_m
 		return; // only matters if we would subsequently save the .png
 	}
 
-	Con_Printf("&cdd0libpng&r: %s (%s)\n", filename, error_msg);
+	Image_Printf(false, "&cdd0libpng&r: %s (%s)\n", filename, error_msg);
 }
 
 png_data *Image_LoadPNG_All (vfsfile_t *fin, const char *filename, int matchwidth, int matchheight, int loadflag, int *real_width, int *real_height)
 {
-	byte **rowpointers = NULL;
-	byte *data = NULL;
+	byte ** volatile rowpointers = NULL;	// volatile as they're freed after a longjmp
+	byte * volatile data = NULL;
 	png_structp png_ptr = NULL;
 	png_infop pnginfo = NULL;			
 	png_textp textchunks = NULL;		// Actual text chunks that will be returned.
@@ -658,7 +854,7 @@ png_data *Image_LoadPNG_All (vfsfile_t *fin, const char *filename, int matchwidt
 	// Check if the loaded file contains a PNG header.
 	if (!PNG_HasHeader (fin))
 	{
-		Com_DPrintf ("Invalid PNG image %s\n", COM_SkipPath(filename));
+		Image_Printf(true, "Invalid PNG image %s\n", COM_SkipPath(filename));
 		return NULL;
 	}
 
@@ -680,16 +876,16 @@ png_data *Image_LoadPNG_All (vfsfile_t *fin, const char *filename, int matchwidt
 	}
 
 	// Set the return address that PNGLib should return to if
-	// an error occurs during reading.
-#if 0
-	if (setjmp(png_ptr->jmpbuf)) 
+	// an error occurs during reading.  Only used off the main thread,
+	// see Image_PngErrorHandler.
+	if (setjmp(png_jmpbuf(png_ptr)))
 	{
 		png_destroy_read_struct(&png_ptr, &pnginfo, NULL);
 		VFS_CLOSE(fin);
-		fin = NULL;
+		Q_free(rowpointers);
+		Q_free(data);
 		return NULL;
 	}
-#endif
 
 	// Set the read function that should be used.
     png_set_read_fn(png_ptr, fin, PNG_IO_user_read_data);
@@ -721,7 +917,7 @@ png_data *Image_LoadPNG_All (vfsfile_t *fin, const char *filename, int matchwidt
 		// Too big?
 		if (width > IMAGE_MAX_DIMENSIONS || height > IMAGE_MAX_DIMENSIONS) 
 		{
-			Com_DPrintf ("PNG image %s exceeds maximum supported dimensions\n", COM_SkipPath(filename));
+			Image_Printf(true, "PNG image %s exceeds maximum supported dimensions\n", COM_SkipPath(filename));
 			png_destroy_read_struct(&png_ptr, &pnginfo, NULL);
 			VFS_CLOSE(fin);
 			fin = NULL;
@@ -803,7 +999,7 @@ png_data *Image_LoadPNG_All (vfsfile_t *fin, const char *filename, int matchwidt
 		// We don't support some formats.
 		if (bitdepth != 8 || (bytesperpixel != 4 && bytesperpixel != 1)) 
 		{
-			Com_DPrintf ("Unsupported PNG image %s: Bad color depth and/or bpp\n", COM_SkipPath(filename));
+			Image_Printf(true, "Unsupported PNG image %s: Bad color depth and/or bpp\n", COM_SkipPath(filename));
 			png_destroy_read_struct(&png_ptr, &pnginfo, NULL);
 			VFS_CLOSE(fin);
 			fin = NULL;
@@ -1195,7 +1391,7 @@ static void TGA_upsample32(byte *dest, byte *src)
 }
 
 
-#define TGA_ERROR(msg)	{if (msg) {Com_DPrintf((msg), COM_SkipPath(filename));} Q_free(fileBuffer); return NULL;}
+#define TGA_ERROR(msg)	{if (msg) {Image_Printf(true, (msg), COM_SkipPath(filename));} Q_free(fileBuffer); return NULL;}
 
 byte *Image_LoadTGA(vfsfile_t *fin, const char *filename, int matchwidth, int matchheight, int *real_width, int *real_height) 
 {
@@ -1683,7 +1879,7 @@ byte *Image_LoadJPEG(vfsfile_t *fin, const char *filename, int matchwidth, int m
 	infile = (byte *) Q_malloc(length = filesize);
 	if (VFS_READ(fin, infile, filesize, NULL) != filesize) 
 	{
-		Com_DPrintf ("Image_LoadJPEG: fread() failed on %s\n", COM_SkipPath(filename));
+		Image_Printf(true, "Image_LoadJPEG: fread() failed on %s\n", COM_SkipPath(filename));
 		VFS_CLOSE(fin);
 		Q_free(infile);
 		return NULL;
@@ -1708,7 +1904,7 @@ badjpeg:
 
 		Q_free(infile);
 		Q_free(mem);
-		Com_DPrintf ("Image_LoadJPEG: badjpeg %s, len %d\n", COM_SkipPath(filename), length);
+		Image_Printf(true, "Image_LoadJPEG: badjpeg %s, len %d\n", COM_SkipPath(filename), length);
 		return 0;
 	}
 
@@ -1732,19 +1928,19 @@ badjpeg:
 
 	if (image_width > IMAGE_MAX_DIMENSIONS || image_height > IMAGE_MAX_DIMENSIONS || image_width <= 0 || image_height <= 0)
 	{
-		Com_Printf("Bad actual dimensions %dx%d in jpeg %s\n", image_width, image_height, COM_SkipPath(filename));
+		Image_Printf(false, "Bad actual dimensions %dx%d in jpeg %s\n", image_width, image_height, COM_SkipPath(filename));
 		goto badjpeg;
 	}
 
 	if ((matchwidth && image_width != matchwidth) || (matchheight && image_height != matchheight))
 	{
-		Com_Printf("Bad match dimensions %dx%d vs %dx%d in jpeg %s\n", image_width, image_height, matchwidth, matchheight, COM_SkipPath(filename));
+		Image_Printf(false, "Bad match dimensions %dx%d vs %dx%d in jpeg %s\n", image_width, image_height, matchwidth, matchheight, COM_SkipPath(filename));
 		goto badjpeg; 
 	}
 
 	if (cinfo.output_components!=3)
 	{
-		Com_Printf("Bad number of componants in jpeg %s\n", COM_SkipPath(filename));
+		Image_Printf(false, "Bad number of componants in jpeg %s\n", COM_SkipPath(filename));
 		goto badjpeg;
 	}
 
@@ -1813,7 +2009,7 @@ byte *Image_LoadPCX (vfsfile_t *fin, const char *filename, int matchwidth, int m
 	pcxbuf = (byte *) Q_malloc(filesize);
 	if (VFS_READ(fin, pcxbuf, filesize, NULL) != filesize) 
 	{
-		Com_DPrintf ("Image_LoadPCX: fread() failed on %s\n", COM_SkipPath(filename));
+		Image_Printf(true, "Image_LoadPCX: fread() failed on %s\n", COM_SkipPath(filename));
 		VFS_CLOSE(fin);
 		Q_free(pcxbuf);
 		return NULL;
@@ -1834,7 +2030,7 @@ byte *Image_LoadPCX (vfsfile_t *fin, const char *filename, int matchwidth, int m
 
 	if (pcx->manufacturer != 0x0a || pcx->version != 5 || pcx->encoding != 1 || pcx->bits_per_pixel != 8) 
 	{
-		Com_DPrintf ("Invalid PCX image %s\n", COM_SkipPath(filename));
+		Image_Printf(true, "Invalid PCX image %s\n", COM_SkipPath(filename));
 		Q_free(pcxbuf);
 		return NULL;
 	}
@@ -1851,7 +2047,7 @@ byte *Image_LoadPCX (vfsfile_t *fin, const char *filename, int matchwidth, int m
 
 	if (width > IMAGE_MAX_DIMENSIONS || height > IMAGE_MAX_DIMENSIONS)
 	{
-		Com_DPrintf ("PCX image %s exceeds maximum supported dimensions\n", COM_SkipPath(filename));
+		Image_Printf(true, "PCX image %s exceeds maximum supported dimensions\n", COM_SkipPath(filename));
 		Q_free(pcxbuf);
 		return NULL;
 	}
@@ -1870,7 +2066,7 @@ byte *Image_LoadPCX (vfsfile_t *fin, const char *filename, int matchwidth, int m
 		{
 			if (pix - (byte *) pcx > filesize) 
 			{
-				Com_DPrintf ("Malformed PCX image %s\n", COM_SkipPath(filename));
+				Image_Printf(true, "Malformed PCX image %s\n", COM_SkipPath(filename));
 				Q_free(pcxbuf);
 				Q_free(data);
 				return NULL;
@@ -1883,7 +2079,7 @@ byte *Image_LoadPCX (vfsfile_t *fin, const char *filename, int matchwidth, int m
 				runLength = dataByte & 0x3F;
 				if (pix - (byte *) pcx > filesize)
 				{
-					Com_DPrintf ("Malformed PCX image %s\n", COM_SkipPath(filename));
+					Image_Printf(true, "Malformed PCX image %s\n", COM_SkipPath(filename));
 					Q_free(pcxbuf);
 					Q_free(data);
 					return NULL;
@@ -1897,7 +2093,7 @@ byte *Image_LoadPCX (vfsfile_t *fin, const char *filename, int matchwidth, int m
 
 			if (runLength + x > width + 1) 
 			{
-				Com_DPrintf ("Malformed PCX image %s\n", COM_SkipPath(filename));
+				Image_Printf(true, "Malformed PCX image %s\n", COM_SkipPath(filename));
 				Q_free(pcxbuf);
 				Q_free(data);
 				return NULL;
@@ -1910,7 +2106,7 @@ byte *Image_LoadPCX (vfsfile_t *fin, const char *filename, int matchwidth, int m
 
 	if (pix - (byte *) pcx > filesize) 
 	{
-		Com_DPrintf ("Malformed PCX image %s\n", COM_SkipPath(filename));
+		Image_Printf(true, "Malformed PCX image %s\n", COM_SkipPath(filename));
 		Q_free(pcxbuf);
 		Q_free(data);
 		return NULL;
@@ -2008,8 +2204,97 @@ int Image_WritePCX (char *filename, byte *data, int width, int height, byte *pal
 
 /*********************************** INIT ************************************/
 
+#define IMAGE_BENCHMARK_SIZE 512
+
+typedef struct image_benchmark_s {
+	double time[2];
+	byte *out[2];
+} image_benchmark_t;
+
+static void Image_BenchmarkReport(const char *name, image_benchmark_t *b, int size)
+{
+	Com_Printf("%-10s %8.2f ms %8.2f ms  %s\n", name, b->time[0] * 1000, b->time[1] * 1000,
+		memcmp(b->out[0], b->out[1], size) ? "MISMATCH" : "ok");
+}
+
+// Times the resample, mip and brighten paths with and without SIMD, and checks they agree.
+static void Image_Benchmark_f(void)
+{
+	int iterations = Cmd_Argc() > 1 ? max(1, Q_atoi(Cmd_Argv(1))) : 20;
+	int in_width = IMAGE_BENCHMARK_SIZE - 37, in_height = IMAGE_BENCHMARK_SIZE - 91;
+	int size = IMAGE_BENCHMARK_SIZE * IMAGE_BENCHMARK_SIZE * 4;
+	image_benchmark_t resample32, resample24, mip, brighten;
+	byte *source;
+	int i, n, pass, width, height;
+	double start;
+
+	if (!Image_SIMDEnabled()) {
+		Com_Printf("image_benchmark: no SIMD path available%s\n", image_simd.integer ? "" : " (image_simd is 0)");
+		return;
+	}
+
+	source = Q_malloc(size);
+	srand(1);
+	for (i = 0; i < size; i++) {
+		source[i] = rand() & 0xFF;
+	}
+
+	for (pass = 0; pass < 2; pass++) {
+		image_simd_disabled = !pass;
+
+		resample32.out[pass] = Q_malloc(size);
+		start = Sys_DoubleTime();
+		for (n = 0; n < iterations; n++) {
+			Image_Resample(source, in_width, in_height, resample32.out[pass], IMAGE_BENCHMARK_SIZE, IMAGE_BENCHMARK_SIZE, 4, 1);
+		}
+		resample32.time[pass] = Sys_DoubleTime() - start;
+
+		resample24.out[pass] = Q_malloc(size);
+		start = Sys_DoubleTime();
+		for (n = 0; n < iterations; n++) {
+			Image_Resample(source, in_width, in_height, resample24.out[pass], IMAGE_BENCHMARK_SIZE, IMAGE_BENCHMARK_SIZE, 3, 1);
+		}
+		resample24.time[pass] = Sys_DoubleTime() - start;
+
+		mip.out[pass] = Q_malloc(size);
+		start = Sys_DoubleTime();
+		for (n = 0; n < iterations; n++) {
+			width = height = IMAGE_BENCHMARK_SIZE;
+			Image_MipReduce(source, mip.out[pass], &width, &height, 4);
+		}
+		mip.time[pass] = Sys_DoubleTime() - start;
+
+		brighten.out[pass] = Q_malloc(size);
+		brighten.time[pass] = 0;
+		for (n = 0; n < iterations; n++) {
+			memcpy(brighten.out[pass], source, size);
+			start = Sys_DoubleTime();
+			Image_Brighten32(brighten.out[pass], size);
+			brighten.time[pass] += Sys_DoubleTime() - start;
+		}
+	}
+	image_simd_disabled = false;
+
+	Com_Printf("%d iterations, %dx%d\n", iterations, IMAGE_BENCHMARK_SIZE, IMAGE_BENCHMARK_SIZE);
+	Com_Printf("%-10s %11s %11s\n", "", "scalar", "simd");
+	Image_BenchmarkReport("resample32", &resample32, size);
+	Image_BenchmarkReport("resample24", &resample24, IMAGE_BENCHMARK_SIZE * IMAGE_BENCHMARK_SIZE * 3);
+	Image_BenchmarkReport("mipreduce", &mip, size / 4);
+	Image_BenchmarkReport("brighten", &brighten, size);
+
+	for (pass = 0; pass < 2; pass++) {
+		Q_free(resample32.out[pass]);
+		Q_free(resample24.out[pass]);
+		Q_free(mip.out[pass]);
+		Q_free(brighten.out[pass]);
+	}
+	Q_free(source);
+}
+
 void Image_Init(void) 
 {
+	image_messages_tls = SDL_TLSCreate();
+
 	Cvar_SetCurrentGroup(CVAR_GROUP_SCREENSHOTS);
 
 	#ifdef WITH_PNG
@@ -2020,7 +2305,11 @@ void Image_Init(void)
 	Cvar_Register (&image_jpeg_quality_level);
 	#endif // WITH_JPEG
 
+	Cvar_Register (&image_simd);
+
 	Cvar_ResetCurrentGroup();
+
+	Cmd_AddCommand("image_benchmark", Image_Benchmark_f);
 }
 
 
@@ -28,9 +28,20 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 void Image_Init(void);
 
+// Messages of image loaders run off the main thread, printed later on the main thread
+typedef struct image_messages_s {
+	char text[256];		// Com_Printf, or Sys_Error if fatal
+	char dtext[256];	// Com_DPrintf
+	qbool fatal;
+} image_messages_t;
+
+void Image_CaptureMessages(image_messages_t *messages);
+void Image_PrintMessages(image_messages_t *messages);
+
 void Image_Resample (void *indata, int inwidth, int inheight,
 					 void *outdata, int outwidth, int outheight, int bpp, int quality);
 void Image_MipReduce (const byte *in, byte *out, int *width, int *height, int bpp);
+void Image_Brighten32(byte *data, int size);
 
 #if defined(WITH_PNG)
 #include <png.h>
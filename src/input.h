@@ -46,6 +46,8 @@ void CL_InitInput (void);
 void IN_ResetAutohopState(void);
 void CL_SendClientCommand(qbool reliable, char *format, ...);
 void CL_SendCmd (void);
+void CL_CmdStatsCatchup(double lag);
+void CL_CmdStatsDropped(double time);
 void CL_BaseMove (usercmd_t *cmd);
 float CL_KeyState (kbutton_t *key, qbool lookbutton);
 qbool Key_TryMovementProtected(const char *cmd, qbool down, int key);
@@ -38,9 +38,12 @@ void SCR_Movieshot (char *);	//joe: capturing to avi
 
 //joe: capturing audio
 // Variables for buffering audio
-static short capture_audio_samples[44100];	// big enough buffer for 1fps at 44100Hz
+#define MOVIE_MAX_AUDIO_SAMPLES 48000
+static short capture_audio_samples[MOVIE_MAX_AUDIO_SAMPLES * 2];	// big enough buffer for 1fps at 48000Hz stereo
 static int captured_audio_samples;
-static qbool frame_has_sound = false;
+static int movie_audio_frame;	// video frames the audio has been mixed for
+static int movie_audio_samples;	// samples captured since the capture started
+static unsigned int movie_audio_checksum;	// of those samples, compare two captures of a demo
 
 #ifdef _WIN32
 void OnChange_movie_codec(cvar_t *var, char *string, qbool *cancel);
@@ -68,8 +71,6 @@ static cvar_t   movie_background_threads = {"demo_capture_background_threads", "
 
 extern cvar_t scr_sshot_type;
 
-static unsigned char aviSoundBuffer[4096]; // Static buffer for mixing
-
 static double movie_real_start_time;
 static volatile qbool movie_is_capturing = false;
 static double movie_start_time;
@@ -125,6 +126,10 @@ static void Movie_Start(double _time)
 	movie_start_time = cls.realtime;
 
 	movie_frame_count = 0;
+	movie_audio_frame = 0;
+	captured_audio_samples = 0;
+	movie_audio_samples = 0;
+	movie_audio_checksum = 0;
 
 	#ifdef _WIN32
 	if (movie_is_avi)	//joe: capturing to avi
@@ -175,6 +180,9 @@ void Movie_Stop(qbool restarting)
 	}
 #endif
 	WAVCaptureStop ();
+	if (!restarting && movie_audio_samples) {
+		Com_Printf("Captured %d audio samples, checksum %08x\n", movie_audio_samples, movie_audio_checksum);
+	}
 	movie_is_capturing = restarting;
 }
 
@@ -497,48 +505,46 @@ static void WAVCaptureStop (void)
 	}
 }
 
-void Movie_MixFrameSound (void (*mixFunction)(void))
+// Mixes the sound of one video frame. The number of samples follows from the frame
+// number rather than from the device or the wall clock, so a demo produces the
+// same audio however fast (or slowly) its frames are rendered.
+void Movie_MixFrameSound (void (*mixFunction)(int samples))
 {
-	int samples_required = (int)(0.5 + Movie_Frametime() * shw->khz) * shw->numchannels - (captured_audio_samples << 1);
-
-	memset(aviSoundBuffer, 0, sizeof(aviSoundBuffer));
-	shw->buffer = (unsigned char*)aviSoundBuffer;
-	shw->samples = min(samples_required, sizeof(aviSoundBuffer) / 2);
-	frame_has_sound = false;
+	double samples_per_frame = Movie_Frametime() * shw->khz;
+	int start = (int)(0.5 + movie_audio_frame * samples_per_frame);
+	int end = (int)(0.5 + (movie_audio_frame + 1) * samples_per_frame);
 
-	do {
-		mixFunction();
-	} while (! frame_has_sound);
-}
-
-void Movie_TransferSound(void* data, int snd_linear_count)
-{
-	int samples_per_frame = (int)(0.5 + Movie_Frametime() * shw->khz);
+	captured_audio_samples = 0;
+	mixFunction(min(end - start, MOVIE_MAX_AUDIO_SAMPLES));
+	movie_audio_frame++;
 
-	// Write some sound
-	memcpy(capture_audio_samples + (captured_audio_samples << 1), data, snd_linear_count * shw->numchannels);
-	captured_audio_samples += (snd_linear_count >> 1);
-	shw->snd_sent += snd_linear_count * shw->numchannels;
+	if (captured_audio_samples) {
+		movie_audio_checksum = (movie_audio_checksum * 33) ^ Com_BlockChecksum(capture_audio_samples, captured_audio_samples * 2 * shw->numchannels);
+		movie_audio_samples += captured_audio_samples;
 
-	if (captured_audio_samples >= samples_per_frame) {
-		// We have enough audio samples to match one frame of video
 #ifdef _WIN32
 		if (movie_is_avi) {
-			Capture_WriteAudio (samples_per_frame, (byte *)capture_audio_samples);
+			Capture_WriteAudio (captured_audio_samples, (byte *)capture_audio_samples);
 		}
 		else {
-			WAVCaptureFrame (samples_per_frame, (byte *)capture_audio_samples);
+			WAVCaptureFrame (captured_audio_samples, (byte *)capture_audio_samples);
 		}
 #else
-		WAVCaptureFrame (samples_per_frame, (byte *)capture_audio_samples);
+		WAVCaptureFrame (captured_audio_samples, (byte *)capture_audio_samples);
 #endif
-		memcpy (capture_audio_samples, capture_audio_samples + (samples_per_frame << 1), (captured_audio_samples - samples_per_frame) * 2 * shw->numchannels);
-		captured_audio_samples -= samples_per_frame;
-
-		frame_has_sound = true;
+		captured_audio_samples = 0;
 	}
 }
 
+void Movie_TransferSound(void* data, int snd_linear_count)
+{
+	int samples = min(snd_linear_count >> 1, MOVIE_MAX_AUDIO_SAMPLES - captured_audio_samples);
+
+	// Buffer until the whole frame has been mixed
+	memcpy(capture_audio_samples + (captured_audio_samples << 1), data, samples * 2 * shw->numchannels);
+	captured_audio_samples += samples;
+}
+
 static void OnChange_movie_dir(cvar_t *var, char *string, qbool *cancel) {
 	if (Movie_IsCapturing()) {
 		Com_Printf("Cannot change demo_capture_dir whilst capturing.  Use 'demo_capture stop' to cease capturing first.\n");
@@ -30,7 +30,7 @@ qbool Movie_IsCapturingAVI(void);
 void Movie_Stop(qbool restarting);
 double Movie_Frametime(void);
 double Movie_InputFrametime(void);
-qbool Movie_TransferSound(void* data, int snd_linear_count);
-void Movie_MixFrameSound(void (*mixFunction)(void));
+void Movie_TransferSound(void* data, int snd_linear_count);
+void Movie_MixFrameSound(void (*mixFunction)(int samples));
 
 #endif
@@ -98,6 +98,9 @@ static byte net_message_buffer[MSG_BUF_SIZE];
 // forward definition.
 qbool NET_GetPacketEx (netsrc_t netsrc, qbool delay);
 void NET_SendPacketEx (netsrc_t netsrc, int length, void *data, netadr_t to, qbool delay);
+qbool NET_SendUDPPacket (netsrc_t netsrc, int length, void *data, netadr_t to);
+static int NET_SendUDPPacketQuiet (netsrc_t netsrc, int length, void *data, netadr_t to, int *sock);
+static void NET_PrintSendError (int err, int socket);
 
 #ifdef SERVERONLY
 #define TCP_LISTEN_BACKLOG 2
@@ -135,10 +138,13 @@ loopback_t	loopbacks[2];
 
 #ifndef SERVERONLY
 
+// Single-producer/single-consumer ring. One slot is always left free so that
+// head == tail means empty; the indices are atomic so that the outgoing queue
+// can be drained by the delayed send thread while the main loop fills it.
 typedef struct packet_queue_s {
 	cl_delayed_packet_t packets[CL_MAX_DELAYED_PACKETS];
-	int head;
-	int tail;
+	SDL_atomic_t head; // next packet to release, only advanced by the consumer
+	SDL_atomic_t tail; // next free slot, only advanced by the producer
 	qbool outgoing;
 } packet_queue_t;
 
@@ -148,18 +154,75 @@ static packet_queue_t delay_queue_send;
 // Estimated round-trip latency excluding artificial packet delay, in milliseconds.
 static float delay_target_natural_latency_ms = -1;
 
-static inline void NET_PacketQueueSetNextIndex(int* index)
+// How late packets left the queue compared to their scheduled time.
+typedef struct packet_delay_stats_s {
+	int packets;
+	double lateness_sum;
+	double lateness_sqsum;
+	double lateness_max;
+} packet_delay_stats_t;
+
+static packet_delay_stats_t delay_send_stats;
+
+// Dedicated thread releasing outgoing delayed packets at their scheduled time,
+// so that cl_ping timing does not depend on the client frame rate.
+static cvar_t cl_ping_thread = { "cl_ping_thread", "0" };
+
+static SDL_Thread *delay_send_thread;
+static SDL_mutex *delay_send_mutex;
+static SDL_cond *delay_send_cond;
+static SDL_atomic_t delay_send_thread_quit;
+static SDL_atomic_t delay_send_thread_released;
+// Last sendto error of the thread, printed by the main thread
+static SDL_atomic_t delay_send_error;
+static SDL_atomic_t delay_send_error_socket;
+
+static inline int NET_PacketQueueNextIndex(int index)
 {
-	*index = (*index + 1) % CL_MAX_DELAYED_PACKETS;
+	return (index + 1) % CL_MAX_DELAYED_PACKETS;
+}
+
+static cl_delayed_packet_t* NET_PacketQueuePeek(packet_queue_t* queue)
+{
+	int head = SDL_AtomicGet(&queue->head);
+
+	// Empty queue
+	if (head == SDL_AtomicGet(&queue->tail)) {
+		return NULL;
+	}
+
+	SDL_MemoryBarrierAcquire();
+	return &queue->packets[head];
+}
+
+static void NET_PacketQueueAdvance(packet_queue_t* queue)
+{
+	int head = SDL_AtomicGet(&queue->head);
+
+	if (head != SDL_AtomicGet(&queue->tail)) {
+		queue->packets[head].time = 0;
+
+		SDL_MemoryBarrierRelease();
+		SDL_AtomicSet(&queue->head, NET_PacketQueueNextIndex(head));
+	}
+}
+
+// Caller holds delay_send_mutex when the send thread may be running.
+static void NET_PacketDelayStatsAdd(packet_delay_stats_t* stats, double lateness)
+{
+	stats->packets++;
+	stats->lateness_sum += lateness;
+	stats->lateness_sqsum += lateness * lateness;
+	stats->lateness_max = max(stats->lateness_max, lateness);
 }
 
 static qbool NET_PacketQueueRemove(packet_queue_t* queue, sizebuf_t* buffer, netadr_t* from_address)
 {
-	cl_delayed_packet_t* next = &queue->packets[queue->head];
+	cl_delayed_packet_t* next = NET_PacketQueuePeek(queue);
 	double time;
 
 	// Empty queue
-	if (!next->time) {
+	if (!next) {
 		return false;
 	}
 
@@ -172,15 +235,15 @@ static qbool NET_PacketQueueRemove(packet_queue_t* queue, sizebuf_t* buffer, net
 	SZ_Clear(buffer);
 	SZ_Write(buffer, next->data, next->length);
 	*from_address = next->addr;
-	next->time = 0;
 
-	NET_PacketQueueSetNextIndex(&queue->head);
+	NET_PacketQueueAdvance(queue);
 	return true;
 }
 
 static qbool NET_PacketQueueAdd(packet_queue_t* queue, byte* data, int size, netadr_t addr)
 {
-	cl_delayed_packet_t* next = &queue->packets[queue->tail];
+	int tail = SDL_AtomicGet(&queue->tail);
+	cl_delayed_packet_t* next = &queue->packets[tail];
 	float deviation = 0;
 	float ms_delay;
 
@@ -189,10 +252,9 @@ static qbool NET_PacketQueueAdd(packet_queue_t* queue, byte* data, int size, net
 	}
 
 	// If buffer is full, can't prevent packet loss - drop this packet
-	if (next->time && queue->head == queue->tail) {
+	if (NET_PacketQueueNextIndex(tail) == SDL_AtomicGet(&queue->head)) {
 		return false;
 	}
-
 	// calculate delay based on settings
 	if (cls.state != ca_active) {
 		// not yet connected, go as fast as possible
@@ -253,33 +315,145 @@ static qbool NET_PacketQueueAdd(packet_queue_t* queue, byte* data, int size, net
 	next->addr = addr;
 	next->time = Sys_DoubleTime() + 0.001 * ms_delay;
 
-	NET_PacketQueueSetNextIndex(&queue->tail);
+	// Publish the slot only once it is fully written.
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&queue->tail, NET_PacketQueueNextIndex(tail));
+
+	if (queue->outgoing && delay_send_thread) {
+		SDL_LockMutex(delay_send_mutex);
+		SDL_CondSignal(delay_send_cond);
+		SDL_UnlockMutex(delay_send_mutex);
+	}
 	return true;
 }
 
-static cl_delayed_packet_t* NET_PacketQueuePeek(packet_queue_t* queue)
+static int NET_DelayedSendThread(void *data)
 {
-	cl_delayed_packet_t* next = &queue->packets[queue->head];
+	cl_delayed_packet_t* packet;
+	double now;
+	int err, sock;
+
+	SDL_LockMutex(delay_send_mutex);
+	while (!SDL_AtomicGet(&delay_send_thread_quit)) {
+		packet = NET_PacketQueuePeek(&delay_queue_send);
+		if (!packet) {
+			SDL_CondWaitTimeout(delay_send_cond, delay_send_mutex, 100);
+			continue;
+		}
 
-	// Empty queue
-	if (!next->time)
-		return NULL;
+		now = Sys_DoubleTime();
+		if (packet->time - now > 0.002) {
+			// Sleep until shortly before the deadline, the OS timer is too coarse to hit it exactly
+			SDL_CondWaitTimeout(delay_send_cond, delay_send_mutex, (Uint32)((packet->time - now) * 1000) - 1);
+			continue;
+		}
+		if (packet->time > now) {
+			SDL_UnlockMutex(delay_send_mutex);
+			SDL_Delay(0);
+			SDL_LockMutex(delay_send_mutex);
+			continue;
+		}
+
+		err = NET_SendUDPPacketQuiet(NS_CLIENT, packet->length, packet->data, packet->addr, &sock);
+		if (err > 0) {
+			SDL_AtomicSet(&delay_send_error_socket, sock);
+			SDL_AtomicSet(&delay_send_error, err);
+		}
 
-	return next;
+		NET_PacketDelayStatsAdd(&delay_send_stats, now - packet->time);
+
+		NET_PacketQueueAdvance(&delay_queue_send);
+		SDL_AtomicSet(&delay_send_thread_released, 1);
+	}
+	SDL_UnlockMutex(delay_send_mutex);
+
+	return 0;
 }
 
-static void NET_PacketQueueAdvance(packet_queue_t* queue)
+// The thread only ever sends UDP; loopback and TCP connections keep using the main loop.
+static qbool NET_DelayedSendThreadAllowed(void)
 {
-	cl_delayed_packet_t* head = NET_PacketQueuePeek(queue);
+	return cl_ping_thread.integer && delay_send_mutex && delay_send_cond
+		&& cls.sockettcp == INVALID_SOCKET && cls.netchan.remote_address.type == NA_IP;
+}
 
-	if (head != NULL)
-	{
-		head->time = 0;
+static void NET_StartDelayedSendThread(void)
+{
+	if (delay_send_thread) {
+		return;
+	}
 
-		NET_PacketQueueSetNextIndex(&queue->head);
+	SDL_AtomicSet(&delay_send_thread_quit, 0);
+	SDL_AtomicSet(&delay_send_thread_released, 0);
+	delay_send_thread = Sys_CreateThread(NET_DelayedSendThread, NULL);
+	if (!delay_send_thread) {
+		Com_Printf("Unable to create delayed packet thread, falling back to main loop\n");
+		Cvar_SetValue(&cl_ping_thread, 0);
 	}
 }
 
+// Prints the error the send thread ran into, the console is main thread only
+static void NET_PrintDelayedSendError(void)
+{
+	int err = SDL_AtomicSet(&delay_send_error, 0);
+
+	if (err) {
+		NET_PrintSendError(err, SDL_AtomicGet(&delay_send_error_socket));
+	}
+}
+
+static void NET_StopDelayedSendThread(void)
+{
+	if (!delay_send_thread) {
+		return;
+	}
+
+	SDL_AtomicSet(&delay_send_thread_quit, 1);
+	SDL_LockMutex(delay_send_mutex);
+	SDL_CondSignal(delay_send_cond);
+	SDL_UnlockMutex(delay_send_mutex);
+
+	SDL_WaitThread(delay_send_thread, NULL);
+	delay_send_thread = NULL;
+	NET_PrintDelayedSendError();
+}
+
+static void CL_PingStats_f(void)
+{
+	packet_delay_stats_t stats;
+	double mean, deviation;
+
+	if (Cmd_Argc() == 2 && !strcmp(Cmd_Argv(1), "reset")) {
+		if (delay_send_mutex) {
+			SDL_LockMutex(delay_send_mutex);
+		}
+		memset(&delay_send_stats, 0, sizeof(delay_send_stats));
+		if (delay_send_mutex) {
+			SDL_UnlockMutex(delay_send_mutex);
+		}
+		return;
+	}
+
+	if (delay_send_mutex) {
+		SDL_LockMutex(delay_send_mutex);
+	}
+	stats = delay_send_stats;
+	if (delay_send_mutex) {
+		SDL_UnlockMutex(delay_send_mutex);
+	}
+
+	Com_Printf("Delayed outgoing packets (%s)\n", delay_send_thread ? "send thread" : "main loop");
+	if (!stats.packets) {
+		Com_Printf("  no packets released\n");
+		return;
+	}
+
+	mean = stats.lateness_sum / stats.packets;
+	deviation = sqrt(max(0, stats.lateness_sqsum / stats.packets - mean * mean));
+	Com_Printf("  packets: %d\n", stats.packets);
+	Com_Printf("  lateness: avg %.3f ms, stddev %.3f ms, max %.3f ms\n", mean * 1000.0, deviation * 1000.0, stats.lateness_max * 1000.0);
+}
+
 #endif
 
 //=============================================================================
@@ -980,14 +1154,17 @@ qbool NET_SendTCPPacket_SV (netsrc_t netsrc, int length, void *data, netadr_t to
 }
 #endif
 
-qbool NET_SendUDPPacket (netsrc_t netsrc, int length, void *data, netadr_t to)
+// Sends without printing, returns the sendto error worth reporting or 0.
+// Safe to call from the delayed send thread.
+static int NET_SendUDPPacketQuiet (netsrc_t netsrc, int length, void *data, netadr_t to, int *sock)
 {
 	struct sockaddr_storage addr;
 	int ret;
 	int socket = NET_GetSocket(netsrc, false);
 
+	*sock = socket;
 	if (socket == INVALID_SOCKET)
-		return false;
+		return -1;
 
 	NetadrToSockadr (&to, &addr);
 
@@ -999,9 +1176,27 @@ qbool NET_SendUDPPacket (netsrc_t netsrc, int length, void *data, netadr_t to)
 		if (err == EWOULDBLOCK || err == ECONNREFUSED || err == EADDRNOTAVAIL || err == ENOBUFS)
 			; // nothing
 		else
-			Con_Printf ("NET_SendPacket: sendto: (%i): %s %i\n", err, strerror(err), socket);
+			return err;
 	}
 
+	return 0;
+}
+
+static void NET_PrintSendError (int err, int socket)
+{
+	Con_Printf ("NET_SendPacket: sendto: (%i): %s %i\n", err, strerror(err), socket);
+}
+
+qbool NET_SendUDPPacket (netsrc_t netsrc, int length, void *data, netadr_t to)
+{
+	int socket;
+	int err = NET_SendUDPPacketQuiet(netsrc, length, data, to, &socket);
+
+	if (err == -1)
+		return false;
+	if (err)
+		NET_PrintSendError(err, socket);
+
 	return true;
 }
 
@@ -1056,6 +1251,17 @@ qbool CL_UnqueOutputPacket(qbool sendall)
 	cl_delayed_packet_t* packet = NULL;
 	qbool released = false;
 
+	if (!sendall && NET_DelayedSendThreadAllowed()) {
+		NET_StartDelayedSendThread();
+		if (delay_send_thread) {
+			NET_PrintDelayedSendError();
+			return SDL_AtomicSet(&delay_send_thread_released, 0) != 0;
+		}
+	}
+
+	// Main loop owns the queue from here on
+	NET_StopDelayedSendThread();
+
 	while ((packet = NET_PacketQueuePeek(&delay_queue_send)))
 	{
 		if (!time) {
@@ -1068,6 +1274,9 @@ qbool CL_UnqueOutputPacket(qbool sendall)
 
 		// ok, send it
 		NET_SendPacketEx(NS_CLIENT, packet->length, packet->data, packet->addr, false);
+		if (!sendall) {
+			NET_PacketDelayStatsAdd(&delay_send_stats, time - packet->time);
+		}
 
 		// mark as unused slot
 		NET_PacketQueueAdvance(&delay_queue_send);
@@ -1427,7 +1636,12 @@ void NET_Init (void)
 	Cvar_Register(&cl_portpingprobe_port_probes);
 	NET_SetPortPingProbeStatus(PORTPINGPROBE_READY);
 
+	Cvar_Register(&cl_ping_thread);
+	Cmd_AddCommand("cl_ping_stats", CL_PingStats_f);
+
 	delay_queue_send.outgoing = true;
+	delay_send_mutex = SDL_CreateMutex();
+	delay_send_cond = SDL_CreateCond();
 #endif
 
 #ifndef CLIENTONLY
@@ -1573,6 +1787,8 @@ void NET_InitClient(void)
 
 void NET_CloseClient (void)
 {
+	NET_StopDelayedSendThread();
+
 	if (cls.socketip != INVALID_SOCKET) {
 		closesocket(cls.socketip);
 		cls.socketip = INVALID_SOCKET;
@@ -1602,6 +1818,8 @@ static void CL_ResetPacketDelayTarget(void)
 
 void CL_ClearQueuedPackets(void)
 {
+	NET_StopDelayedSendThread();
+
 	memset(&delay_queue_get, 0, sizeof(delay_queue_get));
 	memset(&delay_queue_send, 0, sizeof(delay_queue_send));
 	CL_ResetPacketDelayTarget();
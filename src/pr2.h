@@ -24,6 +24,8 @@
 
 
 intptr_t PR2_GameSystemCalls( intptr_t *args );
+void PR2_InitSyscalls( void );
+const char *PR2_SyscallName( int num );
 extern cvar_t sv_progtype;
 extern vm_t* sv_vm;
 
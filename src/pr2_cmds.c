@@ -68,7 +68,10 @@ struct
 	{"SetExtFieldPtr",	EXT_SetExtFieldPtr},
 	{"GetExtFieldPtr",	EXT_GetExtFieldPtr},
 };
-ext_syscall_t ext_syscall_tbl[256];
+
+// indexed by syscall number, G_Map_Extension fills the slots from G_EXTENSIONS_FIRST on
+static syscall_t pr2_syscall_tbl[G_EXTENSIONS_FIRST + 256];
+static char *pr2_syscall_names[G_EXTENSIONS_FIRST + 256];
 
 int NUM_FOR_GAME_EDICT(byte *e)
 {
@@ -866,18 +869,26 @@ intptr_t PF2_FindRadius(int e, float *org, float rad)
 
 	edict_t *ed;
 	vec3_t	eorg;
+	float	length;
+	double	inside, outside;
 
-	for ( e++; e < sv.num_edicts; e++ )
-	{
-		ed = EDICT_NUM( e );
+	if (rad < 0)
+		return 0;
+
+	// compare squared lengths, VectorLength only decides right at the edge
+	inside = (double)rad * rad;
+	outside = inside * 1.0001;
 
+	for ( e++, ed = sv.edicts + e; e < sv.num_edicts; e++, ed++ )
+	{
 		if (ed->e.free)
 			continue;
 		if (ed->v->solid == SOLID_NOT)
 			continue;
 		for (j=0 ; j<3 ; j++)
 			eorg[j] = org[j] - (ed->v->origin[j] + (ed->v->mins[j] + ed->v->maxs[j])*0.5);
-		if (VectorLength(eorg) > rad)
+		length = eorg[0] * eorg[0] + eorg[1] * eorg[1] + eorg[2] * eorg[2];
+		if (length > inside && (length > outside || VectorLength(eorg) > rad))
 			continue;
 		return VM_Ptr2VM((byte *)ed->v);
 	}
@@ -2077,24 +2088,21 @@ intptr_t PF2_Map_Extension(char *name, int mapto)
 {
 	int i;
 
-	if ((mapto - G_EXTENSIONS_FIRST) >= ARRAY_LEN(ext_syscall_tbl))
+	if (mapto < G_EXTENSIONS_FIRST || mapto >= ARRAY_LEN(pr2_syscall_tbl))
 	{
 		return -2;
 	}
 
 	if (!name)
 	{
-		if (mapto < _G__LASTAPI)
-		{
-			return -2;
-		}
 		return -1;
 	}
 	for (i = 0; i < ARRAY_LEN(ext_syscalls); i++)
 	{
 		if (!strcmp(ext_syscalls[i].extname, name))
 		{
-			ext_syscall_tbl[mapto - G_EXTENSIONS_FIRST] = ext_syscalls[i].fun;
+			pr2_syscall_tbl[mapto] = ext_syscalls[i].fun;
+			pr2_syscall_names[mapto] = ext_syscalls[i].extname;
 			return mapto;
 		}
 	}
@@ -2516,309 +2524,723 @@ void PF2_VisibleTo(int viewer, int first, int len, byte *visible)
 
 #define VMV(x) _vmf(args[x]), _vmf(args[(x) + 1]), _vmf(args[(x) + 2])
 #define VME(x) EDICT_NUM(args[x])
-intptr_t PR2_GameSystemCalls(intptr_t *args) {
-	switch (args[0]) {
-	case G_GETAPIVERSION:
-		return GAME_API_VERSION;
-	case G_DPRINT:
-		Con_DPrintf("%s", (const char *)VMA(1));
-		return 0;
-	case G_ERROR:
-		PR2_RunError(VMA(1));
-		return 0;
-	case G_GetEntityToken:
-		VM_CheckBounds(sv_vm, args[1], args[2]);
-		pr2_ent_data_ptr = COM_Parse(pr2_ent_data_ptr);
-		strlcpy(VMA(1), com_token, args[2]);
-		return pr2_ent_data_ptr != NULL;
-	case G_SPAWN_ENT:
-		return NUM_FOR_EDICT(ED_Alloc());
-	case G_REMOVE_ENT:
-		ED_Free(VME(1));
-		return 0;
-	case G_PRECACHE_SOUND:
-		PF2_precache_sound(VMA(1));
-		return 0;
-	case G_PRECACHE_MODEL:
-		PF2_precache_model(VMA(1));
-		return 0;
-	case G_LIGHTSTYLE:
-		PF2_lightstyle(args[1], VMA(2));
-		return 0;
-	case G_SETORIGIN:
-		PF2_setorigin(VME(1), VMV(2));
-		return 0;
-	case G_SETSIZE:
-		PF2_setsize(VME(1), VMV(2), VMV(5));
-		return 0;
-	case G_SETMODEL:
-		PF2_setmodel(VME(1), VMA(2));
-		return 0;
-	case G_BPRINT: {
-		int flags = args[3];
-		if (gamedata.APIversion < 15)
-			flags = 0;
-		SV_BroadcastPrintfEx(args[1], flags, "%s", VMA(2));
-	}
-		return 0;
-	case G_SPRINT:
-		PF2_sprint(args[1], args[2], VMA(3), args[4]);
-		return 0;
-	case G_CENTERPRINT:
-		PF2_centerprint(args[1], VMA(2));
-		return 0;
-	case G_AMBIENTSOUND:
-		PF2_ambientsound(VMV(1), VMA(4), VMF(5), VMF(6));
-		return 0;
-	case G_SOUND:
-		/*
-		=================
-		PF2_sound
-
-		Each entity can have eight independant sound sources, like voice,
-		weapon, feet, etc.
-
-		Channel 0 is an auto-allocate channel, the others override anything
-		already running on that entity/channel pair.
-
-		An attenuation of 0 will play full volume everywhere in the level.
-		Larger attenuations will drop off.
-		void sound( gedict_t * ed, int channel, char *samp, float vol, float att )
-		=================
-		*/
-		SV_StartSound(VME(1), args[2], VMA(3), VMF(4) * 255, VMF(5));
-		return 0;
-	case G_TRACELINE:
-		PF2_traceline(VMV(1), VMV(4), args[7], args[8]);
-		return 0;
-	case G_CHECKCLIENT:
-		return PF2_checkclient();
-	case G_STUFFCMD:
-		PF2_stuffcmd(args[1], VMA(2), args[3]);
-		return 0;
-	case G_LOCALCMD:
-		/* =================
-		Sends text over to the server's execution buffer
 
-		localcmd (string)
-		================= */
-		Cbuf_AddTextEx(&cbuf_server, VMA(1));
-		return 0;
-	case G_CVAR:
-		return PASSFLOAT(Cvar_Value(VMA(1)));
-	case G_CVAR_SET:
-		Cvar_SetByName(VMA(1), VMA(2));
-		return 0;
-	case G_FINDRADIUS:
-		return PF2_FindRadius(NUM_FOR_GAME_EDICT(VMA(1)), (float *)VMA(2), VMF(3));
-	case G_WALKMOVE:
-		return PF2_walkmove(VME(1), VMF(2), VMF(3));
-	case G_DROPTOFLOOR:
-		return PF2_droptofloor(VME(1));
-	case G_CHECKBOTTOM:
-		return SV_CheckBottom(VME(1));
-	case G_POINTCONTENTS:
-		return PF2_pointcontents(VMV(1));
-	case G_NEXTENT:
-		return PF2_nextent(args[1]);
-	case G_AIM:
-		return 0;
-	case G_MAKESTATIC:
-		PF2_makestatic(VME(1));
-		return 0;
-	case G_SETSPAWNPARAMS:
-		PF2_setspawnparms(args[1]);
-		return 0;
-	case G_CHANGELEVEL:
-		PF2_changelevel(VMA(1), VMA(2));
-		return 0;
-	case G_LOGFRAG:
-		PF2_logfrag(args[1], args[2]);
-		return 0;
-	case G_GETINFOKEY:
-		VM_CheckBounds(sv_vm, args[3], args[4]);
-		PF2_infokey(args[1], VMA(2), VMA(3), args[4]);
-		return 0;
-	case G_MULTICAST:
-		PF2_multicast(VMV(1), args[4]);
-		return 0;
-	case G_DISABLEUPDATES:
-		PF2_disable_updates(args[1], VMF(2));
-		return 0;
-	case G_WRITEBYTE:
-		PF2_WriteByte(args[1], args[2]);
-		return 0;
-	case G_WRITECHAR:
-		PF2_WriteChar(args[1], args[2]);
-		return 0;
-	case G_WRITESHORT:
-		PF2_WriteShort(args[1], args[2]);
-		return 0;
-	case G_WRITELONG:
-		PF2_WriteLong(args[1], args[2]);
-		return 0;
-	case G_WRITEANGLE:
-		PF2_WriteAngle(args[1], VMF(2));
-		return 0;
-	case G_WRITECOORD:
-		PF2_WriteCoord(args[1], VMF(2));
-		return 0;
-	case G_WRITESTRING:
-		PF2_WriteString(args[1], VMA(2));
-		return 0;
-	case G_WRITEENTITY:
-		PF2_WriteEntity(args[1], args[2]);
-		return 0;
-	case G_FLUSHSIGNON:
-		SV_FlushSignon();
-		return 0;
-	case g_memset:
-		VM_CheckBounds(sv_vm, args[1], args[3]);
-		memset(VMA(1), args[2], args[3]);
-		return args[1];
-	case g_memcpy:
-		VM_CheckBounds2(sv_vm, args[1], args[2], args[3]);
-		memcpy(VMA(1), VMA(2), args[3]);
-		return args[1];
-	case g_strncpy:
-		VM_CheckBounds2(sv_vm, args[1], args[2], args[3]);
-		strncpy(VMA(1), VMA(2), args[3]);
-		return args[1];
-	case g_sin:
-		return PASSFLOAT(sin(VMF(1)));
-	case g_cos:
-		return PASSFLOAT(cos(VMF(1)));
-	case g_atan2:
-		return PASSFLOAT(atan2(VMF(1), VMF(2)));
-	case g_sqrt:
-		return PASSFLOAT(sqrt(VMF(1)));
-	case g_floor:
-		return PASSFLOAT(floor(VMF(1)));
-	case g_ceil:
-		return PASSFLOAT(ceil(VMF(1)));
-	case g_acos:
-		return PASSFLOAT(acos(VMF(1)));
-	case G_CMD_ARGC:
-		return Cmd_Argc();
-	case G_CMD_ARGV:
-		VM_CheckBounds(sv_vm, args[2], args[3]);
-		strlcpy(VMA(2), Cmd_Argv(args[1]), args[3]);
-		return 0;
-	case G_TraceCapsule:
-		PF2_TraceCapsule(VMV(1), VMV(4), args[7], VME(8), VMV(9), VMV(12));
-		return 0;
-	case G_FSOpenFile:
-		return PF2_FS_OpenFile(VMA(1), (fileHandle_t *)VMA(2), (fsMode_t)args[3]);
-	case G_FSCloseFile:
-		PF2_FS_CloseFile((fileHandle_t)args[1]);
-		return 0;
-	case G_FSReadFile:
-		VM_CheckBounds(sv_vm, args[1], args[2]);
-		return PF2_FS_ReadFile(VMA(1), args[2], (fileHandle_t)args[3]);
-	case G_FSWriteFile:
-		VM_CheckBounds(sv_vm, args[1], args[2]);
-		return PF2_FS_WriteFile(VMA(1), args[2], (fileHandle_t)args[3]);
-	case G_FSSeekFile:
-		return PF2_FS_SeekFile((fileHandle_t)args[1], args[2], (fsOrigin_t)args[3]);
-	case G_FSTellFile:
-		return PF2_FS_TellFile((fileHandle_t)args[1]);
-	case G_FSGetFileList:
-		VM_CheckBounds(sv_vm, args[3], args[4]);
-		return PF2_FS_GetFileList(VMA(1), VMA(2), VMA(3), args[4], args[5]);
-	case G_CVAR_SET_FLOAT:
-		Cvar_SetValueByName(VMA(1), VMF(2));
-		return 0;
-	case G_CVAR_STRING:
-		VM_CheckBounds(sv_vm, args[2], args[3]);
-		strlcpy(VMA(2), Cvar_String(VMA(1)), args[3]);
-		return 0;
-	case G_Map_Extension:
-		return PF2_Map_Extension(VMA(1), args[2]);
-	case G_strcmp:
-		return strcmp(VMA(1), VMA(2));
-	case G_strncmp:
-		return strncmp(VMA(1), VMA(2), args[3]);
-	case G_stricmp:
-		return strcasecmp(VMA(1), VMA(2));
-	case G_strnicmp:
-		return strncasecmp(VMA(1), VMA(2), args[3]);
-	case G_Find:
-		return PF2_Find(NUM_FOR_GAME_EDICT(VMA(1)), args[2], VMA(3));
-	case G_executecmd:
-		PF2_executecmd();
-		return 0;
-	case G_conprint:
-		Sys_Printf("%s", VMA(1));
-		return 0;
-	case G_readcmd:
-		VM_CheckBounds(sv_vm, args[2], args[3]);
-		PF2_readcmd(VMA(1), VMA(2), args[3]);
-		return 0;
-	case G_redirectcmd:
-		PF2_redirectcmd(NUM_FOR_GAME_EDICT(VMA(1)), VMA(2));
-		return 0;
-	case G_Add_Bot:
-		return PF2_Add_Bot(VMA(1), args[2], args[3], VMA(4));
-	case G_Remove_Bot:
-		PF2_Remove_Bot(args[1]);
-		return 0;
-	case G_SetBotUserInfo:
-		PF2_SetBotUserInfo(args[1], VMA(2), VMA(3), args[4]);
-		return 0;
-	case G_SetBotCMD:
-		PF2_SetBotCMD(args[1], args[2], VMV(3), args[6], args[7], args[8], args[9], args[10]);
-		return 0;
-	case G_QVMstrftime:
-		VM_CheckBounds(sv_vm, args[1], args[2]);
-		return PF2_QVMstrftime(VMA(1), args[2], VMA(3), args[4]);
-	case G_CMD_ARGS:
-		VM_CheckBounds(sv_vm, args[1], args[2]);
-		strlcpy(VMA(1), Cmd_Args(), args[2]);
-		return 0;
-	case G_CMD_TOKENIZE:
-		Cmd_TokenizeString(VMA(1));
-		return 0;
-	case g_strlcpy:
-		VM_CheckBounds(sv_vm, args[1], args[3]);
-		return strlcpy(VMA(1), VMA(2), args[3]);
-	case g_strlcat:
-		VM_CheckBounds(sv_vm, args[1], args[3]);
-		return strlcat(VMA(1), VMA(2), args[3]);
-	case G_MAKEVECTORS:
-		AngleVectors(VMA(1), pr_global_struct->v_forward, pr_global_struct->v_right,
-								 pr_global_struct->v_up);
-		return 0;
-	case G_NEXTCLIENT:
-		return PF2_nextclient(NUM_FOR_GAME_EDICT(VMA(1)));
-	case G_PRECACHE_VWEP_MODEL:
-		return PF2_precache_vwep_model(VMA(1));
-	case G_SETPAUSE:
-		PF2_setpause(args[1]);
-		return 0;
-	case G_SETUSERINFO:
-		PF2_SetUserInfo(args[1], VMA(2), VMA(3), args[4]);
-		return 0;
-	case G_MOVETOGOAL:
-		PF2_MoveToGoal(VMF(1));
-		return 0;
-	case G_VISIBLETO:
-		VM_CheckBounds(sv_vm, args[4], args[3]);
-		memset(VMA(4), 0, args[3]); // Ensure same memory state on each run.
-		PF2_VisibleTo(args[1], args[2], args[3], VMA(4));
-		return 0;
-	default:
-		if (args[0] >= _G__LASTAPI && ext_syscall_tbl[args[0] - G_EXTENSIONS_FIRST])
-		{
-			return ext_syscall_tbl[args[0] - G_EXTENSIONS_FIRST](args);
-		}
-		else
-		{
-			SV_Error("Bad game system trap: %ld", (long int)args[0]);
-		}
-	}
+static intptr_t SYS_GETAPIVERSION(intptr_t *args)
+{
+	return GAME_API_VERSION;
+}
+
+static intptr_t SYS_DPRINT(intptr_t *args)
+{
+	Con_DPrintf("%s", (const char *)VMA(1));
+	return 0;
+}
+
+static intptr_t SYS_ERROR(intptr_t *args)
+{
+	PR2_RunError(VMA(1));
+	return 0;
+}
+
+static intptr_t SYS_GetEntityToken(intptr_t *args)
+{
+	VM_CheckBounds(sv_vm, args[1], args[2]);
+	pr2_ent_data_ptr = COM_Parse(pr2_ent_data_ptr);
+	strlcpy(VMA(1), com_token, args[2]);
+	return pr2_ent_data_ptr != NULL;
+}
+
+static intptr_t SYS_SPAWN_ENT(intptr_t *args)
+{
+	return NUM_FOR_EDICT(ED_Alloc());
+}
+
+static intptr_t SYS_REMOVE_ENT(intptr_t *args)
+{
+	ED_Free(VME(1));
+	return 0;
+}
+
+static intptr_t SYS_PRECACHE_SOUND(intptr_t *args)
+{
+	PF2_precache_sound(VMA(1));
+	return 0;
+}
+
+static intptr_t SYS_PRECACHE_MODEL(intptr_t *args)
+{
+	PF2_precache_model(VMA(1));
+	return 0;
+}
+
+static intptr_t SYS_LIGHTSTYLE(intptr_t *args)
+{
+	PF2_lightstyle(args[1], VMA(2));
+	return 0;
+}
+
+static intptr_t SYS_SETORIGIN(intptr_t *args)
+{
+	PF2_setorigin(VME(1), VMV(2));
+	return 0;
+}
+
+static intptr_t SYS_SETSIZE(intptr_t *args)
+{
+	PF2_setsize(VME(1), VMV(2), VMV(5));
+	return 0;
+}
+
+static intptr_t SYS_SETMODEL(intptr_t *args)
+{
+	PF2_setmodel(VME(1), VMA(2));
+	return 0;
+}
+
+static intptr_t SYS_BPRINT(intptr_t *args)
+{
+	int flags = args[3];
+	if (gamedata.APIversion < 15)
+		flags = 0;
+	SV_BroadcastPrintfEx(args[1], flags, "%s", VMA(2));
+	return 0;
+}
+
+static intptr_t SYS_SPRINT(intptr_t *args)
+{
+	PF2_sprint(args[1], args[2], VMA(3), args[4]);
+	return 0;
+}
+
+static intptr_t SYS_CENTERPRINT(intptr_t *args)
+{
+	PF2_centerprint(args[1], VMA(2));
+	return 0;
+}
+
+static intptr_t SYS_AMBIENTSOUND(intptr_t *args)
+{
+	PF2_ambientsound(VMV(1), VMA(4), VMF(5), VMF(6));
+	return 0;
+}
+
+/*
+=================
+PF2_sound
+
+Each entity can have eight independant sound sources, like voice,
+weapon, feet, etc.
+
+Channel 0 is an auto-allocate channel, the others override anything
+already running on that entity/channel pair.
+
+An attenuation of 0 will play full volume everywhere in the level.
+Larger attenuations will drop off.
+void sound( gedict_t * ed, int channel, char *samp, float vol, float att )
+=================
+*/
+static intptr_t SYS_SOUND(intptr_t *args)
+{
+	SV_StartSound(VME(1), args[2], VMA(3), VMF(4) * 255, VMF(5));
+	return 0;
+}
+
+static intptr_t SYS_TRACELINE(intptr_t *args)
+{
+	PF2_traceline(VMV(1), VMV(4), args[7], args[8]);
+	return 0;
+}
+
+static intptr_t SYS_CHECKCLIENT(intptr_t *args)
+{
+	return PF2_checkclient();
+}
+
+static intptr_t SYS_STUFFCMD(intptr_t *args)
+{
+	PF2_stuffcmd(args[1], VMA(2), args[3]);
+	return 0;
+}
+
+/* =================
+Sends text over to the server's execution buffer
+
+localcmd (string)
+================= */
+static intptr_t SYS_LOCALCMD(intptr_t *args)
+{
+	Cbuf_AddTextEx(&cbuf_server, VMA(1));
+	return 0;
+}
+
+// cvar_t.value always holds Q_atof(string), no need to parse it again
+static intptr_t SYS_CVAR(intptr_t *args)
+{
+	cvar_t *var = Cvar_Find(VMA(1));
+
+	return PASSFLOAT(var ? var->value : 0);
+}
+
+static intptr_t SYS_CVAR_SET(intptr_t *args)
+{
+	Cvar_SetByName(VMA(1), VMA(2));
+	return 0;
+}
+
+static intptr_t SYS_FINDRADIUS(intptr_t *args)
+{
+	VM_CheckBounds(sv_vm, args[2], sizeof(vec3_t));
+	return PF2_FindRadius(NUM_FOR_GAME_EDICT(VMA(1)), (float *)VMA(2), VMF(3));
+}
+
+static intptr_t SYS_WALKMOVE(intptr_t *args)
+{
+	return PF2_walkmove(VME(1), VMF(2), VMF(3));
+}
+
+static intptr_t SYS_DROPTOFLOOR(intptr_t *args)
+{
+	return PF2_droptofloor(VME(1));
+}
+
+static intptr_t SYS_CHECKBOTTOM(intptr_t *args)
+{
+	return SV_CheckBottom(VME(1));
+}
+
+static intptr_t SYS_POINTCONTENTS(intptr_t *args)
+{
+	return PF2_pointcontents(VMV(1));
+}
+
+static intptr_t SYS_NEXTENT(intptr_t *args)
+{
+	return PF2_nextent(args[1]);
+}
+
+static intptr_t SYS_AIM(intptr_t *args)
+{
+	return 0;
+}
+
+static intptr_t SYS_MAKESTATIC(intptr_t *args)
+{
+	PF2_makestatic(VME(1));
+	return 0;
+}
+
+static intptr_t SYS_SETSPAWNPARAMS(intptr_t *args)
+{
+	PF2_setspawnparms(args[1]);
+	return 0;
+}
+
+static intptr_t SYS_CHANGELEVEL(intptr_t *args)
+{
+	PF2_changelevel(VMA(1), VMA(2));
+	return 0;
+}
+
+static intptr_t SYS_LOGFRAG(intptr_t *args)
+{
+	PF2_logfrag(args[1], args[2]);
+	return 0;
+}
+
+static intptr_t SYS_GETINFOKEY(intptr_t *args)
+{
+	VM_CheckBounds(sv_vm, args[3], args[4]);
+	PF2_infokey(args[1], VMA(2), VMA(3), args[4]);
+	return 0;
+}
+
+static intptr_t SYS_MULTICAST(intptr_t *args)
+{
+	PF2_multicast(VMV(1), args[4]);
+	return 0;
+}
+
+static intptr_t SYS_DISABLEUPDATES(intptr_t *args)
+{
+	PF2_disable_updates(args[1], VMF(2));
+	return 0;
+}
+
+static intptr_t SYS_WRITEBYTE(intptr_t *args)
+{
+	PF2_WriteByte(args[1], args[2]);
+	return 0;
+}
+
+static intptr_t SYS_WRITECHAR(intptr_t *args)
+{
+	PF2_WriteChar(args[1], args[2]);
+	return 0;
+}
+
+static intptr_t SYS_WRITESHORT(intptr_t *args)
+{
+	PF2_WriteShort(args[1], args[2]);
+	return 0;
+}
+
+static intptr_t SYS_WRITELONG(intptr_t *args)
+{
+	PF2_WriteLong(args[1], args[2]);
 	return 0;
 }
 
+static intptr_t SYS_WRITEANGLE(intptr_t *args)
+{
+	PF2_WriteAngle(args[1], VMF(2));
+	return 0;
+}
+
+static intptr_t SYS_WRITECOORD(intptr_t *args)
+{
+	PF2_WriteCoord(args[1], VMF(2));
+	return 0;
+}
+
+static intptr_t SYS_WRITESTRING(intptr_t *args)
+{
+	PF2_WriteString(args[1], VMA(2));
+	return 0;
+}
+
+static intptr_t SYS_WRITEENTITY(intptr_t *args)
+{
+	PF2_WriteEntity(args[1], args[2]);
+	return 0;
+}
+
+static intptr_t SYS_FLUSHSIGNON(intptr_t *args)
+{
+	SV_FlushSignon();
+	return 0;
+}
+
+static intptr_t SYS_memset(intptr_t *args)
+{
+	VM_CheckBounds(sv_vm, args[1], args[3]);
+	memset(VMA(1), args[2], args[3]);
+	return args[1];
+}
+
+static intptr_t SYS_memcpy(intptr_t *args)
+{
+	VM_CheckBounds2(sv_vm, args[1], args[2], args[3]);
+	memcpy(VMA(1), VMA(2), args[3]);
+	return args[1];
+}
+
+static intptr_t SYS_strncpy(intptr_t *args)
+{
+	VM_CheckBounds2(sv_vm, args[1], args[2], args[3]);
+	strncpy(VMA(1), VMA(2), args[3]);
+	return args[1];
+}
+
+static intptr_t SYS_sin(intptr_t *args)
+{
+	return PASSFLOAT(sin(VMF(1)));
+}
+
+static intptr_t SYS_cos(intptr_t *args)
+{
+	return PASSFLOAT(cos(VMF(1)));
+}
+
+static intptr_t SYS_atan2(intptr_t *args)
+{
+	return PASSFLOAT(atan2(VMF(1), VMF(2)));
+}
+
+static intptr_t SYS_sqrt(intptr_t *args)
+{
+	return PASSFLOAT(sqrt(VMF(1)));
+}
+
+static intptr_t SYS_floor(intptr_t *args)
+{
+	return PASSFLOAT(floor(VMF(1)));
+}
+
+static intptr_t SYS_ceil(intptr_t *args)
+{
+	return PASSFLOAT(ceil(VMF(1)));
+}
+
+static intptr_t SYS_acos(intptr_t *args)
+{
+	return PASSFLOAT(acos(VMF(1)));
+}
+
+static intptr_t SYS_CMD_ARGC(intptr_t *args)
+{
+	return Cmd_Argc();
+}
+
+static intptr_t SYS_CMD_ARGV(intptr_t *args)
+{
+	VM_CheckBounds(sv_vm, args[2], args[3]);
+	strlcpy(VMA(2), Cmd_Argv(args[1]), args[3]);
+	return 0;
+}
+
+static intptr_t SYS_TraceCapsule(intptr_t *args)
+{
+	PF2_TraceCapsule(VMV(1), VMV(4), args[7], VME(8), VMV(9), VMV(12));
+	return 0;
+}
+
+static intptr_t SYS_FSOpenFile(intptr_t *args)
+{
+	return PF2_FS_OpenFile(VMA(1), (fileHandle_t *)VMA(2), (fsMode_t)args[3]);
+}
+
+static intptr_t SYS_FSCloseFile(intptr_t *args)
+{
+	PF2_FS_CloseFile((fileHandle_t)args[1]);
+	return 0;
+}
+
+static intptr_t SYS_FSReadFile(intptr_t *args)
+{
+	VM_CheckBounds(sv_vm, args[1], args[2]);
+	return PF2_FS_ReadFile(VMA(1), args[2], (fileHandle_t)args[3]);
+}
+
+static intptr_t SYS_FSWriteFile(intptr_t *args)
+{
+	VM_CheckBounds(sv_vm, args[1], args[2]);
+	return PF2_FS_WriteFile(VMA(1), args[2], (fileHandle_t)args[3]);
+}
+
+static intptr_t SYS_FSSeekFile(intptr_t *args)
+{
+	return PF2_FS_SeekFile((fileHandle_t)args[1], args[2], (fsOrigin_t)args[3]);
+}
+
+static intptr_t SYS_FSTellFile(intptr_t *args)
+{
+	return PF2_FS_TellFile((fileHandle_t)args[1]);
+}
+
+static intptr_t SYS_FSGetFileList(intptr_t *args)
+{
+	VM_CheckBounds(sv_vm, args[3], args[4]);
+	return PF2_FS_GetFileList(VMA(1), VMA(2), VMA(3), args[4], args[5]);
+}
+
+static intptr_t SYS_CVAR_SET_FLOAT(intptr_t *args)
+{
+	Cvar_SetValueByName(VMA(1), VMF(2));
+	return 0;
+}
+
+static intptr_t SYS_CVAR_STRING(intptr_t *args)
+{
+	VM_CheckBounds(sv_vm, args[2], args[3]);
+	strlcpy(VMA(2), Cvar_String(VMA(1)), args[3]);
+	return 0;
+}
+
+static intptr_t SYS_Map_Extension(intptr_t *args)
+{
+	return PF2_Map_Extension(VMA(1), args[2]);
+}
+
+static intptr_t SYS_strcmp(intptr_t *args)
+{
+	return strcmp(VMA(1), VMA(2));
+}
+
+static intptr_t SYS_strncmp(intptr_t *args)
+{
+	return strncmp(VMA(1), VMA(2), args[3]);
+}
+
+static intptr_t SYS_stricmp(intptr_t *args)
+{
+	return strcasecmp(VMA(1), VMA(2));
+}
+
+static intptr_t SYS_strnicmp(intptr_t *args)
+{
+	return strncasecmp(VMA(1), VMA(2), args[3]);
+}
+
+static intptr_t SYS_Find(intptr_t *args)
+{
+	return PF2_Find(NUM_FOR_GAME_EDICT(VMA(1)), args[2], VMA(3));
+}
+
+static intptr_t SYS_executecmd(intptr_t *args)
+{
+	PF2_executecmd();
+	return 0;
+}
+
+static intptr_t SYS_conprint(intptr_t *args)
+{
+	Sys_Printf("%s", VMA(1));
+	return 0;
+}
+
+static intptr_t SYS_readcmd(intptr_t *args)
+{
+	VM_CheckBounds(sv_vm, args[2], args[3]);
+	PF2_readcmd(VMA(1), VMA(2), args[3]);
+	return 0;
+}
+
+static intptr_t SYS_redirectcmd(intptr_t *args)
+{
+	PF2_redirectcmd(NUM_FOR_GAME_EDICT(VMA(1)), VMA(2));
+	return 0;
+}
+
+static intptr_t SYS_Add_Bot(intptr_t *args)
+{
+	return PF2_Add_Bot(VMA(1), args[2], args[3], VMA(4));
+}
+
+static intptr_t SYS_Remove_Bot(intptr_t *args)
+{
+	PF2_Remove_Bot(args[1]);
+	return 0;
+}
+
+static intptr_t SYS_SetBotUserInfo(intptr_t *args)
+{
+	PF2_SetBotUserInfo(args[1], VMA(2), VMA(3), args[4]);
+	return 0;
+}
+
+static intptr_t SYS_SetBotCMD(intptr_t *args)
+{
+	PF2_SetBotCMD(args[1], args[2], VMV(3), args[6], args[7], args[8], args[9], args[10]);
+	return 0;
+}
+
+static intptr_t SYS_QVMstrftime(intptr_t *args)
+{
+	VM_CheckBounds(sv_vm, args[1], args[2]);
+	return PF2_QVMstrftime(VMA(1), args[2], VMA(3), args[4]);
+}
+
+static intptr_t SYS_CMD_ARGS(intptr_t *args)
+{
+	VM_CheckBounds(sv_vm, args[1], args[2]);
+	strlcpy(VMA(1), Cmd_Args(), args[2]);
+	return 0;
+}
+
+static intptr_t SYS_CMD_TOKENIZE(intptr_t *args)
+{
+	Cmd_TokenizeString(VMA(1));
+	return 0;
+}
+
+static intptr_t SYS_strlcpy(intptr_t *args)
+{
+	VM_CheckBounds(sv_vm, args[1], args[3]);
+	return strlcpy(VMA(1), VMA(2), args[3]);
+}
+
+static intptr_t SYS_strlcat(intptr_t *args)
+{
+	VM_CheckBounds(sv_vm, args[1], args[3]);
+	return strlcat(VMA(1), VMA(2), args[3]);
+}
+
+static intptr_t SYS_MAKEVECTORS(intptr_t *args)
+{
+	AngleVectors(VMA(1), pr_global_struct->v_forward, pr_global_struct->v_right,
+							 pr_global_struct->v_up);
+	return 0;
+}
+
+static intptr_t SYS_NEXTCLIENT(intptr_t *args)
+{
+	return PF2_nextclient(NUM_FOR_GAME_EDICT(VMA(1)));
+}
+
+static intptr_t SYS_PRECACHE_VWEP_MODEL(intptr_t *args)
+{
+	return PF2_precache_vwep_model(VMA(1));
+}
+
+static intptr_t SYS_SETPAUSE(intptr_t *args)
+{
+	PF2_setpause(args[1]);
+	return 0;
+}
+
+static intptr_t SYS_SETUSERINFO(intptr_t *args)
+{
+	PF2_SetUserInfo(args[1], VMA(2), VMA(3), args[4]);
+	return 0;
+}
+
+static intptr_t SYS_MOVETOGOAL(intptr_t *args)
+{
+	PF2_MoveToGoal(VMF(1));
+	return 0;
+}
+
+static intptr_t SYS_VISIBLETO(intptr_t *args)
+{
+	VM_CheckBounds(sv_vm, args[4], args[3]);
+	memset(VMA(4), 0, args[3]); // Ensure same memory state on each run.
+	PF2_VisibleTo(args[1], args[2], args[3], VMA(4));
+	return 0;
+}
+
+#define PR2_SYSCALL(num, fun) { num, #num, fun }
+static struct
+{
+	int num;
+	char *name;
+	syscall_t fun;
+} pr2_syscalls[] =
+{
+	PR2_SYSCALL(G_GETAPIVERSION, SYS_GETAPIVERSION),
+	PR2_SYSCALL(G_DPRINT, SYS_DPRINT),
+	PR2_SYSCALL(G_ERROR, SYS_ERROR),
+	PR2_SYSCALL(G_GetEntityToken, SYS_GetEntityToken),
+	PR2_SYSCALL(G_SPAWN_ENT, SYS_SPAWN_ENT),
+	PR2_SYSCALL(G_REMOVE_ENT, SYS_REMOVE_ENT),
+	PR2_SYSCALL(G_PRECACHE_SOUND, SYS_PRECACHE_SOUND),
+	PR2_SYSCALL(G_PRECACHE_MODEL, SYS_PRECACHE_MODEL),
+	PR2_SYSCALL(G_LIGHTSTYLE, SYS_LIGHTSTYLE),
+	PR2_SYSCALL(G_SETORIGIN, SYS_SETORIGIN),
+	PR2_SYSCALL(G_SETSIZE, SYS_SETSIZE),
+	PR2_SYSCALL(G_SETMODEL, SYS_SETMODEL),
+	PR2_SYSCALL(G_BPRINT, SYS_BPRINT),
+	PR2_SYSCALL(G_SPRINT, SYS_SPRINT),
+	PR2_SYSCALL(G_CENTERPRINT, SYS_CENTERPRINT),
+	PR2_SYSCALL(G_AMBIENTSOUND, SYS_AMBIENTSOUND),
+	PR2_SYSCALL(G_SOUND, SYS_SOUND),
+	PR2_SYSCALL(G_TRACELINE, SYS_TRACELINE),
+	PR2_SYSCALL(G_CHECKCLIENT, SYS_CHECKCLIENT),
+	PR2_SYSCALL(G_STUFFCMD, SYS_STUFFCMD),
+	PR2_SYSCALL(G_LOCALCMD, SYS_LOCALCMD),
+	PR2_SYSCALL(G_CVAR, SYS_CVAR),
+	PR2_SYSCALL(G_CVAR_SET, SYS_CVAR_SET),
+	PR2_SYSCALL(G_FINDRADIUS, SYS_FINDRADIUS),
+	PR2_SYSCALL(G_WALKMOVE, SYS_WALKMOVE),
+	PR2_SYSCALL(G_DROPTOFLOOR, SYS_DROPTOFLOOR),
+	PR2_SYSCALL(G_CHECKBOTTOM, SYS_CHECKBOTTOM),
+	PR2_SYSCALL(G_POINTCONTENTS, SYS_POINTCONTENTS),
+	PR2_SYSCALL(G_NEXTENT, SYS_NEXTENT),
+	PR2_SYSCALL(G_AIM, SYS_AIM),
+	PR2_SYSCALL(G_MAKESTATIC, SYS_MAKESTATIC),
+	PR2_SYSCALL(G_SETSPAWNPARAMS, SYS_SETSPAWNPARAMS),
+	PR2_SYSCALL(G_CHANGELEVEL, SYS_CHANGELEVEL),
+	PR2_SYSCALL(G_LOGFRAG, SYS_LOGFRAG),
+	PR2_SYSCALL(G_GETINFOKEY, SYS_GETINFOKEY),
+	PR2_SYSCALL(G_MULTICAST, SYS_MULTICAST),
+	PR2_SYSCALL(G_DISABLEUPDATES, SYS_DISABLEUPDATES),
+	PR2_SYSCALL(G_WRITEBYTE, SYS_WRITEBYTE),
+	PR2_SYSCALL(G_WRITECHAR, SYS_WRITECHAR),
+	PR2_SYSCALL(G_WRITESHORT, SYS_WRITESHORT),
+	PR2_SYSCALL(G_WRITELONG, SYS_WRITELONG),
+	PR2_SYSCALL(G_WRITEANGLE, SYS_WRITEANGLE),
+	PR2_SYSCALL(G_WRITECOORD, SYS_WRITECOORD),
+	PR2_SYSCALL(G_WRITESTRING, SYS_WRITESTRING),
+	PR2_SYSCALL(G_WRITEENTITY, SYS_WRITEENTITY),
+	PR2_SYSCALL(G_FLUSHSIGNON, SYS_FLUSHSIGNON),
+	PR2_SYSCALL(g_memset, SYS_memset),
+	PR2_SYSCALL(g_memcpy, SYS_memcpy),
+	PR2_SYSCALL(g_strncpy, SYS_strncpy),
+	PR2_SYSCALL(g_sin, SYS_sin),
+	PR2_SYSCALL(g_cos, SYS_cos),
+	PR2_SYSCALL(g_atan2, SYS_atan2),
+	PR2_SYSCALL(g_sqrt, SYS_sqrt),
+	PR2_SYSCALL(g_floor, SYS_floor),
+	PR2_SYSCALL(g_ceil, SYS_ceil),
+	PR2_SYSCALL(g_acos, SYS_acos),
+	PR2_SYSCALL(G_CMD_ARGC, SYS_CMD_ARGC),
+	PR2_SYSCALL(G_CMD_ARGV, SYS_CMD_ARGV),
+	PR2_SYSCALL(G_TraceCapsule, SYS_TraceCapsule),
+	PR2_SYSCALL(G_FSOpenFile, SYS_FSOpenFile),
+	PR2_SYSCALL(G_FSCloseFile, SYS_FSCloseFile),
+	PR2_SYSCALL(G_FSReadFile, SYS_FSReadFile),
+	PR2_SYSCALL(G_FSWriteFile, SYS_FSWriteFile),
+	PR2_SYSCALL(G_FSSeekFile, SYS_FSSeekFile),
+	PR2_SYSCALL(G_FSTellFile, SYS_FSTellFile),
+	PR2_SYSCALL(G_FSGetFileList, SYS_FSGetFileList),
+	PR2_SYSCALL(G_CVAR_SET_FLOAT, SYS_CVAR_SET_FLOAT),
+	PR2_SYSCALL(G_CVAR_STRING, SYS_CVAR_STRING),
+	PR2_SYSCALL(G_Map_Extension, SYS_Map_Extension),
+	PR2_SYSCALL(G_strcmp, SYS_strcmp),
+	PR2_SYSCALL(G_strncmp, SYS_strncmp),
+	PR2_SYSCALL(G_stricmp, SYS_stricmp),
+	PR2_SYSCALL(G_strnicmp, SYS_strnicmp),
+	PR2_SYSCALL(G_Find, SYS_Find),
+	PR2_SYSCALL(G_executecmd, SYS_executecmd),
+	PR2_SYSCALL(G_conprint, SYS_conprint),
+	PR2_SYSCALL(G_readcmd, SYS_readcmd),
+	PR2_SYSCALL(G_redirectcmd, SYS_redirectcmd),
+	PR2_SYSCALL(G_Add_Bot, SYS_Add_Bot),
+	PR2_SYSCALL(G_Remove_Bot, SYS_Remove_Bot),
+	PR2_SYSCALL(G_SetBotUserInfo, SYS_SetBotUserInfo),
+	PR2_SYSCALL(G_SetBotCMD, SYS_SetBotCMD),
+	PR2_SYSCALL(G_QVMstrftime, SYS_QVMstrftime),
+	PR2_SYSCALL(G_CMD_ARGS, SYS_CMD_ARGS),
+	PR2_SYSCALL(G_CMD_TOKENIZE, SYS_CMD_TOKENIZE),
+	PR2_SYSCALL(g_strlcpy, SYS_strlcpy),
+	PR2_SYSCALL(g_strlcat, SYS_strlcat),
+	PR2_SYSCALL(G_MAKEVECTORS, SYS_MAKEVECTORS),
+	PR2_SYSCALL(G_NEXTCLIENT, SYS_NEXTCLIENT),
+	PR2_SYSCALL(G_PRECACHE_VWEP_MODEL, SYS_PRECACHE_VWEP_MODEL),
+	PR2_SYSCALL(G_SETPAUSE, SYS_SETPAUSE),
+	PR2_SYSCALL(G_SETUSERINFO, SYS_SETUSERINFO),
+	PR2_SYSCALL(G_MOVETOGOAL, SYS_MOVETOGOAL),
+	PR2_SYSCALL(G_VISIBLETO, SYS_VISIBLETO),
+};
+
+// fills the dispatch table of PR2_GameSystemCalls
+void PR2_InitSyscalls(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_LEN(pr2_syscalls); i++)
+	{
+		pr2_syscall_tbl[pr2_syscalls[i].num] = pr2_syscalls[i].fun;
+		pr2_syscall_names[pr2_syscalls[i].num] = pr2_syscalls[i].name;
+	}
+}
+
+const char *PR2_SyscallName(int num)
+{
+	if (num < 0 || num >= ARRAY_LEN(pr2_syscall_names))
+		return NULL;
+
+	return pr2_syscall_names[num];
+}
+
+intptr_t PR2_GameSystemCalls(intptr_t *args) {
+	syscall_t fun = NULL;
+	intptr_t ret;
+	double start;
+
+	if ((uintptr_t)args[0] < ARRAY_LEN(pr2_syscall_tbl))
+		fun = pr2_syscall_tbl[args[0]];
+	if (!fun)
+		SV_Error("Bad game system trap: %ld", (long int)args[0]);
+
+	if (!vm_logSyscalls)
+		return fun(args);
+
+	start = Sys_DoubleTime();
+	ret = fun(args);
+	VM_LogSyscalls(args, Sys_DoubleTime() - start);
+	return ret;
+}
+
 #endif /* USE_PR2 */
 
 #endif // !CLIENTONLY
@@ -40,6 +40,8 @@ void PR2_Profile_f (void);
 void ED2_PrintEdict_f (void);
 void ED_Count (void);
 void VM_VmInfo_f( void );
+void VM_VmProfile_f( void );
+void VM_VmSyscalls_f( void );
 
 void PR2_Init(void)
 {
@@ -71,7 +73,11 @@ void PR2_Init(void)
 	Cmd_AddCommand ("mod", PR2_GameConsoleCommand);
 
 	Cmd_AddCommand ("vminfo", VM_VmInfo_f);
+	Cmd_AddCommand ("vmprofile", VM_VmProfile_f);
+	Cmd_AddCommand ("vmsyscalls", VM_VmSyscalls_f);
+	PR_SampleInit ();
 	memset(pr_newstrtbl, 0, sizeof(pr_newstrtbl));
+	PR2_InitSyscalls();
 }
 
 void PR2_Profile_f(void)
@@ -412,6 +418,7 @@ void PR2_UnLoadProgs(void)
 	{
 		VM_Free( sv_vm );
 		sv_vm = NULL;
+		PR_SampleProgsChanged();
 	}
 	else
 	{
@@ -1271,6 +1271,7 @@ void PR1_Init (void)
 	Cmd_AddCommand ("edicts", ED_PrintEdicts);
 	Cmd_AddCommand ("edictcount", ED_Count);
 	Cmd_AddCommand ("profile", PR_Profile_f);
+	PR_SampleInit ();
 
 	memset(pr_newstrtbl, 0, sizeof(pr_newstrtbl));
 }
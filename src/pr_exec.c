@@ -253,6 +253,32 @@ void PR_Profile_f (void)
 }
 
 
+/*
+============
+PR_Sample
+
+Hands the QC stack to the sampling profiler, builtin is the leaf if set
+============
+*/
+static void PR_Sample (dfunction_t *builtin)
+{
+	int frames[MAX_STACK_DEPTH + 1];
+	int i, depth;
+
+	depth = 0;
+	if (builtin)
+		frames[depth++] = builtin - pr_functions;
+	frames[depth++] = pr_xfunction - pr_functions;
+	for (i = pr_depth - 1; i > 0; i--)
+	{
+		if (pr_stack[i].f)
+			frames[depth++] = pr_stack[i].f - pr_functions;
+	}
+
+	PR_SampleQC (frames, depth);
+}
+
+
 /*
 ============
 PR_RunError
@@ -319,6 +345,8 @@ int PR_EnterFunction (dfunction_t *f)
 	}
 
 	pr_xfunction = f;
+	if (pr_sample_pending)
+		PR_Sample (NULL);
 	return f->first_statement - 1; // offset the s++
 }
 
@@ -382,6 +410,8 @@ void PR_ExecuteProgram (func_t fnum)
 
 	// make a stack frame
 	exitdepth = pr_depth;
+	if (!exitdepth)
+		pr_sample_pending = 0; // the tick came while the engine was running
 
 	s = PR_EnterFunction (f);
 
@@ -633,6 +663,8 @@ void PR_ExecuteProgram (func_t fnum)
 				if (i >= pr_numbuiltins)
 					PR_RunError ("Bad builtin call number");
 				pr_builtins[i] ();
+				if (pr_sample_pending)
+					PR_Sample (newf);
 				break;
 			}
 
@@ -871,6 +903,7 @@ void PR1_UnLoadProgs(void)
 		pr_nqprogs = false;
 #endif
 		progs = NULL;
+		PR_SampleProgsChanged();
 	}
 }
 
@@ -0,0 +1,571 @@
+/*
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifndef CLIENTONLY
+#include "qwsvdef.h"
+#ifdef USE_PR2
+#include "vm_local.h"
+#endif
+
+// A thread raises pr_sample_pending every sv_sampleprofile_interval ms.
+// The interpreters check the flag on function entry and after syscalls or
+// builtins return, and record the call stack they are in. The stacks are
+// written in the collapsed format that flamegraph.pl and speedscope read.
+
+#define PRSP_MAX_DEPTH		32
+#define PRSP_MAX_STACKS		16384
+#define PRSP_HASH_SIZE		4096
+
+typedef struct prsp_funcs_s
+{
+	int			count;
+	int			*start;			// first instruction of each QVM function, sorted
+	int			*frame;			// stack frame size from its OP_ENTER
+	char		**names;
+	struct prsp_funcs_s *next;
+} prsp_funcs_t;
+
+typedef struct prsp_stack_s
+{
+	prsp_funcs_t *funcs;
+	int			count;
+	int			depth;
+	struct prsp_stack_s *next;
+	int			frames[1];		// leaf first, variable sized
+} prsp_stack_t;
+
+cvar_t	sv_sampleprofile_interval = {"sv_sampleprofile_interval", "2"};
+
+volatile int	pr_sample_pending;
+
+static SDL_Thread	*prsp_thread;
+static volatile int	prsp_quit;
+static int			prsp_interval;
+static double		prsp_starttime, prsp_runtime;
+
+static prsp_funcs_t	*prsp_funcs;		// every table a recorded stack may point to
+static prsp_funcs_t	*prsp_vmfuncs;		// table of the loaded QVM
+static prsp_funcs_t	*prsp_qcfuncs;		// table of the loaded QC progs
+
+static prsp_stack_t	*prsp_hash[PRSP_HASH_SIZE];
+static int			prsp_numstacks;
+static int			prsp_samples;
+static int			prsp_dropped;
+
+static int PR_SampleThread (void *unused)
+{
+	while (!prsp_quit)
+	{
+		Sys_MSleep(prsp_interval);
+		pr_sample_pending = 1;
+	}
+
+	return 0;
+}
+
+static prsp_funcs_t *PR_SampleNewFuncs (int count)
+{
+	prsp_funcs_t *funcs;
+
+	funcs = (prsp_funcs_t *) Q_calloc(1, sizeof(*funcs));
+	funcs->count = count;
+	funcs->names = (char **) Q_calloc(max(count, 1), sizeof(*funcs->names));
+	funcs->next = prsp_funcs;
+	prsp_funcs = funcs;
+
+	return funcs;
+}
+
+// frees the tables that no longer belong to loaded progs
+static void PR_SampleFreeFuncs (void)
+{
+	prsp_funcs_t *funcs, **prev;
+	int i;
+
+	for (prev = &prsp_funcs; (funcs = *prev); )
+	{
+		if (funcs == prsp_vmfuncs || funcs == prsp_qcfuncs)
+		{
+			prev = &funcs->next;
+			continue;
+		}
+
+		*prev = funcs->next;
+		for (i = 0; i < funcs->count; i++)
+			Q_free(funcs->names[i]);
+		Q_free(funcs->names);
+		Q_free(funcs->start);
+		Q_free(funcs->frame);
+		Q_free(funcs);
+	}
+}
+
+static void PR_SampleClear (void)
+{
+	prsp_stack_t *stack, *next;
+	int i;
+
+	for (i = 0; i < PRSP_HASH_SIZE; i++)
+	{
+		for (stack = prsp_hash[i]; stack; stack = next)
+		{
+			next = stack->next;
+			Q_free(stack);
+		}
+		prsp_hash[i] = NULL;
+	}
+	PR_SampleFreeFuncs();
+
+	prsp_numstacks = prsp_samples = prsp_dropped = 0;
+	prsp_runtime = 0;
+	if (prsp_thread)
+		prsp_starttime = Sys_DoubleTime();
+}
+
+static void PR_SampleRecord (prsp_funcs_t *funcs, const int *frames, int depth)
+{
+	prsp_stack_t *stack;
+	unsigned int hash;
+	int i;
+
+	if (!depth)
+		return;
+
+	hash = 2166136261u ^ (unsigned int)(intptr_t) funcs;
+	for (i = 0; i < depth; i++)
+		hash = (hash ^ (unsigned int) frames[i]) * 16777619u;
+	hash &= PRSP_HASH_SIZE - 1;
+
+	for (stack = prsp_hash[hash]; stack; stack = stack->next)
+	{
+		if (stack->funcs == funcs && stack->depth == depth && !memcmp(stack->frames, frames, depth * sizeof(*frames)))
+			break;
+	}
+
+	if (!stack)
+	{
+		if (prsp_numstacks >= PRSP_MAX_STACKS)
+		{
+			prsp_dropped++;
+			return;
+		}
+
+		stack = (prsp_stack_t *) Q_malloc(sizeof(*stack) + (depth - 1) * sizeof(*frames));
+		stack->funcs = funcs;
+		stack->count = 0;
+		stack->depth = depth;
+		memcpy(stack->frames, frames, depth * sizeof(*frames));
+		stack->next = prsp_hash[hash];
+		prsp_hash[hash] = stack;
+		prsp_numstacks++;
+	}
+
+	stack->count++;
+	prsp_samples++;
+}
+
+/*
+============
+PR_SampleQC
+
+Records the QC stack, frames are indexes into pr_functions, leaf first
+============
+*/
+void PR_SampleQC (const int *frames, int depth)
+{
+	int i;
+
+	pr_sample_pending = 0;
+
+	if (!prsp_thread || !progs)
+		return;
+
+	if (!prsp_qcfuncs)
+	{
+		prsp_qcfuncs = PR_SampleNewFuncs(progs->numfunctions);
+		for (i = 0; i < progs->numfunctions; i++)
+			prsp_qcfuncs->names[i] = Q_strdup(PR1_GetString(pr_functions[i].s_name));
+	}
+
+	PR_SampleRecord(prsp_qcfuncs, frames, depth);
+}
+
+#ifdef USE_PR2
+static prsp_funcs_t *PR_SampleVMFuncs (vm_t *vm)
+{
+	instruction_t *inst = (instruction_t *) vm->codeBase.ptr;
+	prsp_funcs_t *funcs;
+	vmSymbol_t *sym;
+	int count, i, n;
+
+	for (i = count = 0; i < vm->instructionCount; i++)
+	{
+		if (inst[i].op == OP_ENTER)
+			count++;
+	}
+
+	funcs = PR_SampleNewFuncs(count);
+	funcs->start = (int *) Q_malloc(max(count, 1) * sizeof(int));
+	funcs->frame = (int *) Q_malloc(max(count, 1) * sizeof(int));
+
+	// the symbols are sorted by value as well, so walk both lists together
+	sym = vm->symbols;
+	for (i = n = 0; i < vm->instructionCount; i++)
+	{
+		if (inst[i].op != OP_ENTER)
+			continue;
+
+		while (sym && sym->next && sym->next->symValue <= i)
+			sym = sym->next;
+
+		funcs->start[n] = i;
+		funcs->frame[n] = inst[i].value;
+		if (sym && sym->symValue == i)
+			funcs->names[n] = Q_strdup(sym->symName);
+		else if (sym && sym->symValue < i)
+			funcs->names[n] = Q_strdup(va("%s+%i", sym->symName, i - sym->symValue));
+		else
+			funcs->names[n] = Q_strdup(va("func_%i", i));
+		n++;
+	}
+
+	return funcs;
+}
+
+static int PR_SampleFindVMFunc (prsp_funcs_t *funcs, int pc)
+{
+	int lo, hi, mid;
+
+	lo = 0;
+	hi = funcs->count - 1;
+	if (hi < 0 || pc < funcs->start[0])
+		return -1;
+
+	while (lo < hi)
+	{
+		mid = (lo + hi + 1) / 2;
+		if (funcs->start[mid] <= pc)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+
+	return lo;
+}
+
+/*
+============
+PR_SampleVM
+
+Walks the stack of the interpreted QVM. pc is an instruction of the function
+that owns the frame at programStack, syscall is >= 0 when that function has
+just called into the engine.
+============
+*/
+void PR_SampleVM (vm_t *vm, int pc, unsigned int programStack, int syscall)
+{
+	int frames[PRSP_MAX_DEPTH];
+	int depth, f;
+
+	pr_sample_pending = 0;
+
+	if (!prsp_thread)
+		return;
+
+	if (!prsp_vmfuncs)
+		prsp_vmfuncs = PR_SampleVMFuncs(vm);
+
+	depth = 0;
+	if (syscall >= 0)
+		frames[depth++] = -1 - syscall;
+
+	while (depth < PRSP_MAX_DEPTH)
+	{
+		if ((f = PR_SampleFindVMFunc(prsp_vmfuncs, pc)) < 0)
+			break;
+		frames[depth++] = f;
+
+		// OP_LEAVE pops the frame and finds the return address there,
+		// -1 when the function was called by VM_Call
+		programStack += prsp_vmfuncs->frame[f];
+		if (programStack > vm->dataMask - 3)
+			break;
+		pc = *(int *)&vm->dataBase[programStack];
+		if ((unsigned int) pc >= (unsigned int) vm->instructionCount)
+			break;
+	}
+
+	PR_SampleRecord(prsp_vmfuncs, frames, depth);
+}
+#endif
+
+/*
+============
+PR_SampleProgsChanged
+
+Called when progs are unloaded, recorded stacks keep the names they had
+============
+*/
+void PR_SampleProgsChanged (void)
+{
+	prsp_vmfuncs = NULL;
+	prsp_qcfuncs = NULL;
+}
+
+static const char *PR_SampleFrameName (prsp_funcs_t *funcs, int frame)
+{
+#ifdef USE_PR2
+	const char *name;
+
+	if (frame < 0 && (name = PR2_SyscallName(-1 - frame)))
+		return name;
+#endif
+	if (frame < 0)
+		return va("syscall_%i", -1 - frame);
+
+	return funcs->names[frame];
+}
+
+typedef struct
+{
+	char	*name;
+	int		count;
+} prsp_line_t;
+
+static int PR_SampleLineNameCmp (const void *a, const void *b)
+{
+	return strcmp(((const prsp_line_t *) a)->name, ((const prsp_line_t *) b)->name);
+}
+
+static int PR_SampleLineCountCmp (const void *a, const void *b)
+{
+	return ((const prsp_line_t *) b)->count - ((const prsp_line_t *) a)->count;
+}
+
+// sorts the lines by name and adds up the counts of equal ones
+static int PR_SampleMergeLines (prsp_line_t *lines, int count)
+{
+	int i, n;
+
+	if (!count)
+		return 0;
+
+	qsort(lines, count, sizeof(*lines), PR_SampleLineNameCmp);
+	for (i = 1, n = 0; i < count; i++)
+	{
+		if (!strcmp(lines[i].name, lines[n].name))
+		{
+			lines[n].count += lines[i].count;
+			Q_free(lines[i].name);
+		}
+		else
+		{
+			lines[++n] = lines[i];
+		}
+	}
+
+	return n + 1;
+}
+
+// one line per recorded stack, or per leaf function when leaves is set
+static prsp_line_t *PR_SampleCollect (qbool leaves, int *count)
+{
+	prsp_line_t *lines;
+	prsp_stack_t *stack;
+	char buf[2048];
+	int i, j, n;
+
+	lines = (prsp_line_t *) Q_malloc(max(prsp_numstacks, 1) * sizeof(*lines));
+	for (i = n = 0; i < PRSP_HASH_SIZE; i++)
+	{
+		for (stack = prsp_hash[i]; stack; stack = stack->next)
+		{
+			if (leaves)
+			{
+				strlcpy(buf, PR_SampleFrameName(stack->funcs, stack->frames[0]), sizeof(buf));
+			}
+			else
+			{
+				buf[0] = 0;
+				for (j = stack->depth - 1; j >= 0; j--)
+				{
+					strlcat(buf, PR_SampleFrameName(stack->funcs, stack->frames[j]), sizeof(buf));
+					if (j)
+						strlcat(buf, ";", sizeof(buf));
+				}
+			}
+			lines[n].name = Q_strdup(buf);
+			lines[n].count = stack->count;
+			n++;
+		}
+	}
+
+	*count = PR_SampleMergeLines(lines, n);
+	return lines;
+}
+
+static void PR_SampleFreeLines (prsp_line_t *lines, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		Q_free(lines[i].name);
+	Q_free(lines);
+}
+
+static void PR_SampleDump (const char *name)
+{
+	prsp_line_t *lines;
+	char path[MAX_OSPATH];
+	FILE *f;
+	int i, count;
+
+	if (strstr(name, "..") || name[0] == '/' || name[0] == '\\' || strchr(name, ':'))
+	{
+		Con_Printf("Invalid file name %s\n", name);
+		return;
+	}
+
+	snprintf(path, sizeof(path), "%s/%s", fs_gamedir, name);
+	if (!(f = fopen(path, "w")))
+	{
+		Con_Printf("Couldn't write %s\n", path);
+		return;
+	}
+
+	lines = PR_SampleCollect(false, &count);
+	for (i = 0; i < count; i++)
+		fprintf(f, "%s %i\n", lines[i].name, lines[i].count);
+	PR_SampleFreeLines(lines, count);
+	fclose(f);
+
+	Con_Printf("Wrote %i stacks from %i samples to %s\n", count, prsp_samples, path);
+}
+
+static void PR_SampleStatus (void)
+{
+	prsp_line_t *lines;
+	double runtime;
+	int i, count;
+
+	runtime = prsp_runtime;
+	if (prsp_thread)
+		runtime += Sys_DoubleTime() - prsp_starttime;
+
+	Con_Printf("Sampling profiler is %s, every %i ms\n", prsp_thread ? "running" : "stopped", prsp_thread ? prsp_interval : bound(1, (int) sv_sampleprofile_interval.value, 1000));
+	Con_Printf("%i samples in %.1f seconds, %i stacks", prsp_samples, runtime, prsp_numstacks);
+	if (prsp_dropped)
+		Con_Printf(", %i samples dropped", prsp_dropped);
+	Con_Printf("\n");
+#ifdef USE_PR2
+	if (sv_vm && sv_vm->compiled)
+		Con_Printf("The QVM is compiled and can't be sampled, use sv_progtype 2\n");
+	else if (sv_vm && sv_vm->dllHandle)
+		Con_Printf("Native game modules can't be sampled, use sv_progtype 2\n");
+#endif
+
+	if (!prsp_samples)
+		return;
+
+	lines = PR_SampleCollect(true, &count);
+	qsort(lines, count, sizeof(*lines), PR_SampleLineCountCmp);
+	Con_Printf("self samples:\n");
+	for (i = 0; i < count && i < 10; i++)
+		Con_Printf("%3i%% %7i %s\n", (int)(100.0 * lines[i].count / prsp_samples), lines[i].count, lines[i].name);
+	PR_SampleFreeLines(lines, count);
+}
+
+static void PR_SampleStart (void)
+{
+	if (prsp_thread)
+		return;
+
+	prsp_interval = bound(1, (int) sv_sampleprofile_interval.value, 1000);
+	prsp_quit = 0;
+	pr_sample_pending = 0;
+	if (!(prsp_thread = Sys_CreateThread(PR_SampleThread, NULL)))
+	{
+		Con_Printf("Couldn't start the sampling thread\n");
+		return;
+	}
+	prsp_starttime = Sys_DoubleTime();
+}
+
+/*
+============
+PR_SampleStop
+============
+*/
+void PR_SampleStop (void)
+{
+	if (!prsp_thread)
+		return;
+
+	prsp_quit = 1;
+	SDL_WaitThread(prsp_thread, NULL);
+	prsp_thread = NULL;
+	pr_sample_pending = 0;
+	prsp_runtime += Sys_DoubleTime() - prsp_starttime;
+}
+
+/*
+============
+PR_SampleProfile_f
+============
+*/
+static void PR_SampleProfile_f (void)
+{
+	char *cmd = Cmd_Argv(1);
+
+	if (Cmd_Argc() < 2)
+	{
+		PR_SampleStatus();
+	}
+	else if (!strcasecmp(cmd, "start"))
+	{
+		PR_SampleStart();
+	}
+	else if (!strcasecmp(cmd, "stop"))
+	{
+		PR_SampleStop();
+	}
+	else if (!strcasecmp(cmd, "clear"))
+	{
+		PR_SampleClear();
+	}
+	else if (!strcasecmp(cmd, "dump"))
+	{
+		PR_SampleDump(Cmd_Argc() > 2 ? Cmd_Argv(2) : "profile.folded");
+	}
+	else
+	{
+		Con_Printf("Usage: %s [start|stop|clear|dump [file]]\n", Cmd_Argv(0));
+	}
+}
+
+/*
+============
+PR_SampleInit
+============
+*/
+void PR_SampleInit (void)
+{
+	Cvar_Register(&sv_sampleprofile_interval);
+	Cmd_AddCommand("sampleprofile", PR_SampleProfile_f);
+}
+
+#endif // !CLIENTONLY
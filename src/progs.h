@@ -126,6 +126,13 @@ void PR_InitPatchTables (void);	// NQ progs support
 
 void PR_Profile_f (void);
 
+// sampling profiler, pr_profile.c
+extern volatile int pr_sample_pending;
+void PR_SampleInit (void);
+void PR_SampleStop (void);
+void PR_SampleProgsChanged (void);
+void PR_SampleQC (const int *frames, int depth);
+
 void ED_ClearEdict (edict_t *e);
 edict_t *ED_Alloc (void);
 void ED_Free (edict_t *ed);
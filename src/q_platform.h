@@ -29,6 +29,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #ifdef Q3_VM
 
 #define idx386 0
+#define idarm64 0
 #define idppc 0
 #define idppc_altivec 0
 #define idsparc 0
@@ -41,6 +42,12 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #define idx386 0
 #endif
 
+#if defined __aarch64__ && (defined __linux__ || defined __FreeBSD__) && !defined(C_ONLY)
+#define idarm64 1
+#else
+#define idarm64 0
+#endif
+
 #if (defined(powerc) || defined(powerpc) || defined(ppc) || \
 	defined(__ppc) || defined(__ppc__)) && !defined(C_ONLY)
 #define idppc 1
@@ -198,6 +205,8 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #define ARCH_STRING "alpha"
 #elif defined __sparc__
 #define ARCH_STRING "sparc"
+#elif defined __aarch64__
+#define ARCH_STRING "aarch64"
 #elif defined __arm__
 #define ARCH_STRING "arm"
 #elif defined __cris__
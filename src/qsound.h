@@ -28,6 +28,12 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 typedef struct sfx_s {
 	char  name[MAX_QPATH];
 	void *buf;
+
+	// sound cache, see snd_mem.c
+	struct sfx_decode_s *decode;    // background decode in flight
+	double last_used;
+	int uses;
+	int registration;               // S_BeginPrecache count it was last precached at
 } sfx_t;
 
 extern sfx_t	*cl_sfx_jump, *cl_sfx_land, *cl_sfx_land2, *cl_sfx_h2ojump, *cl_sfx_inh2o, *cl_sfx_inlava, *cl_sfx_inslime, *cl_sfx_outwater, *cl_sfx_ax1, *cl_sfx_axhit1, *cl_sfx_sg, *cl_sfx_ssg, *cl_sfx_ng, *cl_sfx_sng, *cl_sfx_gl, *cl_sfx_rl, *cl_sfx_lg, *cl_sfx_lghit, *cl_sfx_coil, *cl_sfx_hook;
@@ -103,6 +109,21 @@ void S_PaintChannels(int endtime);
 void S_LocalSound (char *s);
 void S_LocalSoundWithVol(char *sound, float volume);
 sfxcache_t *S_LoadSound (sfx_t *s);
+void S_QueueSound (sfx_t *s);
+void S_FinishSoundDecodes (void);
+void S_FreeSound (sfx_t *s);
+void S_SoundCacheShutdown (void);
+void S_BeginPrecache (void);
+
+typedef struct snd_cache_stats_s {
+	unsigned int hits;          // already decoded
+	unsigned int waits;         // waited for a background decode
+	unsigned int misses;        // decoded on the spot
+	unsigned int evictions;
+	size_t resident;            // bytes of decoded samples
+} snd_cache_stats_t;
+
+extern snd_cache_stats_t snd_cache_stats;
 #define RAW_SOURCE_QIZMO_VOICE MAX_CLIENTS
 #define RAW_SOURCE_DEMO_VOICE_COUNT 12
 #define RAW_SOURCE_DEMO_VOICE_BASE (RAW_SOURCE_QIZMO_VOICE + 1)
@@ -110,7 +131,8 @@ sfxcache_t *S_LoadSound (sfx_t *s);
 void S_RawAudio(int sourceid, byte *data, unsigned int speed, unsigned int samples, unsigned int channelsnum, unsigned int width);
 void S_QizmoVoice_PlayFrame(int sequence, int voice_id, const byte *data, int bytes);
 
-void SND_InitScaletable (void);
+void SND_AllocPaintBuffer (void);
+void S_MixerBenchmark_f (void);
 int SND_Rate(int rate);
 
 void SND_ResampleStream(void *in, int inrate, int inwidth, int inchannels, int insamps,
@@ -141,6 +163,8 @@ extern cvar_t		s_khz;
 extern cvar_t		s_volume;
 extern cvar_t		s_raw_volume;
 extern cvar_t		s_swapstereo;
+extern cvar_t		s_mixer_simd;
+extern cvar_t		s_paintbuffersize;
 extern cvar_t		bgmvolume;
 
 #endif
@@ -325,6 +325,9 @@ void R_DrawAliasModel(entity_t *ent, qbool outline)
 
 	// Meag: Do not move this above R_FilterEntity(), it might change the model... :(
 	paliashdr = (aliashdr_t *)Mod_Extradata(ent->model); // locate the proper data
+	if (ent->model->lazy_skins) {
+		Mod_LazySkinsTouch(ent->model);
+	}
 
 	//VULT CORONAS
 	if (amf_coronas.integer) {
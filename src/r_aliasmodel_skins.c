@@ -136,6 +136,184 @@ static texture_ref Mod_LoadExternalSkin(model_t* loadmodel, char *identifier, te
 	return texnum;
 }
 
+//
+// Lazy external skins
+//
+// With gl_lazyModelTextures the 8 bit skins of an alias model are uploaded at
+// load and stand in for its external skins until the model is first drawn.
+// The external images are then decoded on the image decode workers and
+// swapped in from the main thread once they are all ready.
+//
+
+typedef struct lazy_skin_s {
+	model_t *model;
+	char identifier[64];
+	int skin;
+	int group;          // index in an animating group, -1 for single skins
+	int groupskins;
+	qbool queued;       // in the running decode batch
+} lazy_skin_t;
+
+extern cvar_t gl_lazyModelTextures;
+
+static lazy_skin_t *lazy_skins;
+static int lazy_skins_count;
+static int lazy_skins_size;
+static qbool lazy_skins_batch;
+
+static void Mod_LazySkinsRemove(model_t *mod)
+{
+	int i, kept = 0;
+
+	for (i = 0; i < lazy_skins_count; i++) {
+		if (lazy_skins[i].model != mod) {
+			lazy_skins[kept++] = lazy_skins[i];
+		}
+	}
+	lazy_skins_count = kept;
+
+	mod->lazy_skins = 0;
+	mod->lazy_skins_wanted = false;
+}
+
+static void Mod_LazySkinsAdd(model_t *mod, const char *identifier, int skin, int group, int groupskins)
+{
+	lazy_skin_t *lazy;
+
+	if (lazy_skins_count >= lazy_skins_size) {
+		lazy_skins_size = max(64, lazy_skins_size * 2);
+		lazy_skins = Q_realloc(lazy_skins, lazy_skins_size * sizeof(lazy_skins[0]));
+	}
+
+	lazy = &lazy_skins[lazy_skins_count++];
+	memset(lazy, 0, sizeof(*lazy));
+	lazy->model = mod;
+	strlcpy(lazy->identifier, identifier, sizeof(lazy->identifier));
+	lazy->skin = skin;
+	lazy->group = group;
+	lazy->groupskins = groupskins;
+
+	mod->lazy_skins++;
+}
+
+// Called when the model is drawn, its external skins get loaded over the next frames
+void Mod_LazySkinsTouch(model_t *mod)
+{
+	mod->lazy_skins_wanted = true;
+}
+
+static void Mod_LazySkinLoad(lazy_skin_t *lazy)
+{
+	model_t *mod = lazy->model;
+	aliashdr_t *hdr = (aliashdr_t *)mod->cached_data;
+	texture_ref gl_texnum, fb_texnum;
+	int j;
+
+	mod->lazy_skins--;
+	if (mod->type != mod_alias || !hdr || lazy->skin >= hdr->numskins) {
+		return;
+	}
+
+	gl_texnum = Mod_LoadExternalSkin(mod, lazy->identifier, &fb_texnum);
+	if (!R_TextureReferenceIsValid(gl_texnum)) {
+		// no external skin, the 8 bit one stays
+		return;
+	}
+
+	if (lazy->group < 0) {
+		for (j = 0; j < 4; j++) {
+			hdr->gl_texturenum[lazy->skin][j] = gl_texnum;
+			hdr->glc_fb_texturenum[lazy->skin][j] = fb_texnum;
+		}
+	}
+	else {
+		hdr->gl_texturenum[lazy->skin][lazy->group & 3] = gl_texnum;
+		hdr->glc_fb_texturenum[lazy->skin][lazy->group & 3] = fb_texnum;
+
+		// groups of less than four repeat, as in Mod_LoadAllSkins
+		for (j = lazy->groupskins; j < 4; j++) {
+			hdr->gl_texturenum[lazy->skin][j] = hdr->gl_texturenum[lazy->skin][j - lazy->groupskins];
+			hdr->glc_fb_texturenum[lazy->skin][j] = hdr->glc_fb_texturenum[lazy->skin][j - lazy->groupskins];
+		}
+	}
+}
+
+static void Mod_LazySkinQueue(lazy_skin_t *lazy)
+{
+	int texmode = TEX_MIPMAP;
+	char *path;
+
+	texmode |= (lazy->model->modhint == MOD_VMODEL ? TEX_VIEWMODEL : 0);
+	texmode |= (!gl_scaleModelTextures.value ? TEX_NOSCALE : 0);
+
+	// the same paths Mod_LoadExternalSkin tries
+	path = va("textures/models/%s", lazy->identifier);
+	if (!R_ImageDecodeQueue(path, texmode)) {
+		path = va("textures/%s", lazy->identifier);
+		if (!R_ImageDecodeQueue(path, texmode)) {
+			path = NULL;
+		}
+	}
+	if (path && Ruleset_IsLumaAllowed(lazy->model)) {
+		R_ImageDecodeQueue(va("%s_luma", path), texmode | TEX_FULLBRIGHT | TEX_ALPHA | TEX_LUMA);
+	}
+	lazy->queued = true;
+}
+
+// Swaps in the skins of the last decode batch, or starts one for newly drawn models
+void Mod_LazySkinsFrame(void)
+{
+	int i, kept = 0;
+
+	if (lazy_skins_batch) {
+		if (!R_ImageDecodeDone()) {
+			return;
+		}
+
+		for (i = 0; i < lazy_skins_count; i++) {
+			if (lazy_skins[i].queued) {
+				Mod_LazySkinLoad(&lazy_skins[i]);
+			}
+			else {
+				lazy_skins[kept++] = lazy_skins[i];
+			}
+		}
+		lazy_skins_count = kept;
+
+		R_ImageDecodeFinish();
+		lazy_skins_batch = false;
+		return;
+	}
+
+	for (i = 0; i < lazy_skins_count && !lazy_skins[i].model->lazy_skins_wanted; i++) {
+	}
+	if (i == lazy_skins_count) {
+		return;
+	}
+
+	if (!R_ImageDecodeBegin()) {
+		// no decode workers, load them here
+		for (i = 0; i < lazy_skins_count; i++) {
+			if (lazy_skins[i].model->lazy_skins_wanted) {
+				Mod_LazySkinLoad(&lazy_skins[i]);
+			}
+			else {
+				lazy_skins[kept++] = lazy_skins[i];
+			}
+		}
+		lazy_skins_count = kept;
+		return;
+	}
+
+	for (i = 0; i < lazy_skins_count; i++) {
+		if (lazy_skins[i].model->lazy_skins_wanted) {
+			Mod_LazySkinQueue(&lazy_skins[i]);
+		}
+	}
+	R_ImageDecodeStart();
+	lazy_skins_batch = true;
+}
+
 void* Mod_LoadAllSkins(model_t* loadmodel, int numskins, daliasskintype_t* pskintype)
 {
 	int i, j, k, s, groupskins, texmode = 0;
@@ -144,6 +322,7 @@ void* Mod_LoadAllSkins(model_t* loadmodel, int numskins, daliasskintype_t* pskin
 	byte *skin;
 	daliasskingroup_t *pinskingroup;
 	daliasskininterval_t *pinskinintervals;
+	qbool lazy;
 
 	skin = (byte *)(pskintype + 1);
 
@@ -151,6 +330,10 @@ void* Mod_LoadAllSkins(model_t* loadmodel, int numskins, daliasskintype_t* pskin
 		Host_Error("Mod_LoadAllSkins: Invalid # of skins: %d (model %s)\n", numskins, loadmodel->name);
 	}
 
+	// the external skins of an earlier load are not wanted anymore
+	Mod_LazySkinsRemove(loadmodel);
+	lazy = gl_lazyModelTextures.integer && !gl_no24bit.integer && !RuleSets_DisallowExternalTexture(loadmodel);
+
 	s = pheader->skinwidth * pheader->skinheight;
 
 	COM_StripExtension(COM_SkipPath(loadmodel->name), basename, sizeof(basename));
@@ -177,7 +360,12 @@ void* Mod_LoadAllSkins(model_t* loadmodel, int numskins, daliasskintype_t* pskin
 			R_TextureReferenceInvalidate(gl_texnum);
 			R_TextureReferenceInvalidate(fb_texnum);
 
-			gl_texnum = Mod_LoadExternalSkin(loadmodel, identifier, &fb_texnum);
+			if (lazy) {
+				Mod_LazySkinsAdd(loadmodel, identifier, i, -1, 0);
+			}
+			else {
+				gl_texnum = Mod_LoadExternalSkin(loadmodel, identifier, &fb_texnum);
+			}
 			if (!R_TextureReferenceIsValid(gl_texnum)) {
 				gl_texnum = R_LoadTexture(identifier, pheader->skinwidth, pheader->skinheight, (byte *)(pskintype + 1), texmode, 1);
 
@@ -208,7 +396,12 @@ void* Mod_LoadAllSkins(model_t* loadmodel, int numskins, daliasskintype_t* pskin
 				R_TextureReferenceInvalidate(gl_texnum);
 				R_TextureReferenceInvalidate(fb_texnum);
 
-				gl_texnum = Mod_LoadExternalSkin(loadmodel, identifier, &fb_texnum);
+				if (lazy) {
+					Mod_LazySkinsAdd(loadmodel, identifier, i, j, groupskins);
+				}
+				else {
+					gl_texnum = Mod_LoadExternalSkin(loadmodel, identifier, &fb_texnum);
+				}
 				if (!R_TextureReferenceIsValid(gl_texnum)) {
 					gl_texnum = R_LoadTexture(identifier, pheader->skinwidth, pheader->skinheight, (byte *)(pskintype), texmode, 1);
 
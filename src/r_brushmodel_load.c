@@ -49,6 +49,7 @@ extern msurface_t* skychain;
 extern msurface_t* alphachain;
 char* TranslateTextureName(texture_t *tx);
 qbool Mod_LoadExternalTexture(model_t* loadmodel, texture_t *tx, int mode, int brighten_flag);
+void Mod_PrefetchExternalTexture(model_t* loadmodel, texture_t *tx);
 
 model_t* Mod_FindName(const char *name);
 
@@ -1657,6 +1658,21 @@ void R_LoadBrushModelTextures(model_t *m)
 
 	//	Com_Printf("lm %d %s\n", lightmode, loadmodel->name);
 
+	// decode the world's external textures in the background while they get uploaded
+	if (m->isworldmodel && R_ImageDecodeBegin()) {
+		for (i = 0; i < m->numtextures; i++) {
+			tx = m->textures[i];
+			if (!tx || tx->loaded) {
+				continue;
+			}
+			if (m->isworldmodel && m->bspversion != HL_BSPVERSION && Mod_IsSkyTextureName(m, tx->name)) {
+				continue;
+			}
+			Mod_PrefetchExternalTexture(m, tx);
+		}
+		R_ImageDecodeStart();
+	}
+
 	for (i = 0; i < m->numtextures; i++)
 	{
 		tx = m->textures[i];
@@ -1726,4 +1742,6 @@ void R_LoadBrushModelTextures(model_t *m)
 		}
 		tx->loaded = true; // mark as loaded
 	}
+
+	R_ImageDecodeFinish();
 }
@@ -72,61 +72,83 @@ char *TranslateTextureName(texture_t *tx)
 	return NULL;
 }
 
-qbool Mod_LoadExternalTexture(model_t* loadmodel, texture_t *tx, int mode, int brighten_flag)
+#define MAX_EXTERNAL_TEXTURE_PATHS 4
+
+// Fills paths with the locations to look for an external texture, in order of preference.
+static int Mod_ExternalTexturePaths(model_t* loadmodel, texture_t *tx, char paths[MAX_EXTERNAL_TEXTURE_PATHS][MAX_OSPATH])
 {
 	char *name, *altname, *mapname, *groupname;
-	int luma_mode = TEX_LUMA;
-	int material_width = 0;
-	int material_height = 0;
-	int luma_width = 0;
-	int luma_height = 0;
-	byte* material_pixels = NULL;
-	byte* luma_pixels = NULL;
-	char texture_path[MAX_OSPATH];
-
-	if (!R_ExternalTexturesEnabled(loadmodel->isworldmodel)) {
-		return false;
-	}
+	int count = 0;
 
 	name = tx->name;
 	altname = TranslateTextureName(tx);
 	mapname = TP_MapName();
 	groupname = TP_GetMapGroupName(mapname, NULL);
-	texture_path[0] = '\0';
 
 	if (loadmodel->isworldmodel) {
-		strlcpy(texture_path, "textures/", sizeof(texture_path));
-		strlcat(texture_path, mapname, sizeof(texture_path));
-		strlcat(texture_path, "/", sizeof(texture_path));
-		strlcat(texture_path, name, sizeof(texture_path));
-
-		material_pixels = R_LoadImagePixels(texture_path, 0, 0, mode | brighten_flag, &material_width, &material_height);
-		if (!material_pixels && groupname) {
-			strlcpy(texture_path, "textures/", sizeof(texture_path));
-			strlcat(texture_path, groupname, sizeof(texture_path));
-			strlcat(texture_path, "/", sizeof(texture_path));
-			strlcat(texture_path, name, sizeof(texture_path));
-
-			material_pixels = R_LoadImagePixels(texture_path, 0, 0, mode | brighten_flag, &material_width, &material_height);
+		snprintf(paths[count++], MAX_OSPATH, "textures/%s/%s", mapname, name);
+		if (groupname) {
+			snprintf(paths[count++], MAX_OSPATH, "textures/%s/%s", groupname, name);
 		}
 	}
 	else {
-		strlcpy(texture_path, "textures/bmodels/", sizeof(texture_path));
-		strlcat(texture_path, name, sizeof(texture_path));
+		snprintf(paths[count++], MAX_OSPATH, "textures/bmodels/%s", name);
+	}
 
-		material_pixels = R_LoadImagePixels(texture_path, 0, 0, mode | brighten_flag, &material_width, &material_height);
+	if (altname) {
+		snprintf(paths[count++], MAX_OSPATH, "textures/%s", altname);
 	}
 
-	if (!material_pixels && altname) {
-		strlcpy(texture_path, "textures/", sizeof(texture_path));
-		strlcat(texture_path, altname, sizeof(texture_path));
+	snprintf(paths[count++], MAX_OSPATH, "textures/%s", name);
 
-		material_pixels = R_LoadImagePixels(texture_path, 0, 0, mode | brighten_flag, &material_width, &material_height);
+	return count;
+}
+
+// Queues the external texture and its luma for background decoding.
+void Mod_PrefetchExternalTexture(model_t* loadmodel, texture_t *tx)
+{
+	char paths[MAX_EXTERNAL_TEXTURE_PATHS][MAX_OSPATH];
+	int i, count;
+
+	if (!R_ExternalTexturesEnabled(loadmodel->isworldmodel)) {
+		return;
+	}
+
+	count = Mod_ExternalTexturePaths(loadmodel, tx, paths);
+	for (i = 0; i < count; i++) {
+		if (R_ImageDecodeQueue(paths[i], 0)) {
+			if (!Mod_IsTurbTextureName(loadmodel, tx->name)) {
+				R_ImageDecodeQueue(va("%s_luma", paths[i]), 0);
+			}
+			break;
+		}
+	}
+}
+
+qbool Mod_LoadExternalTexture(model_t* loadmodel, texture_t *tx, int mode, int brighten_flag)
+{
+	char *name;
+	int luma_mode = TEX_LUMA;
+	int material_width = 0;
+	int material_height = 0;
+	int luma_width = 0;
+	int luma_height = 0;
+	byte* material_pixels = NULL;
+	byte* luma_pixels = NULL;
+	char paths[MAX_EXTERNAL_TEXTURE_PATHS][MAX_OSPATH];
+	char texture_path[MAX_OSPATH];
+	int i, count;
+
+	if (!R_ExternalTexturesEnabled(loadmodel->isworldmodel)) {
+		return false;
 	}
 
-	if (!material_pixels) {
-		strlcpy(texture_path, "textures/", sizeof(texture_path));
-		strlcat(texture_path, name, sizeof(texture_path));
+	name = tx->name;
+	texture_path[0] = '\0';
+
+	count = Mod_ExternalTexturePaths(loadmodel, tx, paths);
+	for (i = 0; i < count && !material_pixels; i++) {
+		strlcpy(texture_path, paths[i], sizeof(texture_path));
 
 		material_pixels = R_LoadImagePixels(texture_path, 0, 0, mode | brighten_flag, &material_width, &material_height);
 	}
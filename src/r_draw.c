@@ -760,6 +760,38 @@ mpic_t *Draw_CachePicSafe(const char *path, qbool crash, qbool only24bit)
 	}
 }
 
+// Called by the file watcher when an image file on disk has been rewritten.
+// Only cached pictures loaded from that file are reloaded, the atlas is then
+// rebuilt so it picks up the new texels.
+void Draw_PicFileChanged(const char *path)
+{
+	extern cachepic_node_t *cachepics[CACHED_PICS_HDSIZE];
+	cachepic_node_t *cur;
+	mpic_t *pic_24bit;
+	qbool changed = false;
+	int i;
+
+	for (i = 0; i < CACHED_PICS_HDSIZE; ++i) {
+		for (cur = cachepics[i]; cur; cur = cur->next) {
+			if (!R_ImageFileMatches(cur->data.name, path)) {
+				continue;
+			}
+
+			if ((pic_24bit = R_LoadPicImage(cur->data.name, NULL, 0, 0, TEX_ALPHA))) {
+				// keep the size the picture was laid out with, as an .lmp may have set it
+				pic_24bit->width = cur->data.pic->width;
+				pic_24bit->height = cur->data.pic->height;
+				memcpy(cur->data.pic, pic_24bit, sizeof(mpic_t));
+				changed = true;
+			}
+		}
+	}
+
+	if (changed) {
+		CachePics_MarkAtlasDirty();
+	}
+}
+
 static const char* cache_pic_paths[] = {
 	"gfx/pause.lmp",
 	"gfx/loading.lmp",
@@ -547,6 +547,24 @@ void R_RenderAllDynamicLightmaps(model_t *model)
 	R_TraceLeaveFunctionRegion;
 }
 
+static void LightmapGrowArray(void)
+{
+	unsigned int i, new_size = lightmap_array_size + LIGHTMAP_ARRAY_GROWTH;
+
+	lightmaps = Q_realloc(lightmaps, sizeof(lightmaps[0]) * new_size);
+	if (!lightmaps) {
+		Sys_Error("AllocBlock: full");
+		return;
+	}
+	memset(lightmaps + lightmap_array_size, 0, sizeof(lightmaps[0]) * LIGHTMAP_ARRAY_GROWTH);
+	lightmap_array_size = new_size;
+
+	// Memory pointers might now be invalid afer realloc()
+	for (i = 0; i < new_size; ++i) {
+		lightmaps[i].drawflat_chain_tail = &lightmaps[i].drawflat_chain;
+	}
+}
+
 // returns a lightmap number and the position inside it
 static int LightmapAllocBlock(int w, int h, int *x, int *y)
 {
@@ -591,21 +609,7 @@ static int LightmapAllocBlock(int w, int h, int *x, int *y)
 	}
 
 	// Dynamically increase array
-	{
-		unsigned int new_size = lightmap_array_size + LIGHTMAP_ARRAY_GROWTH;
-		lightmaps = Q_realloc(lightmaps, sizeof(lightmaps[0]) * new_size);
-		if (!lightmaps) {
-			Sys_Error("AllocBlock: full");
-			return 0;
-		}
-		memset(lightmaps + lightmap_array_size, 0, sizeof(lightmaps[0]) * LIGHTMAP_ARRAY_GROWTH);
-		lightmap_array_size = new_size;
-
-		// Memory pointers might now be invalid afer realloc()
-		for (i = 0; i < new_size; ++i) {
-			lightmaps[i].drawflat_chain_tail = &lightmaps[i].drawflat_chain;
-		}
-	}
+	LightmapGrowArray();
 	return LightmapAllocBlock(w, h, x, y);
 }
 
@@ -821,10 +825,19 @@ static void R_BuildLightmapData(msurface_t* surf, int surfnum)
 	}
 }
 
+// fills the block already allocated to the surface
+static void R_LightmapFillForSurface(msurface_t *surf, int surfnum, uint32_t flags)
+{
+	byte *base = lightmaps[surf->lightmaptexturenum].rawdata + (surf->light_t * LIGHTMAP_WIDTH + surf->light_s) * 4;
+
+	numdlights = 0;
+	R_BuildLightmapData(surf, surfnum);
+	R_BuildLightMap(surf, base, LIGHTMAP_WIDTH * 4, flags);
+}
+
 static void R_LightmapCreateForSurface(msurface_t *surf, int surfnum, uint32_t flags)
 {
 	int smax, tmax;
-	byte *base;
 
 	smax = (surf->extents[0] >> surf->lmshift) + 1;
 	tmax = (surf->extents[1] >> surf->lmshift) + 1;
@@ -841,10 +854,7 @@ static void R_LightmapCreateForSurface(msurface_t *surf, int surfnum, uint32_t f
 
 	surf->lightmaptexturenum = LightmapAllocBlock(smax, tmax, &surf->light_s, &surf->light_t);
 
-	base = lightmaps[surf->lightmaptexturenum].rawdata + (surf->light_t * LIGHTMAP_WIDTH + surf->light_s) * 4;
-	numdlights = 0;
-	R_BuildLightmapData(surf, surfnum);
-	R_BuildLightMap(surf, base, LIGHTMAP_WIDTH * 4, flags);
+	R_LightmapFillForSurface(surf, surfnum, flags);
 }
 
 static int R_LightmapSurfaceSortFunction(const void* lhs_, const void* rhs_)
@@ -877,32 +887,358 @@ static int R_LightmapSurfaceSortFunction(const void* lhs_, const void* rhs_)
 	}
 }
 
-//Builds the lightmap texture with all the surfaces from all brush models
-//Only called when map is initially loaded
-void R_BuildLightmaps(void)
+//
+// Lightmap layout cache
+//
+// The block each surface got in the lightmap atlas and its final polygon are
+// kept on disk under lmcache/ in the home directory, one file per map. The key
+// covers every input of the packing and polygon building, so a changed map or
+// setting rebuilds the layout and overwrites the file. Lightmap texels are
+// still computed at load, they depend on the lightstyles.
+//
+
+#define LIGHTMAP_CACHE_MAGIC	(('C' << 24) + ('M' << 16) + ('L' << 8) + 'E')
+#define LIGHTMAP_CACHE_VERSION	1
+
+typedef struct lightmap_cache_header_s {
+	int magic;
+	int version;
+	unsigned int key;
+	int lightmap_width, lightmap_height, vertexsize;
+	int packbytexture, remove_collinear;
+	int surface_count;
+	int lightmap_count;
+	int vert_count;
+	unsigned int last_lightmap_updated;
+} lightmap_cache_header_t;
+
+typedef struct lightmap_cache_surface_s {
+	int lightmaptexturenum;
+	int light_s, light_t;
+	int numverts;				// -1 when no display list is built for the surface
+} lightmap_cache_surface_t;
+
+// what the layout of a surface is computed from
+typedef struct lightmap_cache_surface_key_s {
+	int flags;
+	int numedges;
+	int miptex;
+	int texflags;
+	unsigned int width, height;
+	int litturb;
+	short texturemins[2];
+	short extents[2];
+	short lmshift;
+	float lmvecs[2][4];
+	float vecs[2][4];
+} lightmap_cache_surface_key_t;
+
+static qbool R_LightmapSurfaceHasDisplayList(msurface_t *surf)
 {
-	int i, j, t;
-	model_t	*m;
+	qbool isTurb = (surf->flags & SURF_DRAWTURB);
+	qbool isSky = (surf->flags & SURF_DRAWSKY);
 
-	if (lightmaps) {
-		for (i = 0; i < lightmap_array_size; ++i) {
-			lightmaps[i].drawflat_chain = NULL;
-			lightmaps[i].drawflat_chain_tail = &lightmaps[i].drawflat_chain;
-			memset(lightmaps[i].allocated, 0, sizeof(lightmaps[i].allocated));
+	return !isSky && (isTurb || !(surf->texinfo->flags & TEX_SPECIAL));
+}
+
+static float *R_LightmapSurfaceVertex(model_t *m, msurface_t *surf, int i)
+{
+	int lindex = m->surfedges[surf->firstedge + i];
+
+	if (lindex > 0) {
+		return m->vertexes[m->edges[lindex].v[0]].position;
+	}
+	return m->vertexes[m->edges[-lindex].v[1]].position;
+}
+
+// Works out the cache file of the current map and the key its contents must match
+static qbool R_LightmapCacheKey(char *path, int size, unsigned int *key, int *surface_count)
+{
+	char mapname[MAX_QPATH];
+	int i, j, k, length = 0, capacity = 0;
+	byte *buffer;
+	model_t *m;
+
+	if (!cl.worldmodel) {
+		return false;
+	}
+
+	*surface_count = 0;
+	for (j = 1; j < MAX_MODELS && (m = cl.model_precache[j]); j++) {
+		if (m->name[0] == '*') {
+			continue;
+		}
+		capacity += MAX_QPATH + m->numsurfaces * sizeof(lightmap_cache_surface_key_t);
+		for (i = 0; i < m->numsurfaces; i++) {
+			capacity += m->surfaces[i].numedges * sizeof(vec3_t);
 		}
+		*surface_count += m->numsurfaces;
 	}
-	else {
-		lightmaps = Q_malloc(sizeof(*lightmaps) * LIGHTMAP_ARRAY_GROWTH);
-		lightmap_array_size = LIGHTMAP_ARRAY_GROWTH;
-		for (i = 0; i < lightmap_array_size; ++i) {
-			lightmaps[i].drawflat_chain_tail = &lightmaps[i].drawflat_chain;
+
+	buffer = Q_malloc(max(capacity, 1));
+	for (j = 1; j < MAX_MODELS && (m = cl.model_precache[j]); j++) {
+		if (m->name[0] == '*') {
+			continue;
+		}
+
+		memset(buffer + length, 0, MAX_QPATH);
+		strlcpy((char *)buffer + length, m->name, MAX_QPATH);
+		length += MAX_QPATH;
+
+		for (i = 0; i < m->numsurfaces; i++) {
+			msurface_t *surf = &m->surfaces[i];
+			texture_t *texture = surf->texinfo->texture;
+			lightmap_cache_surface_key_t surface_key;
+
+			memset(&surface_key, 0, sizeof(surface_key));
+			surface_key.flags = surf->flags;
+			surface_key.numedges = surf->numedges;
+			surface_key.miptex = surf->texinfo->miptex;
+			surface_key.texflags = surf->texinfo->flags;
+			surface_key.width = texture ? texture->width : 0;
+			surface_key.height = texture ? texture->height : 0;
+			surface_key.litturb = texture ? texture->isLitTurb : 0;
+			surface_key.texturemins[0] = surf->texturemins[0];
+			surface_key.texturemins[1] = surf->texturemins[1];
+			surface_key.extents[0] = surf->extents[0];
+			surface_key.extents[1] = surf->extents[1];
+			surface_key.lmshift = surf->lmshift;
+			memcpy(surface_key.lmvecs, surf->lmvecs, sizeof(surface_key.lmvecs));
+			memcpy(surface_key.vecs, surf->texinfo->vecs, sizeof(surface_key.vecs));
+			memcpy(buffer + length, &surface_key, sizeof(surface_key));
+			length += sizeof(surface_key);
+
+			for (k = 0; k < surf->numedges; k++) {
+				memcpy(buffer + length, R_LightmapSurfaceVertex(m, surf, k), sizeof(vec3_t));
+				length += sizeof(vec3_t);
+			}
 		}
 	}
-	last_lightmap_updated = 0;
 
-	gl_invlightmaps = R_UseImmediateOpenGL();
+	*key = Com_BlockChecksum(buffer, length);
+	Q_free(buffer);
+
+	COM_StripExtension(COM_SkipPath(cl.worldmodel->name), mapname, sizeof(mapname));
+	snprintf(path, size, "%s/lmcache/%s.lmc", *com_homedir ? com_homedir : com_basedir, mapname);
+	return true;
+}
+
+static void R_LightmapCacheHeader(lightmap_cache_header_t *header, unsigned int key, int surface_count)
+{
+	extern cvar_t r_remove_collinear_vertices;
+
+	memset(header, 0, sizeof(*header));
+	header->magic = LIGHTMAP_CACHE_MAGIC;
+	header->version = LIGHTMAP_CACHE_VERSION;
+	header->key = key;
+	header->lightmap_width = LIGHTMAP_WIDTH;
+	header->lightmap_height = LIGHTMAP_HEIGHT;
+	header->vertexsize = VERTEXSIZE;
+	header->packbytexture = r_lightmap_packbytexture.integer;
+	header->remove_collinear = (r_remove_collinear_vertices.value != 0);
+	header->surface_count = surface_count;
+}
+
+static void R_LightmapCacheSave(const char *path, unsigned int key, int surface_count)
+{
+	lightmap_cache_header_t header;
+	lightmap_cache_surface_t record;
+	char temp[MAX_OSPATH];
+	qbool ok = true;
+	int i, j;
+	model_t *m;
+	FILE *f;
+
+	// files are native byte order, a cache from another machine fails the magic
+	R_LightmapCacheHeader(&header, key, surface_count);
+	while (header.lightmap_count < lightmap_array_size && lightmaps[header.lightmap_count].allocated[0]) {
+		header.lightmap_count++;
+	}
+	header.last_lightmap_updated = last_lightmap_updated;
+	for (j = 1; j < MAX_MODELS && (m = cl.model_precache[j]); j++) {
+		if (m->name[0] == '*') {
+			continue;
+		}
+		for (i = 0; i < m->numsurfaces; i++) {
+			if (R_LightmapSurfaceHasDisplayList(&m->surfaces[i]) && m->surfaces[i].polys) {
+				header.vert_count += m->surfaces[i].polys->numverts;
+			}
+		}
+	}
+
+	snprintf(temp, sizeof(temp), "%s.tmp", path);
+	if (!(f = fopen(temp, "wb"))) {
+		FS_CreatePath(temp);
+		if (!(f = fopen(temp, "wb"))) {
+			return;
+		}
+	}
+
+	ok &= fwrite(&header, sizeof(header), 1, f) == 1;
+	for (i = 0; i < header.lightmap_count; i++) {
+		ok &= fwrite(lightmaps[i].allocated, sizeof(lightmaps[i].allocated), 1, f) == 1;
+	}
+	for (j = 1; j < MAX_MODELS && (m = cl.model_precache[j]); j++) {
+		if (m->name[0] == '*') {
+			continue;
+		}
+		for (i = 0; i < m->numsurfaces; i++) {
+			msurface_t *surf = &m->surfaces[i];
+
+			record.lightmaptexturenum = surf->lightmaptexturenum;
+			record.light_s = surf->light_s;
+			record.light_t = surf->light_t;
+			record.numverts = (R_LightmapSurfaceHasDisplayList(surf) && surf->polys ? surf->polys->numverts : -1);
+			ok &= fwrite(&record, sizeof(record), 1, f) == 1;
+		}
+	}
+	for (j = 1; j < MAX_MODELS && (m = cl.model_precache[j]); j++) {
+		if (m->name[0] == '*') {
+			continue;
+		}
+		for (i = 0; i < m->numsurfaces; i++) {
+			msurface_t *surf = &m->surfaces[i];
+
+			if (R_LightmapSurfaceHasDisplayList(surf) && surf->polys && surf->polys->numverts) {
+				ok &= fwrite(surf->polys->verts, sizeof(float) * VERTEXSIZE, surf->polys->numverts, f) == (size_t)surf->polys->numverts;
+			}
+		}
+	}
+	fclose(f);
+
+	// the file of an older layout of this map is replaced
+	remove(path);
+	if (!ok || rename(temp, path)) {
+		remove(temp);
+	}
+}
+
+// Restores the layout stored by R_LightmapCacheSave, returns false if it doesn't match the map
+static qbool R_LightmapCacheLoad(const char *path, unsigned int key, int surface_count)
+{
+	lightmap_cache_header_t expected, *header;
+	lightmap_cache_surface_t *records, *record;
+	int (*allocated)[LIGHTMAP_WIDTH];
+	float (*verts)[VERTEXSIZE];
+	byte *data;
+	long length;
+	int i, j, vert_count = 0;
+	model_t *m;
+	FILE *f;
+
+	if (!(f = fopen(path, "rb"))) {
+		return false;
+	}
+	fseek(f, 0, SEEK_END);
+	length = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	if (length < (long)sizeof(lightmap_cache_header_t)) {
+		fclose(f);
+		return false;
+	}
+	data = Q_malloc(length);
+	if (fread(data, 1, length, f) != (size_t)length) {
+		fclose(f);
+		Q_free(data);
+		return false;
+	}
+	fclose(f);
+
+	header = (lightmap_cache_header_t *)data;
+	R_LightmapCacheHeader(&expected, key, surface_count);
+	if (header->magic != expected.magic || header->version != expected.version || header->key != expected.key ||
+		header->lightmap_width != expected.lightmap_width || header->lightmap_height != expected.lightmap_height ||
+		header->vertexsize != expected.vertexsize || header->packbytexture != expected.packbytexture ||
+		header->remove_collinear != expected.remove_collinear || header->surface_count != expected.surface_count ||
+		header->lightmap_count < 0 || header->vert_count < 0 ||
+		length != (long)(sizeof(*header) + header->lightmap_count * sizeof(allocated[0]) + header->surface_count * sizeof(*records) + header->vert_count * sizeof(verts[0]))) {
+		Q_free(data);
+		return false;
+	}
+
+	allocated = (int (*)[LIGHTMAP_WIDTH])(header + 1);
+	records = (lightmap_cache_surface_t *)(allocated + header->lightmap_count);
+	verts = (float (*)[VERTEXSIZE])(records + header->surface_count);
+
+	// check every record before touching the surfaces
+	for (record = records, j = 1; j < MAX_MODELS && (m = cl.model_precache[j]); j++) {
+		if (m->name[0] == '*') {
+			continue;
+		}
+		for (i = 0; i < m->numsurfaces; i++, record++) {
+			msurface_t *surf = &m->surfaces[i];
+
+			if (record->lightmaptexturenum >= header->lightmap_count || record->numverts < -1 || record->numverts > surf->numedges ||
+				(record->numverts >= 0) != R_LightmapSurfaceHasDisplayList(surf)) {
+				Q_free(data);
+				return false;
+			}
+			if (record->lightmaptexturenum >= 0) {
+				int smax = (surf->extents[0] >> surf->lmshift) + 1;
+				int tmax = (surf->extents[1] >> surf->lmshift) + 1;
+
+				if (record->light_s < 0 || record->light_t < 0 || record->light_s + smax > LIGHTMAP_WIDTH || record->light_t + tmax > LIGHTMAP_HEIGHT) {
+					Q_free(data);
+					return false;
+				}
+			}
+			vert_count += max(record->numverts, 0);
+		}
+	}
+	if (vert_count != header->vert_count || header->last_lightmap_updated > header->lightmap_count) {
+		Q_free(data);
+		return false;
+	}
+
+	while (lightmap_array_size < header->lightmap_count) {
+		LightmapGrowArray();
+	}
+	for (i = 0; i < header->lightmap_count; i++) {
+		memcpy(lightmaps[i].allocated, allocated[i], sizeof(lightmaps[i].allocated));
+	}
+	last_lightmap_updated = header->last_lightmap_updated;
+
+	for (record = records, j = 1; j < MAX_MODELS && (m = cl.model_precache[j]); j++) {
+		if (m->name[0] == '*') {
+			continue;
+		}
+		for (i = 0; i < m->numsurfaces; i++, record++) {
+			msurface_t *surf = &m->surfaces[i];
+			glpoly_t *poly;
+
+			surf->surfacenum = i;
+			surf->lightmaptexturenum = record->lightmaptexturenum;
+			if (surf->lightmaptexturenum >= 0) {
+				surf->light_s = record->light_s;
+				surf->light_t = record->light_t;
+				R_LightmapFillForSurface(surf, m->isworldmodel ? i : -1, m->flags);
+			}
+
+			if (record->numverts < 0) {
+				continue;
+			}
+			if (!surf->polys) {
+				poly = (glpoly_t *)Hunk_AllocName(sizeof(glpoly_t) + (surf->numedges - 4) * VERTEXSIZE * sizeof(float), "lmpoly");
+				poly->next = surf->polys;
+				surf->polys = poly;
+			}
+			poly = surf->polys;
+			memcpy(poly->verts, verts, record->numverts * sizeof(verts[0]));
+			poly->numverts = record->numverts;
+			verts += record->numverts;
+		}
+	}
+
+	Q_free(data);
+	return true;
+}
+
+// Allocates lightmap blocks and builds the display lists of all brush models
+static void R_LightmapPackSurfaces(void)
+{
+	int i, j, t;
+	model_t	*m;
 
-	r_framecount = 1;		// no dlightcache
 	for (j = 1; j < MAX_MODELS; j++) {
 		if (!(m = cl.model_precache[j])) {
 			break;
@@ -977,6 +1313,43 @@ void R_BuildLightmaps(void)
 			R_BuildSurfaceDisplayList(m, m->surfaces + i);
 		}
 	}
+}
+
+//Builds the lightmap texture with all the surfaces from all brush models
+//Only called when map is initially loaded
+void R_BuildLightmaps(void)
+{
+	char cache_path[MAX_OSPATH];
+	unsigned int cache_key = 0;
+	int i, surface_count = 0;
+	qbool use_cache;
+
+	if (lightmaps) {
+		for (i = 0; i < lightmap_array_size; ++i) {
+			lightmaps[i].drawflat_chain = NULL;
+			lightmaps[i].drawflat_chain_tail = &lightmaps[i].drawflat_chain;
+			memset(lightmaps[i].allocated, 0, sizeof(lightmaps[i].allocated));
+		}
+	}
+	else {
+		lightmaps = Q_malloc(sizeof(*lightmaps) * LIGHTMAP_ARRAY_GROWTH);
+		lightmap_array_size = LIGHTMAP_ARRAY_GROWTH;
+		for (i = 0; i < lightmap_array_size; ++i) {
+			lightmaps[i].drawflat_chain_tail = &lightmaps[i].drawflat_chain;
+		}
+	}
+	last_lightmap_updated = 0;
+
+	gl_invlightmaps = R_UseImmediateOpenGL();
+
+	r_framecount = 1;		// no dlightcache
+	use_cache = r_lightmap_cache.integer && R_LightmapCacheKey(cache_path, sizeof(cache_path), &cache_key, &surface_count);
+	if (!use_cache || !R_LightmapCacheLoad(cache_path, cache_key, surface_count)) {
+		R_LightmapPackSurfaces();
+		if (use_cache) {
+			R_LightmapCacheSave(cache_path, cache_key, surface_count);
+		}
+	}
 
 	// upload all lightmaps that were filled
 	renderer.CreateLightmapTextures();
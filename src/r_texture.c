@@ -263,6 +263,7 @@ void R_Texture_Init(void)
 			renderer.TextureDelete(gltextures[i].reference);
 		}
 		Q_free(gltextures[i].pathname);
+		Q_free(gltextures[i].source);
 	}
 
 	memset(gltextures, 0, sizeof(gltextures));
@@ -294,6 +295,7 @@ void R_DeleteTexture(texture_ref* texture)
 
 	// Free structure, updated linked list so we can re-use this slot
 	Q_free(gltextures[texture->index].pathname);
+	Q_free(gltextures[texture->index].source);
 	memset(&gltextures[texture->index], 0, sizeof(gltextures[0]));
 	gltextures[texture->index].next_free = next_free_texture;
 	next_free_texture = texture->index;
@@ -444,10 +446,15 @@ gltexture_t* R_TextureAllocateSlot(r_texture_type_id type, const char* identifie
 	else if (glt && glt->storage_allocated) {
 		if (gl_width != glt->texture_width || gl_height != glt->texture_height || depth != glt->depth || glt->bpp != bpp) {
 			texture_ref ref = glt->reference;
+			int slot = ref.index;
 
 			R_DeleteTexture(&ref);
 
-			return R_TextureAllocateSlot(type, identifier, width, height, depth, bpp, mode, crc, new_texture);
+			// the slot just freed heads the free list, so the texture keeps it
+			// and references held elsewhere stay valid
+			glt = R_TextureAllocateSlot(type, identifier, width, height, depth, bpp, mode, crc, new_texture);
+			assert(glt->reference.index == slot);
+			return glt;
 		}
 	}
 
@@ -466,6 +473,7 @@ gltexture_t* R_TextureAllocateSlot(r_texture_type_id type, const char* identifie
 	glt->texture_height = gl_height;
 	glt->miplevels = miplevels;
 	Q_free(glt->pathname);
+	Q_free(glt->source);
 	if (bpp == 4 && fs_netpath[0]) {
 		glt->pathname = Q_strdup(fs_netpath);
 	}
@@ -96,6 +96,14 @@ void R_TextureAnisotropyChanged(texture_ref tex, qbool mipmap, qbool viewmodel);
 
 mpic_t* R_LoadPicImage(const char *filename, char *id, int matchwidth, int matchheight, int mode);
 byte* R_LoadImagePixels(const char *filename, int matchwidth, int matchheight, int mode, int *real_width, int *real_height);
+qbool R_ImageDecodeBegin(void);
+qbool R_ImageDecodeQueue(const char *filename, int mode);
+void R_ImageDecodeStart(void);
+void R_ImageDecodeFinish(void);
+qbool R_ImageDecodeDone(void);
+void R_ImageDecodeInit(void);
+qbool R_ImageFileMatches(const char *filename, const char *changed);
+void R_ImageFileChanged(const char *path);
 qbool R_LoadCharsetImage(char *filename, char *identifier, int flags, charset_t* pic);
 void R_ImagePreMultiplyAlpha(byte* image, int width, int height, qbool zero);
 
@@ -46,6 +46,7 @@ cvar_t gl_texturemode = { "gl_texturemode", "GL_LINEAR_MIPMAP_LINEAR", 0, OnChan
 cvar_t gl_texturemode_viewmodels = { "gl_texturemode_viewmodels", "GL_LINEAR", 0, OnChange_gl_texturemode };
 cvar_t gl_anisotropy = { "gl_anisotropy","16", 0, OnChange_gl_anisotropy };
 cvar_t gl_scaleModelTextures = { "gl_scaleModelTextures", "0", CVAR_RELOAD_GFX };
+cvar_t gl_lazyModelTextures = { "gl_lazyModelTextures", "0" };
 cvar_t gl_scaleModelSimpleTextures = { "gl_scaleModelSimpleTextures", "0", CVAR_RELOAD_GFX };
 cvar_t gl_scaleTurbTextures = { "gl_scaleTurbTextures", "1", CVAR_RELOAD_GFX };
 cvar_t gl_scaleAlphaTextures = { "gl_scaleAlphaTextures", "0", CVAR_RELOAD_GFX };
@@ -179,6 +180,7 @@ void R_TextureRegisterCvars(void)
 		Cvar_SetCurrentGroup(CVAR_GROUP_TEXTURES);
 		Cvar_Register(&gl_max_size);
 		Cvar_Register(&gl_scaleModelTextures);
+		Cvar_Register(&gl_lazyModelTextures);
 		Cvar_Register(&gl_scaleModelSimpleTextures);
 		Cvar_Register(&gl_scaleTurbTextures);
 		Cvar_Register(&gl_scaleskytextures);
@@ -195,6 +197,8 @@ void R_TextureRegisterCvars(void)
 		Cvar_Register(&gl_no24bit);
 		Cvar_Register(&gl_wicked_luma_level);
 		Cvar_ResetCurrentGroup();
+
+		R_ImageDecodeInit();
 	}
 
 	// This way user can specify gl_max_size in his cfg.
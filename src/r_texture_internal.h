@@ -12,6 +12,8 @@ typedef struct gltexture_s {
 	r_texture_type_id type;
 	char        identifier[MAX_QPATH];
 	char*       pathname;
+	char*       source;         // image file passed to R_LoadTextureImage, for hot reload
+	int         source_matchwidth, source_matchheight, source_mode;
 	int         image_width, image_height;
 	int         texture_width, texture_height;
 	int         texmode;
@@ -26,6 +26,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "crc.h"
 #include "gl_texture.h"
 #include "r_trace.h"
+#include "vfs.h"
 
 static void R_LoadTextureData(gltexture_t* glt, int width, int height, byte *data, int mode, int bpp);
 
@@ -88,6 +89,16 @@ texture_ref R_LoadTextureImage(const char *filename, const char *identifier, int
 	else {
 		reference = R_LoadTexturePixels(data, identifier, image_width, image_height, mode);
 		Q_free(data);	// Data was Q_malloc'ed by R_LoadImagePixels.
+
+		// Remember how we got here so R_ImageFileChanged() can do it again
+		if (R_TextureReferenceIsValid(reference)) {
+			gltexture = &gltextures[reference.index];
+			Q_free(gltexture->source);
+			gltexture->source = Q_strdup(filename);
+			gltexture->source_matchwidth = matchwidth;
+			gltexture->source_matchheight = matchheight;
+			gltexture->source_mode = mode;
+		}
 	}
 
 	return reference;
@@ -265,16 +276,632 @@ typedef struct image_load_format_s {
 	int filter_mask;
 } image_load_format_t;
 
+static image_load_format_t image_load_formats[] = {
+	{ "tga", Image_LoadTGA, 0 },
+#ifdef WITH_PNG
+	{ "png", Image_LoadPNG, 0 },
+#endif
+#ifdef WITH_JPEG
+	{ "jpg", Image_LoadJPEG, 0 },
+#endif
+	{ "pcx", Image_LoadPCX_As32Bit, TEX_NO_PCX }
+};
+
+static void R_ImageBaseName(const char *filename, char *basename, int size)
+{
+	char *c;
+
+	COM_StripExtension(filename, basename, size);
+	for (c = basename; *c; c++) {
+		if (*c == '*') {
+			*c = '#';
+		}
+	}
+}
+
+// Opens the preferred image file for basename, *f may hold a file opened earlier.
+static image_load_format_t *R_FindImageFile(const char *basename, int mode, vfsfile_t **f)
+{
+	image_load_format_t* best = NULL;
+	char name[MAX_QPATH];
+	int i;
+
+	for (i = 0; i < sizeof(image_load_formats) / sizeof(image_load_formats[0]); ++i) {
+		vfsfile_t *file = NULL;
+
+		if (mode & image_load_formats[i].filter_mask) {
+			continue;
+		}
+
+		snprintf(name, sizeof(name), "%s.%s", basename, image_load_formats[i].extension);
+		if ((file = FS_OpenVFS(name, "rb", FS_ANY))) {
+			if (*f == NULL || ((*f)->copyprotected && !file->copyprotected)) {
+				if (*f) {
+					VFS_CLOSE(*f);
+				}
+				*f = file;
+				best = &image_load_formats[i];
+			}
+			else {
+				VFS_CLOSE(file);
+			}
+		}
+	}
+
+	return best;
+}
+
+//
+// Decoded image cache
+//
+// Decoded pixels are kept on disk under texcache/ in the home directory,
+// named after the MD4 of the source's VFS_STAMP (the disk file holding it,
+// where it is in there, its size and that file's modification time), so a hit
+// doesn't read the source and a rewritten file misses the cache.  Images
+// decoded through the palette are also keyed by the palette.  Reading a cached
+// image touches it, and once the directory grows beyond gl_texture_cache_size
+// the least recently used images are deleted.
+//
+// What is cached is the decoded image, not the uploaded texture: the same
+// pixels are scaled by gl_max_size/gl_picmip, packed into texture arrays or
+// cut up (charsets, particle fonts) differently by each caller, and the mips
+// are generated by the driver, so the upload isn't a fixed function of the
+// file.
+//
+
+#define IMAGE_CACHE_MAGIC	(('C' << 24) + ('I' << 16) + ('Z' << 8) + 'E')
+#define IMAGE_CACHE_VERSION	1
+#define IMAGE_CACHE_MAX_SIZE	8192
+
+typedef struct image_cache_header_s {
+	int magic;
+	int version;
+	int width;
+	int height;
+} image_cache_header_t;
+
+cvar_t gl_texture_cache = { "gl_texture_cache", "0" };
+cvar_t gl_texture_cache_size = { "gl_texture_cache_size", "512" };
+
+typedef struct image_cache_file_s {
+	char path[MAX_OSPATH];
+	int kb;
+	int mtime;
+} image_cache_file_t;
+
+static SDL_atomic_t image_cache_kb;	// size of texcache/, kept up to date by the writers
+static qbool image_cache_scanned;
+
+// False when the file can't be identified without reading it (not on disk, or
+// in an archive type without stamps), such files aren't cached
+static qbool R_ImageCachePath(ImageLoadFunction function, vfsfile_t *f, char *path, int size)
+{
+	unsigned char digest[16];
+	char stamp[MAX_OSPATH + 64], hex[33], palette[10] = "";
+	int i;
+
+	if (!VFS_STAMP(f, stamp, sizeof(stamp))) {
+		return false;
+	}
+
+	Com_BlockFullChecksum(stamp, strlen(stamp), digest);
+	for (i = 0; i < 16; i++) {
+		snprintf(hex + i * 2, sizeof(hex) - i * 2, "%02x", digest[i]);
+	}
+
+	// 8 bit images come out in the colors of the current palette
+	if (function == Image_LoadPCX_As32Bit) {
+		snprintf(palette, sizeof(palette), "-%08x", Com_BlockChecksum(d_8to24table, sizeof(d_8to24table)));
+	}
+
+	snprintf(path, size, "%s/texcache/%c%c/%s%s.rgba", *com_homedir ? com_homedir : com_basedir, hex[0], hex[1], hex, palette);
+	return true;
+}
+
+static byte *R_ImageCacheRead(const char *path, int *real_width, int *real_height)
+{
+	image_cache_header_t header;
+	int width, height;
+	byte *data;
+	FILE *f;
+
+	if (!(f = fopen(path, "r+b"))) {
+		return NULL;
+	}
+
+	if (fread(&header, sizeof(header), 1, f) != 1 ||
+		LittleLong(header.magic) != IMAGE_CACHE_MAGIC || LittleLong(header.version) != IMAGE_CACHE_VERSION) {
+		fclose(f);
+		return NULL;
+	}
+
+	width = LittleLong(header.width);
+	height = LittleLong(header.height);
+	if (width <= 0 || height <= 0 || width > IMAGE_CACHE_MAX_SIZE || height > IMAGE_CACHE_MAX_SIZE) {
+		fclose(f);
+		return NULL;
+	}
+
+	data = Q_malloc(width * height * 4);
+	if (fread(data, 4, width * height, f) != (size_t)(width * height)) {
+		fclose(f);
+		Q_free(data);
+		return NULL;
+	}
+
+	// write the header back unchanged, so the modification time tells when it was last used
+	fseek(f, 0, SEEK_SET);
+	fwrite(&header, sizeof(header), 1, f);
+	fclose(f);
+
+	*real_width = width;
+	*real_height = height;
+	return data;
+}
+
+static void R_ImageCacheWrite(char *path, byte *data, int width, int height)
+{
+	image_cache_header_t header;
+	char temp[MAX_OSPATH];
+	size_t written;
+	FILE *f;
+
+	if (width > IMAGE_CACHE_MAX_SIZE || height > IMAGE_CACHE_MAX_SIZE) {
+		return;
+	}
+
+	// write under a name of our own first, another thread may be caching the same image
+	snprintf(temp, sizeof(temp), "%s.%lu", path, (unsigned long)SDL_ThreadID());
+	if (!(f = fopen(temp, "wb"))) {
+		FS_CreatePath(temp);
+		if (!(f = fopen(temp, "wb"))) {
+			return;
+		}
+	}
+
+	header.magic = LittleLong(IMAGE_CACHE_MAGIC);
+	header.version = LittleLong(IMAGE_CACHE_VERSION);
+	header.width = LittleLong(width);
+	header.height = LittleLong(height);
+
+	written = fwrite(&header, sizeof(header), 1, f);
+	written += fwrite(data, 4, width * height, f);
+	fclose(f);
+
+	if (written != (size_t)(1 + width * height) || rename(temp, path)) {
+		remove(temp);
+		return;
+	}
+	SDL_AtomicAdd(&image_cache_kb, (sizeof(header) + width * height * 4 + 1023) / 1024);
+}
+
+static int R_ImageCacheCompareTime(const void *a, const void *b)
+{
+	return ((const image_cache_file_t *)a)->mtime - ((const image_cache_file_t *)b)->mtime;
+}
+
+// Deletes the least recently used images once the cache is over gl_texture_cache_size.
+// Lists the directory with Sys_listdir, so only called on the main thread.
+static void R_ImageCachePrune(void)
+{
+	image_cache_file_t *files = NULL;
+	int i, j, count = 0, size = 0, total = 0, limit;
+	char dirname[MAX_OSPATH];
+	struct stat buf;
+
+	if (!gl_texture_cache.integer || gl_texture_cache_size.integer <= 0) {
+		return;
+	}
+
+	limit = gl_texture_cache_size.integer * 1024;
+	if (image_cache_scanned && SDL_AtomicGet(&image_cache_kb) <= limit) {
+		return;
+	}
+
+	for (i = 0; i < 256; i++) {
+		dir_t dir;
+
+		snprintf(dirname, sizeof(dirname), "%s/texcache/%02x", *com_homedir ? com_homedir : com_basedir, i);
+		dir = Sys_listdir(dirname, ".*", SORT_NO);
+		for (j = 0; j < dir.numfiles; j++) {
+			image_cache_file_t *file;
+
+			if (dir.files[j].isdir) {
+				continue;
+			}
+
+			if (count >= size) {
+				size = max(1024, size * 2);
+				files = Q_realloc(files, size * sizeof(files[0]));
+			}
+
+			file = &files[count];
+			snprintf(file->path, sizeof(file->path), "%s/%s", dirname, dir.files[j].name);
+			if (stat(file->path, &buf) == -1) {
+				continue;
+			}
+			file->kb = (int)((buf.st_size + 1023) / 1024);
+			file->mtime = (int)buf.st_mtime;
+			total += file->kb;
+			count++;
+		}
+	}
+	image_cache_scanned = true;
+
+	if (total > limit) {
+		int removed = 0;
+
+		// leave some room so that the next few images don't trigger another scan
+		qsort(files, count, sizeof(files[0]), R_ImageCacheCompareTime);
+		for (i = 0; i < count && total > limit - limit / 10; i++) {
+			if (!remove(files[i].path)) {
+				total -= files[i].kb;
+				removed++;
+			}
+		}
+		Com_DPrintf("texcache: removed %d images, %d KB left\n", removed, total);
+	}
+
+	SDL_AtomicSet(&image_cache_kb, total);
+	Q_free(files);
+}
+
+// Decodes the image file, which is closed, using the cache when possible.
+static byte *R_ImageCacheDecode(ImageLoadFunction function, vfsfile_t *f, const char *name, int *real_width, int *real_height)
+{
+	char path[MAX_OSPATH];
+	byte *data;
+
+	if (!R_ImageCachePath(function, f, path, sizeof(path))) {
+		return function(f, name, 0, 0, real_width, real_height);
+	}
+
+	if ((data = R_ImageCacheRead(path, real_width, real_height))) {
+		VFS_CLOSE(f);
+		return data;
+	}
+
+	if ((data = function(f, name, 0, 0, real_width, real_height))) {
+		R_ImageCacheWrite(path, data, *real_width, *real_height);
+	}
+
+	return data;
+}
+
+//
+// Asynchronous image decoding
+//
+// Images queued between R_ImageDecodeBegin() and R_ImageDecodeStart() are read
+// on the main thread and decoded by worker threads.  R_LoadImagePixels() takes
+// the decoded pixels instead of decoding them again, the upload stays on the
+// main thread.  R_ImageDecodeFinish() drops whatever was not used.
+//
+
+#define MAX_DECODE_THREADS 16
+
+typedef struct image_decode_job_s {
+	char basename[MAX_QPATH];
+	char name[MAX_QPATH];
+	char netpath[MAX_OSPATH];
+	int filter;
+	ImageLoadFunction function;
+	char cache_path[MAX_OSPATH];	// empty when not cached
+
+	byte *buffer;
+	int buffer_length;
+
+	byte *data;
+	int width, height;
+	qbool done;
+	qbool taken;
+	image_messages_t messages;	// what the decoder printed, shown when the image is taken
+
+	double read_time;
+	double decode_time;
+	double wait_time;
+} image_decode_job_t;
+
+cvar_t gl_texture_decode_threads = { "gl_texture_decode_threads", "2" };
+
+static image_decode_job_t *decode_jobs;
+static int decode_jobs_count;
+static int decode_jobs_size;
+static SDL_atomic_t decode_next_job;
+static SDL_mutex *decode_mutex;
+static SDL_cond *decode_cond;
+static SDL_Thread *decode_threads[MAX_DECODE_THREADS];
+static int decode_threads_count;
+static qbool decode_collecting;
+static qbool decode_active;
+
+static int R_ImageDecodeThread(void *unused)
+{
+	int i;
+
+	while ((i = SDL_AtomicAdd(&decode_next_job, 1)) < decode_jobs_count) {
+		image_decode_job_t *job = &decode_jobs[i];
+		double start = Sys_DoubleTime();
+		byte *buffer = job->buffer;
+
+		// the decoder closes the file, which frees the buffer
+		job->buffer = NULL;
+		Image_CaptureMessages(&job->messages);
+		if (!buffer) {
+			// only queued without the source when it's in the cache
+			job->data = R_ImageCacheRead(job->cache_path, &job->width, &job->height);
+		}
+		else if ((job->data = job->function(FSMMAP_OpenVFS(buffer, job->buffer_length), job->name, 0, 0, &job->width, &job->height)) && job->cache_path[0]) {
+			R_ImageCacheWrite(job->cache_path, job->data, job->width, job->height);
+		}
+		Image_CaptureMessages(NULL);
+		job->decode_time = Sys_DoubleTime() - start;
+
+		SDL_LockMutex(decode_mutex);
+		job->done = true;
+		SDL_CondBroadcast(decode_cond);
+		SDL_UnlockMutex(decode_mutex);
+	}
+
+	return 0;
+}
+
+static image_decode_job_t *R_ImageDecodeFind(const char *basename, int filter)
+{
+	int i;
+
+	for (i = 0; i < decode_jobs_count; i++) {
+		if (decode_jobs[i].filter == filter && !strcmp(decode_jobs[i].basename, basename)) {
+			return &decode_jobs[i];
+		}
+	}
+
+	return NULL;
+}
+
+// Hands out the pixels of a queued image, waiting for the worker if needed.
+static byte *R_ImageDecodeTake(image_decode_job_t *job, int *real_width, int *real_height)
+{
+	double start = Sys_DoubleTime();
+	byte *data;
+
+	SDL_LockMutex(decode_mutex);
+	while (!job->done) {
+		SDL_CondWait(decode_cond, decode_mutex);
+	}
+	SDL_UnlockMutex(decode_mutex);
+
+	job->wait_time = Sys_DoubleTime() - start;
+	job->taken = true;
+
+	data = job->data;
+	job->data = NULL;
+	if (data) {
+		// a failed decode is left to the caller, which decodes and reports it again
+		Image_PrintMessages(&job->messages);
+
+		*real_width = job->width;
+		*real_height = job->height;
+
+		// the texture is registered with the path of the file it came from
+		strlcpy(fs_netpath, job->netpath, sizeof(fs_netpath));
+	}
+
+	return data;
+}
+
+qbool R_ImageDecodeBegin(void)
+{
+	int i;
+
+	R_ImageDecodeFinish();
+
+	for (i = 0; i < decode_jobs_count; i++) {
+		Q_free(decode_jobs[i].buffer);
+	}
+	decode_jobs_count = 0;
+
+	if (gl_texture_decode_threads.integer <= 0 || Block24BitTextures) {
+		return false;
+	}
+
+	decode_collecting = true;
+	return true;
+}
+
+// Queues an image for decoding, returns false if there's no such image
+qbool R_ImageDecodeQueue(const char *filename, int mode)
+{
+	char basename[MAX_QPATH], name[MAX_QPATH];
+	image_load_format_t *best;
+	image_decode_job_t *job;
+	vfsfile_t *f = NULL;
+	struct stat buf;
+	double start;
+	int filter = mode & TEX_NO_PCX;
+
+	if (!decode_collecting) {
+		return false;
+	}
+
+	R_ImageBaseName(filename, basename, sizeof(basename));
+	if (R_ImageDecodeFind(basename, filter)) {
+		return true;
+	}
+
+	// linked images are left to R_LoadImagePixels
+	snprintf(name, sizeof(name), "%s.link", basename);
+	if ((f = FS_OpenVFS(name, "rb", FS_ANY))) {
+		VFS_CLOSE(f);
+		return true;
+	}
+
+	start = Sys_DoubleTime();
+	if (!(best = R_FindImageFile(basename, mode, &f)) || !f) {
+		return false;
+	}
+
+	if (decode_jobs_count >= decode_jobs_size) {
+		decode_jobs_size = max(64, decode_jobs_size * 2);
+		decode_jobs = Q_realloc(decode_jobs, decode_jobs_size * sizeof(decode_jobs[0]));
+	}
+
+	job = &decode_jobs[decode_jobs_count];
+	memset(job, 0, sizeof(*job));
+	strlcpy(job->basename, basename, sizeof(job->basename));
+	snprintf(job->name, sizeof(job->name), "%s.%s", basename, best->extension);
+	strlcpy(job->netpath, fs_netpath, sizeof(job->netpath));
+	job->filter = filter;
+	job->function = best->function;
+
+	// a cached image is read by the worker, without the source
+	if (gl_texture_cache.integer && R_ImageCachePath(best->function, f, job->cache_path, sizeof(job->cache_path))
+		&& stat(job->cache_path, &buf) != -1) {
+		VFS_CLOSE(f);
+		job->read_time = Sys_DoubleTime() - start;
+		decode_jobs_count++;
+		return true;
+	}
+
+	job->buffer_length = VFS_GETLEN(f);
+	job->buffer = Q_malloc(max(job->buffer_length, 1));
+	if (VFS_READ(f, job->buffer, job->buffer_length, NULL) != job->buffer_length) {
+		VFS_CLOSE(f);
+		Q_free(job->buffer);
+		return true;
+	}
+	VFS_CLOSE(f);
+	job->read_time = Sys_DoubleTime() - start;
+
+	decode_jobs_count++;
+	return true;
+}
+
+void R_ImageDecodeStart(void)
+{
+	int threads;
+
+	decode_collecting = false;
+	if (!decode_jobs_count) {
+		return;
+	}
+
+	if (!decode_mutex) {
+		decode_mutex = SDL_CreateMutex();
+		decode_cond = SDL_CreateCond();
+	}
+
+	SDL_AtomicSet(&decode_next_job, 0);
+	decode_active = true;
+
+	threads = bound(1, gl_texture_decode_threads.integer, min(MAX_DECODE_THREADS, decode_jobs_count));
+	for (decode_threads_count = 0; decode_threads_count < threads; decode_threads_count++) {
+		if (!(decode_threads[decode_threads_count] = Sys_CreateThread(R_ImageDecodeThread, NULL))) {
+			break;
+		}
+	}
+
+	if (!decode_threads_count) {
+		// no workers, decode everything here
+		R_ImageDecodeThread(NULL);
+	}
+}
+
+// True when every queued image has been decoded, so taking them won't wait
+qbool R_ImageDecodeDone(void)
+{
+	qbool done = true;
+	int i;
+
+	if (!decode_active) {
+		return true;
+	}
+
+	SDL_LockMutex(decode_mutex);
+	for (i = 0; i < decode_jobs_count && done; i++) {
+		done = decode_jobs[i].done;
+	}
+	SDL_UnlockMutex(decode_mutex);
+
+	return done;
+}
+
+void R_ImageDecodeFinish(void)
+{
+	int i, used = 0;
+	double decode_time = 0, wait_time = 0;
+
+	if (!decode_active) {
+		decode_collecting = false;
+		return;
+	}
+
+	for (i = 0; i < decode_threads_count; i++) {
+		SDL_WaitThread(decode_threads[i], NULL);
+	}
+	decode_threads_count = 0;
+	decode_active = false;
+
+	for (i = 0; i < decode_jobs_count; i++) {
+		if (decode_jobs[i].taken) {
+			used++;
+		}
+		decode_time += decode_jobs[i].decode_time;
+		wait_time += decode_jobs[i].wait_time;
+		Q_free(decode_jobs[i].data);
+	}
+
+	Com_DPrintf("Decoded %d images (%d used) in %.1f ms, waited %.1f ms\n", decode_jobs_count, used, decode_time * 1000, wait_time * 1000);
+
+	R_ImageCachePrune();
+}
+
+static void R_ImageDecodeReport_f(void)
+{
+	int i;
+	double read_time = 0, decode_time = 0, wait_time = 0;
+
+	if (!decode_jobs_count) {
+		Com_Printf("No images were decoded in the background\n");
+		return;
+	}
+
+	Com_Printf("   read decode   wait image\n");
+	for (i = 0; i < decode_jobs_count; i++) {
+		image_decode_job_t *job = &decode_jobs[i];
+
+		Com_Printf("%7.2f %6.2f %6.2f %s%s\n", job->read_time * 1000, job->decode_time * 1000, job->wait_time * 1000, job->name, job->taken ? "" : " (unused)");
+		read_time += job->read_time;
+		decode_time += job->decode_time;
+		wait_time += job->wait_time;
+	}
+	Com_Printf("%7.2f %6.2f %6.2f total (ms), %d threads\n", read_time * 1000, decode_time * 1000, wait_time * 1000, bound(1, gl_texture_decode_threads.integer, MAX_DECODE_THREADS));
+}
+
+void R_ImageDecodeInit(void)
+{
+	Cvar_SetCurrentGroup(CVAR_GROUP_TEXTURES);
+	Cvar_Register(&gl_texture_decode_threads);
+	Cvar_Register(&gl_texture_cache);
+	Cvar_Register(&gl_texture_cache_size);
+	Cvar_ResetCurrentGroup();
+
+	Cmd_AddCommand("gl_texture_decode_report", R_ImageDecodeReport_f);
+}
+
 byte* R_LoadImagePixels(const char *filename, int matchwidth, int matchheight, int mode, int *real_width, int *real_height)
 {
 	char basename[MAX_QPATH], name[MAX_QPATH];
-	byte *c, *data = NULL;
+	byte *data = NULL;
 	vfsfile_t *f;
+	image_load_format_t* best;
 
-	COM_StripExtension(filename, basename, sizeof(basename));
-	for (c = (byte *)basename; *c; c++) {
-		if (*c == '*') {
-			*c = '#';
+	R_ImageBaseName(filename, basename, sizeof(basename));
+
+	if (decode_active && !matchwidth && !matchheight) {
+		image_decode_job_t *job = R_ImageDecodeFind(basename, mode & TEX_NO_PCX);
+
+		if (job && !job->taken && (data = R_ImageDecodeTake(job, real_width, real_height))) {
+			return data;
 		}
 	}
 
@@ -325,44 +952,21 @@ byte* R_LoadImagePixels(const char *filename, int matchwidth, int matchheight, i
 		}
 	}
 
-	image_load_format_t formats[] = {
-		{ "tga", Image_LoadTGA, 0 },
-#ifdef WITH_PNG
-		{ "png", Image_LoadPNG, 0 },
-#endif
-#ifdef WITH_JPEG
-		{ "jpg", Image_LoadJPEG, 0 },
-#endif
-		{ "pcx", Image_LoadPCX_As32Bit, TEX_NO_PCX }
-	};
-	int i = 0;
-
-	image_load_format_t* best = NULL;
-	for (i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i) {
-		vfsfile_t *file = NULL;
-
-		if (mode & formats[i].filter_mask) {
-			continue;
-		}
-
-		snprintf(name, sizeof(name), "%s.%s", basename, formats[i].extension);
-		if ((file = FS_OpenVFS(name, "rb", FS_ANY))) {
-			if (f == NULL || (f->copyprotected && !file->copyprotected)) {
-				if (f) {
-					VFS_CLOSE(f);
-				}
-				f = file;
-				best = &formats[i];
-			}
-			else {
-				VFS_CLOSE(file);
-			}
-		}
-	}
+	best = R_FindImageFile(basename, mode, &f);
 
 	if (best && f) {
 		snprintf(name, sizeof(name), "%s.%s", basename, best->extension);
-		if ((data = best->function(f, name, matchwidth, matchheight, real_width, real_height))) {
+		if (gl_texture_cache.integer && !matchwidth && !matchheight) {
+			data = R_ImageCacheDecode(best->function, f, name, real_width, real_height);
+			if (!decode_active) {
+				// a running batch prunes when it finishes
+				R_ImageCachePrune();
+			}
+		}
+		else {
+			data = best->function(f, name, matchwidth, matchheight, real_width, real_height);
+		}
+		if (data) {
 			return data;
 		}
 	}
@@ -376,6 +980,61 @@ byte* R_LoadImagePixels(const char *filename, int matchwidth, int matchheight, i
 	return NULL;
 }
 
+qbool R_ImageFileMatches(const char *filename, const char *changed)
+{
+	char basename[MAX_QPATH], changedname[MAX_QPATH];
+
+	R_ImageBaseName(filename, basename, sizeof(basename));
+	R_ImageBaseName(changed, changedname, sizeof(changedname));
+
+	return !strcasecmp(basename, changedname);
+}
+
+// Called by the file watcher when an image file on disk has been rewritten.
+// Reloads the textures that were loaded from it, keeping their slots so any
+// references held by models and the world stay valid.
+void R_ImageFileChanged(const char *path)
+{
+	static int slots[MAX_GLTEXTURES];
+	char filename[MAX_QPATH], identifier[MAX_QPATH];
+	int i, count = 0, matchwidth, matchheight, mode, reloaded = 0;
+
+	// find them all first, the loads below rewrite the slots
+	for (i = 1; i < MAX_GLTEXTURES; ++i) {
+		if (gltextures[i].source && R_ImageFileMatches(gltextures[i].source, path)) {
+			slots[count++] = i;
+		}
+	}
+
+	for (i = 0; i < count; ++i) {
+		gltexture_t *glt = &gltextures[slots[i]];
+		texture_ref reference;
+
+		// an earlier failed load in this batch may have deleted it
+		if (!glt->source) {
+			continue;
+		}
+
+		// the load below replaces glt->source, so work from copies
+		strlcpy(filename, glt->source, sizeof(filename));
+		strlcpy(identifier, glt->identifier, sizeof(identifier));
+		matchwidth = glt->source_matchwidth;
+		matchheight = glt->source_matchheight;
+		mode = glt->source_mode;
+
+		reference = R_LoadTextureImage(filename, identifier, matchwidth, matchheight, mode);
+		if (R_TextureReferenceIsValid(reference)) {
+			// loading over an existing identifier keeps its slot
+			assert(reference.index == slots[i]);
+			++reloaded;
+		}
+	}
+
+	if (reloaded) {
+		Con_DPrintf("Reloaded %d texture%s from %s\n", reloaded, reloaded == 1 ? "" : "s", path);
+	}
+}
+
 texture_ref R_LoadTexturePixels(byte *data, const char *identifier, int width, int height, int mode)
 {
 	int i, j, image_size;
@@ -2,6 +2,7 @@
 #include "quakedef.h"
 #include "r_texture.h"
 #include "r_texture_internal.h"
+#include "image.h"
 #include "tr_types.h"
 
 void R_TextureUtil_ScaleDimensions(int width, int height, int *scaled_width, int *scaled_height, int mode)
@@ -26,16 +27,7 @@ void R_TextureUtil_ScaleDimensions(int width, int height, int *scaled_width, int
 
 void R_TextureUtil_Brighten32(byte *data, int size)
 {
-	byte *p;
-	int i;
-
-	p = data;
-	for (i = 0; i < size / 4; i++) {
-		p[0] = min(p[0] * 2.0 / 1.5, 255);
-		p[1] = min(p[1] * 2.0 / 1.5, 255);
-		p[2] = min(p[2] * 2.0 / 1.5, 255);
-		p += 4;
-	}
+	Image_Brighten32(data, size);
 }
 
 void R_TextureUtil_ImageDimensionsToTexture(int imageWidth_, int imageHeight_, int* textureWidth, int* textureHeight, int mode)
@@ -31,6 +31,14 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "movie.h" // /demo_capture
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SND_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define SND_NEON
+#endif
+
 extern qbool ActiveApp, Minimized;
 extern cvar_t sys_inactivesound;
 
@@ -40,6 +48,7 @@ static void S_Play_f (void);
 static void S_MuteSound_f (void);
 static void S_SoundList_f (void);
 static void S_Update_ (void);
+static void S_MixSamples (int samples);
 static void S_StopSoundScript_f(void);
 static void S_StopAllSounds_f (void);
 static void S_Register_LatchCvars(void);
@@ -57,10 +66,16 @@ qbool		snd_started = false;
 
 int		soundtime;
 
-static vec3_t	listener_origin;
-static vec3_t	listener_forward;
-static vec3_t	listener_right;
-static vec3_t	listener_up;
+typedef struct snd_listener_s {
+	vec3_t origin;
+	vec3_t forward;
+	vec3_t right;
+	vec3_t up;
+	int viewentity;     // sounds from it always play at full volume
+} snd_listener_t;
+
+static snd_listener_t listener;        // game thread
+static snd_listener_t mix_listener;    // mixer, follows listener through SND_CMD_UPDATE
 #define sound_nominal_clip_dist 1000.0
 
 // during registration it is possible to have more sounds
@@ -76,6 +91,66 @@ static int	num_sfx;
 static qbool	sound_spatialized = false;
 
 static sfx_t	*ambient_sfx[NUM_AMBIENTS] = {0};
+static int	ambient_vol[NUM_AMBIENTS];     // game thread copy of the ambient channel volumes
+static unsigned int	static_sounds;         // started since the last S_StopAllSounds
+
+// The game thread never touches channels[] directly, it posts commands that
+// the mixer runs before painting. Only the consumers of the queue (the audio
+// callback, movie capture mixing and raw streams) take smutex.
+
+#define SND_MAX_COMMANDS 512
+
+typedef enum {
+	SND_CMD_START,
+	SND_CMD_STOP,
+	SND_CMD_STATIC,
+	SND_CMD_STOPALL,
+	SND_CMD_UPDATE
+} snd_command_type_t;
+
+typedef struct snd_command_s {
+	snd_command_type_t type;
+
+	// SND_CMD_START, SND_CMD_STOP, SND_CMD_STATIC
+	int entnum;
+	int entchannel;
+	sfx_t *sfx;
+	vec3_t origin;
+	float vol;
+	float attenuation;
+	int flags;
+
+	// SND_CMD_UPDATE
+	snd_listener_t listener;
+	qbool ambient;      // ambient channels changed
+	sfx_t *ambient_sfx[NUM_AMBIENTS];
+	int ambient_vol[NUM_AMBIENTS];
+} snd_command_t;
+
+// head == tail means empty, see also the delayed packet queues in net.c
+typedef struct snd_command_queue_s {
+	snd_command_t commands[SND_MAX_COMMANDS];
+	SDL_atomic_t head; // next command to run, only advanced by the consumer
+	SDL_atomic_t tail; // next free slot, only advanced by the game thread
+	unsigned int full; // times the game thread had to run the queue itself
+} snd_command_queue_t;
+
+static snd_command_queue_t snd_commands;
+
+// Audio callback timing, shown by soundinfo
+#define SND_CALLBACK_BUCKETS 8
+
+static const int snd_callback_bucket_us[SND_CALLBACK_BUCKETS - 1] = { 50, 100, 250, 500, 1000, 2500, 5000 };
+
+typedef struct snd_callback_stats_s {
+	unsigned int callbacks;
+	unsigned int underruns;     // late callbacks or mixes longer than the buffer they fill
+	unsigned int buckets[SND_CALLBACK_BUCKETS];
+	double max_us;
+	Uint64 last_start;
+} snd_callback_stats_t;
+
+static snd_callback_stats_t snd_callback_stats;
 
 // ====================================================================
 // User-setable variables
@@ -97,12 +172,27 @@ cvar_t s_linearresample_stream = {"s_linearresample_stream", "0"};
 cvar_t s_khz = {"s_khz", "11", CVAR_NONE, OnChange_s_khz}; // If > 11, default sounds are noticeably different.
 cvar_t s_desiredsamples = {"s_desiredsamples", "0", CVAR_AUTO, OnChange_s_desiredsamples };
 cvar_t s_audiodevice = {"s_audiodevice", "0", CVAR_LATCH_SOUND };
+cvar_t s_offline = {"s_offline", "0", CVAR_LATCH_SOUND };
 cvar_t s_silent_racing = { "s_silent_racing", "0" };
+cvar_t s_cachesize = { "s_cachesize", "64" };
+
+// sounds precached since the last S_BeginPrecache and sounds started this
+// many times are kept when the cache is over s_cachesize
+#define SND_CACHE_PIN_USES 16
+
+static int snd_registration;
+static size_t snd_cache_unevictable;   // resident size at which nothing could be evicted
 
 SDL_mutex *smutex;
 soundhw_t *shw;
 static SDL_AudioDeviceID audiodevid;
 
+// Without a device the mixer paints here, the output only ever reaches movie capture
+#define SND_OFFLINE_SAMPLES 16384
+static short snd_offline_buffer[SND_OFFLINE_SAMPLES];
+static qbool snd_offline;
+static double snd_offline_time;     // host time not mixed yet
+
 static void S_ListDrivers(void)
 {
 	int i = 0, numdrivers;
@@ -150,6 +240,9 @@ static void S_UnlockMixer(void)
 
 static void S_SoundInfo_f (void)
 {
+	snd_callback_stats_t *stats = &snd_callback_stats;
+	int i;
+
 	if (!shw) {
 		Com_Printf ("sound system not started\n");
 		return;
@@ -160,13 +253,49 @@ static void S_SoundInfo_f (void)
 	Com_Printf("%5d samplebits\n", shw->samplebits);
 	Com_Printf("%5d kHz\n", shw->khz);
 	Com_Printf("%5u total_channels\n", total_channels);
+	Com_Printf("%5u callbacks\n", stats->callbacks);
+	Com_Printf("%5u underruns\n", stats->underruns);
+	Com_Printf("%5u command queue full\n", snd_commands.full);
+	Com_Printf("callback duration (max %.0f us):\n", stats->max_us);
+	for (i = 0; i < SND_CALLBACK_BUCKETS; i++) {
+		if (i < SND_CALLBACK_BUCKETS - 1) {
+			Com_Printf(" < %4d us: %u\n", snd_callback_bucket_us[i], stats->buckets[i]);
+		}
+		else {
+			Com_Printf(">= %4d us: %u\n", snd_callback_bucket_us[i - 1], stats->buckets[i]);
+		}
+	}
+}
+
+static void S_CallbackStatsAdd(Uint64 start, int len)
+{
+	snd_callback_stats_t *stats = &snd_callback_stats;
+	double freq = SDL_GetPerformanceFrequency();
+	double duration_us = (SDL_GetPerformanceCounter() - start) * 1000000.0 / freq;
+	double buffer_us = (double)(len / (shw->numchannels * (shw->samplebits / 8))) * 1000000.0 / shw->khz;
+	int i;
+
+	// the device ran dry if the callback came late or the mix could not keep up
+	if ((stats->last_start && (start - stats->last_start) * 1000000.0 / freq > buffer_us * 1.5) || duration_us > buffer_us) {
+		stats->underruns++;
+	}
+	stats->last_start = start;
+
+	for (i = 0; i < SND_CALLBACK_BUCKETS - 1 && duration_us >= snd_callback_bucket_us[i]; i++) {
+	}
+	stats->buckets[i]++;
+	stats->max_us = max(stats->max_us, duration_us);
+	stats->callbacks++;
 }
 
 static void S_SDL_callback(void *userdata, Uint8 *stream, int len)
 {
+	Uint64 start = SDL_GetPerformanceCounter();
+
 	// Mixer is run in main thread when capturing, play silence instead
 	if (Movie_IsCapturing()) {
 		SDL_memset(stream, 0, len);
+		snd_callback_stats.last_start = 0;
 		return;
 	}
 
@@ -177,6 +306,8 @@ static void S_SDL_callback(void *userdata, Uint8 *stream, int len)
 	shw->snd_sent += len;
 	S_UnlockMixer();
 
+	S_CallbackStatsAdd(start, len);
+
 	// Implicit Minimized in first case
 	if ((sys_inactivesound.integer == 0 && !ActiveApp) || (sys_inactivesound.integer == 2 && Minimized) || cls.demoseeking) {
 		SDL_memset(stream, 0, len);
@@ -185,13 +316,16 @@ static void S_SDL_callback(void *userdata, Uint8 *stream, int len)
 
 static void S_SDL_Shutdown(void)
 {
-	Con_Printf("Shutting down SDL audio.\n");
+	if (!snd_offline) {
+		Con_Printf("Shutting down SDL audio.\n");
 
-	SDL_CloseAudioDevice(audiodevid);
-	audiodevid = 0;
+		SDL_CloseAudioDevice(audiodevid);
+		audiodevid = 0;
 
-	if (SDL_WasInit(SDL_INIT_AUDIO) != 0)
-		SDL_QuitSubSystem(SDL_INIT_AUDIO);
+		if (SDL_WasInit(SDL_INIT_AUDIO) != 0)
+			SDL_QuitSubSystem(SDL_INIT_AUDIO);
+	}
+	snd_offline = false;
 
 	if (smutex) {
 		SDL_DestroyMutex(smutex);
@@ -219,10 +353,6 @@ static qbool S_SDL_Init(void)
 		return false;
 	}
 
-	if (!smutex) {
-		smutex = SDL_CreateMutex();
-	}
-
 	memset(&desired, 0, sizeof(desired));
 	switch (s_khz.integer) {
 		case 48:
@@ -310,6 +440,40 @@ fail:
 	return false;
 }
 
+// Sound without an audio device. Nothing is played: the mixer runs from S_Update,
+// one video frame's worth of samples at a time while a movie is captured and
+// against the host clock otherwise, so sounds still progress and end.
+static qbool S_Offline_Init(void)
+{
+	shw = Q_calloc(1, sizeof(*shw));
+
+	switch (s_khz.integer) {
+		case 48:
+			shw->khz = 48000;
+			break;
+		case 44:
+			shw->khz = 44100;
+			break;
+		case 22:
+			shw->khz = 22050;
+			break;
+		default:
+			shw->khz = 11025;
+			break;
+	}
+	shw->numchannels = 2;
+	shw->samplebits = 16;
+	shw->samples = SND_OFFLINE_SAMPLES;
+	shw->buffer = (unsigned char *) snd_offline_buffer;
+
+	snd_offline = true;
+	snd_offline_time = 0;
+
+	Com_Printf("Using offline audio @ %d Hz\n", shw->khz);
+
+	return true;
+}
+
 static void S_FModCheckExtraSounds(void)
 {
 	char *soundlist[] = {
@@ -344,9 +508,21 @@ static qbool S_Startup (void)
 	if (known_sfx == NULL) {
 		known_sfx = Q_malloc(MAX_SFX * sizeof(sfx_t));
 	}
+	snd_cache_unevictable = 0;
 	num_sfx = 0;
 
-	if (!S_SDL_Init()) {
+	SND_AllocPaintBuffer();
+
+	if (!smutex) {
+		smutex = SDL_CreateMutex();
+	}
+
+	// commands left from before a restart may point at freed sounds
+	SDL_AtomicSet(&snd_commands.head, 0);
+	SDL_AtomicSet(&snd_commands.tail, 0);
+	memset(&snd_callback_stats, 0, sizeof(snd_callback_stats));
+
+	if (s_offline.integer ? !S_Offline_Init() : !S_SDL_Init()) {
 		Com_Printf ("S_Startup: S_Init failed.\n");
 		snd_started = false;
 		sound_spatialized = false;
@@ -374,16 +550,15 @@ void S_Shutdown (void)
 	/* FIXME: this one free's sfx->buf's in channels array, is that correct ?? */
 	S_StopAllSounds();
 #ifdef FTE_PEXT2_VOICECHAT
-	S_Capture_Shutdown();
+	S_Voip_Shutdown();
 #endif
 	S_SDL_Shutdown();
+	S_SoundCacheShutdown();
 
 	if (known_sfx != NULL) {
 		int i;
 		for (i = 0; i < num_sfx; i++) {
-			if (known_sfx[i].buf != NULL) {
-				Q_free(known_sfx[i].buf);
-			}
+			S_FreeSound(&known_sfx[i]);
 		}
 	}
 	Q_free(known_sfx);
@@ -441,6 +616,8 @@ static void S_Register_RegularCvarsAndCommands(void)
 	Cvar_Register(&s_linearresample_stream);
 	Cvar_Register(&s_desiredsamples);
 	Cvar_Register(&s_silent_racing);
+	Cvar_Register(&s_mixer_simd);
+	Cvar_Register(&s_cachesize);
 
 	Cvar_ResetCurrentGroup();
 
@@ -456,6 +633,7 @@ static void S_Register_RegularCvarsAndCommands(void)
 	Cmd_AddCommand("soundlist", S_SoundList_f);
 	Cmd_AddCommand("soundinfo", S_SoundInfo_f);
 	Cmd_AddCommand("s_listdrivers", S_ListDrivers);
+	Cmd_AddCommand("s_mixer_benchmark", S_MixerBenchmark_f);
 
 	/* Naming it like this to be seen together with s_audiodevice cvar */
 	Cmd_AddCommand("s_audiodevicelist", S_ListAudioDevices);
@@ -471,6 +649,8 @@ static void S_Register_LatchCvars(void)
 
 	Cvar_Register(&s_linearresample);
 	Cvar_Register(&s_audiodevice);
+	Cvar_Register(&s_paintbuffersize);
+	Cvar_Register(&s_offline);
 
 	Cvar_ResetCurrentGroup();
 }
@@ -493,7 +673,6 @@ void S_Init (void)
 
 	S_Register_RegularCvarsAndCommands();
 	S_Register_LatchCvars();
-	SND_InitScaletable ();
 
 	known_sfx = Q_malloc(MAX_SFX * sizeof(sfx_t));
 	num_sfx = 0;
@@ -553,13 +732,39 @@ sfx_t *S_PrecacheSound (char *name)
 	if (sfx == NULL)
 		return NULL;
 
-	// cache it in
+	sfx->registration = snd_registration;
+
+	// cache it in, in the background
 	if (s_precache.value)
-		S_LoadSound (sfx);
+		S_QueueSound (sfx);
 
 	return sfx;
 }
 
+// Called before the sounds of a new map are precached, they replace the
+// previous map's as the ones the cache keeps
+void S_BeginPrecache (void)
+{
+	snd_registration++;
+}
+
+static qbool S_SoundPinned (sfx_t *sfx)
+{
+	int i;
+
+	if ((snd_registration && sfx->registration == snd_registration) || sfx->uses >= SND_CACHE_PIN_USES) {
+		return true;
+	}
+
+	for (i = 0; i < NUM_AMBIENTS; i++) {
+		if (sfx == ambient_sfx[i]) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 //=============================================================================
 
 // picks a channel based on priorities, empty slots, number of channels
@@ -580,7 +785,7 @@ static channel_t *SND_PickChannel (int entnum, int entchannel)
 		}
 
 		// don't let monster sounds override player sounds
-		if (channels[ch_idx].entnum == cl.playernum+1 && entnum != cl.playernum+1 && channels[ch_idx].sfx)
+		if (channels[ch_idx].entnum == mix_listener.viewentity && entnum != mix_listener.viewentity && channels[ch_idx].sfx)
 			continue;
 
 		if (channels[ch_idx].end - shw->paintedtime < life_left) {
@@ -599,23 +804,23 @@ static channel_t *SND_PickChannel (int entnum, int entchannel)
 }
 
 // spatializes a channel
-static void SND_Spatialize (channel_t *ch)
+static void SND_Spatialize (channel_t *ch, const snd_listener_t *from)
 {
 	vec_t dot, dist, lscale, rscale, scale;
 	vec3_t source_vec;
 
 	// anything coming from the view entity will always be full volume
-	if ((ch->entnum == cl.playernum + 1) || (ch->entnum == SELF_SOUND_ENTITY)) {
+	if ((ch->entnum == from->viewentity) || (ch->entnum == SELF_SOUND_ENTITY)) {
 		ch->leftvol = ch->master_vol;
 		ch->rightvol = ch->master_vol;
 		return;
 	}
 
 	// calculate stereo seperation and distance attenuation
-	VectorSubtract(ch->origin, listener_origin, source_vec);
+	VectorSubtract(ch->origin, from->origin, source_vec);
 
 	dist = VectorNormalize(source_vec) * ch->dist_mult;
-	dot = DotProduct(listener_right, source_vec);
+	dot = DotProduct(from->right, source_vec);
 
 	if (shw->numchannels == 1) {
 		rscale = 1.0;
@@ -637,51 +842,241 @@ static void SND_Spatialize (channel_t *ch)
 		ch->leftvol = 0;
 }
 
+// Channels to spatialize, as structure of arrays so that four are done at
+// once. Padded to a multiple of four with silent channels.
+typedef struct snd_spatial_batch_s {
+	float x[MAX_CHANNELS + 3];
+	float y[MAX_CHANNELS + 3];
+	float z[MAX_CHANNELS + 3];
+	float dist_mult[MAX_CHANNELS + 3];
+	float master_vol[MAX_CHANNELS + 3];
+	int leftvol[MAX_CHANNELS + 3];
+	int rightvol[MAX_CHANNELS + 3];
+	channel_t *channel[MAX_CHANNELS + 3];
+} snd_spatial_batch_t;
+
+static snd_spatial_batch_t snd_spatial_batch;
+
+// SND_Spatialize for count channels of the batch, starting at first
+static void SND_SpatializeBatchRange (snd_spatial_batch_t *b, int first, int count, float stereo)
+{
+	int i = first;
+
+	if (s_mixer_simd.integer) {
+#if defined(SND_SSE2)
+		__m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), sep = _mm_set1_ps(stereo);
+		__m128 rx = _mm_set1_ps(mix_listener.right[0]), ry = _mm_set1_ps(mix_listener.right[1]), rz = _mm_set1_ps(mix_listener.right[2]);
+
+		for (; i + 4 <= first + count; i += 4) {
+			__m128 x = _mm_loadu_ps(b->x + i), y = _mm_loadu_ps(b->y + i), z = _mm_loadu_ps(b->z + i);
+			__m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+			// a sound at the listener has no direction, as in VectorNormalize
+			__m128 inv = _mm_and_ps(_mm_div_ps(one, len), _mm_cmpgt_ps(len, zero));
+			__m128 dot = _mm_mul_ps(_mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, rx), _mm_mul_ps(y, ry)), _mm_mul_ps(z, rz)), inv), sep);
+			__m128 att = _mm_mul_ps(_mm_loadu_ps(b->master_vol + i), _mm_sub_ps(one, _mm_mul_ps(len, _mm_loadu_ps(b->dist_mult + i))));
+
+			_mm_storeu_si128((__m128i *)(b->rightvol + i), _mm_cvttps_epi32(_mm_max_ps(_mm_mul_ps(att, _mm_add_ps(one, dot)), zero)));
+			_mm_storeu_si128((__m128i *)(b->leftvol + i), _mm_cvttps_epi32(_mm_max_ps(_mm_mul_ps(att, _mm_sub_ps(one, dot)), zero)));
+		}
+#elif defined(SND_NEON)
+		float32x4_t zero = vdupq_n_f32(0), one = vdupq_n_f32(1.0f), sep = vdupq_n_f32(stereo);
+		float32x4_t rx = vdupq_n_f32(mix_listener.right[0]), ry = vdupq_n_f32(mix_listener.right[1]), rz = vdupq_n_f32(mix_listener.right[2]);
+
+		for (; i + 4 <= first + count; i += 4) {
+			float32x4_t x = vld1q_f32(b->x + i), y = vld1q_f32(b->y + i), z = vld1q_f32(b->z + i);
+			float32x4_t len2 = vmlaq_f32(vmlaq_f32(vmulq_f32(x, x), y, y), z, z);
+			uint32x4_t nonzero = vcgtq_f32(len2, zero);
+			// 1 / sqrt by estimate and two refinement steps, ARMv7 has no vector sqrt
+			float32x4_t inv = vrsqrteq_f32(len2);
+			float32x4_t len, dot, att;
+
+			inv = vmulq_f32(inv, vrsqrtsq_f32(vmulq_f32(len2, inv), inv));
+			inv = vmulq_f32(inv, vrsqrtsq_f32(vmulq_f32(len2, inv), inv));
+			// a sound at the listener has no direction, as in VectorNormalize
+			inv = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(inv), nonzero));
+			len = vmulq_f32(len2, inv);
+			dot = vmulq_f32(vmulq_f32(vmlaq_f32(vmlaq_f32(vmulq_f32(x, rx), y, ry), z, rz), inv), sep);
+			att = vmulq_f32(vld1q_f32(b->master_vol + i), vmlsq_f32(one, len, vld1q_f32(b->dist_mult + i)));
+
+			vst1q_s32(b->rightvol + i, vcvtq_s32_f32(vmaxq_f32(vmulq_f32(att, vaddq_f32(one, dot)), zero)));
+			vst1q_s32(b->leftvol + i, vcvtq_s32_f32(vmaxq_f32(vmulq_f32(att, vsubq_f32(one, dot)), zero)));
+		}
+#endif
+	}
+
+	for (; i < first + count; i++) {
+		float len = sqrt(b->x[i] * b->x[i] + b->y[i] * b->y[i] + b->z[i] * b->z[i]);
+		float dot = 0, att;
+
+		if (len > 0) {
+			dot = (b->x[i] * mix_listener.right[0] + b->y[i] * mix_listener.right[1] + b->z[i] * mix_listener.right[2]) / len * stereo;
+		}
+		att = b->master_vol[i] * (1.0f - len * b->dist_mult[i]);
+
+		b->rightvol[i] = (int) max(0, att * (1.0f + dot));
+		b->leftvol[i] = (int) max(0, att * (1.0f - dot));
+	}
+}
+
+// SND_Spatialize for every static and dynamic channel
+static void SND_SpatializeBatch (void)
+{
+	snd_spatial_batch_t *b = &snd_spatial_batch;
+	unsigned int i;
+	int k, count = 0;
+	channel_t *ch;
+	vec3_t delta;
+
+	ch = channels + NUM_AMBIENTS;
+	for (i = NUM_AMBIENTS; i < total_channels; i++, ch++) {
+		if (!ch->sfx)
+			continue;
+
+		// anything coming from the view entity will always be full volume
+		if ((ch->entnum == mix_listener.viewentity) || (ch->entnum == SELF_SOUND_ENTITY)) {
+			ch->leftvol = ch->rightvol = ch->master_vol;
+			continue;
+		}
+
+		// beyond 1 / dist_mult the distance attenuation silences the channel
+		VectorSubtract(ch->origin, mix_listener.origin, delta);
+		if (!ch->master_vol || DotProduct(delta, delta) * ch->dist_mult * ch->dist_mult >= 1) {
+			ch->leftvol = ch->rightvol = 0;
+			continue;
+		}
+
+		b->x[count] = delta[0];
+		b->y[count] = delta[1];
+		b->z[count] = delta[2];
+		b->dist_mult[count] = ch->dist_mult;
+		b->master_vol[count] = ch->master_vol;
+		b->channel[count++] = ch;
+	}
+
+	for (k = count; k & 3; k++) {
+		b->x[k] = b->y[k] = b->z[k] = 0;
+		b->dist_mult[k] = b->master_vol[k] = 0;
+	}
+
+	SND_SpatializeBatchRange(b, 0, k, shw->numchannels == 1 ? 0 : 1);
+
+	for (k = 0; k < count; k++) {
+		b->channel[k]->leftvol = b->leftvol[k];
+		b->channel[k]->rightvol = b->rightvol[k];
+	}
+}
+
+// respatializes static and dynamic sounds after the listener moved
+static void SND_SpatializeChannels (void)
+{
+	unsigned int i, j;
+	channel_t *ch, *combine;
+
+	combine = NULL;
+
+	SND_SpatializeBatch();
+
+	ch = channels + NUM_AMBIENTS;
+	for (i = NUM_AMBIENTS; i < total_channels; i++, ch++) {
+		if (!ch->sfx)
+			continue;
+		if (!ch->leftvol && !ch->rightvol)
+			continue;
+
+		// try to combine static sounds with a previous channel of the same
+		// sound effect so we don't mix five torches every frame
+
+		if (i >= MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS) {
+			// see if it can just use the last one
+			if (combine && combine->sfx == ch->sfx) {
+				combine->leftvol += ch->leftvol;
+				combine->rightvol += ch->rightvol;
+				ch->leftvol = ch->rightvol = 0;
+				continue;
+			}
+			// search for one
+			combine = channels+MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS;
+			for (j = MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS; j < i; j++, combine++)
+				if (combine->sfx == ch->sfx)
+					break;
+
+			if (j == total_channels) {
+				combine = NULL;
+			} else {
+				if (combine != ch) {
+					combine->leftvol += ch->leftvol;
+					combine->rightvol += ch->rightvol;
+					ch->leftvol = ch->rightvol = 0;
+				}
+				continue;
+			}
+		}
+	}
+}
+
 // =======================================================================
-// Start a sound effect
+// Mixer commands
 // =======================================================================
 
-void S_StartSound (int entnum, int entchannel, sfx_t *sfx, vec3_t origin, float fvol, float attenuation)
+static inline int S_CommandQueueNextIndex(int index)
+{
+	return (index + 1) % SND_MAX_COMMANDS;
+}
+
+static snd_command_t *S_CommandQueuePeek(void)
+{
+	int head = SDL_AtomicGet(&snd_commands.head);
+
+	// Empty queue
+	if (head == SDL_AtomicGet(&snd_commands.tail)) {
+		return NULL;
+	}
+
+	SDL_MemoryBarrierAcquire();
+	return &snd_commands.commands[head];
+}
+
+static void S_CommandQueueAdvance(void)
+{
+	int head = SDL_AtomicGet(&snd_commands.head);
+
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&snd_commands.head, S_CommandQueueNextIndex(head));
+}
+
+static void S_RunStartSound(const snd_command_t *cmd)
 {
 	channel_t *target_chan, *check;
 	sfxcache_t *sc;
 	int ch_idx, skip;
 
-	if (!shw || !sfx || s_nosound.value)
-		return;
-
-	S_LockMixer();
-
 	// pick a channel to play on
-	target_chan = SND_PickChannel(entnum, entchannel);
+	target_chan = SND_PickChannel(cmd->entnum, cmd->entchannel);
 	if (!target_chan) {
-		S_UnlockMixer();
 		return;
 	}
 
 	// spatialize
 	memset (target_chan, 0, sizeof(*target_chan));
-	VectorCopy(origin, target_chan->origin);
-	target_chan->dist_mult = attenuation / sound_nominal_clip_dist;
-	target_chan->master_vol = (int) (fvol * 255);
-	target_chan->entnum = entnum;
-	target_chan->entchannel = entchannel;
-	SND_Spatialize(target_chan);
+	VectorCopy(cmd->origin, target_chan->origin);
+	target_chan->dist_mult = cmd->attenuation / sound_nominal_clip_dist;
+	target_chan->master_vol = (int) (cmd->vol * 255);
+	target_chan->entnum = cmd->entnum;
+	target_chan->entchannel = cmd->entchannel;
+	target_chan->flags = cmd->flags;
+	SND_Spatialize(target_chan, &mix_listener);
 
 	if (!target_chan->leftvol && !target_chan->rightvol) {
-		S_UnlockMixer();
 		return; // not audible at all
 	}
 
-	// new channel
-	sc = S_LoadSound (sfx);
+	// loaded by the game thread before posting
+	sc = (sfxcache_t *) cmd->sfx->buf;
 	if (!sc) {
-		target_chan->sfx = NULL;
-		S_UnlockMixer();
-		return; // couldn't load the sound's data
+		return;
 	}
 
-	target_chan->sfx = sfx;
+	target_chan->sfx = cmd->sfx;
 	target_chan->pos = 0.0;
 	target_chan->end = shw->paintedtime + (int) sc->total_length;
 
@@ -691,7 +1086,7 @@ void S_StartSound (int entnum, int entchannel, sfx_t *sfx, vec3_t origin, float
 	for (ch_idx=NUM_AMBIENTS; ch_idx < NUM_AMBIENTS + MAX_DYNAMIC_CHANNELS; ch_idx++, check++) {
 		if (check == target_chan)
 			continue;
-		if (check->sfx == sfx && !check->pos) {
+		if (check->sfx == cmd->sfx && !check->pos) {
 			skip = rand () % (int)(0.1 * shw->khz);
 			if (skip >= target_chan->end)
 				skip = target_chan->end - 1;
@@ -700,44 +1095,201 @@ void S_StartSound (int entnum, int entchannel, sfx_t *sfx, vec3_t origin, float
 			break;
 		}
 	}
-	S_UnlockMixer();
 }
 
-void S_StopSound (int entnum, int entchannel)
+static void S_RunStopSound(const snd_command_t *cmd)
 {
 	unsigned int i;
 
-	S_LockMixer();
-
 	for (i = 0; i < MAX_DYNAMIC_CHANNELS; i++) {
-		if (channels[i].entnum == entnum && channels[i].entchannel == entchannel) {
+		if (channels[i].entnum == cmd->entnum && channels[i].entchannel == cmd->entchannel) {
 			channels[i].end = 0;
 			channels[i].sfx = NULL;
-			S_UnlockMixer();
 			return;
 		}
 	}
-	S_UnlockMixer();
 }
 
-static void S_StopSoundScript_f(void) {
-	S_StopSound(SELF_SOUND_ENTITY, 0);
+static void S_RunStaticSound(const snd_command_t *cmd)
+{
+	channel_t *ss;
+	sfxcache_t *sc = (sfxcache_t *) cmd->sfx->buf;
+
+	if (total_channels == MAX_CHANNELS || !sc) {
+		return;
+	}
+
+	ss = &channels[total_channels];
+	total_channels++;
+
+	ss->sfx = cmd->sfx;
+	VectorCopy (cmd->origin, ss->origin);
+	ss->master_vol = (int) cmd->vol;
+	ss->dist_mult = (cmd->attenuation/64) / sound_nominal_clip_dist;
+	ss->end = shw->paintedtime + (int) sc->total_length;
+
+	SND_Spatialize (ss, &mix_listener);
 }
 
-void S_StopAllSounds(void)
+static void S_RunStopAllSounds(void)
+{
+	total_channels = MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS; // no statics
+
+	memset(channels, 0, MAX_CHANNELS * sizeof(channel_t));
+
+	shw->numwraps = shw->oldsamplepos = shw->paintedtime = shw->samplepos = shw->snd_sent = 0;
+}
+
+static void S_RunUpdate(const snd_command_t *cmd)
+{
+	int i;
+
+	mix_listener = cmd->listener;
+
+	if (cmd->ambient) {
+		for (i = 0; i < NUM_AMBIENTS; i++) {
+			channel_t *chan = &channels[i];
+
+			chan->sfx = cmd->ambient_sfx[i];
+			chan->master_vol = cmd->ambient_vol[i];
+			chan->leftvol = chan->rightvol = chan->master_vol;
+		}
+	}
+}
+
+// Runs the commands posted by the game thread, smutex held
+static void S_RunCommands(void)
+{
+	snd_command_t *cmd;
+	qbool moved = false;
+
+	while ((cmd = S_CommandQueuePeek())) {
+		switch (cmd->type) {
+		case SND_CMD_START:
+			S_RunStartSound(cmd);
+			break;
+		case SND_CMD_STOP:
+			S_RunStopSound(cmd);
+			break;
+		case SND_CMD_STATIC:
+			S_RunStaticSound(cmd);
+			break;
+		case SND_CMD_STOPALL:
+			S_RunStopAllSounds();
+			break;
+		case SND_CMD_UPDATE:
+			S_RunUpdate(cmd);
+			moved = true;
+			break;
+		}
+
+		S_CommandQueueAdvance();
+	}
+
+	if (moved) {
+		SND_SpatializeChannels();
+	}
+}
+
+// Returns the next free command, to be filled in and handed to S_PostCommand
+static snd_command_t *S_AllocCommand(snd_command_type_t type)
+{
+	int tail = SDL_AtomicGet(&snd_commands.tail);
+	snd_command_t *cmd;
+
+	if (S_CommandQueueNextIndex(tail) == SDL_AtomicGet(&snd_commands.head)) {
+		// the mixer is not keeping up (or not running), make room here
+		snd_commands.full++;
+		S_LockMixer();
+		S_RunCommands();
+		S_UnlockMixer();
+	}
+
+	cmd = &snd_commands.commands[tail];
+	cmd->type = type;
+	return cmd;
+}
+
+static void S_PostCommand(void)
+{
+	int tail = SDL_AtomicGet(&snd_commands.tail);
+
+	// Publish the slot only once it is fully written.
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&snd_commands.tail, S_CommandQueueNextIndex(tail));
+}
+
+// =======================================================================
+// Start a sound effect
+// =======================================================================
+
+static void S_StartSoundWithFlags (int entnum, int entchannel, sfx_t *sfx, vec3_t origin, float fvol, float attenuation, int flags)
+{
+	channel_t test;
+	snd_command_t *cmd;
+
+	if (!shw || !sfx || s_nosound.value)
+		return;
+
+	// skip loading sounds that would not be heard, the mixer checks again
+	memset (&test, 0, sizeof(test));
+	VectorCopy(origin, test.origin);
+	test.dist_mult = attenuation / sound_nominal_clip_dist;
+	test.master_vol = (int) (fvol * 255);
+	test.entnum = entnum;
+	SND_Spatialize(&test, &listener);
+
+	if (!test.leftvol && !test.rightvol) {
+		return; // not audible at all
+	}
+
+	if (!S_LoadSound (sfx)) {
+		return; // couldn't load the sound's data
+	}
+
+	cmd = S_AllocCommand(SND_CMD_START);
+	cmd->entnum = entnum;
+	cmd->entchannel = entchannel;
+	cmd->sfx = sfx;
+	VectorCopy(origin, cmd->origin);
+	cmd->vol = fvol;
+	cmd->attenuation = attenuation;
+	cmd->flags = flags;
+	S_PostCommand();
+}
+
+void S_StartSound (int entnum, int entchannel, sfx_t *sfx, vec3_t origin, float fvol, float attenuation)
+{
+	S_StartSoundWithFlags(entnum, entchannel, sfx, origin, fvol, attenuation, 0);
+}
+
+void S_StopSound (int entnum, int entchannel)
 {
+	snd_command_t *cmd;
+
 	if (!shw)
 		return;
 
-	total_channels = MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS; // no statics
+	cmd = S_AllocCommand(SND_CMD_STOP);
+	cmd->entnum = entnum;
+	cmd->entchannel = entchannel;
+	S_PostCommand();
+}
 
-	S_LockMixer();
+static void S_StopSoundScript_f(void) {
+	S_StopSound(SELF_SOUND_ENTITY, 0);
+}
 
-	memset(channels, 0, MAX_CHANNELS * sizeof(channel_t));
+void S_StopAllSounds(void)
+{
+	if (!shw)
+		return;
 
-	shw->numwraps = shw->oldsamplepos = shw->paintedtime = shw->samplepos = shw->snd_sent = 0;
+	static_sounds = 0;
+	memset(ambient_vol, 0, sizeof(ambient_vol));
 
-	S_UnlockMixer();
+	S_AllocCommand(SND_CMD_STOPALL);
+	S_PostCommand();
 }
 
 static void S_StopAllSounds_f(void)
@@ -747,161 +1299,181 @@ static void S_StopAllSounds_f(void)
 
 void S_StaticSound (sfx_t *sfx, vec3_t origin, float vol, float attenuation)
 {
-	channel_t *ss;
+	snd_command_t *cmd;
 	sfxcache_t *sc;
 
 	if (!shw || !sfx || s_nosound.value)
 		return;
 
-	S_LockMixer();
-
-	if (total_channels == MAX_CHANNELS) {
+	if (MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS + static_sounds == MAX_CHANNELS) {
 		Com_Printf ("total_channels == MAX_CHANNELS\n");
-		S_UnlockMixer();
 		return;
 	}
-
-	ss = &channels[total_channels];
-	total_channels++;
+	static_sounds++;
 
 	sc = S_LoadSound (sfx);
 	if (!sc) {
-		S_UnlockMixer();
 		return;
 	}
 
 	if (sc->loopstart == -1) {
 		Com_Printf ("Sound %s not looped\n", sfx->name);
-		S_UnlockMixer();
 		return;
 	}
 
-	ss->sfx = sfx;
-	VectorCopy (origin, ss->origin);
-	ss->master_vol = (int) vol;
-	ss->dist_mult = (attenuation/64) / sound_nominal_clip_dist;
-	ss->end = shw->paintedtime + (int) sc->total_length;
-
-	SND_Spatialize (ss);
-
-	S_UnlockMixer();
+	cmd = S_AllocCommand(SND_CMD_STATIC);
+	cmd->sfx = sfx;
+	VectorCopy (origin, cmd->origin);
+	cmd->vol = vol;
+	cmd->attenuation = attenuation;
+	S_PostCommand();
 }
 
 //=============================================================================
 
-static void S_UpdateAmbientSounds (void)
+// Fills in the ambient channels for the mixer, false if they stay as they are
+static qbool S_UpdateAmbientSounds (sfx_t **sfx, int *vols)
 {
 	static double last_adjusted = 0;
 	struct cleaf_s *leaf;
 	int vol;
 	int ambient_channel;
-	channel_t *chan;
 	double frametime = (last_adjusted ? cls.realtime - last_adjusted : cls.frametime);
 	int adjustment = Q_rint (frametime * s_ambientfade.value);
 
 	if (cls.state != ca_active) {
 		last_adjusted = 0;
-		return;
+		return false;
 	}
 
-	leaf = CM_PointInLeaf (listener_origin);
+	leaf = CM_PointInLeaf (listener.origin);
 	if (!CM_Leafnum(leaf) || !s_ambientlevel.value) {
-		for (ambient_channel = 0 ; ambient_channel< NUM_AMBIENTS ; ambient_channel++)
-			channels[ambient_channel].sfx = NULL;
+		for (ambient_channel = 0 ; ambient_channel< NUM_AMBIENTS ; ambient_channel++) {
+			sfx[ambient_channel] = NULL;
+			vols[ambient_channel] = ambient_vol[ambient_channel];
+		}
 		last_adjusted = cls.realtime;
-		return;
+		return true;
 	}
 
 	if (!adjustment) {
-		return;
+		return false;
 	}
 
 	last_adjusted = cls.realtime;
 
 	for (ambient_channel = 0 ; ambient_channel< NUM_AMBIENTS ; ambient_channel++) {
-		chan = &channels[ambient_channel];
-		chan->sfx = ambient_sfx[ambient_channel];
+		int *master_vol = &ambient_vol[ambient_channel];
 
 		vol = (int) (s_ambientlevel.value * CM_LeafAmbientLevel(leaf, ambient_channel));
 		if (vol < 8)
 			vol = 0;
 
 		// don't adjust volume too fast
-		if (chan->master_vol < vol) {
-			chan->master_vol += adjustment;
-			if (chan->master_vol > vol)
-				chan->master_vol = vol;
-		} else if (chan->master_vol > vol) {
-			chan->master_vol -= adjustment;
-			if (chan->master_vol < vol)
-				chan->master_vol = vol;
+		if (*master_vol < vol) {
+			*master_vol += adjustment;
+			if (*master_vol > vol)
+				*master_vol = vol;
+		} else if (*master_vol > vol) {
+			*master_vol -= adjustment;
+			if (*master_vol < vol)
+				*master_vol = vol;
 		}
 
-		chan->leftvol = chan->rightvol = chan->master_vol;
+		// the mixer only plays decoded sounds
+		sfx[ambient_channel] = ambient_sfx[ambient_channel];
+		if (sfx[ambient_channel] && !sfx[ambient_channel]->buf && !S_LoadSound(sfx[ambient_channel])) {
+			sfx[ambient_channel] = NULL;
+		}
+		vols[ambient_channel] = *master_vol;
 	}
+
+	return true;
 }
 
-//Called once each time through the main loop
-void S_Update (vec3_t origin, vec3_t forward, vec3_t right, vec3_t up)
+static qbool S_SoundPlaying (sfx_t *sfx)
 {
-	unsigned int i, j, total;
-	static unsigned int printed_total = 0;
-	channel_t *ch, *combine;
-
-	if (!snd_initialized || !snd_started || !shw)
-		return;
-
-	S_LockMixer();
+	unsigned int i;
 
-	VectorCopy(origin, listener_origin);
-	VectorCopy(forward, listener_forward);
-	VectorCopy(right, listener_right);
-	VectorCopy(up, listener_up);
+	for (i = 0; i < total_channels; i++) {
+		if (channels[i].sfx == sfx) {
+			return true;
+		}
+	}
 
-	// update general area ambient sound sources
-	S_UpdateAmbientSounds ();
+	return false;
+}
 
-	combine = NULL;
+// Frees the least recently used sounds that are neither pinned nor playing
+// until the decoded sounds fit in s_cachesize
+static void S_SoundCacheEvict (void)
+{
+	size_t budget = (size_t) (max(0, s_cachesize.value) * 1024 * 1024);
+	sfx_t *sfx, *victim;
+	int i;
 
-	// update spatialization for static and dynamic sounds
-	ch = channels + NUM_AMBIENTS;
-	for (i = NUM_AMBIENTS; i < total_channels; i++, ch++) {
-		if (!ch->sfx)
-			continue;
-		SND_Spatialize(ch); // respatialize channel
-		if (!ch->leftvol && !ch->rightvol)
-			continue;
+	if (!budget || snd_cache_stats.resident <= budget || snd_cache_stats.resident == snd_cache_unevictable) {
+		return;
+	}
 
-		// try to combine static sounds with a previous channel of the same
-		// sound effect so we don't mix five torches every frame
+	// run what is queued so channels[] shows every sound in use
+	S_LockMixer();
+	S_RunCommands();
 
-		if (i >= MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS) {
-			// see if it can just use the last one
-			if (combine && combine->sfx == ch->sfx) {
-				combine->leftvol += ch->leftvol;
-				combine->rightvol += ch->rightvol;
-				ch->leftvol = ch->rightvol = 0;
+	while (snd_cache_stats.resident > budget) {
+		victim = NULL;
+		for (i = 0, sfx = known_sfx; i < num_sfx; i++, sfx++) {
+			if (!sfx->buf || S_SoundPinned(sfx) || S_SoundPlaying(sfx)) {
 				continue;
 			}
-			// search for one
-			combine = channels+MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS;
-			for (j = MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS; j < i; j++, combine++)
-				if (combine->sfx == ch->sfx)
-					break;
-
-			if (j == total_channels) {
-				combine = NULL;
-			} else {
-				if (combine != ch) {
-					combine->leftvol += ch->leftvol;
-					combine->rightvol += ch->rightvol;
-					ch->leftvol = ch->rightvol = 0;
-				}
-				continue;
+			if (!victim || sfx->last_used < victim->last_used) {
+				victim = sfx;
 			}
 		}
+
+		if (!victim) {
+			// try again once something else is loaded
+			snd_cache_unevictable = snd_cache_stats.resident;
+			break;
+		}
+
+		S_FreeSound(victim);
+		snd_cache_stats.evictions++;
 	}
 
+	S_UnlockMixer();
+}
+
+//Called once each time through the main loop
+void S_Update (vec3_t origin, vec3_t forward, vec3_t right, vec3_t up)
+{
+	unsigned int i, total;
+	static unsigned int printed_total = 0;
+	snd_command_t *cmd;
+	channel_t *ch;
+
+	if (!snd_initialized || !snd_started || !shw)
+		return;
+
+	S_FinishSoundDecodes();
+	S_SoundCacheEvict();
+#ifdef FTE_PEXT2_VOICECHAT
+	S_Voip_Update();
+#endif
+
+	VectorCopy(origin, listener.origin);
+	VectorCopy(forward, listener.forward);
+	VectorCopy(right, listener.right);
+	VectorCopy(up, listener.up);
+	listener.viewentity = cl.playernum + 1;
+
+	// the mixer respatializes static and dynamic sounds and
+	// updates general area ambient sound sources
+	cmd = S_AllocCommand(SND_CMD_UPDATE);
+	cmd->listener = listener;
+	cmd->ambient = S_UpdateAmbientSounds(cmd->ambient_sfx, cmd->ambient_vol);
+	S_PostCommand();
+
 	sound_spatialized = true;
 
 	// debugging output
@@ -909,12 +1481,14 @@ void S_Update (vec3_t origin, vec3_t forward, vec3_t right, vec3_t up)
 		total = 0;
 		ch = channels;
 
+		S_LockMixer();
 		for (i = 0; i < total_channels; i++, ch++)
 			if (ch->sfx && (ch->leftvol || ch->rightvol)) {
 				if ((cl.standby || cls.demoplayback) && s_show.value == 2)
 					Com_Printf ("%3i %3i %s\n", ch->leftvol, ch->rightvol, ch->sfx->name); // s_show 2
 				total++;
 			}
+		S_UnlockMixer();
 
 		Print_flags[Print_current] |= PR_TR_SKIP;
 		
@@ -925,10 +1499,21 @@ void S_Update (vec3_t origin, vec3_t forward, vec3_t right, vec3_t up)
 	}
 
 	if (Movie_IsCapturing()) {
-		Movie_MixFrameSound(S_Update_);
+		S_LockMixer();
+		Movie_MixFrameSound(S_MixSamples);
+		S_UnlockMixer();
 	}
+	else if (snd_offline) {
+		int samples;
 
-	S_UnlockMixer();
+		snd_offline_time += cls.trueframetime;
+		samples = (int)(snd_offline_time * shw->khz);
+		snd_offline_time -= (double)samples / shw->khz;
+
+		S_LockMixer();
+		S_MixSamples(min(samples, shw->khz));
+		S_UnlockMixer();
+	}
 }
 
 static void GetSoundtime(void)
@@ -960,6 +1545,8 @@ static void S_Update_(void)
 		return;
 	}
 
+	S_RunCommands();
+
 	// Updates soundtime
 	GetSoundtime();
 
@@ -974,6 +1561,25 @@ static void S_Update_(void)
 	S_PaintChannels(endtime);
 }
 
+// Paints exactly 'samples' sample frames past what was painted before, whatever
+// the device has played. Used for movie capture, where the transfer hands them to
+// Movie_TransferSound in order, and by the offline device.
+static void S_MixSamples(int samples)
+{
+	S_RunCommands();
+
+	if (samples <= 0) {
+		return;
+	}
+
+	// the device buffer belongs to the audio callback
+	shw->buffer = (unsigned char *) snd_offline_buffer;
+	shw->samples = SND_OFFLINE_SAMPLES;
+
+	S_PaintChannels(shw->paintedtime + samples);
+	shw->snd_sent += samples * shw->numchannels * (shw->samplebits / 8);
+}
+
 /*
 ===============================================================================
 console functions
@@ -1002,7 +1608,7 @@ static void S_Play_f (void)
 			continue;
 		}
 
-		VectorCopy(listener_origin, sound_origin);
+		VectorCopy(listener.origin, sound_origin);
 		COM_DefaultExtension (name, ".wav", sizeof(name));
 		sfx = S_PrecacheSound(name);
 		if (playvol)
@@ -1061,6 +1667,9 @@ static void S_SoundList_f (void)
 		Com_Printf ("(%2db) %6i : %s\n",sc->format.width*8,  size, sfx->name);
 	}
 	Com_Printf ("Total resident: %i\n", total);
+	Com_Printf ("Cache: %u hits, %u waits, %u misses, %u evictions, %.1f of %.0f MB\n",
+		snd_cache_stats.hits, snd_cache_stats.waits, snd_cache_stats.misses, snd_cache_stats.evictions,
+		snd_cache_stats.resident / (1024.0 * 1024.0), s_cachesize.value);
 
 	S_UnlockMixer();
 }
@@ -1212,6 +1821,9 @@ void S_RawAudio(int sourceid, byte *data, unsigned int speed, unsigned int sampl
 		(sourceid >= RAW_SOURCE_DEMO_VOICE_BASE && sourceid <= RAW_SOURCE_DEMO_VOICE_MAX)) ? CHANNEL_FLAG_VOICE : 0;
 	raw_volume = (raw_flags & CHANNEL_FLAG_VOICE) ? 1 : s_raw_volume.value;
 
+	// channels[] must be up to date before looking for the stream's channel
+	S_RunCommands();
+
 	// search for free slot or re-use previous one with the same sourceid.
 	s = S_RawGetFreeStream(sourceid);
 
@@ -1383,13 +1995,8 @@ void S_RawAudio(int sourceid, byte *data, unsigned int speed, unsigned int sampl
 
 	//this one wasn't playing, lets start it then.
 	if (i == total_channels) {
-		S_StartSound(SELF_SOUND_ENTITY, 0, &s->sfx, r_origin, raw_volume, 0);
-		for (i = 0; i < total_channels; i++) {
-			if (channels[i].sfx == &s->sfx) {
-				channels[i].flags = raw_flags;
-				break;
-			}
-		}
+		S_StartSoundWithFlags(SELF_SOUND_ENTITY, 0, &s->sfx, r_origin, raw_volume, 0, raw_flags);
+		S_RunCommands();
 	}
 
 	S_UnlockMixer();
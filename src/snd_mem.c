@@ -47,6 +47,27 @@ static unsigned char *S_LoadSoundFileData(char *path, int *filesize)
 	return FS_LoadTempFile(path, filesize);
 }
 
+snd_cache_stats_t snd_cache_stats;
+
+// A sound read on the main thread, to be decoded and resampled. The output
+// format is taken when it is read, decoding does not look at shw or cvars.
+typedef struct sfx_decode_s {
+	sfx_t *sfx;
+	char name[MAX_QPATH];
+	unsigned char *data;
+	int filesize;
+	qbool owned;                    // data is a copy, not temporary memory
+	int khz;
+	int loadas8bit;
+	int linearresample;
+	sfxcache_t *result;
+	char error[128];
+	qbool fatal;                    // Sys_Error on the main thread
+	qbool done;
+	struct sfx_decode_s *next;      // decode queue
+	struct sfx_decode_s *next_job;  // snd_decode_jobs
+} sfx_decode_t;
+
 #define LINEARUPSCALE(in, inrate, insamps, out, outrate, outlshift, outrshift) \
 	{ \
 		scale = inrate / (double)outrate; \
@@ -562,9 +583,8 @@ void SND_ResampleStream (void *in, int inrate, int inwidth, int inchannels, int
 ResampleSfx
 ================
 */
-static void ResampleSfx (sfx_t *sfx, int inrate, int inchannels, int inwidth, int insamps, int inloopstart, byte *data)
+static sfxcache_t *ResampleSfx (const sfx_decode_t *job, int inrate, int inchannels, int inwidth, int insamps, int inloopstart, byte *data)
 {
-	extern cvar_t s_linearresample;
 	double scale;
 	sfxcache_t	*sc;
 	int len;
@@ -572,25 +592,25 @@ static void ResampleSfx (sfx_t *sfx, int inrate, int inchannels, int inwidth, in
 	int outwidth;
 	int outchannels = 1; // inchannels;
 
-	scale = shw->khz / (double)inrate;
+	scale = job->khz / (double)inrate;
 	outsamps = insamps * scale;
-	if (s_loadas8bit.integer < 0)
+	if (job->loadas8bit < 0)
 		outwidth = 2;
-	else if (s_loadas8bit.integer)
+	else if (job->loadas8bit)
 		outwidth = 1;
 	else
 		outwidth = inwidth;
 	len = outsamps * outwidth * outchannels;
 
-	sc = sfx->buf = Q_malloc(len + sizeof(sfxcache_t));
+	sc = Q_malloc(len + sizeof(sfxcache_t));
 	if (!sc)
 	{
-		return;
+		return NULL;
 	}
 
 	sc->format.channels = outchannels;
 	sc->format.width = outwidth;
-	sc->format.speed = shw->khz;
+	sc->format.speed = job->khz;
 	sc->total_length = outsamps;
 	if (inloopstart == -1)
 		sc->loopstart = inloopstart;
@@ -606,7 +626,261 @@ static void ResampleSfx (sfx_t *sfx, int inrate, int inchannels, int inwidth, in
 		sc->format.speed, 
 		sc->format.width, 
 		sc->format.channels, 
-		s_linearresample.integer);
+		job->linearresample);
+
+	return sc;
+}
+
+/*
+===============================================================================
+Sound cache
+
+Precached sounds are read on the main thread and decoded and resampled to
+the device rate on a background thread. S_LoadSound waits for a sound that
+is still being decoded and decodes sounds that were never queued (or were
+evicted, see S_SoundCacheEvict) on the spot.
+===============================================================================
+*/
+
+static sfxcache_t *S_DecodeSound (sfx_decode_t *job);
+
+static SDL_Thread *snd_decode_thread;
+static SDL_mutex *snd_decode_mutex;
+static SDL_cond *snd_decode_cond;
+static sfx_decode_t *snd_decode_queue;     // not started yet, oldest first
+static sfx_decode_t *snd_decode_jobs;      // all in flight, main thread only
+static qbool snd_decode_quit;
+
+static size_t S_SoundCacheSize(const sfxcache_t *sc)
+{
+	return sizeof(sfxcache_t) + sc->total_length * sc->format.width * sc->format.channels;
+}
+
+static int S_DecodeThread(void *unused)
+{
+	sfx_decode_t *job;
+
+	SDL_LockMutex(snd_decode_mutex);
+	while (!snd_decode_quit) {
+		if (!(job = snd_decode_queue)) {
+			SDL_CondWait(snd_decode_cond, snd_decode_mutex);
+			continue;
+		}
+		snd_decode_queue = job->next;
+		SDL_UnlockMutex(snd_decode_mutex);
+
+		job->result = S_DecodeSound(job);
+
+		SDL_LockMutex(snd_decode_mutex);
+		job->done = true;
+		SDL_CondBroadcast(snd_decode_cond);
+	}
+	SDL_UnlockMutex(snd_decode_mutex);
+
+	return 0;
+}
+
+// Reads the file of a sound and takes the output format, on the main thread
+static sfx_decode_t *S_ReadSound(sfx_t *s, qbool keep)
+{
+	extern cvar_t s_linearresample;
+	char namebuffer[256];
+	unsigned char *data;
+	int filesize;
+	sfx_decode_t *job;
+
+	snprintf(namebuffer, sizeof(namebuffer), "sound/%s", s->name);
+
+	if (!(data = S_LoadSoundFileData(namebuffer, &filesize))) {
+		Com_Printf ("Couldn't load %s\n", namebuffer);
+		return NULL;
+	}
+
+	FMod_CheckModel(namebuffer, data, filesize);
+
+	job = Q_calloc(1, sizeof(*job));
+	job->sfx = s;
+	strlcpy(job->name, s->name, sizeof(job->name));
+	job->filesize = filesize;
+	job->khz = shw->khz;
+	job->loadas8bit = s_loadas8bit.integer;
+	job->linearresample = s_linearresample.integer;
+
+	if (keep) {
+		// the file is in temporary memory, which the next load reuses
+		job->data = Q_malloc(filesize + 1);
+		memcpy(job->data, data, filesize);
+		job->data[filesize] = 0;
+		job->owned = true;
+	}
+	else {
+		job->data = data;
+	}
+
+	return job;
+}
+
+static sfxcache_t *S_FinishDecode(sfx_decode_t *job)
+{
+	sfx_decode_t **link;
+	sfx_t *s = job->sfx;
+
+	for (link = &snd_decode_jobs; *link; link = &(*link)->next_job) {
+		if (*link == job) {
+			*link = job->next_job;
+			break;
+		}
+	}
+
+	if (job->fatal) {
+		Sys_Error("%s", job->error);
+	}
+	if (job->error[0]) {
+		Com_Printf("%s", job->error);
+	}
+
+	if ((s->buf = job->result)) {
+		snd_cache_stats.resident += S_SoundCacheSize(job->result);
+	}
+	s->decode = NULL;
+
+	if (job->owned) {
+		Q_free(job->data);
+	}
+	Q_free(job);
+
+	return s->buf;
+}
+
+sfxcache_t *S_LoadSound (sfx_t *s)
+{
+	sfx_decode_t *job;
+
+	s->last_used = cls.realtime;
+	s->uses++;
+
+	// see if allocated
+	if (s->buf) {
+		snd_cache_stats.hits++;
+		return s->buf;
+	}
+
+	if ((job = s->decode)) {
+		snd_cache_stats.waits++;
+
+		SDL_LockMutex(snd_decode_mutex);
+		while (!job->done) {
+			SDL_CondWait(snd_decode_cond, snd_decode_mutex);
+		}
+		SDL_UnlockMutex(snd_decode_mutex);
+
+		return S_FinishDecode(job);
+	}
+
+	// load it in
+	snd_cache_stats.misses++;
+	if (!(job = S_ReadSound(s, false))) {
+		return NULL;
+	}
+	job->result = S_DecodeSound(job);
+
+	return S_FinishDecode(job);
+}
+
+// Starts decoding a precached sound in the background
+void S_QueueSound (sfx_t *s)
+{
+	sfx_decode_t *job, **link;
+
+	if (s->buf || s->decode) {
+		return;
+	}
+
+#ifndef OLD_WAV_LOADING
+	if (!snd_decode_mutex) {
+		snd_decode_mutex = SDL_CreateMutex();
+		snd_decode_cond = SDL_CreateCond();
+	}
+	if (!snd_decode_thread) {
+		snd_decode_quit = false;
+		snd_decode_thread = Sys_CreateThread(S_DecodeThread, NULL);
+	}
+#endif
+
+	if (!snd_decode_thread) {
+		// the old wav loader is not thread safe
+		S_LoadSound(s);
+		return;
+	}
+
+	if (!(job = S_ReadSound(s, true))) {
+		return;
+	}
+
+	SDL_LockMutex(snd_decode_mutex);
+	for (link = &snd_decode_queue; *link; link = &(*link)->next) {
+	}
+	*link = job;
+	SDL_CondBroadcast(snd_decode_cond);
+	SDL_UnlockMutex(snd_decode_mutex);
+
+	job->next_job = snd_decode_jobs;
+	snd_decode_jobs = job;
+	s->decode = job;
+}
+
+// Picks up the sounds the background thread has finished, once a frame
+void S_FinishSoundDecodes (void)
+{
+	sfx_decode_t *job, *next;
+	qbool done;
+
+	for (job = snd_decode_jobs; job; job = next) {
+		next = job->next_job;
+
+		SDL_LockMutex(snd_decode_mutex);
+		done = job->done;
+		SDL_UnlockMutex(snd_decode_mutex);
+
+		if (done) {
+			S_FinishDecode(job);
+		}
+	}
+}
+
+void S_FreeSound (sfx_t *s)
+{
+	if (s->buf) {
+		snd_cache_stats.resident -= S_SoundCacheSize(s->buf);
+		Q_free(s->buf);
+	}
+}
+
+// Stops the decode thread and drops the sounds it has not finished
+void S_SoundCacheShutdown (void)
+{
+	sfx_decode_t *job;
+
+	if (snd_decode_thread) {
+		SDL_LockMutex(snd_decode_mutex);
+		snd_decode_quit = true;
+		SDL_CondBroadcast(snd_decode_cond);
+		SDL_UnlockMutex(snd_decode_mutex);
+
+		SDL_WaitThread(snd_decode_thread, NULL);
+		snd_decode_thread = NULL;
+	}
+	snd_decode_queue = NULL;
+
+	while ((job = snd_decode_jobs)) {
+		snd_decode_jobs = job->next_job;
+		job->sfx->decode = NULL;
+		Q_free(job->result);
+		if (job->owned) {
+			Q_free(job->data);
+		}
+		Q_free(job);
+	}
 }
 
 #ifndef OLD_WAV_LOADING
@@ -745,11 +1019,9 @@ static qbool S_FindCuePointSampleLength(SNDFILE* sndfile, int cue_point_id, int*
 	return false;
 }
 
-sfxcache_t *S_LoadSound (sfx_t *s)
+// Called on the decode thread, reports through job->error instead of printing
+static sfxcache_t *S_DecodeSound (sfx_decode_t *job)
 {
-	char namebuffer[256];
-	unsigned char *data;
-	int filesize;
 	SF_VIRTUAL_IO sfvio;
 	SF_INFO sfinfo;
 	sfviodata_t sfviodata;
@@ -758,20 +1030,7 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 	int loopstart;
 	SF_CUES sfcues;
 	SNDFILE *sndfile;
-
-	// see if allocated
-	if (s->buf)
-		return s->buf;
-
-	// load it in
-	snprintf(namebuffer, sizeof(namebuffer), "sound/%s", s->name);
-
-	if (!(data = S_LoadSoundFileData(namebuffer, &filesize))) {
-		Com_Printf ("Couldn't load %s\n", namebuffer);
-		return NULL;
-	}
-
-	FMod_CheckModel(namebuffer, data, filesize);
+	sfxcache_t *sc;
 
 	sfvio.get_filelen = SFVIO_GetFilelen;
 	sfvio.seek = SFVIO_Seek;
@@ -780,12 +1039,16 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 
 	sfinfo.format = 0;
 
-	sfviodata.path = namebuffer;
+	sfviodata.path = job->name;
 	sfviodata.position = 0;
-	sfviodata.data = data;
-	sfviodata.filesize = filesize;
+	sfviodata.data = job->data;
+	sfviodata.filesize = job->filesize;
 
 	sndfile = sf_open_virtual(&sfvio, SFM_READ, &sfinfo, &sfviodata);
+	if (!sndfile) {
+		snprintf(job->error, sizeof(job->error), "Couldn't decode sound/%s\n", job->name);
+		return NULL;
+	}
 
 	buf = (short *)Q_malloc(sfinfo.frames * sfinfo.channels * sizeof(short));
 	sf_readf_short(sndfile, buf, sfinfo.frames);
@@ -801,7 +1064,11 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 		if (S_FindCuePointSampleLength(sndfile, sfcues.cue_points[0].position, &loop_sample_count)) {
 			loopstart = sfcues.cue_points[0].sample_offset;
 			if (loopstart + loop_sample_count > sfinfo.frames) {
-				Sys_Error("Sound %s has a bad loop length", s->name);
+				snprintf(job->error, sizeof(job->error), "Sound %s has a bad loop length", job->name);
+				job->fatal = true;
+				sf_close(sndfile);
+				Q_free(buf);
+				return NULL;
 			}
 			sfinfo.frames = loopstart + loop_sample_count;
 		}
@@ -810,15 +1077,15 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 	sf_close(sndfile);
 
 	if (sfinfo.channels < 1 || sfinfo.channels > 2) {
-		Com_Printf("%s has an unsupported number of channels (%i)\n", s->name, sfinfo.channels);
+		snprintf(job->error, sizeof(job->error), "%s has an unsupported number of channels (%i)\n", job->name, sfinfo.channels);
 		Q_free(buf);
 		return NULL;
 	}
 
-	ResampleSfx (s, sfinfo.samplerate, sfinfo.channels, sizeof(short), sfinfo.frames, loopstart, (byte *)buf);
+	sc = ResampleSfx (job, sfinfo.samplerate, sfinfo.channels, sizeof(short), sfinfo.frames, loopstart, (byte *)buf);
 	Q_free(buf);
 
-	return s->buf;
+	return sc;
 }
 
 #else
@@ -1001,37 +1268,22 @@ static void COM_CharBias (signed char *c, int size)
 	}
 }
 
-sfxcache_t *S_LoadSound (sfx_t *s)
+// Main thread only, GetWavinfo is not thread safe
+static sfxcache_t *S_DecodeSound (sfx_decode_t *job)
 {
-	char namebuffer[256];
-	unsigned char *data;
 	wavinfo_t info;
-	int filesize;
-
-	// see if allocated
-	if (s->buf)
-		return (sfxcache_t*)s->buf;
-
-	// load it in
-	snprintf(namebuffer, sizeof(namebuffer), "sound/%s", s->name);
-
-	if (!(data = S_LoadSoundFileData(namebuffer, &filesize))) {
-		Com_Printf ("Couldn't load %s\n", namebuffer);
-		return NULL;
-	}
-
-	FMod_CheckModel(namebuffer, data, filesize);
+	unsigned char *data = job->data;
 
-	info = GetWavinfo (s->name, data, filesize);
+	info = GetWavinfo (job->name, data, job->filesize);
 
 	// Stereo sounds are allowed (intended for music)
 	if (info.channels < 1 || info.channels > 2) {
-		Com_Printf("%s has an unsupported number of channels (%i)\n",s->name, info.channels);
+		snprintf(job->error, sizeof(job->error), "%s has an unsupported number of channels (%i)\n", job->name, info.channels);
 		return NULL;
 	}
 
-	if (info.dataofs + info.samples * info.channels > filesize) {
-		Com_Printf("%s is corrupt/truncated, delete and re-download\n", s->name);
+	if (info.dataofs + info.samples * info.channels > job->filesize) {
+		snprintf(job->error, sizeof(job->error), "%s is corrupt/truncated, delete and re-download\n", job->name);
 		return NULL;
 	}
 
@@ -1040,9 +1292,7 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 	else if (info.width == 2)
 		COM_SwapLittleShortBlock((short *)(data + info.dataofs), info.samples * info.channels);
 
-	ResampleSfx (s, info.rate, info.channels, info.width, info.samples, info.loopstart, data + info.dataofs);
-
-	return s->buf;
+	return ResampleSfx (job, info.rate, info.channels, info.width, info.samples, info.loopstart, data + info.dataofs);
 }
 
 int SND_Rate(int rate)
@@ -25,57 +25,210 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "qsound.h"
 #include "movie.h" // /demo_capture
 
-
-#define PAINTBUFFER_SIZE 512
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SND_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define SND_NEON
+#endif
+
+#define PAINTBUFFER_SIZE_DEFAULT 2048
+#define PAINTBUFFER_SIZE_MIN     256
+#define PAINTBUFFER_SIZE_MAX     16384
+
+// Channels are mixed in float, scaled by their 0-255 volume / 256 as the old
+// integer mixer did, and only converted and clipped when transferred out.
 typedef struct portable_samplepair_s {
-	int left;
-	int right;
+	float left;
+	float right;
 } portable_samplepair_t;
-portable_samplepair_t paintbuffer[PAINTBUFFER_SIZE];
-static portable_samplepair_t voice_paintbuffer[PAINTBUFFER_SIZE];
-static portable_samplepair_t *painttarget = paintbuffer;
-int snd_scaletable[32][256];
-int snd_vol, *snd_p;
-static int *voice_snd_p;
 
-static int snd_linear_count;
-static short *snd_out;
+static portable_samplepair_t *paintbuffer;
+static portable_samplepair_t *voice_paintbuffer;
+static portable_samplepair_t *painttarget;
+static int paintbuffer_size;
+
+cvar_t s_mixer_simd = {"s_mixer_simd", "1"};
+cvar_t s_paintbuffersize = {"s_paintbuffersize", "2048", CVAR_LATCH_SOUND};
+
+// set by s_mixer_benchmark to time the plain C paths
+static qbool snd_simd_disabled;
 
-static void Snd_WriteLinearBlastStereo16 (int* input_buffer, int* voice_input_buffer, short* output_buffer, int snd_vol, int voice_vol)
+static qbool SND_SIMDEnabled(void)
 {
-	int val, i;
+#if defined(SND_SSE2) || defined(SND_NEON)
+	return s_mixer_simd.integer && !snd_simd_disabled;
+#else
+	return false;
+#endif
+}
+
+/*
+===============================================================================
+MIXING KERNELS
+===============================================================================
+*/
 
-	for (i = 0; i < snd_linear_count; i += 2) {
-		val = ((input_buffer[i] * snd_vol) + (voice_input_buffer[i] * voice_vol)) >> 8;
-		output_buffer[i] = bound (-32768, val, 32767);
-		val = ((input_buffer[i + 1] * snd_vol) + (voice_input_buffer[i + 1] * voice_vol)) >> 8;
-		output_buffer[i+1] = bound (-32768, val, 32767);
+// out[i] = clip(paint[i] * vol + voice[i] * voice_vol) for count interleaved samples,
+// left and right swapped when swap is set
+static void SND_WriteClipped16(const float *paint, const float *voice, short *out, int count, float vol, float voice_vol, qbool swap)
+{
+	int i = 0;
+	float val;
+
+	if (SND_SIMDEnabled()) {
+#if defined(SND_SSE2)
+		__m128 v = _mm_set1_ps(vol), vv = _mm_set1_ps(voice_vol);
+		__m128 lo = _mm_set1_ps(-32768.0f), hi = _mm_set1_ps(32767.0f);
+
+		for (; i + 8 <= count; i += 8) {
+			__m128 a = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(paint + i), v), _mm_mul_ps(_mm_loadu_ps(voice + i), vv));
+			__m128 b = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(paint + i + 4), v), _mm_mul_ps(_mm_loadu_ps(voice + i + 4), vv));
+
+			if (swap) {
+				a = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1));
+				b = _mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 3, 0, 1));
+			}
+
+			// clip before converting, out of range floats do not saturate
+			a = _mm_min_ps(_mm_max_ps(a, lo), hi);
+			b = _mm_min_ps(_mm_max_ps(b, lo), hi);
+			_mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(_mm_cvttps_epi32(a), _mm_cvttps_epi32(b)));
+		}
+#elif defined(SND_NEON)
+		float32x4_t v = vdupq_n_f32(vol), vv = vdupq_n_f32(voice_vol);
+
+		for (; i + 8 <= count; i += 8) {
+			float32x4_t a = vmlaq_f32(vmulq_f32(vld1q_f32(voice + i), vv), vld1q_f32(paint + i), v);
+			float32x4_t b = vmlaq_f32(vmulq_f32(vld1q_f32(voice + i + 4), vv), vld1q_f32(paint + i + 4), v);
+
+			if (swap) {
+				a = vrev64q_f32(a);
+				b = vrev64q_f32(b);
+			}
+
+			// the conversion and the narrowing both saturate, which is the clipping
+			vst1q_s16(out + i, vcombine_s16(vqmovn_s32(vcvtq_s32_f32(a)), vqmovn_s32(vcvtq_s32_f32(b))));
+		}
+#endif
+	}
+
+	for (; i < count; i++) {
+		val = paint[swap ? i ^ 1 : i] * vol + voice[swap ? i ^ 1 : i] * voice_vol;
+		out[i] = (short) bound (-32768.0f, val, 32767.0f);
 	}
 }
 
-static void Snd_WriteLinearBlastStereo16_SwapStereo (int* input_buffer, int* voice_input_buffer, short* output_buffer, int snd_vol, int voice_vol)
+// dst[i] += src[i] * (lvol, rvol) for count mono 16 bit samples
+static void SND_MixFrom16(portable_samplepair_t *dst, const short *src, int count, float lvol, float rvol)
 {
-	int val, i;
+	int i = 0;
+
+	if (SND_SIMDEnabled()) {
+#if defined(SND_SSE2) || defined(SND_NEON)
+		float *out = (float *) dst;
+#endif
+#if defined(SND_SSE2)
+		__m128 vol = _mm_setr_ps(lvol, rvol, lvol, rvol);
+
+		for (; i + 4 <= count; i += 4) {
+			__m128i s = _mm_loadl_epi64((const __m128i *)(src + i));
+			__m128 f = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16));
+
+			_mm_storeu_ps(out + i * 2, _mm_add_ps(_mm_loadu_ps(out + i * 2), _mm_mul_ps(_mm_unpacklo_ps(f, f), vol)));
+			_mm_storeu_ps(out + i * 2 + 4, _mm_add_ps(_mm_loadu_ps(out + i * 2 + 4), _mm_mul_ps(_mm_unpackhi_ps(f, f), vol)));
+		}
+#elif defined(SND_NEON)
+		float volv[4];
+		float32x4_t vol;
+
+		volv[0] = volv[2] = lvol;
+		volv[1] = volv[3] = rvol;
+		vol = vld1q_f32(volv);
 
-	for (i = 0; i < snd_linear_count; i +=2 ) {
-		val = ((input_buffer[i + 1] * snd_vol) + (voice_input_buffer[i + 1] * voice_vol)) >> 8;
-		output_buffer[i] = bound (-32768, val, 32767);
-		val = ((input_buffer[i] * snd_vol) + (voice_input_buffer[i] * voice_vol)) >> 8;
-		output_buffer[i+1] = bound (-32768, val, 32767);
+		for (; i + 4 <= count; i += 4) {
+			float32x4_t f = vcvtq_f32_s32(vmovl_s16(vld1_s16(src + i)));
+			float32x4x2_t lr = vzipq_f32(f, f);
+
+			vst1q_f32(out + i * 2, vmlaq_f32(vld1q_f32(out + i * 2), lr.val[0], vol));
+			vst1q_f32(out + i * 2 + 4, vmlaq_f32(vld1q_f32(out + i * 2 + 4), lr.val[1], vol));
+		}
+#endif
+	}
+
+	for (; i < count; i++) {
+		dst[i].left += src[i] * lvol;
+		dst[i].right += src[i] * rvol;
+	}
+}
+
+// dst[i] += src[i] * (lvol, rvol) for count mono 8 bit samples
+static void SND_MixFrom8(portable_samplepair_t *dst, const signed char *src, int count, float lvol, float rvol)
+{
+	int i = 0;
+
+	if (SND_SIMDEnabled()) {
+#if defined(SND_SSE2) || defined(SND_NEON)
+		float *out = (float *) dst;
+#endif
+#if defined(SND_SSE2)
+		__m128 vol = _mm_setr_ps(lvol, rvol, lvol, rvol);
+
+		for (; i + 4 <= count; i += 4) {
+			int packed;
+			__m128i s;
+			__m128 f;
+
+			memcpy(&packed, src + i, sizeof(packed));
+			s = _mm_cvtsi32_si128(packed);
+			s = _mm_unpacklo_epi8(s, s);
+			f = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 24));
+
+			_mm_storeu_ps(out + i * 2, _mm_add_ps(_mm_loadu_ps(out + i * 2), _mm_mul_ps(_mm_unpacklo_ps(f, f), vol)));
+			_mm_storeu_ps(out + i * 2 + 4, _mm_add_ps(_mm_loadu_ps(out + i * 2 + 4), _mm_mul_ps(_mm_unpackhi_ps(f, f), vol)));
+		}
+#elif defined(SND_NEON)
+		float volv[4];
+		float32x4_t v;
+
+		volv[0] = volv[2] = lvol;
+		volv[1] = volv[3] = rvol;
+		v = vld1q_f32(volv);
+
+		for (; i + 8 <= count; i += 8) {
+			int16x8_t s = vmovl_s8(vld1_s8(src + i));
+			float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(s)));
+			float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(s)));
+			float32x4x2_t lr_lo = vzipq_f32(lo, lo), lr_hi = vzipq_f32(hi, hi);
+
+			vst1q_f32(out + i * 2, vmlaq_f32(vld1q_f32(out + i * 2), lr_lo.val[0], v));
+			vst1q_f32(out + i * 2 + 4, vmlaq_f32(vld1q_f32(out + i * 2 + 4), lr_lo.val[1], v));
+			vst1q_f32(out + i * 2 + 8, vmlaq_f32(vld1q_f32(out + i * 2 + 8), lr_hi.val[0], v));
+			vst1q_f32(out + i * 2 + 12, vmlaq_f32(vld1q_f32(out + i * 2 + 12), lr_hi.val[1], v));
+		}
+#endif
+	}
+
+	for (; i < count; i++) {
+		dst[i].left += src[i] * lvol;
+		dst[i].right += src[i] * rvol;
 	}
 }
 
 static void S_TransferStereo16 (int endtime)
 {
-	int lpaintedtime, lpos, clientVolume;
-	int voiceVolume;
+	int lpaintedtime, lpos, linear_count;
+	float client_vol, voice_vol;
+	float *snd_p, *voice_snd_p;
+	short *snd_out;
 	DWORD *pbuf;
 
-	clientVolume = snd_vol = (s_volume.value * S_VoipVoiceTransmitVolume()) * 256;
-	voiceVolume = max(0, s_raw_volume.value * 256);
+	client_vol = s_volume.value * S_VoipVoiceTransmitVolume();
+	voice_vol = max(0, s_raw_volume.value);
 
-	snd_p = (int *) paintbuffer;
-	voice_snd_p = (int *) voice_paintbuffer;
+	snd_p = (float *) paintbuffer;
+	voice_snd_p = (float *) voice_paintbuffer;
 	lpaintedtime = shw->paintedtime;
 
 	pbuf = (DWORD *)shw->buffer;
@@ -85,61 +238,58 @@ static void S_TransferStereo16 (int endtime)
 		lpos = lpaintedtime % ((shw->samples>>1));
 		snd_out = (short *) pbuf + (lpos << 1);
 
-		snd_linear_count = (shw->samples>>1) - lpos;
-		if (lpaintedtime + snd_linear_count > endtime)
-			snd_linear_count = endtime - lpaintedtime;
+		linear_count = (shw->samples>>1) - lpos;
+		if (lpaintedtime + linear_count > endtime)
+			linear_count = endtime - lpaintedtime;
 
-		snd_linear_count <<= 1;
+		linear_count <<= 1;
 
 		// write a linear blast of samples
-		if (s_swapstereo.value)
-			Snd_WriteLinearBlastStereo16_SwapStereo (snd_p, voice_snd_p, snd_out, clientVolume, voiceVolume);
-		else
-			Snd_WriteLinearBlastStereo16 (snd_p, voice_snd_p, snd_out, clientVolume, voiceVolume);
+		SND_WriteClipped16(snd_p, voice_snd_p, snd_out, linear_count, client_vol, voice_vol, s_swapstereo.value);
 
 		if (Movie_IsCapturing()) {
-			Movie_TransferSound (snd_out, snd_linear_count);
+			Movie_TransferSound (snd_out, linear_count);
 		}
 
-		snd_p += snd_linear_count;
-		voice_snd_p += snd_linear_count;
-		lpaintedtime += (snd_linear_count>>1);
+		snd_p += linear_count;
+		voice_snd_p += linear_count;
+		lpaintedtime += (linear_count>>1);
 	}
 }
 
 static void S_TransferPaintBuffer(int endtime)
 {
 	DWORD *pbuf;
-	int *p;
+	float *p;
 	int out_idx;
 	int out_mask;
 	int count;
 	int step;
 	int val;
-	int snd_vol;
-	int voice_vol;
-	int *voice_p;
+	float snd_vol;
+	float voice_vol;
+	float *voice_p;
 
 	if (shw->samplebits == 16 && shw->numchannels == 2) {
 		S_TransferStereo16(endtime);
 		return;
 	}
 
-	p = (int *) paintbuffer;
-	voice_p = (int *) voice_paintbuffer;
+	p = (float *) paintbuffer;
+	voice_p = (float *) voice_paintbuffer;
 	count = (endtime - shw->paintedtime) * shw->numchannels;
 	out_mask = shw->samples - 1;
 	out_idx = shw->paintedtime * shw->numchannels & out_mask;
 	step = 3 - shw->numchannels;
-	snd_vol = (s_volume.value * S_VoipVoiceTransmitVolume()) * 256;
-	voice_vol = max(0, s_raw_volume.value * 256);
+	snd_vol = s_volume.value * S_VoipVoiceTransmitVolume();
+	voice_vol = max(0, s_raw_volume.value);
 
 	pbuf = (DWORD *)shw->buffer;
 
 	if (shw->samplebits == 16) {
 		short *out = (short *) pbuf;
 		while (count--) {
-			val = ((*p * snd_vol) + (*voice_p * voice_vol)) >> 8;
+			val = (int) ((*p * snd_vol) + (*voice_p * voice_vol));
 			p+= step;
 			voice_p += step;
 			if (val > 0x7fff)
@@ -152,7 +302,7 @@ static void S_TransferPaintBuffer(int endtime)
 	} else if (shw->samplebits == 8) {
 		unsigned char *out = (unsigned char *) pbuf;
 		while (count--) {
-			val = ((*p * snd_vol) + (*voice_p * voice_vol)) >> 8;
+			val = (int) ((*p * snd_vol) + (*voice_p * voice_vol));
 			p+= step;
 			voice_p += step;
 			if (val > 0x7fff)
@@ -174,55 +324,37 @@ CHANNEL MIXING
 
 static void SND_PaintChannelFrom8 (channel_t *ch, sfxcache_t *sc, int count)
 {
-	int data, i;
-	int *lscale, *rscale;
-	unsigned char *sfx;
-
 	if (ch->leftvol > 255)
 		ch->leftvol = 255;
 	if (ch->rightvol > 255)
 		ch->rightvol = 255;
 
-	lscale = snd_scaletable[ch->leftvol >> 3];
-	rscale = snd_scaletable[ch->rightvol >> 3];
-	sfx = (unsigned char *) ((signed char *)sc->data + ch->pos);
-
-	for (i = 0; i < count ;i++) {
-		data = sfx[i];
-		painttarget[i].left += lscale[data];
-		painttarget[i].right += rscale[data];
-	}
+	SND_MixFrom8(painttarget, (signed char *)sc->data + ch->pos, count, ch->leftvol, ch->rightvol);
 
 	ch->pos += count;
 }
 
 static void SND_PaintChannelFrom16 (channel_t *ch, sfxcache_t *sc, int count)
 {
-	int data, left, right, leftvol, rightvol, i;
-	signed short *sfx;
-
-	leftvol = ch->leftvol;
-	rightvol = ch->rightvol;
-	sfx = (signed short *)sc->data + ch->pos;
-
-	for (i = 0; i < count ;i++) {
-		data = sfx[i];
-		left = (data * leftvol) >> 8;
-		right = (data * rightvol) >> 8;
-		painttarget[i].left += left;
-		painttarget[i].right += right;
-	}
+	SND_MixFrom16(painttarget, (signed short *)sc->data + ch->pos, count, ch->leftvol / 256.0f, ch->rightvol / 256.0f);
 
 	ch->pos += count;
 }
 
-void SND_InitScaletable (void)
+// (Re)allocates the paint buffers, called while no audio device is open
+void SND_AllocPaintBuffer (void)
 {
-	int i, j;
+	int size = bound(PAINTBUFFER_SIZE_MIN, s_paintbuffersize.integer, PAINTBUFFER_SIZE_MAX);
+
+	if (size == paintbuffer_size) {
+		return;
+	}
 
-	for (i = 0 ; i < 32; i++)
-		for (j = 0; j < 256; j++)
-			snd_scaletable[i][j] = ((j < 128) ? j : j - 0xff) * i * 8;
+	Q_free(paintbuffer);
+	Q_free(voice_paintbuffer);
+	paintbuffer = Q_malloc(size * sizeof(portable_samplepair_t));
+	voice_paintbuffer = Q_malloc(size * sizeof(portable_samplepair_t));
+	paintbuffer_size = size;
 }
 
 void S_PaintChannels(int endtime)
@@ -236,8 +368,8 @@ void S_PaintChannels(int endtime)
 	while (shw->paintedtime < endtime) {
 		// if paintbuffer is smaller than DMA buffer
 		end = endtime;
-		if (endtime - shw->paintedtime > PAINTBUFFER_SIZE)
-			end = shw->paintedtime + PAINTBUFFER_SIZE;
+		if (endtime - shw->paintedtime > paintbuffer_size)
+			end = shw->paintedtime + paintbuffer_size;
 
 		// clear the paint buffer
 		memset (paintbuffer, 0, (end - shw->paintedtime) * sizeof(portable_samplepair_t));
@@ -266,7 +398,8 @@ void S_PaintChannels(int endtime)
 					continue;
 				}
 			}
-			sc = S_LoadSound (ch->sfx);
+			// loaded by the game thread before the channel was started
+			sc = (sfxcache_t *) ch->sfx->buf;
 			if (!sc)
 				continue;
 
@@ -281,6 +414,7 @@ void S_PaintChannels(int endtime)
 						SND_PaintChannelFrom8(ch, sc, count);
 					else
 						SND_PaintChannelFrom16(ch, sc, count);
+					painttarget += count;
 
 					ltime += count;
 				}
@@ -304,3 +438,87 @@ void S_PaintChannels(int endtime)
 		shw->paintedtime = end;
 	}
 }
+
+/*
+===============================================================================
+BENCHMARK
+===============================================================================
+*/
+
+#define SND_BENCHMARK_CHANNELS 512
+#define SND_BENCHMARK_SOURCE   (1 << 16)
+
+// Mixes 512 channels into one paint buffer with and without SIMD, and checks they agree.
+void S_MixerBenchmark_f(void)
+{
+	int iterations = Cmd_Argc() > 1 ? max(1, Q_atoi(Cmd_Argv(1))) : 100;
+	int frames = bound(PAINTBUFFER_SIZE_MIN, s_paintbuffersize.integer, PAINTBUFFER_SIZE_MAX);
+	portable_samplepair_t *paint, *voice;
+	short *source16, *out[2];
+	signed char *source8;
+	int offset[SND_BENCHMARK_CHANNELS], lvol[SND_BENCHMARK_CHANNELS], rvol[SND_BENCHMARK_CHANNELS];
+	int i, n, pass, max_diff = 0;
+	double time[2], start;
+
+	if (!SND_SIMDEnabled()) {
+		Com_Printf("s_mixer_benchmark: no SIMD path available%s\n", s_mixer_simd.integer ? "" : " (s_mixer_simd is 0)");
+		return;
+	}
+
+	paint = Q_malloc(frames * sizeof(*paint));
+	voice = Q_calloc(frames, sizeof(*voice));
+	source16 = Q_malloc(SND_BENCHMARK_SOURCE * sizeof(*source16));
+	source8 = Q_malloc(SND_BENCHMARK_SOURCE);
+	out[0] = Q_malloc(frames * 2 * sizeof(short));
+	out[1] = Q_malloc(frames * 2 * sizeof(short));
+
+	srand(1);
+	for (i = 0; i < SND_BENCHMARK_SOURCE; i++) {
+		source16[i] = (rand() & 0xFFFF) - 32768;
+		source8[i] = (rand() & 0xFF) - 128;
+	}
+	for (i = 0; i < SND_BENCHMARK_CHANNELS; i++) {
+		offset[i] = rand() % (SND_BENCHMARK_SOURCE - frames);
+		lvol[i] = rand() & 0xFF;
+		rvol[i] = rand() & 0xFF;
+	}
+
+	for (pass = 0; pass < 2; pass++) {
+		snd_simd_disabled = !pass;
+
+		start = Sys_DoubleTime();
+		for (n = 0; n < iterations; n++) {
+			memset(paint, 0, frames * sizeof(*paint));
+
+			// every fourth channel 8 bit, as sounds loaded with s_loadas8bit
+			for (i = 0; i < SND_BENCHMARK_CHANNELS; i++) {
+				if (i & 3) {
+					SND_MixFrom16(paint, source16 + offset[i], frames, lvol[i] / 256.0f, rvol[i] / 256.0f);
+				}
+				else {
+					SND_MixFrom8(paint, source8 + offset[i], frames, lvol[i] / 32.0f, rvol[i] / 32.0f);
+				}
+			}
+
+			SND_WriteClipped16((float *) paint, (float *) voice, out[pass], frames * 2, 1.0f / 16, 1.0f, false);
+		}
+		time[pass] = Sys_DoubleTime() - start;
+	}
+	snd_simd_disabled = false;
+
+	for (i = 0; i < frames * 2; i++) {
+		max_diff = max(max_diff, abs(out[0][i] - out[1][i]));
+	}
+
+	Com_Printf("%d iterations, %d channels, %d samples\n", iterations, SND_BENCHMARK_CHANNELS, frames);
+	Com_Printf("%-10s %11s %11s\n", "", "scalar", "simd");
+	Com_Printf("%-10s %8.2f ms %8.2f ms  %s\n", "mix", time[0] * 1000, time[1] * 1000, max_diff > 1 ? "MISMATCH" : "ok");
+	Com_Printf("%.3f ms of mixing per %d samples with SIMD\n", time[1] * 1000 / iterations, frames);
+
+	Q_free(paint);
+	Q_free(voice);
+	Q_free(source16);
+	Q_free(source8);
+	Q_free(out[0]);
+	Q_free(out[1]);
+}
@@ -53,9 +53,46 @@ static cvar_t cl_voip_demorecord = { "cl_voip_demorecord", "1" };
 static cvar_t cl_voip_showmeter = { "cl_voip_showmeter", "1" };                        // Show speech volume above the hud.  0 = hide, 1=when transmitting, 2=even when voice-activation not triggered
 static cvar_t cl_voip_showmeter_x = { "cl_voip_showmeter_x", "0" };                    // horizontal coordinate
 static cvar_t cl_voip_showmeter_y = { "cl_voip_showmeter_y", "0" };                    // vertical coordinate
+static cvar_t cl_voip_showmeter_speakers = { "cl_voip_showmeter_speakers", "0" };      // List who is talking with their decode time and buffered audio
+static cvar_t cl_voip_jitterbuffer = { "cl_voip_jitterbuffer", "60" };                 // Milliseconds a missing packet is waited for before it is considered lost
 
 static float voicevolumemod = 1; // voice volume modifier.
 
+// Speex runs on a worker thread. The main thread only moves data: captured audio
+// goes in and encoded packets come out for S_Voip_Transmit, received packets go
+// into the sender's jitter buffer and S_Voip_Update hands their decoded audio to
+// the mixer once per frame.
+
+#define VOIP_JITTER_PACKETS   8       // received packets held per speaker
+#define VOIP_PCM_SAMPLES      8192    // decoded samples per speaker waiting for the mixer
+#define VOIP_MAX_CONCEAL      8       // lost frames covered up by the decoder, longer gaps restart
+#define VOIP_OUT_PACKETS      8       // encoded packets waiting for S_Voip_Transmit
+#define VOIP_ENCODE_SAMPLES   2560    // captured samples encoded into one packet
+
+typedef struct voip_data_s {
+	unsigned char gen;
+	unsigned char seq;          // sequence of the first frame
+	int frames;
+	int bytes;
+	unsigned int received;      // SDL_GetTicks()
+	unsigned char data[1024];
+} voip_data_t;
+
+typedef struct voip_speaker_s {
+	voip_data_t packets[VOIP_JITTER_PACKETS];   // in arrival order
+	int packet_count;
+	short pcm[VOIP_PCM_SAMPLES];                // decoded, not given to the mixer yet
+	int pcm_count;
+	float decode_ms;                            // smoothed codec time per packet
+	qbool started;                              // decseq/decgen are valid
+} voip_speaker_t;
+
+static SDL_Thread *voip_thread;
+static SDL_mutex *voip_mutex;       // guards the speakers, the encoder input and output
+static SDL_cond *voip_cond;
+static qbool voip_signalled;
+static qbool voip_quit;
+
 float S_VoipVoiceTransmitVolume(void)
 {
 	return voicevolumemod;
@@ -78,19 +115,34 @@ static struct
 	unsigned char decgen[MAX_CLIENTS];	/*last generation. if it changes, we flush speex to reset packet loss*/
 	float decamp[MAX_CLIENTS];	/*amplify them by this*/
 	float lastspoke[MAX_CLIENTS];	/*time when they're no longer considered talking. if future, they're talking*/
+	voip_speaker_t *speakers;	/*jitter buffers, voip_mutex*/
+	unsigned int jitter_ms;	/*cl_voip_jitterbuffer for the worker*/
 
 	unsigned char capturebuf[32768]; /*pending data*/
 	unsigned int capturepos;/*amount of pending data*/
 	unsigned int encsequence;/*the outgoing sequence count*/
 	unsigned int generation;/*incremented whenever capture is restarted*/
 	qbool wantsend;	/*set if we're capturing data to send*/
-	float voiplevel;	/*your own voice level*/
-	unsigned int dumps;	/*trigger a new generation thing after a bit*/
-	unsigned int keeps;	/*for vad_delay*/
+	float voiplevel;	/*your own voice level, voip_mutex*/
+	unsigned int dumps;	/*trigger a new generation thing after a bit, voip_mutex*/
+	unsigned int keeps;	/*for vad_delay, voip_mutex*/
+
+	/*handed to the worker, voip_mutex*/
+	unsigned char encodebuf[32768];	/*whole frames waiting for the encoder*/
+	unsigned int encodepos;
+	qbool encode_reset;	/*start a new generation before encoding more*/
+	float micamp;
+	int vad_threshold;
+	float vad_delay;
+	int send;
+	voip_data_t outpackets[VOIP_OUT_PACKETS];	/*encoded, waiting to be sent*/
+	int outcount;
 
 	void *driverctx;	/*capture driver context*/
 } s_speex;
 
+static int S_Voip_Thread (void *unused);
+
 static qbool S_Speex_Init (void)
 {
 	int i;
@@ -124,6 +176,15 @@ static qbool S_Speex_Init (void)
 		s_speex.decoder[i] = speex_decoder_init (mode);
 		s_speex.decamp[i] = 1;
 	}
+	s_speex.speakers = Q_malloc (MAX_CLIENTS * sizeof (voip_speaker_t));
+
+	voip_mutex = SDL_CreateMutex ();
+	voip_cond = SDL_CreateCond ();
+	voip_signalled = voip_quit = false;
+	if (!(voip_thread = Sys_CreateThread (S_Voip_Thread, NULL))) {
+		Com_DPrintf ("voip: no worker thread, coding on the main thread\n");
+	}
+
 	s_speex.loaded = true;
 	return s_speex.loaded;
 }
@@ -221,103 +282,432 @@ static unsigned int S_CaptureDriverUpdate (void* driverContext, unsigned char* b
 	return 0;
 }
 
-typedef struct voip_data_s {
-	unsigned int sender;
-	unsigned char gen;
-	unsigned char seq;
-	int bytes;
-	unsigned char data[1024];
-} voip_data_t;
-
-// Called when data is received from server
-// TODO: store the voip data and then process in the main S_Update() call
-void S_Voip_Parse (void)
+// Wakes the worker, voip_mutex must be held
+static void S_Voip_Signal (void)
 {
-	unsigned int sender;
-	int bytes;
-	unsigned char data[1024], *start;
-	short decodebuf[1024];
-	unsigned int decodesamps, len, newseq, drops;
-	unsigned char seq, gen;
-	float amp = 1;
-	unsigned int i;
-
-	sender = MSG_ReadByte ();
-	gen = MSG_ReadByte ();
-	seq = MSG_ReadByte ();
-	bytes = MSG_ReadShort ();
+	voip_signalled = true;
+	SDL_CondSignal (voip_cond);
+}
 
-	if (bytes > sizeof (data) || !cl_voip_play.integer || !S_Speex_Init () || (gen & 0xf0)) {
-		Com_DPrintf ("skip data: %d\n", bytes);
-		MSG_ReadSkip (bytes);
-		return;
+// Picks the packet of a speaker to decode next, voip_mutex must be held.
+// Packets in sequence are taken as soon as they arrive. A gap is waited for
+// cl_voip_jitterbuffer milliseconds, or until the buffer is full, before the
+// decoder covers it up and moves on to the next packet.
+static qbool S_Voip_NextPacket (int sender, voip_data_t *packet, int *conceal)
+{
+	voip_speaker_t *sp = &s_speex.speakers[sender];
+	unsigned int now = SDL_GetTicks ();
+	int i, next = -1, nearest = -1, restart = -1, oldest = -1;
+	qbool expired;
+
+	for (i = 0; i < sp->packet_count; ) {
+		voip_data_t *p = &sp->packets[i];
+		signed char ahead = (signed char)(p->seq - s_speex.decseq[sender]);
+
+		if (sp->started && ((p->gen - s_speex.decgen[sender]) & 0x0f) >= 8) {
+			// late packet of a generation already left behind
+			memmove (p, p + 1, (--sp->packet_count - i) * sizeof (*p));
+			continue;
+		}
+		else if (!sp->started || p->gen != s_speex.decgen[sender]) {
+			if (restart < 0) {
+				restart = i;
+			}
+		}
+		else if (ahead < 0) {
+			// arrived after its frames were covered up
+			memmove (p, p + 1, (--sp->packet_count - i) * sizeof (*p));
+			continue;
+		}
+		else if (ahead == 0) {
+			next = i;
+		}
+		else if (nearest < 0 || ahead < (signed char)(sp->packets[nearest].seq - s_speex.decseq[sender])) {
+			nearest = i;
+		}
+		if (oldest < 0) {
+			oldest = i;
+		}
+		i++;
 	}
-	MSG_ReadData (data, bytes);
-
-	sender &= MAX_CLIENTS - 1;
-
-	amp = s_speex.decamp[sender];
 
-	decodesamps = 0;
-	newseq = 0;
-	drops = 0;
-	start = data;
+	expired = oldest >= 0 && (sp->packet_count == VOIP_JITTER_PACKETS || now - sp->packets[oldest].received >= s_speex.jitter_ms);
 
-	s_speex.lastspoke[sender] = cls.realtime + 0.5;
-	if (s_speex.decgen[sender] != gen) {
+	*conceal = 0;
+	if (next < 0 && nearest >= 0 && expired) {
+		next = nearest;
+		*conceal = (unsigned char)(sp->packets[next].seq - s_speex.decseq[sender]);
+		if (*conceal > VOIP_MAX_CONCEAL) {
+			*conceal = 0;
+			s_speex.decseq[sender] = sp->packets[next].seq;
+		}
+	}
+	if (next < 0 && restart >= 0 && (nearest < 0 || expired)) {
+		// new generation: flush speex to reset packet loss
+		next = restart;
 		speex_bits_reset (&s_speex.decbits[sender]);
-		s_speex.decgen[sender] = gen;
-		s_speex.decseq[sender] = seq;
+		s_speex.decgen[sender] = sp->packets[next].gen;
+		s_speex.decseq[sender] = sp->packets[next].seq;
+		sp->started = true;
+	}
+	if (next < 0) {
+		return false;
 	}
 
-	while (bytes > 0) {
-		if (decodesamps + s_speex.framesize > sizeof (decodebuf) / sizeof (decodebuf[0])) {
-			S_RawAudio (sender, (byte*)decodebuf, s_speex.samplerate, decodesamps, 1, 2);
-			decodesamps = 0;
-		}
+	*packet = sp->packets[next];
+	memmove (&sp->packets[next], &sp->packets[next + 1], (--sp->packet_count - next) * sizeof (*packet));
+	return true;
+}
+
+// Runs the decoder over a packet, after covering up 'conceal' lost frames
+static int S_Voip_DecodePacket (int sender, voip_data_t *packet, int conceal, short *decodebuf, int maxsamples)
+{
+	unsigned char *start = packet->data;
+	int bytes = packet->bytes;
+	int decodesamps = 0;
+	int len;
+	unsigned int i;
+	float amp = s_speex.decamp[sender];
 
-		if (s_speex.decseq[sender] != seq) {
+	while ((conceal > 0 || bytes > 0) && decodesamps + s_speex.framesize <= maxsamples) {
+		if (conceal > 0) {
 			speex_decode_int (s_speex.decoder[sender], NULL, decodebuf + decodesamps);
-			s_speex.decseq[sender]++;
-			drops++;
+			conceal--;
 		}
 		else {
 			bytes--;
 			len = *start++;
+			if (len > bytes) {
+				break;
+			}
 			speex_bits_read_from (&s_speex.decbits[sender], (char *)start, len);
 			bytes -= len;
 			start += len;
 			speex_decode_int (s_speex.decoder[sender], &s_speex.decbits[sender], decodebuf + decodesamps);
-			newseq++;
 		}
+		s_speex.decseq[sender]++;
+
 		if (amp != 1) {
 			for (i = decodesamps; i < decodesamps + s_speex.framesize; i++)
 				decodebuf[i] *= amp;
 		}
 		decodesamps += s_speex.framesize;
 	}
-	s_speex.decseq[sender] += newseq;
 
-	if (drops)
-		Con_DPrintf ("%i dropped audio frames\n", drops);
+	return decodesamps;
+}
+
+// Decodes the next packet of a speaker into its audio waiting for the mixer
+static qbool S_Voip_Decode (int sender)
+{
+	static short decodebuf[VOIP_PCM_SAMPLES];
+	voip_speaker_t *sp = &s_speex.speakers[sender];
+	voip_data_t packet;
+	int conceal, decodesamps;
+	Uint64 start;
+	float decode_ms;
+
+	SDL_LockMutex (voip_mutex);
+	if (!S_Voip_NextPacket (sender, &packet, &conceal)) {
+		SDL_UnlockMutex (voip_mutex);
+		return false;
+	}
+	SDL_UnlockMutex (voip_mutex);
+
+	start = SDL_GetPerformanceCounter ();
+	decodesamps = S_Voip_DecodePacket (sender, &packet, conceal, decodebuf, VOIP_PCM_SAMPLES);
+	decode_ms = (SDL_GetPerformanceCounter () - start) * 1000.0 / SDL_GetPerformanceFrequency ();
 
-	if (decodesamps > 0) {
-		S_RawAudio (sender, (byte*)decodebuf, s_speex.samplerate, decodesamps, 1, 2);
+	SDL_LockMutex (voip_mutex);
+	decodesamps = min (decodesamps, VOIP_PCM_SAMPLES - sp->pcm_count);
+	memcpy (sp->pcm + sp->pcm_count, decodebuf, decodesamps * sizeof (short));
+	sp->pcm_count += decodesamps;
+	sp->decode_ms = sp->decode_ms ? sp->decode_ms * 0.9f + decode_ms * 0.1f : decode_ms;
+	SDL_UnlockMutex (voip_mutex);
+
+	return true;
+}
+
+// Sets your own voice level, which the worker updates once it runs
+static void S_Voip_SetLevel (float level)
+{
+	if (voip_mutex) {
+		SDL_LockMutex (voip_mutex);
+	}
+	s_speex.voiplevel = level;
+	if (voip_mutex) {
+		SDL_UnlockMutex (voip_mutex);
 	}
 }
 
-// Called just prior to sending command to server
-void S_Voip_Transmit (unsigned char clc, sizebuf_t *buf)
+// Your own voice level, and whether the worker is dropping it as too quiet
+static float S_Voip_GetLevel (qbool *dumping)
 {
-	unsigned char outbuf[1024];
+	float level;
+
+	if (voip_mutex) {
+		SDL_LockMutex (voip_mutex);
+	}
+	level = s_speex.voiplevel;
+	if (dumping) {
+		*dumping = s_speex.dumps != 0;
+	}
+	if (voip_mutex) {
+		SDL_UnlockMutex (voip_mutex);
+	}
+
+	return level;
+}
+
+// Encodes captured audio handed over by S_Voip_Transmit into one packet
+static qbool S_Voip_Encode (void)
+{
+	static short capture[VOIP_ENCODE_SAMPLES];
+	voip_data_t packet;
+	unsigned char *outbuf = packet.data;
 	unsigned int outpos;//in bytes
 	unsigned int encpos;//in bytes
+	unsigned int capturepos;
 	short *start;
 	unsigned char initseq;//in frames
 	unsigned int i;
 	unsigned int samps;
 	float level, f;
-	float micamp = cl_voip_micamp.value;
+	float micamp;
+	int vad_threshold, send;
+	float vad_delay;
+
+	SDL_LockMutex (voip_mutex);
+	if (s_speex.encode_reset) {
+		s_speex.encode_reset = false;
+		s_speex.dumps = 0;
+		s_speex.generation++;
+		s_speex.encsequence = 0;
+		speex_bits_reset (&s_speex.encbits);
+	}
+	capturepos = min (s_speex.encodepos, sizeof (capture));
+	capturepos -= capturepos % (s_speex.framesize * 2);
+	if (!capturepos) {
+		SDL_UnlockMutex (voip_mutex);
+		return false;
+	}
+	memcpy (capture, s_speex.encodebuf, capturepos);
+	memmove (s_speex.encodebuf, s_speex.encodebuf + capturepos, s_speex.encodepos - capturepos);
+	s_speex.encodepos -= capturepos;
+	micamp = s_speex.micamp;
+	vad_threshold = s_speex.vad_threshold;
+	vad_delay = s_speex.vad_delay;
+	send = s_speex.send;
+	SDL_UnlockMutex (voip_mutex);
+
+	initseq = s_speex.encsequence;
+	level = 0;
+	samps = 0;
+	for (encpos = 0, outpos = 0; capturepos - encpos >= s_speex.framesize * 2 && sizeof (packet.data) - outpos > 64; s_speex.encsequence++) {
+		start = (short*)((unsigned char *)capture + encpos);
+
+		speex_preprocess_run (s_speex.preproc, start);
+
+		for (i = 0; i < s_speex.framesize; i++) {
+			f = start[i] * micamp;
+			start[i] = f;
+			f = (float)abs(start[i]);
+			level += f*f;
+		}
+		samps += s_speex.framesize;
+
+		speex_bits_reset (&s_speex.encbits);
+		speex_encode_int (s_speex.encoder, start, &s_speex.encbits);
+		outbuf[outpos] = speex_bits_write (&s_speex.encbits, (char *)outbuf + outpos + 1, sizeof (packet.data) - (outpos + 1));
+		outpos += 1 + outbuf[outpos];
+		encpos += s_speex.framesize * 2;
+	}
+
+	// the main thread reads the level for the meter and the speaking icon
+	SDL_LockMutex (voip_mutex);
+	if (samps) {
+		float nl = (3000 * level) / (32767.0f * 32767 * samps);
+
+		s_speex.voiplevel = (s_speex.voiplevel * 7 + nl) / 8;
+		if (s_speex.voiplevel < vad_threshold && !(send & 2)) {
+			/*try and dump it, it was too quiet, and they're not pressing +voip*/
+			if (s_speex.keeps > samps) {
+				/*but not instantly*/
+				s_speex.keeps -= samps;
+			}
+			else {
+				outpos = 0;
+				s_speex.dumps += samps;
+				s_speex.keeps = 0;
+			}
+		}
+		else {
+			s_speex.keeps = s_speex.samplerate * vad_delay;
+		}
+
+		if (outpos) {
+			if (s_speex.dumps > s_speex.samplerate / 4) {
+				s_speex.generation++;
+			}
+			s_speex.dumps = 0;
+		}
+	}
+
+	if (outpos) {
+		packet.gen = s_speex.generation & 0x0f; /*gonna leave that nibble clear here... in this version, the client will ignore packets with those bits set. can use them for codec or something*/
+		packet.seq = initseq;
+		packet.bytes = outpos;
+
+		if (s_speex.outcount < VOIP_OUT_PACKETS) {
+			s_speex.outpackets[s_speex.outcount++] = packet;
+		}
+	}
+	SDL_UnlockMutex (voip_mutex);
+
+	return true;
+}
+
+// One pass over everything the codec has to do, true if anything was done
+static qbool S_Voip_Work (void)
+{
+	qbool worked = S_Voip_Encode ();
+	int i;
+
+	for (i = 0; i < MAX_CLIENTS; i++) {
+		worked |= S_Voip_Decode (i);
+	}
+
+	return worked;
+}
+
+static int S_Voip_Thread (void *unused)
+{
+	SDL_LockMutex (voip_mutex);
+	while (!voip_quit) {
+		// wake up now and then to give up on lost packets
+		if (!voip_signalled) {
+			SDL_CondWaitTimeout (voip_cond, voip_mutex, 10);
+		}
+		voip_signalled = false;
+
+		SDL_UnlockMutex (voip_mutex);
+		while (S_Voip_Work ()) {
+		}
+		SDL_LockMutex (voip_mutex);
+	}
+	SDL_UnlockMutex (voip_mutex);
+
+	return 0;
+}
+
+// Called when data is received from server
+void S_Voip_Parse (void)
+{
+	unsigned int sender;
+	int bytes;
+	unsigned char seq, gen;
+	voip_speaker_t *sp;
+	voip_data_t *packet;
+	int i;
+
+	sender = MSG_ReadByte ();
+	gen = MSG_ReadByte ();
+	seq = MSG_ReadByte ();
+	bytes = MSG_ReadShort ();
+
+	if (bytes > sizeof (packet->data) || !cl_voip_play.integer || !S_Speex_Init () || (gen & 0xf0)) {
+		Com_DPrintf ("skip data: %d\n", bytes);
+		MSG_ReadSkip (bytes);
+		return;
+	}
+
+	sender &= MAX_CLIENTS - 1;
+	sp = &s_speex.speakers[sender];
+
+	s_speex.lastspoke[sender] = cls.realtime + 0.5;
+
+	SDL_LockMutex (voip_mutex);
+	if (sp->packet_count == VOIP_JITTER_PACKETS) {
+		SDL_UnlockMutex (voip_mutex);
+		Com_DPrintf ("voip: jitter buffer full, skip data: %d\n", bytes);
+		MSG_ReadSkip (bytes);
+		return;
+	}
+
+	packet = &sp->packets[sp->packet_count++];
+	packet->gen = gen;
+	packet->seq = seq;
+	packet->bytes = bytes;
+	packet->received = SDL_GetTicks ();
+	MSG_ReadData (packet->data, bytes);
+
+	for (i = 0, packet->frames = 0; i < bytes; i += 1 + packet->data[i]) {
+		packet->frames++;
+	}
+
+	s_speex.jitter_ms = max (0, cl_voip_jitterbuffer.integer);
+	S_Voip_Signal ();
+	SDL_UnlockMutex (voip_mutex);
+}
+
+// Called once per frame, gives decoded voices to the mixer
+void S_Voip_Update (void)
+{
+	static short pcm[VOIP_PCM_SAMPLES];
+	int i, samples;
+
+	if (!s_speex.loaded) {
+		return;
+	}
+
+	if (!voip_thread) {
+		while (S_Voip_Work ()) {
+		}
+	}
+
+	for (i = 0; i < MAX_CLIENTS; i++) {
+		voip_speaker_t *sp = &s_speex.speakers[i];
+
+		SDL_LockMutex (voip_mutex);
+		samples = sp->pcm_count;
+		memcpy (pcm, sp->pcm, samples * sizeof (short));
+		sp->pcm_count = 0;
+		SDL_UnlockMutex (voip_mutex);
+
+		if (samples > 0) {
+			S_RawAudio (i, (byte*)pcm, s_speex.samplerate, samples, 1, 2);
+		}
+	}
+}
+
+// Writes the packets the worker has encoded, as many as fit
+static void S_Voip_SendPackets (unsigned char clc, sizebuf_t *buf)
+{
+	voip_data_t *packet;
+	int i;
+
+	SDL_LockMutex (voip_mutex);
+	for (i = 0; i < s_speex.outcount; i++) {
+		packet = &s_speex.outpackets[i];
+		if (buf->maxsize - buf->cursize < packet->bytes + 5) {
+			break;
+		}
+
+		MSG_WriteByte (buf, clc);
+		MSG_WriteByte (buf, packet->gen);
+		MSG_WriteByte (buf, packet->seq);
+		MSG_WriteShort (buf, packet->bytes);
+		SZ_Write (buf, packet->data, packet->bytes);
+	}
+	memmove (s_speex.outpackets, s_speex.outpackets + i, (s_speex.outcount - i) * sizeof (*packet));
+	s_speex.outcount -= i;
+	SDL_UnlockMutex (voip_mutex);
+}
+
+// Called just prior to sending command to server
+void S_Voip_Transmit (unsigned char clc, sizebuf_t *buf)
+{
+	unsigned int bytes;
 	qbool voipsendenable = (cl_voip_play.integer && (cls.fteprotocolextensions2 & FTE_PEXT2_VOICECHAT));
 
 	if (!voipsendenable) {
@@ -328,7 +718,7 @@ void S_Voip_Transmit (unsigned char clc, sizebuf_t *buf)
 	voipsendenable = cl_voip_send.integer > 0;
 
 	if (!s_speex.driverctx) {
-		s_speex.voiplevel = -1;
+		S_Voip_SetLevel (-1);
 		/*only init the first time capturing is requested*/
 		if (!voipsendenable)
 			return;
@@ -354,10 +744,9 @@ void S_Voip_Transmit (unsigned char clc, sizebuf_t *buf)
 	else if (voipsendenable && !s_speex.wantsend) {
 		s_speex.wantsend = true;
 		if (!s_speex.capturepos) {	/*if we were actually still sending, it was probably only off for a single frame, in which case don't reset it*/
-			s_speex.dumps = 0;
-			s_speex.generation++;
-			s_speex.encsequence = 0;
-			speex_bits_reset (&s_speex.encbits);
+			SDL_LockMutex (voip_mutex);
+			s_speex.encode_reset = true;
+			SDL_UnlockMutex (voip_mutex);
 		}
 		else {
 			s_speex.capturepos += S_CaptureDriverUpdate (s_speex.driverctx, (unsigned char*)s_speex.capturebuf + s_speex.capturepos, 1, sizeof (s_speex.capturebuf) - s_speex.capturepos);
@@ -369,74 +758,36 @@ void S_Voip_Transmit (unsigned char clc, sizebuf_t *buf)
 
 	s_speex.capturepos += S_CaptureDriverUpdate (s_speex.driverctx, (unsigned char*)s_speex.capturebuf + s_speex.capturepos, s_speex.framesize * 2, sizeof (s_speex.capturebuf) - s_speex.capturepos);
 	if (!s_speex.wantsend && s_speex.capturepos < s_speex.framesize * 2) {
-		s_speex.voiplevel = -1;
+		S_Voip_SetLevel (-1);
 		s_speex.capturepos = 0;
 		voicevolumemod = 1;
+		S_Voip_SendPackets (clc, buf);
 		return;
 	}
 
-	initseq = s_speex.encsequence;
-	level = 0;
-	samps = 0;
-	for (encpos = 0, outpos = 0; s_speex.capturepos - encpos >= s_speex.framesize * 2 && sizeof (outbuf) - outpos > 64; s_speex.encsequence++) {
-		start = (short*)(s_speex.capturebuf + encpos);
-
-		speex_preprocess_run (s_speex.preproc, start);
-
-		for (i = 0; i < s_speex.framesize; i++) {
-			f = start[i] * micamp;
-			start[i] = f;
-			f = (float)abs(start[i]);
-			level += f*f;
-		}
-		samps += s_speex.framesize;
-
-		speex_bits_reset (&s_speex.encbits);
-		speex_encode_int (s_speex.encoder, start, &s_speex.encbits);
-		outbuf[outpos] = speex_bits_write (&s_speex.encbits, (char *)outbuf + outpos + 1, sizeof (outbuf) - (outpos + 1));
-		outpos += 1 + outbuf[outpos];
-		encpos += s_speex.framesize * 2;
-	}
-
-	if (samps) {
-		float nl = (3000 * level) / (32767.0f * 32767 * samps);
-
-		s_speex.voiplevel = (s_speex.voiplevel * 7 + nl) / 8;
-		if (s_speex.voiplevel < cl_voip_vad_threshhold.integer && !(cl_voip_send.integer & 2)) {
-			/*try and dump it, it was too quiet, and they're not pressing +voip*/
-			if (s_speex.keeps > samps) {
-				/*but not instantly*/
-				s_speex.keeps -= samps;
-			}
-			else {
-				outpos = 0;
-				s_speex.dumps += samps;
-				s_speex.keeps = 0;
-			}
-		}
-		else {
-			s_speex.keeps = s_speex.samplerate * cl_voip_vad_delay.value;
-		}
-
-		if (outpos) {
-			if (s_speex.dumps > s_speex.samplerate / 4) {
-				s_speex.generation++;
-			}
-			s_speex.dumps = 0;
+	/*hand whole frames to the encoder*/
+	bytes = s_speex.capturepos - s_speex.capturepos % (s_speex.framesize * 2);
+
+	SDL_LockMutex (voip_mutex);
+	bytes = min (bytes, sizeof (s_speex.encodebuf) - s_speex.encodepos);
+	memcpy (s_speex.encodebuf + s_speex.encodepos, s_speex.capturebuf, bytes);
+	s_speex.encodepos += bytes;
+	s_speex.micamp = cl_voip_micamp.value;
+	s_speex.vad_threshold = cl_voip_vad_threshhold.integer;
+	s_speex.vad_delay = cl_voip_vad_delay.value;
+	s_speex.send = cl_voip_send.integer;
+	S_Voip_Signal ();
+	SDL_UnlockMutex (voip_mutex);
+
+	memmove (s_speex.capturebuf, s_speex.capturebuf + bytes, s_speex.capturepos - bytes);
+	s_speex.capturepos -= bytes;
+
+	if (!voip_thread) {
+		while (S_Voip_Work ()) {
 		}
 	}
 
-	if (outpos && buf->maxsize - buf->cursize >= outpos + 4) {
-		MSG_WriteByte (buf, clc);
-		MSG_WriteByte (buf, (s_speex.generation & 0x0f)); /*gonna leave that nibble clear here... in this version, the client will ignore packets with those bits set. can use them for codec or something*/
-		MSG_WriteByte (buf, initseq);
-		MSG_WriteShort (buf, outpos);
-		SZ_Write (buf, outbuf, outpos);
-	}
-
-	/*remove sent data*/
-	memmove (s_speex.capturebuf, s_speex.capturebuf + encpos, s_speex.capturepos - encpos);
-	s_speex.capturepos -= encpos;
+	S_Voip_SendPackets (clc, buf);
 }
 
 // Called when VOIP playback is toggled - pass stop/start to server
@@ -484,6 +835,8 @@ void S_Voip_RegisterCvars (void)
 	Cvar_Register (&cl_voip_showmeter);
 	Cvar_Register (&cl_voip_showmeter_x);
 	Cvar_Register (&cl_voip_showmeter_y);
+	Cvar_Register (&cl_voip_showmeter_speakers);
+	Cvar_Register (&cl_voip_jitterbuffer);
 
 	Cmd_AddCommand ("+voip", S_Voip_Enable_f);
 	Cmd_AddCommand ("-voip", S_Voip_Disable_f);
@@ -492,18 +845,35 @@ void S_Voip_RegisterCvars (void)
 // Called after new serverdata received
 void S_Voip_MapChange (void)
 {
+	int i;
+
 	Cvar_ForceCallback (&cl_voip_play);
+
+	if (s_speex.loaded) {
+		// don't play what was said on the previous map
+		SDL_LockMutex (voip_mutex);
+		for (i = 0; i < MAX_CLIENTS; i++) {
+			s_speex.speakers[i].packet_count = 0;
+			s_speex.speakers[i].pcm_count = 0;
+		}
+		SDL_UnlockMutex (voip_mutex);
+	}
 }
 
 int S_Voip_Loudness(void)
 {
 	qbool ignorevad = cl_voip_showmeter.integer == 2;
+	qbool dumping;
+	float level;
 
-	if (s_speex.voiplevel > 100)
+	if (!cl_voip_showmeter.integer)
+		return -1;
+	level = S_Voip_GetLevel (&dumping);
+	if (level > 100)
 		return 100;
-	if (!s_speex.driverctx || (!ignorevad && s_speex.dumps))
+	if (!s_speex.driverctx || (!ignorevad && dumping))
 		return -1;
-	return s_speex.voiplevel;
+	return level;
 }
 
 qbool S_Voip_ShowMeter (int* x, int* y)
@@ -511,7 +881,31 @@ qbool S_Voip_ShowMeter (int* x, int* y)
 	*x = cl_voip_showmeter_x.integer + 10;
 	*y = cl_voip_showmeter_y.integer + vid.height - 8 - 10;
 
-	return cl_voip_showmeter.integer;
+	return cl_voip_showmeter.integer || cl_voip_showmeter_speakers.integer;
+}
+
+// Decode time and buffered audio of a player who is talking, for the meter
+qbool S_Voip_SpeakerStats (unsigned int plno, float *decode_ms, int *buffered_ms)
+{
+	voip_speaker_t *sp;
+	int i, samples;
+
+	if (!cl_voip_showmeter_speakers.integer || !s_speex.loaded || plno >= MAX_CLIENTS || s_speex.lastspoke[plno] <= cls.realtime) {
+		return false;
+	}
+
+	sp = &s_speex.speakers[plno];
+
+	SDL_LockMutex (voip_mutex);
+	samples = sp->pcm_count;
+	for (i = 0; i < sp->packet_count; i++) {
+		samples += sp->packets[i].frames * s_speex.framesize;
+	}
+	*decode_ms = sp->decode_ms;
+	SDL_UnlockMutex (voip_mutex);
+
+	*buffered_ms = samples * 1000 / s_speex.samplerate;
+	return true;
 }
 
 qbool S_Voip_Speaking(unsigned int plno)
@@ -521,7 +915,7 @@ qbool S_Voip_Speaking(unsigned int plno)
 	}
 
 	if (plno == cl.playernum) {
-		return s_speex.voiplevel >= cl_voip_vad_threshhold.integer || (cl_voip_send.integer & 2);
+		return S_Voip_GetLevel (NULL) >= cl_voip_vad_threshhold.integer || (cl_voip_send.integer & 2);
 	}
 
 	return plno < MAX_CLIENTS && s_speex.lastspoke[plno] > cls.realtime;
@@ -530,6 +924,51 @@ qbool S_Voip_Speaking(unsigned int plno)
 void S_Capture_Shutdown(void)
 {
 	S_CaptureDriverShutdown (s_speex.driverctx);
+	s_speex.driverctx = NULL;
+	s_speex.capturepos = 0;
+	s_speex.wantsend = false;
+	S_Voip_SetLevel (0);
+	voicevolumemod = 1;
+}
+
+// Stops the worker and frees speex
+void S_Voip_Shutdown(void)
+{
+	int i;
+
+	S_Capture_Shutdown();
+
+	if (!s_speex.inited) {
+		return;
+	}
+
+	if (voip_thread) {
+		SDL_LockMutex (voip_mutex);
+		voip_quit = true;
+		S_Voip_Signal ();
+		SDL_UnlockMutex (voip_mutex);
+
+		SDL_WaitThread (voip_thread, NULL);
+		voip_thread = NULL;
+	}
+	if (voip_mutex) {
+		SDL_DestroyCond (voip_cond);
+		SDL_DestroyMutex (voip_mutex);
+		voip_cond = NULL;
+		voip_mutex = NULL;
+	}
+
+	if (s_speex.loaded) {
+		speex_bits_destroy (&s_speex.encbits);
+		speex_encoder_destroy (s_speex.encoder);
+		speex_preprocess_state_destroy (s_speex.preproc);
+		for (i = 0; i < MAX_CLIENTS; i++) {
+			speex_bits_destroy (&s_speex.decbits[i]);
+			speex_decoder_destroy (s_speex.decoder[i]);
+		}
+	}
+	Q_free (s_speex.speakers);
+
 	memset(&s_speex, 0, sizeof(s_speex));
 }
 
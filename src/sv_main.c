@@ -252,6 +252,7 @@ void SV_Shutdown (char *finalmsg)
 #endif
 
 	// Shutdown game.
+	PR_SampleStop();
 	PR_GameShutDown();
 	PR_UnLoadProgs();
 
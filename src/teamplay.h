@@ -233,6 +233,7 @@ char *Macro_PointName (void);
 char *TP_LocationName (vec3_t location);
 void TP_LocFiles_Init(void);
 void TP_LocFiles_NewMap(void);
+void TP_LocFiles_FileChanged(const char *path);
 void TP_LocFiles_Shutdown(void);
 
 char *TP_ItemName(int item_flag);
@@ -26,11 +26,14 @@ $Id: teamplay.c,v 1.96 2007-10-23 08:51:02 himan Exp $
 
 static locdata_t *locdata = NULL;
 static int loc_count = 0;
+static char loc_filename[MAX_OSPATH];	// file the current locs came from, for hot reload
 
 static void TP_ClearLocs(void)
 {
 	locdata_t *node, *temp;
 
+	loc_filename[0] = 0;
+
 	for (node = locdata; node; node = temp) {
 		Q_free(node->name);
 		temp = node->next;
@@ -108,6 +111,7 @@ qbool TP_LoadLocFile(char *path, qbool quiet)
 	}
 
 	TP_ClearLocs();
+	strlcpy(loc_filename, locname, sizeof(loc_filename));
 
 	// Parse the whole file now
 	p = buf;
@@ -209,6 +213,20 @@ _endoffile:
 	return true;
 }
 
+// Called by the file watcher, reloads the locs if their file was rewritten
+void TP_LocFiles_FileChanged(const char *path)
+{
+	char locname[MAX_OSPATH];
+
+	if (!loc_filename[0] || strcasecmp(loc_filename, path)) {
+		return;
+	}
+
+	// skip "locs/", TP_LoadLocFile puts it back
+	strlcpy(locname, loc_filename + 5, sizeof(locname));
+	TP_LoadLocFile(locname, true);
+}
+
 void TP_LoadLocFile_f(void)
 {
 	if (Cmd_Argc() != 2) {
@@ -56,6 +56,10 @@ typedef struct {
 	int		(*GeneratePureCRC) (void *handle, int seed, int usepure);
 
 	vfsfile_t *(*OpenVFS)(void *handle, flocation_t *loc, char *mode);
+
+	qbool	(*PrefetchFile)(void *handle, flocation_t *loc, byte *buffer);
+		// reads the entire file through its own OS handle, so it can run
+		// on another thread while the main thread uses this path
 } searchpathfuncs_t;
 
 typedef struct searchpath_s
@@ -79,11 +83,13 @@ typedef struct {
 	vfsfile_t funcs; // <= must be at top/begining of struct
 
 	FILE *handle;
+	char osname[MAX_OSPATH];	// empty for temporary files
 
 } vfsosfile_t;
 
 vfsfile_t *FS_OpenTemp(void);
 vfsfile_t *VFSOS_Open(char *osname, char *mode);
+qbool VFSOS_StampFile(const char *osname, unsigned long offset, unsigned long length, char *stamp, int size);
 
 extern searchpathfuncs_t osfilefuncs;
 
@@ -106,6 +112,7 @@ extern searchpathfuncs_t packfilefuncs;
 //===========================
 #ifdef WITH_ZIP
 extern searchpathfuncs_t zipfilefuncs;
+void FSZIP_IndexSave(void);
 #endif // WITH_ZIP
 
 //=============================
@@ -23,6 +23,7 @@
 #include "common.h"
 #include "fs.h"
 #include "vfs.h"
+#include <sys/stat.h>
 
 //==================================
 // STDIO files (OS) - VFS Functions
@@ -77,6 +78,24 @@ static unsigned long VFSOS_GetSize (struct vfsfile_s *file)
 	return maxlen;
 }
 
+// The stamp of a file inside an OS file, as returned by VFS_STAMP
+qbool VFSOS_StampFile(const char *osname, unsigned long offset, unsigned long length, char *stamp, int size)
+{
+	struct stat buf;
+
+	if (!*osname || stat(osname, &buf) == -1)
+		return false;
+
+	snprintf(stamp, size, "%s|%lu|%lu|%ld", osname, offset, length, (long)buf.st_mtime);
+	return true;
+}
+
+static qbool VFSOS_Stamp(struct vfsfile_s *file, char *stamp, int size)
+{
+	vfsosfile_t *intfile = (vfsosfile_t*)file;
+	return VFSOS_StampFile(intfile->osname, 0, VFSOS_GetSize(file), stamp, size);
+}
+
 static void VFSOS_Close(vfsfile_t *file)
 {
 	vfsosfile_t *intfile = (vfsosfile_t*)file;
@@ -143,8 +162,10 @@ vfsfile_t *VFSOS_Open(char *osname, char *mode)
 	file->funcs.Tell       = VFSOS_Tell;
 	file->funcs.GetLen     = VFSOS_GetSize;
 	file->funcs.Close      = VFSOS_Close;
+	file->funcs.Stamp      = VFSOS_Stamp;
 
 	file->handle = f;
+	strlcpy(file->osname, osname, sizeof(file->osname));
 
 	return (vfsfile_t*)file;
 }
@@ -252,6 +273,21 @@ void FSOS_ReadFile(void *handle, flocation_t *loc, char *buffer)
 	fclose(f);
 }
 
+static qbool FSOS_PrefetchFile(void *handle, flocation_t *loc, byte *buffer)
+{
+	char diskname[MAX_OSPATH];
+	FILE *f;
+	int read;
+
+	snprintf(diskname, sizeof(diskname), "%s/%s", (char*)handle, loc->rawname);
+	if (!(f = fopen(diskname, "rb")))
+		return false;
+	read = (int)fread(buffer, 1, loc->len, f);
+	fclose(f);
+
+	return read == loc->len;
+}
+
 static int FSOS_EnumerateFiles (void *handle, char *match, int (*func)(char *, int, void *), void *parm)
 {
 	return Sys_EnumerateFiles(handle, match, func, parm);
@@ -266,5 +302,6 @@ searchpathfuncs_t osfilefuncs = {
 	FSOS_EnumerateFiles,
 	NULL,
 	NULL,
-	FSOS_OpenVFS
+	FSOS_OpenVFS,
+	FSOS_PrefetchFile
 };
@@ -134,6 +134,12 @@ static unsigned long VFSPAK_GetLen (struct vfsfile_s *vfs)
 	return vfsp->length;
 }
 
+static qbool VFSPAK_Stamp(struct vfsfile_s *vfs, char *stamp, int size)
+{
+	vfspack_t *vfsp = (vfspack_t*)vfs;
+	return VFSOS_StampFile(vfsp->parentpak->filename, vfsp->startpos, vfsp->length, stamp, size);
+}
+
 static void FSPAK_ClosePath(void *handle);
 static void VFSPAK_Close(vfsfile_t *vfs)
 {
@@ -167,6 +173,7 @@ static vfsfile_t *FSPAK_OpenVFS(void *handle, flocation_t *loc, char *mode)
 	vfsp->funcs.GetLen	      = VFSPAK_GetLen;
 	vfsp->funcs.Close	      = VFSPAK_Close;
 	vfsp->funcs.Flush         = NULL;
+	vfsp->funcs.Stamp         = VFSPAK_Stamp;
 	if (loc->search)
 		vfsp->funcs.copyprotected = loc->search->copyprotected;
 
@@ -273,6 +280,21 @@ static int FSPAK_EnumerateFiles (void *handle, char *match, int (*func)(char *,
 	return true;
 }
 
+static qbool FSPAK_PrefetchFile(void *handle, flocation_t *loc, byte *buffer)
+{
+	pack_t *pak = handle;
+	FILE *f;
+	int read = -1;
+
+	if (!(f = fopen(pak->filename, "rb")))
+		return false;
+	if (!fseek(f, loc->offset, SEEK_SET))
+		read = (int)fread(buffer, 1, loc->len, f);
+	fclose(f);
+
+	return read == loc->len;
+}
+
 /*
 =================
 FSPAK_LoadPackFile
@@ -365,5 +387,6 @@ searchpathfuncs_t packfilefuncs = {
 	FSPAK_EnumerateFiles,
 	FSPAK_LoadPackFile,
 	NULL,
-	FSPAK_OpenVFS
+	FSPAK_OpenVFS,
+	FSPAK_PrefetchFile
 };
@@ -25,6 +25,7 @@
 #include "common.h"
 #include "fs.h"
 #include "vfs.h"
+#include <sys/stat.h>
 
 //===========================
 // Unzip library interfacing
@@ -113,7 +114,7 @@ static void FSZIP_CreteFileFuncs(zlib_filefunc_def *funcs) {
 //==========================================
 typedef struct zipfile_s
 {
-	char filename[MAX_QPATH];
+	char filename[MAX_OSPATH];
 	unzFile handle;
 	int		numfiles;
 	packfile_t	*files;
@@ -131,10 +132,47 @@ typedef struct zipfile_s
 	int references;	//and a reference count
 } zipfile_t;
 
+// Large members are read straight from the archive instead of through unzip,
+// remembering the inflate state every ZIP_SPAN bytes (like zlib's zran.c) so a
+// seek only has to inflate from the nearest access point before it.
+#define ZIP_STREAM_MIN	(256 * 1024)	// smaller members stay with unzip
+#define ZIP_SPAN		(1024 * 1024)	// uncompressed bytes between access points
+#define ZIP_WINDOW		32768			// deflate history needed to resume
+#define ZIP_CHUNK		16384
+
+typedef struct zipaccess_s {
+	unsigned long out;		// position in the uncompressed data
+	unsigned long in;		// first whole byte of compressed data to read
+	int bits;				// unused bits of the byte before, or 0
+	byte window[ZIP_WINDOW];
+} zipaccess_t;
+
+typedef struct zipstream_s {
+	FILE *file;
+	unsigned long datapos;	// start of the member data in the archive
+	unsigned long complen;
+	qbool stored;			// not compressed, read directly
+
+	z_stream z;
+	unsigned long in;		// compressed bytes fed to inflate
+	unsigned long out;		// uncompressed bytes produced
+	qbool done;
+	byte input[ZIP_CHUNK];
+	byte window[ZIP_WINDOW];	// most recent output, circular
+	int window_pos;
+	int window_have;
+
+	zipaccess_t *points;
+	int numpoints;
+	int maxpoints;
+} zipstream_t;
+
 typedef struct {
 	vfsfile_t funcs;
 
 	vfsfile_t *defer;
+	zipstream_t *stream;
+	qbool stream_checked;
 
 	//in case we're forced away.
 	zipfile_t *parent;
@@ -172,6 +210,217 @@ static void VFSZIP_MakeActive(vfszip_t *vfsz)
 	vfsz->parent->currentfile = (vfsfile_t*)vfsz;
 }
 
+static void VFSZIP_StreamClose(zipstream_t *zs)
+{
+	if (!zs->stored)
+		inflateEnd(&zs->z);
+	fclose(zs->file);
+	Q_free(zs->points);
+	Q_free(zs);
+}
+
+// Sets up direct reading for a large member, returns false to keep using unzip.
+static qbool VFSZIP_StreamOpen(vfszip_t *vfsz)
+{
+	zipfile_t *zip = vfsz->parent;
+	unz_file_info info;
+	ZPOS64_T datapos;
+	zipstream_t *zs;
+	FILE *f;
+
+	vfsz->stream_checked = true;
+	if (vfsz->length < ZIP_STREAM_MIN)
+		return false;
+
+	if (zip->currentfile)
+	{
+		unzCloseCurrentFile(zip->handle);
+		zip->currentfile = NULL;
+	}
+
+	if (unzSetOffset(zip->handle, vfsz->startpos) != UNZ_OK
+		|| unzGetCurrentFileInfo(zip->handle, &info, NULL, 0, NULL, 0, NULL, 0) != UNZ_OK
+		|| (info.compression_method != 0 && info.compression_method != Z_DEFLATED)
+		|| unzOpenCurrentFile(zip->handle) != UNZ_OK)
+		return false;
+	datapos = unzGetCurrentFileZStreamPos64(zip->handle);
+	unzCloseCurrentFile(zip->handle);
+
+	// the archive may live inside another one, then unzip it is
+	if (!datapos || !(f = fopen(zip->filename, "rb")))
+		return false;
+
+	zs = Q_calloc(1, sizeof(*zs));
+	zs->file = f;
+	zs->datapos = (unsigned long)datapos;
+	zs->complen = info.compressed_size;
+	zs->stored = (info.compression_method == 0);
+	if (!zs->stored && inflateInit2(&zs->z, -MAX_WBITS) != Z_OK)
+	{
+		fclose(f);
+		Q_free(zs);
+		return false;
+	}
+
+	vfsz->stream = zs;
+	return true;
+}
+
+static void VFSZIP_StreamAddPoint(zipstream_t *zs)
+{
+	zipaccess_t *point;
+
+	if (zs->numpoints == zs->maxpoints)
+	{
+		zs->maxpoints = max(16, zs->maxpoints * 2);
+		zs->points = Q_realloc(zs->points, zs->maxpoints * sizeof(*zs->points));
+	}
+
+	point = &zs->points[zs->numpoints++];
+	point->out = zs->out;
+	point->in = zs->in - zs->z.avail_in;
+	point->bits = zs->z.data_type & 7;
+	// oldest byte first
+	memcpy(point->window, zs->window + zs->window_pos, ZIP_WINDOW - zs->window_pos);
+	memcpy(point->window + ZIP_WINDOW - zs->window_pos, zs->window, zs->window_pos);
+}
+
+// Last access point at or before pos, NULL for the start of the member
+static zipaccess_t *VFSZIP_StreamFindPoint(zipstream_t *zs, unsigned long pos)
+{
+	int low = 0, high = zs->numpoints, mid;
+
+	while (low < high)
+	{
+		mid = (low + high) / 2;
+		if (zs->points[mid].out <= pos)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low ? &zs->points[low - 1] : NULL;
+}
+
+static qbool VFSZIP_StreamRestart(zipstream_t *zs, zipaccess_t *point)
+{
+	int c;
+
+	inflateReset(&zs->z);
+	zs->z.avail_in = 0;
+	zs->done = false;
+	zs->window_pos = 0;
+
+	if (!point)
+	{
+		zs->in = zs->out = 0;
+		zs->window_have = 0;
+		return true;
+	}
+
+	zs->in = point->in;
+	zs->out = point->out;
+	if (point->bits)
+	{
+		if (fseek(zs->file, zs->datapos + point->in - 1, SEEK_SET) || (c = fgetc(zs->file)) == EOF)
+			return false;
+		inflatePrime(&zs->z, point->bits, c >> (8 - point->bits));
+	}
+	memcpy(zs->window, point->window, ZIP_WINDOW);
+	zs->window_have = (int)min(point->out, ZIP_WINDOW);
+	inflateSetDictionary(&zs->z, point->window, ZIP_WINDOW);
+
+	return true;
+}
+
+static int VFSZIP_StreamRead(vfszip_t *vfsz, byte *buffer, int bytestoread)
+{
+	zipstream_t *zs = vfsz->stream;
+	unsigned long pos = vfsz->pos, back;
+	zipaccess_t *point;
+	int copied = 0, chunk, start, ret;
+
+	bytestoread = (int)min((unsigned long)max(bytestoread, 0), vfsz->length - pos);
+
+	if (zs->stored)
+	{
+		if (bytestoread <= 0 || fseek(zs->file, zs->datapos + pos, SEEK_SET))
+			return 0;
+		copied = (int)fread(buffer, 1, bytestoread, zs->file);
+		vfsz->pos += copied;
+		return copied;
+	}
+
+	// start over from an access point if the data is behind the window,
+	// or if one lies between the current position and the data
+	point = VFSZIP_StreamFindPoint(zs, pos);
+	if (pos + zs->window_have < zs->out || (point && point->out > zs->out))
+	{
+		if (!VFSZIP_StreamRestart(zs, point))
+			return 0;
+	}
+
+	while (copied < bytestoread)
+	{
+		if (pos < zs->out)
+		{
+			back = zs->out - pos;
+			start = (zs->window_pos - (int)back + ZIP_WINDOW) % ZIP_WINDOW;
+			chunk = (int)min(back, (unsigned long)(bytestoread - copied));
+			chunk = min(chunk, ZIP_WINDOW - start);
+			memcpy(buffer + copied, zs->window + start, chunk);
+			copied += chunk;
+			pos += chunk;
+			continue;
+		}
+
+		if (zs->done)
+			break;
+
+		if (!zs->z.avail_in)
+		{
+			chunk = (int)min(zs->complen - zs->in, ZIP_CHUNK);
+			if (chunk <= 0 || fseek(zs->file, zs->datapos + zs->in, SEEK_SET)
+				|| (int)fread(zs->input, 1, chunk, zs->file) != chunk)
+				break;
+			zs->in += chunk;
+			zs->z.next_in = zs->input;
+			zs->z.avail_in = chunk;
+		}
+
+		if (zs->window_pos == ZIP_WINDOW)
+			zs->window_pos = 0;
+		zs->z.next_out = zs->window + zs->window_pos;
+		zs->z.avail_out = ZIP_WINDOW - zs->window_pos;
+		ret = inflate(&zs->z, Z_BLOCK);
+		if (ret != Z_OK && ret != Z_STREAM_END)
+		{
+			Com_DPrintf("VFSZIP_StreamRead: inflate failed (%d)\n", ret);
+			zs->done = true;
+			break;
+		}
+
+		chunk = ZIP_WINDOW - zs->window_pos - zs->z.avail_out;
+		zs->window_pos += chunk;
+		zs->window_have = min(zs->window_have + chunk, ZIP_WINDOW);
+		zs->out += chunk;
+
+		if (ret == Z_STREAM_END)
+		{
+			zs->done = true;
+		}
+		else if ((zs->z.data_type & 128) && !(zs->z.data_type & 64)
+			&& zs->out >= (zs->numpoints ? zs->points[zs->numpoints - 1].out : 0) + ZIP_SPAN)
+		{
+			// at a block boundary, far enough from the last point
+			VFSZIP_StreamAddPoint(zs);
+		}
+	}
+
+	vfsz->pos = pos;
+	return copied;
+}
+
 static int VFSZIP_ReadBytes (struct vfsfile_s *file, void *buffer, int bytestoread, vfserrno_t *err)
 {
 	int read;
@@ -180,6 +429,16 @@ static int VFSZIP_ReadBytes (struct vfsfile_s *file, void *buffer, int bytestore
 	if (vfsz->defer)
 		return VFS_READ(vfsz->defer, buffer, bytestoread, err);
 
+	if (!vfsz->stream_checked)
+		VFSZIP_StreamOpen(vfsz);
+	if (vfsz->stream)
+	{
+		read = VFSZIP_StreamRead(vfsz, buffer, bytestoread);
+		if (err)
+			*err = ((read || bytestoread <= 0) ? VFSERR_NONE : VFSERR_EOF);
+		return read;
+	}
+
 	VFSZIP_MakeActive(vfsz);
 	read = unzReadCurrentFile(vfsz->parent->handle, buffer, bytestoread);
 
@@ -204,6 +463,21 @@ static int VFSZIP_Seek (struct vfsfile_s *file, unsigned long pos, int whence)
 	if (vfsz->defer)
 		return VFS_SEEK(vfsz->defer, pos, whence);
 
+	if (!vfsz->stream_checked)
+		VFSZIP_StreamOpen(vfsz);
+	if (vfsz->stream)
+	{
+		// the actual work happens on the next read
+		if (whence == SEEK_CUR)
+			pos += vfsz->pos;
+		else if (whence == SEEK_END)
+			pos += vfsz->length;
+		if (pos > vfsz->length)
+			return -1;
+		vfsz->pos = pos;
+		return 0;
+	}
+
 	//This is *really* inefficient
 	if (vfsz->parent->currentfile == file)
 	{
@@ -268,6 +542,12 @@ static unsigned long VFSZIP_GetLen (struct vfsfile_s *file)
 	return vfsz->length;
 }
 
+static qbool VFSZIP_Stamp (struct vfsfile_s *file, char *stamp, int size)
+{
+	vfszip_t *vfsz = (vfszip_t*)file;
+	return VFSOS_StampFile(vfsz->parent->filename, vfsz->startpos, vfsz->length, stamp, size);
+}
+
 static void FSZIP_ClosePath(void *handle);
 static void VFSZIP_Close (struct vfsfile_s *file)
 {
@@ -278,6 +558,8 @@ static void VFSZIP_Close (struct vfsfile_s *file)
 
 	if (vfsz->defer)
 		VFS_CLOSE(vfsz->defer);
+	if (vfsz->stream)
+		VFSZIP_StreamClose(vfsz->stream);
 
 	FSZIP_ClosePath(vfsz->parent);
 	Q_free(vfsz);
@@ -306,6 +588,7 @@ static vfsfile_t *FSZIP_OpenVFS(void *handle, flocation_t *loc, char *mode)
 	vfsz->funcs.Tell       = VFSZIP_Tell;
 	vfsz->funcs.GetLen     = VFSZIP_GetLen;
 	vfsz->funcs.Close      = VFSZIP_Close;
+	vfsz->funcs.Stamp      = VFSZIP_Stamp;
 	if (loc->search)
 		vfsz->funcs.copyprotected = loc->search->copyprotected;
 
@@ -426,6 +709,24 @@ static void FSZIP_ReadFile(void *handle, flocation_t *loc, char *buffer)
 	return;
 }
 
+// Opens the archive again so the shared handle and its current file stay untouched
+static qbool FSZIP_PrefetchFile(void *handle, flocation_t *loc, byte *buffer)
+{
+	zipfile_t *zip = handle;
+	unzFile unz;
+	int read = -1;
+
+	if (!(unz = unzOpen(zip->filename)))
+		return false;
+
+	if (unzSetOffset(unz, zip->files[loc->index].filepos) == UNZ_OK && unzOpenCurrentFile(unz) == UNZ_OK) {
+		read = unzReadCurrentFile(unz, buffer, loc->len);
+		unzCloseCurrentFile(unz);
+	}
+	unzClose(unz);
+
+	return read == loc->len;
+}
 
 static int FSZIP_EnumerateFiles (void *handle, char *match, int (*func)(char *, int, void *), void *parm)
 {
@@ -444,6 +745,267 @@ static int FSZIP_EnumerateFiles (void *handle, char *match, int (*func)(char *,
 	return true;
 }
 
+//==========================================
+// ZIP directory index cache
+//==========================================
+// Listing a zip means walking its whole central directory through unzip.
+// The listings are kept in a single file in the home directory, keyed by
+// archive path, size and modification time, so unchanged archives can be
+// registered without walking their directory again.
+
+#define ZIPINDEX_MAGIC		(('X' << 24) + ('I' << 16) + ('Z' << 8) + 'Q')
+#define ZIPINDEX_VERSION	1
+#define ZIPINDEX_FILENAME	"zip_index_data"
+
+typedef struct zipindex_s {
+	char		path[MAX_OSPATH];
+	int			size;
+	int			mtime;
+	int			numfiles;
+	packfile_t	*files;
+	struct zipindex_s *next;
+} zipindex_t;
+
+static zipindex_t *zipindex;
+static hashtable_t *zipindex_hash;
+static qbool zipindex_loaded;
+static qbool zipindex_dirty;
+
+extern cvar_t fs_index_cache;
+
+static void FSZIP_IndexFilename(char *filename, int size)
+{
+	snprintf(filename, size, "%s/%s", *com_homedir ? com_homedir : com_basedir, ZIPINDEX_FILENAME);
+}
+
+static qbool FSZIP_IndexStat(const char *path, int *size, int *mtime)
+{
+	struct stat buf;
+
+	if (stat(path, &buf) == -1) {
+		return false;
+	}
+
+	*size = (int)buf.st_size;
+	*mtime = (int)buf.st_mtime;
+	return true;
+}
+
+static zipindex_t *FSZIP_IndexAdd(const char *path, int size, int mtime, int numfiles)
+{
+	zipindex_t *entry = Hash_Get(zipindex_hash, (char *)path);
+
+	if (entry) {
+		Q_free(entry->files);
+	}
+	else {
+		entry = Q_calloc(1, sizeof(*entry));
+		strlcpy(entry->path, path, sizeof(entry->path));
+		entry->next = zipindex;
+		zipindex = entry;
+		Hash_Add(zipindex_hash, entry->path, entry);
+	}
+
+	entry->size = size;
+	entry->mtime = mtime;
+	entry->numfiles = numfiles;
+	entry->files = Q_malloc(max(numfiles, 1) * sizeof(packfile_t));
+	return entry;
+}
+
+// Reads the whole index file in one go and parses it into entries.
+static void FSZIP_IndexLoad(void)
+{
+	char filename[MAX_OSPATH];
+	byte *data, *p, *end;
+	FILE *f;
+	long len;
+	int i, count;
+
+	zipindex_loaded = true;
+	zipindex_hash = Hash_InitTable(256);
+
+	FSZIP_IndexFilename(filename, sizeof(filename));
+	if (!(f = fopen(filename, "rb"))) {
+		return;
+	}
+
+	fseek(f, 0, SEEK_END);
+	len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	if (len < 12) {
+		fclose(f);
+		return;
+	}
+
+	data = Q_malloc(len);
+	if (fread(data, 1, len, f) != (size_t)len) {
+		fclose(f);
+		Q_free(data);
+		return;
+	}
+	fclose(f);
+
+	p = data;
+	end = data + len;
+
+	if (BuffLittleLong(p) != ZIPINDEX_MAGIC || BuffLittleLong(p + 4) != ZIPINDEX_VERSION) {
+		Q_free(data);
+		return;
+	}
+	count = BuffLittleLong(p + 8);
+	p += 12;
+
+	for (i = 0; i < count; i++) {
+		zipindex_t *entry;
+		int j, pathlen, size, mtime, numfiles;
+		char path[MAX_OSPATH];
+
+		if (end - p < 4 || (pathlen = BuffLittleLong(p)) <= 0 || pathlen >= (int)sizeof(path) || end - p < 4 + pathlen + 12) {
+			break;
+		}
+		memcpy(path, p + 4, pathlen);
+		path[pathlen] = 0;
+		p += 4 + pathlen;
+
+		size = BuffLittleLong(p);
+		mtime = BuffLittleLong(p + 4);
+		numfiles = BuffLittleLong(p + 8);
+		p += 12;
+
+		// every listed file takes at least a length byte, position and size
+		if (numfiles < 0 || numfiles > (end - p) / 9) {
+			break;
+		}
+
+		entry = FSZIP_IndexAdd(path, size, mtime, numfiles);
+		for (j = 0; j < numfiles; j++) {
+			int namelen = *p;
+
+			if (namelen >= MAX_QPATH || end - p < 1 + namelen + 8) {
+				break;
+			}
+			memcpy(entry->files[j].name, p + 1, namelen);
+			entry->files[j].name[namelen] = 0;
+			p += 1 + namelen;
+			entry->files[j].filepos = BuffLittleLong(p);
+			entry->files[j].filelen = BuffLittleLong(p + 4);
+			p += 8;
+		}
+
+		if (j != numfiles) {
+			// truncated file, forget the partial entry
+			entry->size = -1;
+			break;
+		}
+	}
+
+	Q_free(data);
+}
+
+static void FSZIP_IndexWriteLong(FILE *f, int value)
+{
+	value = LittleLong(value);
+	fwrite(&value, 4, 1, f);
+}
+
+void FSZIP_IndexSave(void)
+{
+	char filename[MAX_OSPATH];
+	zipindex_t *entry;
+	FILE *f;
+	int count = 0;
+
+	if (!zipindex_dirty) {
+		return;
+	}
+	zipindex_dirty = false;
+
+	// entries of archives that are gone are dropped here
+	for (entry = zipindex; entry; entry = entry->next) {
+		int size, mtime;
+
+		if (FSZIP_IndexStat(entry->path, &size, &mtime) && size == entry->size && mtime == entry->mtime) {
+			count++;
+		}
+		else {
+			entry->size = -1;
+		}
+	}
+
+	FSZIP_IndexFilename(filename, sizeof(filename));
+	if (!(f = fopen(filename, "wb"))) {
+		FS_CreatePath(filename);
+		if (!(f = fopen(filename, "wb"))) {
+			Com_DPrintf("Couldn't write %s\n", filename);
+			return;
+		}
+	}
+
+	FSZIP_IndexWriteLong(f, ZIPINDEX_MAGIC);
+	FSZIP_IndexWriteLong(f, ZIPINDEX_VERSION);
+	FSZIP_IndexWriteLong(f, count);
+
+	for (entry = zipindex; entry; entry = entry->next) {
+		int i, pathlen = strlen(entry->path);
+
+		if (entry->size == -1) {
+			continue;
+		}
+
+		FSZIP_IndexWriteLong(f, pathlen);
+		fwrite(entry->path, 1, pathlen, f);
+		FSZIP_IndexWriteLong(f, entry->size);
+		FSZIP_IndexWriteLong(f, entry->mtime);
+		FSZIP_IndexWriteLong(f, entry->numfiles);
+		for (i = 0; i < entry->numfiles; i++) {
+			byte namelen = (byte)strlen(entry->files[i].name);
+
+			fwrite(&namelen, 1, 1, f);
+			fwrite(entry->files[i].name, 1, namelen, f);
+			FSZIP_IndexWriteLong(f, entry->files[i].filepos);
+			FSZIP_IndexWriteLong(f, entry->files[i].filelen);
+		}
+	}
+
+	fclose(f);
+}
+
+// Returns a copy of the cached listing for the archive, or NULL when the
+// archive is not indexed or has changed since.
+static packfile_t *FSZIP_IndexLookup(const char *path, int size, int mtime, int *numfiles)
+{
+	zipindex_t *entry;
+	packfile_t *files;
+
+	if (!zipindex_loaded) {
+		FSZIP_IndexLoad();
+	}
+
+	entry = Hash_Get(zipindex_hash, (char *)path);
+	if (!entry || entry->size != size || entry->mtime != mtime) {
+		return NULL;
+	}
+
+	files = Q_malloc(max(entry->numfiles, 1) * sizeof(packfile_t));
+	memcpy(files, entry->files, entry->numfiles * sizeof(packfile_t));
+	*numfiles = entry->numfiles;
+	return files;
+}
+
+static void FSZIP_IndexStore(const char *path, int size, int mtime, const packfile_t *files, int numfiles)
+{
+	zipindex_t *entry;
+
+	if (!zipindex_loaded) {
+		FSZIP_IndexLoad();
+	}
+
+	entry = FSZIP_IndexAdd(path, size, mtime, numfiles);
+	memcpy(entry->files, files, numfiles * sizeof(packfile_t));
+	zipindex_dirty = true;
+}
+
 /*
 =================
 COM_LoadZipFile
@@ -462,6 +1024,8 @@ static void *FSZIP_LoadZipFile(vfsfile_t *packhandle, const char *desc)
 	packfile_t		*newfiles;
 	zlib_filefunc_def *funcs = NULL;
 	unz_global_info info;
+	int size, mtime;
+	qbool use_index;
 	
 	zip   = (zipfile_t *) Q_calloc(1, sizeof(*zip));
 	strlcpy (zip->filename, desc, sizeof (zip->filename));
@@ -472,6 +1036,17 @@ static void *FSZIP_LoadZipFile(vfsfile_t *packhandle, const char *desc)
 
 	if (unzGetGlobalInfo(zip->handle, &info) != UNZ_OK) goto fail;
 
+	// Archives on disk may have been listed before
+	use_index = fs_index_cache.integer && FSZIP_IndexStat(desc, &size, &mtime);
+	if (use_index && (zip->files = FSZIP_IndexLookup(desc, size, mtime, &zip->numfiles)) != NULL) {
+		if (zip->numfiles == (int)info.number_entry) {
+			zip->references = 1;
+			zip->currentfile = NULL;
+			return zip;
+		}
+		Q_free(zip->files);
+	}
+
 	// Get the number of zip files
 	zip->numfiles = info.number_entry;
 
@@ -493,6 +1068,10 @@ static void *FSZIP_LoadZipFile(vfsfile_t *packhandle, const char *desc)
 		}
 
 	}
+
+	if (use_index) {
+		FSZIP_IndexStore(desc, size, mtime, zip->files, zip->numfiles);
+	}
 	
 	zip->references = 1;
 	zip->currentfile = NULL;
@@ -547,7 +1126,8 @@ searchpathfuncs_t zipfilefuncs = {
 	FSZIP_EnumerateFiles,
 	FSZIP_LoadZipFile,
 	FSZIP_GeneratePureCRC,
-	FSZIP_OpenVFS
+	FSZIP_OpenVFS,
+	FSZIP_PrefetchFile
 };
 
 #endif // WITH_ZIP
@@ -1443,6 +1443,9 @@ intptr_t QDECL VM_Call( vm_t *vm, int nargs, int callnum, ... )
 	}
 #endif
 
+	if ( !vm->callLevel ) {
+		pr_sample_pending = 0; // the tick came while the engine was running
+	}
 	++vm->callLevel;
 	// if we have a dll loaded, call it directly
 	if ( vm->entryPoint ) 
@@ -1513,6 +1516,8 @@ static int QDECL VM_ProfileSort( const void *a, const void *b ) {
 ==============
 VM_VmProfile_f
 
+vmprofile [on|off] - "on" makes the interpreter count which opcodes follow
+each other, plain vmprofile prints the hottest pairs
 ==============
 */
 void VM_VmProfile_f( void ) {
@@ -1521,6 +1526,18 @@ void VM_VmProfile_f( void ) {
 	int			i;
 	double		total;
 
+	if ( Cmd_Argc() > 1 ) {
+		if ( !strcasecmp( Cmd_Argv( 1 ), "on" ) ) {
+			VM_ProfileOpPairs( true );
+			Con_Printf( "Counting opcode pairs of interpreted VMs.\n" );
+		} else if ( !strcasecmp( Cmd_Argv( 1 ), "off" ) ) {
+			VM_ProfileOpPairs( false );
+		} else {
+			Con_Printf( "Usage: %s [on|off]\n", Cmd_Argv( 0 ) );
+		}
+		return;
+	}
+
     vm = &vmTable[VM_GAME];
 
 	if ( !vm->name ) {
@@ -1531,6 +1548,10 @@ void VM_VmProfile_f( void ) {
 		return;
 	}
 
+	if ( !vm->compiled ) {
+		VM_PrintOpPairs( 20 );
+	}
+
 	if ( !vm->numSymbols ) {
 		return;
 	}
@@ -1595,13 +1616,31 @@ void VM_VmInfo_f( void ) {
 ===============
 VM_LogSyscalls
 
-Insert calls to this while debugging the vm compiler
+Called after each syscall while vm_logSyscalls is set. Adds up the calls and
+the time spent in each syscall, which includes any VM_Call made from inside
+it. With VM_LOG_SYSCALLS_FILE every call also goes to syscalls.log.
 ===============
 */
-void VM_LogSyscalls(int *args) {
-#if 1
+int		vm_logSyscalls;
+
+#define	MAX_VM_SYSCALLS	512
+
+static int		vm_syscallCount[ MAX_VM_SYSCALLS ];
+static double	vm_syscallTime[ MAX_VM_SYSCALLS ];
+
+void VM_LogSyscalls( intptr_t *args, double time ) {
 	static	int		callnum;
 	static	FILE	*f;
+	const char		*name;
+
+	if ( (uintptr_t)args[0] < MAX_VM_SYSCALLS ) {
+		vm_syscallCount[ args[0] ]++;
+		vm_syscallTime[ args[0] ] += time;
+	}
+
+	if ( !( vm_logSyscalls & VM_LOG_SYSCALLS_FILE ) ) {
+		return;
+	}
 
 	if (!f) {
 		f = fopen("syscalls.log", "w");
@@ -1610,8 +1649,78 @@ void VM_LogSyscalls(int *args) {
 		}
 	}
 	callnum++;
-	fprintf(f, "%i: %p (%i) = %i %i %i %i\n", callnum, (void*)(args - (int *)currentVM->dataBase),
-		args[0], args[1], args[2], args[3], args[4]);
-#endif
+	name = PR2_SyscallName( args[0] );
+	fprintf(f, "%i: %s (%i) = %i %i %i %i, %.1f us\n", callnum, name ? name : "?",
+		(int)args[0], (int)args[1], (int)args[2], (int)args[3], (int)args[4], time * 1000000.0);
+}
+
+static int QDECL VM_SyscallSort( const void *a, const void *b ) {
+	double	ta, tb;
+
+	ta = vm_syscallTime[ *(const int *)a ];
+	tb = vm_syscallTime[ *(const int *)b ];
+
+	if ( ta < tb ) {
+		return 1;
+	}
+	if ( ta > tb ) {
+		return -1;
+	}
+	return 0;
+}
+
+/*
+==============
+VM_VmSyscalls_f
+
+vmsyscalls [on|log|off|clear] - "on" counts the calls and time of each game
+syscall, "log" also writes them to syscalls.log, plain vmsyscalls prints the
+counts, most expensive first
+==============
+*/
+void VM_VmSyscalls_f( void ) {
+	int		sorted[ MAX_VM_SYSCALLS ];
+	int		i, count;
+	double	total;
+	const char	*name;
+
+	if ( Cmd_Argc() > 1 ) {
+		if ( !strcasecmp( Cmd_Argv( 1 ), "on" ) ) {
+			vm_logSyscalls = VM_LOG_SYSCALLS_COUNT;
+		} else if ( !strcasecmp( Cmd_Argv( 1 ), "log" ) ) {
+			vm_logSyscalls = VM_LOG_SYSCALLS_COUNT | VM_LOG_SYSCALLS_FILE;
+		} else if ( !strcasecmp( Cmd_Argv( 1 ), "off" ) ) {
+			vm_logSyscalls = 0;
+		} else if ( !strcasecmp( Cmd_Argv( 1 ), "clear" ) ) {
+			memset( vm_syscallCount, 0, sizeof( vm_syscallCount ) );
+			memset( vm_syscallTime, 0, sizeof( vm_syscallTime ) );
+		} else {
+			Con_Printf( "Usage: %s [on|log|off|clear]\n", Cmd_Argv( 0 ) );
+		}
+		return;
+	}
+
+	total = 0;
+	for ( i = count = 0; i < MAX_VM_SYSCALLS; i++ ) {
+		if ( vm_syscallCount[ i ] ) {
+			sorted[ count++ ] = i;
+			total += vm_syscallTime[ i ];
+		}
+	}
+
+	if ( !count ) {
+		Con_Printf( "No syscalls counted%s.\n", vm_logSyscalls ? " yet" : ", use \"vmsyscalls on\"" );
+		return;
+	}
+
+	qsort( sorted, count, sizeof( sorted[0] ), VM_SyscallSort );
+
+	Con_Printf( "    calls   total ms  us/call name\n" );
+	for ( i = 0; i < count; i++ ) {
+		name = PR2_SyscallName( sorted[ i ] );
+		Con_Printf( "%9i %10.2f %8.2f %s\n", vm_syscallCount[ sorted[ i ] ], vm_syscallTime[ sorted[ i ] ] * 1000.0,
+			vm_syscallTime[ sorted[ i ] ] * 1000000.0 / vm_syscallCount[ sorted[ i ] ], name ? name : va( "%i", sorted[ i ] ) );
+	}
+	Con_Printf( "          %10.2f total\n", total * 1000.0 );
 }
 #endif				/* USE_PR2 */
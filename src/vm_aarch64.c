@@ -0,0 +1,1472 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ *
+ */
+
+#ifdef USE_PR2
+#ifdef SERVERONLY
+#include "qwsvdef.h"
+#else
+#include "quakedef.h"
+#include "pr_comp.h"
+#include "g_public.h"
+#endif
+#include "vm_local.h"
+
+#if idarm64
+#include <sys/mman.h> // for PROT_ stuff
+
+// first pass measures the code with long conditional jumps, if everything
+// fits into the +/-1MB range of b.cond the second pass uses short ones
+#define NUM_PASSES 2
+#define MAX_SHORT_JUMP ( 1 << 20 )
+
+static void *VM_Alloc_Compiled( vm_t *vm, int codeLength, int tableLength );
+static void VM_Destroy_Compiled( vm_t *vm );
+
+/*
+  -------------
+  x0-x4  scratch
+  x16    scratch (call targets)
+  x17    scratch (immediates which do not fit into the instruction)
+  x19*   dataBase
+  x20*   programStack
+  x21*   opStack
+  x22*   current proc stack ( dataBase + programStack )
+  x23*   instructionPointers
+  x24*   dataMask
+  x25*   vm
+  x26*   stackBottom
+  x27*   opStackTop
+  x30    link register, saved on the native stack by OP_ENTER
+  s0-s1  scratch
+
+  (*) callee-saved by AAPCS64, so they survive system calls without spilling
+
+  Data segment layout and jump/call opStack rules are the same as in vm_x86.c.
+
+  The opStack lives in memory. A push is a single pre-indexed store, and if
+  the next instruction pops the value again the store is rewound and the
+  value is taken from the register it was computed in.
+*/
+
+#define R0			0
+#define R1			1
+#define R2			2
+#define R3			3
+#define R4			4
+#define R16			16
+#define R17			17
+#define R_DATABASE	19
+#define R_PSTACK	20
+#define R_OPSTACK	21
+#define R_PROCBASE	22
+#define R_INSTRPTRS	23
+#define R_DATAMASK	24
+#define R_VM		25
+#define R_STACKBTM	26
+#define R_OPSTACKTOP 27
+#define R_FP		29
+#define R_LR		30
+#define R_SP		31
+#define R_ZR		31
+
+#define S0			0
+#define S1			1
+
+#define REWIND(N) { compiledOfs -= (N); instructionOffsets[ ip-1 ] = compiledOfs; };
+
+typedef enum
+{
+	COND_EQ = 0,
+	COND_NE,
+	COND_HS,
+	COND_LO,
+	COND_MI,
+	COND_PL,
+	COND_VS,
+	COND_VC,
+	COND_HI,
+	COND_LS,
+	COND_GE,
+	COND_LT,
+	COND_GT,
+	COND_LE,
+	COND_AL
+} cond_t;
+
+// load/store opcodes in their unscaled (ldur/stur) form, bits 31:30 hold log2 of the access size
+#define LDR32		0xB8400000U
+#define STR32		0xB8000000U
+#define LDRH		0x78400000U
+#define LDRSH		0x78C00000U
+#define STRH		0x78000000U
+#define LDRB		0x38400000U
+#define LDRSB		0x38C00000U
+#define STRB		0x38000000U
+#define LDRSW		0xB8800000U
+#define LDR64		0xF8400000U
+#define STR64		0xF8000000U
+#define LDRS		0xBC400000U
+#define STRS		0xBC000000U
+
+#define LDST_UIMM		0x01000000	// unsigned scaled 12-bit offset
+#define LDST_REG		0x00200800	// register offset
+#define LDST_PRE		0x00000C00	// pre-indexed 9-bit offset
+#define LDST_POST		0x00000400	// post-indexed 9-bit offset
+#define EXTEND_UXTW		0x00004000
+#define EXTEND_SXTW		0x0000C000
+
+typedef enum
+{
+	LAST_COMMAND_NONE = 0,
+	LAST_COMMAND_PUSH_INT,
+	LAST_COMMAND_PUSH_FLOAT
+} ELastCommand;
+
+typedef enum
+{
+	FUNC_ENTR = 0,
+	FUNC_CALL,
+	FUNC_SYSC,
+	FUNC_PSOF,
+	FUNC_OSOF,
+	FUNC_BADJ,
+	FUNC_ERRJ,
+	FUNC_DATA,
+	FUNC_LAST
+} funcarm64_t;
+
+// macro opcode sequences
+typedef enum {
+	MOP_UNDEF = OP_MAX,
+	MOP_IGNORE4,
+	MOP_ADD4,
+	MOP_SUB4,
+	MOP_BAND4,
+	MOP_BOR4,
+} macro_op_t;
+
+static	byte     *code;
+static	int      compiledOfs;
+static	int      *instructionOffsets;
+static	intptr_t *instructionPointers;
+
+static  instruction_t *inst = NULL;
+static  instruction_t *ci;
+static  instruction_t *ni;
+
+static	int	ip, pass;
+static	qbool	shortJumps;
+static	qbool	jumpOutOfRange;
+
+static	ELastCommand	LastCommand;
+static	int	lastPushReg;
+
+static int funcOffset[FUNC_LAST];
+
+static void ErrJump( void )
+{
+	SV_Error( "program tried to execute code outside VM" );
+}
+
+
+static void BadJump( void )
+{
+	SV_Error( "program tried to execute code at bad location inside VM" );
+}
+
+
+static void BadStack( void )
+{
+	SV_Error( "program tried to overflow program stack" );
+}
+
+
+static void BadOpStack( void )
+{
+	SV_Error( "program tried to overflow opcode stack" );
+}
+
+
+static void BadData( void )
+{
+	SV_Error( "program tried to read/write out of data segment" );
+}
+
+
+// same range clamping as OP_BLOCK_COPY in the interpreter
+static void BlockCopy( byte *dataBase, unsigned int dataMask, unsigned int dest, unsigned int src, int count )
+{
+	int srci, desti;
+
+	srci = src & dataMask;
+	desti = dest & dataMask;
+	count = ((srci + count) & dataMask) - srci;
+	count = ((desti + count) & dataMask) - desti;
+
+	memcpy( dataBase + desti, dataBase + srci, count );
+}
+
+static void VM_FreeBuffers( void )
+{
+	// should be freed in reversed allocation order
+	Q_free( instructionOffsets );
+	Q_free( inst );
+}
+
+
+static void Emit4( uint32_t v )
+{
+	if ( code )
+	{
+		// instructions are always little-endian
+		code[ compiledOfs + 0 ] = v & 255;
+		code[ compiledOfs + 1 ] = ( v >> 8 ) & 255;
+		code[ compiledOfs + 2 ] = ( v >> 16 ) & 255;
+		code[ compiledOfs + 3 ] = ( v >> 24 ) & 255;
+	}
+	compiledOfs += 4;
+
+	LastCommand = LAST_COMMAND_NONE;
+}
+
+
+static void Patch4( int offset, uint32_t v )
+{
+	if ( code )
+	{
+		code[ offset + 0 ] = v & 255;
+		code[ offset + 1 ] = ( v >> 8 ) & 255;
+		code[ offset + 2 ] = ( v >> 16 ) & 255;
+		code[ offset + 3 ] = ( v >> 24 ) & 255;
+	}
+}
+
+
+static uint32_t BranchImm( int disp, int bits )
+{
+	int range = 1 << ( bits + 1 ); // in bytes, both directions
+
+	// offsets from earlier passes may be meaningless, only the final one has to fit
+	if ( code && ( disp < -range || disp >= range ) )
+		jumpOutOfRange = true;
+
+	return ( disp >> 2 ) & ( ( 1 << bits ) - 1 );
+}
+
+
+static void EmitMovW( int rd, int v )
+{
+	uint32_t u = (uint32_t)v;
+
+	if ( ( u & 0xFFFF0000 ) == 0 ) {
+		Emit4( 0x52800000 | ( u << 5 ) | rd );						// movz wd, #lo16
+	} else if ( ( ~u & 0xFFFF0000 ) == 0 ) {
+		Emit4( 0x12800000 | ( ( ~u & 0xFFFF ) << 5 ) | rd );		// movn wd, #~lo16
+	} else if ( ( u & 0xFFFF ) == 0 ) {
+		Emit4( 0x52A00000 | ( ( u >> 16 ) << 5 ) | rd );			// movz wd, #hi16, lsl 16
+	} else {
+		Emit4( 0x52800000 | ( ( u & 0xFFFF ) << 5 ) | rd );		// movz wd, #lo16
+		Emit4( 0x72A00000 | ( ( u >> 16 ) << 5 ) | rd );			// movk wd, #hi16, lsl 16
+	}
+}
+
+
+// always four instructions, pointers are not known before the last pass
+static void EmitMovPtr( int rd, const void *ptr )
+{
+	uint64_t u = (uint64_t)(intptr_t)ptr;
+
+	Emit4( 0xD2800000 | ( ( u & 0xFFFF ) << 5 ) | rd );				// movz xd, #bits0-15
+	Emit4( 0xF2A00000 | ( ( ( u >> 16 ) & 0xFFFF ) << 5 ) | rd );		// movk xd, #bits16-31, lsl 16
+	Emit4( 0xF2C00000 | ( ( ( u >> 32 ) & 0xFFFF ) << 5 ) | rd );		// movk xd, #bits32-47, lsl 32
+	Emit4( 0xF2E00000 | ( ( ( u >> 48 ) & 0xFFFF ) << 5 ) | rd );		// movk xd, #bits48-63, lsl 48
+}
+
+
+static void EmitMovRegW( int rd, int rm )
+{
+	Emit4( 0x2A0003E0 | ( rm << 16 ) | rd );		// mov wd, wm
+}
+
+
+static void EmitAddSubW( qbool sub, int rd, int rn, int v )
+{
+	if ( v < 0 && v != (int)0x80000000 ) {
+		sub = !sub;
+		v = -v;
+	}
+
+	if ( v >= 0 && v <= 0xFFF ) {
+		Emit4( ( sub ? 0x51000000 : 0x11000000 ) | ( v << 10 ) | ( rn << 5 ) | rd );				// add|sub wd, wn, #v
+	} else if ( v >= 0 && ( v & 0xFFF ) == 0 && v <= 0xFFF000 ) {
+		Emit4( ( sub ? 0x51400000 : 0x11400000 ) | ( ( v >> 12 ) << 10 ) | ( rn << 5 ) | rd );	// add|sub wd, wn, #v, lsl 12
+	} else {
+		EmitMovW( R17, v );
+		Emit4( ( sub ? 0x4B000000 : 0x0B000000 ) | ( R17 << 16 ) | ( rn << 5 ) | rd );			// add|sub wd, wn, w17
+	}
+}
+
+
+static void EmitCmpW( int rn, int v )
+{
+	if ( v >= 0 && v <= 0xFFF ) {
+		Emit4( 0x7100001F | ( v << 10 ) | ( rn << 5 ) );		// cmp wn, #v
+	} else if ( v < 0 && v >= -0xFFF ) {
+		Emit4( 0x3100001F | ( -v << 10 ) | ( rn << 5 ) );		// cmn wn, #-v
+	} else {
+		EmitMovW( R17, v );
+		Emit4( 0x6B00001F | ( R17 << 16 ) | ( rn << 5 ) );	// cmp wn, w17
+	}
+}
+
+
+static void EmitLdSt( uint32_t op, int rt, int rn, int offset )
+{
+	int shift = op >> 30;
+
+	if ( offset >= 0 && ( offset & ( ( 1 << shift ) - 1 ) ) == 0 && ( offset >> shift ) <= 0xFFF ) {
+		Emit4( op | LDST_UIMM | ( ( offset >> shift ) << 10 ) | ( rn << 5 ) | rt );	// ldr|str rt, [rn, #offset]
+	} else if ( offset >= -256 && offset <= 255 ) {
+		Emit4( op | ( ( offset & 0x1FF ) << 12 ) | ( rn << 5 ) | rt );					// ldur|stur rt, [rn, #offset]
+	} else {
+		EmitMovW( R17, offset );
+		Emit4( op | LDST_REG | EXTEND_SXTW | ( R17 << 16 ) | ( rn << 5 ) | rt );		// ldr|str rt, [rn, w17, sxtw]
+	}
+}
+
+
+// access to the data segment, rm has passed EmitCheckReg()
+static void EmitLdStData( uint32_t op, int rt, int rm )
+{
+	Emit4( op | LDST_REG | EXTEND_UXTW | ( rm << 16 ) | ( R_DATABASE << 5 ) | rt );		// ldr|str rt, [x19, wm, uxtw]
+}
+
+
+static void EmitPushW( int reg )
+{
+	Emit4( STR32 | LDST_PRE | ( 4 << 12 ) | ( R_OPSTACK << 5 ) | reg );	// str wn, [x21, #4]!
+	LastCommand = LAST_COMMAND_PUSH_INT;
+	lastPushReg = reg;
+}
+
+
+static void EmitPushS( int reg )
+{
+	Emit4( STRS | LDST_PRE | ( 4 << 12 ) | ( R_OPSTACK << 5 ) | reg );	// str sn, [x21, #4]!
+	LastCommand = LAST_COMMAND_PUSH_FLOAT;
+	lastPushReg = reg;
+}
+
+
+/*
+=================
+EmitPopW
+
+Returns the register holding the value, which is only different
+from the requested one if the push of the previous instruction was rewound
+=================
+*/
+static int EmitPopW( int reg )
+{
+	if ( LastCommand == LAST_COMMAND_PUSH_INT ) {
+		REWIND( 4 );
+		LastCommand = LAST_COMMAND_NONE;
+		return lastPushReg;
+	}
+
+	if ( LastCommand == LAST_COMMAND_PUSH_FLOAT ) {
+		REWIND( 4 );
+		Emit4( 0x1E260000 | ( lastPushReg << 5 ) | reg );		// fmov wd, sn
+		return reg;
+	}
+
+	Emit4( LDR32 | LDST_POST | ( 0x1FC << 12 ) | ( R_OPSTACK << 5 ) | reg );	// ldr wd, [x21], #-4
+	return reg;
+}
+
+
+static int EmitPopS( int reg )
+{
+	if ( LastCommand == LAST_COMMAND_PUSH_FLOAT ) {
+		REWIND( 4 );
+		LastCommand = LAST_COMMAND_NONE;
+		return lastPushReg;
+	}
+
+	if ( LastCommand == LAST_COMMAND_PUSH_INT ) {
+		REWIND( 4 );
+		Emit4( 0x1E270000 | ( lastPushReg << 5 ) | reg );		// fmov sd, wn
+		return reg;
+	}
+
+	Emit4( LDRS | LDST_POST | ( 0x1FC << 12 ) | ( R_OPSTACK << 5 ) | reg );	// ldr sd, [x21], #-4
+	return reg;
+}
+
+
+static void EmitJumpCond( cond_t cond, int offset )
+{
+	int v = offset - compiledOfs;
+
+	if ( cond == COND_AL ) {
+		Emit4( 0x14000000 | BranchImm( v, 26 ) );						// b +offset
+	} else if ( shortJumps ) {
+		Emit4( 0x54000000 | ( BranchImm( v, 19 ) << 5 ) | cond );		// b.cond +offset
+	} else {
+		Emit4( 0x54000040 | ( cond ^ 1 ) );								// b.!cond +8
+		Emit4( 0x14000000 | BranchImm( v - 4, 26 ) );					// b +offset
+	}
+}
+
+
+static void EmitJump( vm_t *vm, cond_t cond, int addr )
+{
+	EmitJumpCond( cond, instructionOffsets[ addr ] );
+}
+
+
+static void EmitCallOffset( funcarm64_t Func )
+{
+	Emit4( 0x94000000 | BranchImm( funcOffset[ Func ] - compiledOfs, 26 ) );	// bl +funcOffset[ Func ]
+}
+
+
+static void EmitCheckReg( vm_t *vm, int reg, int size )
+{
+	if ( !( (int)vm_rtChecks.value & 8 ) || vm->forceDataMask ) {
+		if ( vm->forceDataMask ) {
+			Emit4( 0x0A000000 | ( R_DATAMASK << 16 ) | ( reg << 5 ) | reg );	// and wn, wn, w24
+		}
+		return;
+	}
+
+	Emit4( 0x6B00001F | ( R_DATAMASK << 16 ) | ( reg << 5 ) );	// cmp wn, w24 // vm->dataMask
+	EmitJumpCond( COND_HI, funcOffset[FUNC_DATA] );				// b.hi +errorFunction
+}
+
+
+static cond_t IntJumpCond( int op )
+{
+	switch ( op )
+	{
+		case OP_EQ:  return COND_EQ;
+		case OP_NE:  return COND_NE;
+		case OP_LTI: return COND_LT;
+		case OP_LEI: return COND_LE;
+		case OP_GTI: return COND_GT;
+		case OP_GEI: return COND_GE;
+		case OP_LTU: return COND_LO;
+		case OP_LEU: return COND_LS;
+		case OP_GTU: return COND_HI;
+		case OP_GEU: return COND_HS;
+	};
+	SV_Error( "VM_CompileARM64: bad jump opcode %02X", op );
+	return COND_AL;
+}
+
+
+// same results as C comparisons, false for NaN except for OP_NEF
+static cond_t FloatJumpCond( int op )
+{
+	switch ( op )
+	{
+		case OP_EQF: return COND_EQ;
+		case OP_NEF: return COND_NE;
+		case OP_LTF: return COND_MI;
+		case OP_LEF: return COND_LS;
+		case OP_GTF: return COND_GT;
+		case OP_GEF: return COND_GE;
+	};
+	SV_Error( "VM_CompileARM64: bad jump opcode %02X", op );
+	return COND_AL;
+}
+
+
+static uint32_t IntOp( int op )
+{
+	switch ( op )
+	{
+		case OP_ADD:  return 0x0B000000;	// add
+		case OP_SUB:  return 0x4B000000;	// sub
+		case OP_MULI:
+		case OP_MULU: return 0x1B007C00;	// mul
+		case OP_DIVI: return 0x1AC00C00;	// sdiv
+		case OP_DIVU: return 0x1AC00800;	// udiv
+		case OP_BAND: return 0x0A000000;	// and
+		case OP_BOR:  return 0x2A000000;	// orr
+		case OP_BXOR: return 0x4A000000;	// eor
+		case OP_LSH:  return 0x1AC02000;	// lslv
+		case OP_RSHI: return 0x1AC02800;	// asrv
+		case OP_RSHU: return 0x1AC02400;	// lsrv
+	};
+	SV_Error( "VM_CompileARM64: bad opcode %02X", op );
+	return 0;
+}
+
+
+static uint32_t FloatOp( int op )
+{
+	switch ( op )
+	{
+		case OP_ADDF: return 0x1E202800;	// fadd
+		case OP_SUBF: return 0x1E203800;	// fsub
+		case OP_MULF: return 0x1E200800;	// fmul
+		case OP_DIVF: return 0x1E201800;	// fdiv
+	};
+	SV_Error( "VM_CompileARM64: bad opcode %02X", op );
+	return 0;
+}
+
+
+static void EmitCallFunc( vm_t *vm )
+{
+	int sysCallBranch;
+	int i;
+
+	sysCallBranch = compiledOfs;
+	Emit4( 0 );							// tbnz w0, #31, systemCall
+
+	// jump target range check
+	if ( (int)vm_rtChecks.value & 4 ) {
+		EmitCmpW( R0, vm->instructionCount );
+		EmitJumpCond( COND_HS, funcOffset[FUNC_ERRJ] );	// b.hs +funcOffset[FUNC_ERRJ]
+	}
+
+	// calling another vm function, save proc base and programStack
+	Emit4( 0xF8607800 | ( R0 << 16 ) | ( R_INSTRPTRS << 5 ) | R16 );	// ldr x16, [x23, x0, lsl #3]
+	Emit4( 0xA9BE0000 | ( R_PROCBASE << 10 ) | ( R_SP << 5 ) | R_PSTACK );	// stp x20, x22, [sp, #-32]!
+	EmitLdSt( STR64, R_LR, R_SP, 16 );								// str x30, [sp, #16]
+	Emit4( 0xD63F0000 | ( R16 << 5 ) );								// blr x16
+	EmitLdSt( LDR64, R_LR, R_SP, 16 );								// ldr x30, [sp, #16]
+	Emit4( 0xA8C20000 | ( R_PROCBASE << 10 ) | ( R_SP << 5 ) | R_PSTACK );	// ldp x20, x22, [sp], #32
+	Emit4( 0xD65F03C0 );												// ret
+
+	// systemCall:
+	// convert negative num to system call number
+	Patch4( sysCallBranch, 0x37F80000 | ( ( ( compiledOfs - sysCallBranch ) >> 2 ) << 5 ) | R0 );
+	Emit4( 0x2A2003E0 | ( R0 << 16 ) | R0 );							// mvn w0, w0
+
+	// we may jump here from ConstOptimize() also
+funcOffset[FUNC_SYSC] = compiledOfs;
+
+	// allocate frame for int64_params[16]
+	Emit4( 0xA9B70000 | ( R_LR << 10 ) | ( R_SP << 5 ) | R_FP );		// stp x29, x30, [sp, #-144]!
+	Emit4( 0x910003E0 | R_FP );											// mov x29, sp
+
+	// vm->programStack = programStack - 8;
+	EmitAddSubW( true, R1, R_PSTACK, 8 );								// sub w1, w20, #8
+	EmitLdSt( STR32, R1, R_VM, offsetof( vm_t, programStack ) );		// str w1, [x25, #programStack]
+
+	// params = (vm->dataBase + programStack + 8);
+	Emit4( 0x8B204000 | ( R_PSTACK << 16 ) | ( R_DATABASE << 5 ) | R1 );	// add x1, x19, w20, uxtw
+
+	// int64_params[0] = syscallNum, int64_params[1-15] = params[0-14]
+	EmitLdSt( STR64, R0, R_SP, 16 );									// str x0, [sp, #16]
+	for ( i = 1; i < 16; i++ ) {
+		EmitLdSt( LDRSW, R2, R1, 8 + ( i - 1 ) * 4 );					// ldrsw x2, [x1, #params[i-1]]
+		EmitLdSt( STR64, R2, R_SP, 16 + i * 8 );						// str x2, [sp, #int64_params[i]]
+	}
+
+	// currentVm->systemCall( param );
+	Emit4( 0x910043E0 | R0 );											// add x0, sp, #16
+	EmitLdSt( LDR64, R16, R_VM, offsetof( vm_t, systemCall ) );		// ldr x16, [x25, #systemCall]
+	Emit4( 0xD63F0000 | ( R16 << 5 ) );								// blr x16
+
+	Emit4( 0xA8C90000 | ( R_LR << 10 ) | ( R_SP << 5 ) | R_FP );		// ldp x29, x30, [sp], #144
+
+	// we added the return value: *(opstack+1) = w0
+	EmitPushW( R0 );													// str w0, [x21, #4]!
+	Emit4( 0xD65F03C0 );												// ret
+}
+
+
+static void EmitErrorFunc( void (*func)( void ) )
+{
+	EmitMovPtr( R16, (void *)func );		// mov x16, func
+	Emit4( 0xD63F0000 | ( R16 << 5 ) );	// blr x16
+	Emit4( 0xD4200000 );					// brk #0
+}
+
+
+/*
+=================
+ConstOptimize
+=================
+*/
+static qbool ConstOptimize( vm_t *vm )
+{
+	int v, r, t;
+	int op1;
+
+	op1 = ni->op;
+	v = ci->value;
+
+	switch ( op1 ) {
+
+	case OP_LOAD4:
+		EmitLdSt( LDR32, R0, R_DATABASE, v );			// ldr w0, [x19, #v]
+		EmitPushW( R0 );
+		ip += 1;
+		return true;
+
+	case OP_LOAD2:
+		if ( (ci+2)->op == OP_SEX16 ) {
+			EmitLdSt( LDRSH, R0, R_DATABASE, v );		// ldrsh w0, [x19, #v]
+			ip += 1;
+		} else {
+			EmitLdSt( LDRH, R0, R_DATABASE, v );		// ldrh w0, [x19, #v]
+		}
+		EmitPushW( R0 );
+		ip += 1;
+		return true;
+
+	case OP_LOAD1:
+		if ( (ci+2)->op == OP_SEX8 ) {
+			EmitLdSt( LDRSB, R0, R_DATABASE, v );		// ldrsb w0, [x19, #v]
+			ip += 1;
+		} else {
+			EmitLdSt( LDRB, R0, R_DATABASE, v );		// ldrb w0, [x19, #v]
+		}
+		EmitPushW( R0 );
+		ip += 1;
+		return true;
+
+	case OP_STORE4:
+	case OP_STORE2:
+	case OP_STORE1:
+		r = EmitPopW( R0 );								// address
+		if ( v == 0 ) {
+			t = R_ZR;
+		} else {
+			t = ( r == R1 ) ? R0 : R1;
+			EmitMovW( t, v );
+		}
+		EmitCheckReg( vm, r, op1 == OP_STORE4 ? 4 : op1 == OP_STORE2 ? 2 : 1 );
+		EmitLdStData( op1 == OP_STORE4 ? STR32 : op1 == OP_STORE2 ? STRH : STRB, t, r );
+		ip += 1;
+		return true;
+
+	case OP_ADD:
+	case OP_SUB:
+		r = EmitPopW( R0 );
+		EmitAddSubW( op1 == OP_SUB, R0, r, v );		// add|sub w0, wn, #v
+		EmitPushW( R0 );
+		ip += 1;
+		return true;
+
+	case OP_MULI:
+	case OP_BAND:
+	case OP_BOR:
+	case OP_BXOR:
+		r = EmitPopW( R0 );
+		t = ( r == R1 ) ? R0 : R1;
+		EmitMovW( t, v );
+		Emit4( IntOp( op1 ) | ( t << 16 ) | ( r << 5 ) | R0 );	// op w0, wn, wt
+		EmitPushW( R0 );
+		ip += 1;
+		return true;
+
+	case OP_LSH:
+	case OP_RSHI:
+	case OP_RSHU:
+		if ( v < 0 || v > 31 )
+			break;
+		r = EmitPopW( R0 );
+		if ( op1 == OP_LSH )
+			Emit4( 0x53000000 | ( ( ( 32 - v ) & 31 ) << 16 ) | ( ( 31 - v ) << 10 ) | ( r << 5 ) | R0 );	// lsl w0, wn, #v
+		else if ( op1 == OP_RSHI )
+			Emit4( 0x13007C00 | ( v << 16 ) | ( r << 5 ) | R0 );	// asr w0, wn, #v
+		else
+			Emit4( 0x53007C00 | ( v << 16 ) | ( r << 5 ) | R0 );	// lsr w0, wn, #v
+		EmitPushW( R0 );
+		ip += 1;
+		return true;
+
+	case OP_MULF:
+	case OP_DIVF:
+	case OP_ADDF:
+	case OP_SUBF:
+		r = EmitPopS( S0 );
+		t = ( r == S1 ) ? S0 : S1;
+		EmitMovW( R1, v );
+		Emit4( 0x1E270000 | ( R1 << 5 ) | t );				// fmov st, w1
+		Emit4( FloatOp( op1 ) | ( t << 16 ) | ( r << 5 ) | S0 );	// op s0, sn, st
+		EmitPushS( S0 );
+		ip += 1;
+		return true;
+
+	case OP_JUMP:
+		EmitJump( vm, COND_AL, v );
+		ip += 1; // OP_JUMP
+		return true;
+
+	case OP_CALL:
+		// try to inline some syscalls
+		if ( v == ~g_sqrt ) {
+			EmitLdSt( LDRS, S0, R_PROCBASE, 8 );		// ldr s0, [x22, #8]
+			Emit4( 0x1E21C000 );						// fsqrt s0, s0
+			EmitPushS( S0 );
+			ip += 1;
+			return true;
+		}
+
+		if ( v < 0 ) // syscall
+		{
+			EmitMovW( R0, ~v );							// mov w0, #syscallNum
+			EmitCallOffset( FUNC_SYSC );
+			ip += 1; // OP_CALL
+			return true;
+		}
+
+		if ( v >= vm->instructionCount )
+			break;
+
+		Emit4( 0xA9BF0000 | ( R_PROCBASE << 10 ) | ( R_SP << 5 ) | R_PSTACK );	// stp x20, x22, [sp, #-16]!
+		Emit4( 0x94000000 | BranchImm( instructionOffsets[ v ] - compiledOfs, 26 ) );	// bl +addr
+		Emit4( 0xA8C10000 | ( R_PROCBASE << 10 ) | ( R_SP << 5 ) | R_PSTACK );	// ldp x20, x22, [sp], #16
+		ip += 1; // OP_CALL
+		return true;
+
+	case OP_EQF:
+	case OP_NEF:
+	case OP_LTF:
+	case OP_LEF:
+	case OP_GTF:
+	case OP_GEF:
+		r = EmitPopS( S0 );
+		if ( v == 0 ) {
+			Emit4( 0x1E202008 | ( r << 5 ) );			// fcmp sn, #0.0
+		} else {
+			t = ( r == S1 ) ? S0 : S1;
+			EmitMovW( R1, v );
+			Emit4( 0x1E270000 | ( R1 << 5 ) | t );		// fmov st, w1
+			Emit4( 0x1E202000 | ( t << 16 ) | ( r << 5 ) );	// fcmp sn, st
+		}
+		EmitJump( vm, FloatJumpCond( op1 ), ni->value );
+		ip += 1;
+		return true;
+
+	case OP_EQ:
+	case OP_NE:
+	case OP_GEI:
+	case OP_GTI:
+	case OP_GTU:
+	case OP_GEU:
+	case OP_LTU:
+	case OP_LEU:
+	case OP_LEI:
+	case OP_LTI:
+		r = EmitPopW( R0 );
+		EmitCmpW( r, v );								// cmp wn, #v
+		EmitJump( vm, IntJumpCond( op1 ), ni->value );
+		ip += 1;
+		return true;
+
+	default:
+		break;
+	}
+
+	return false;
+}
+
+/*
+=================
+VM_FindMOps
+
+Search for known macro-op sequences
+=================
+*/
+static void VM_FindMOps( instruction_t *buf, int instructionCount )
+{
+	int n, v, op0;
+	instruction_t *i;
+
+	i = buf;
+	n = 0;
+
+	while ( n < instructionCount )
+	{
+		op0 = i->op;
+		if ( op0 == OP_LOCAL ) {
+			// OP_LOCAL + OP_LOCAL + OP_LOAD4 + OP_CONST + OP_XXX + OP_STORE4
+			if ( (i+1)->op == OP_LOCAL && i->value == (i+1)->value && (i+2)->op == OP_LOAD4 && (i+3)->op == OP_CONST && (i+4)->op != OP_UNDEF && (i+5)->op == OP_STORE4 ) {
+				v = (i+4)->op;
+				if ( v == OP_ADD ) {
+					i->op = MOP_ADD4;
+					i += 6; n += 6;
+					continue;
+				}
+				if ( v == OP_SUB ) {
+					i->op = MOP_SUB4;
+					i += 6; n += 6;
+					continue;
+				}
+				if ( v == OP_BAND ) {
+					i->op = MOP_BAND4;
+					i += 6; n += 6;
+					continue;
+				}
+				if ( v == OP_BOR ) {
+					i->op = MOP_BOR4;
+					i += 6; n += 6;
+					continue;
+				}
+			}
+
+			// skip useless sequences
+			if ( (i+1)->op == OP_LOCAL && (i+0)->value == (i+1)->value && (i+2)->op == OP_LOAD4 && (i+3)->op == OP_STORE4 ) {
+				i->op = MOP_IGNORE4;
+				i += 4; n += 4;
+				continue;
+			}
+		}
+
+		i++;
+		n++;
+	}
+}
+
+
+/*
+=================
+EmitMOPs
+=================
+*/
+static qbool EmitMOPs( vm_t *vm, int op )
+{
+	int v, n;
+	switch ( op )
+	{
+		//[local] += CONST
+		//[local] -= CONST
+		case MOP_ADD4:
+		case MOP_SUB4:
+			n = inst[ip+2].value;
+			v = ci->value; // local variable address
+			EmitLdSt( LDR32, R0, R_PROCBASE, v );			// ldr w0, [x22, #v]
+			EmitAddSubW( op == MOP_SUB4, R0, R0, n );		// add|sub w0, w0, #n
+			EmitLdSt( STR32, R0, R_PROCBASE, v );			// str w0, [x22, #v]
+			ip += 5;
+			return true;
+
+		//[local] &= CONST
+		//[local] |= CONST
+		case MOP_BAND4:
+		case MOP_BOR4:
+			n = inst[ip+2].value;
+			v = ci->value; // local variable address
+			EmitLdSt( LDR32, R0, R_PROCBASE, v );			// ldr w0, [x22, #v]
+			EmitMovW( R1, n );
+			Emit4( IntOp( op == MOP_BAND4 ? OP_BAND : OP_BOR ) | ( R1 << 16 ) | ( R0 << 5 ) | R0 );	// and|orr w0, w0, w1
+			EmitLdSt( STR32, R0, R_PROCBASE, v );			// str w0, [x22, #v]
+			ip += 5;
+			return true;
+
+		// [local] = [local]
+		case MOP_IGNORE4:
+			ip += 3;
+			return true;
+
+	};
+	return false;
+}
+
+/*
+=================
+VM_Compile
+=================
+*/
+qbool VM_Compile( vm_t *vm, vmHeader_t *header ) {
+	const char *errMsg;
+	int		instructionCount;
+	int		proc_base;
+	int		proc_len;
+	int		i, n, v, r, t;
+
+	inst = (instruction_t*)Q_malloc( (header->instructionCount + 8 ) * sizeof( instruction_t ) );
+	instructionOffsets = (int*)Q_malloc( header->instructionCount * sizeof( int ) );
+
+	errMsg = VM_LoadInstructions( (byte *) header + header->codeOffset, header->codeLength, header->instructionCount, inst );
+	if ( !errMsg ) {
+		errMsg = VM_CheckInstructions( inst, vm->instructionCount, vm->jumpTableTargets, vm->numJumpTableTargets, vm->exactDataLength );
+	}
+	if ( errMsg ) {
+		VM_FreeBuffers();
+		Con_Printf( "VM_CompileARM64 error: %s\n", errMsg );
+		return false;
+	}
+
+	VM_FindMOps( inst, vm->instructionCount );
+
+	code = NULL; // we will allocate memory later, after last defined pass
+	instructionPointers = NULL;
+	shortJumps = false;
+	jumpOutOfRange = false;
+
+	memset( funcOffset, 0, sizeof( funcOffset ) );
+
+	instructionCount = header->instructionCount;
+
+	for( pass = 0; pass < NUM_PASSES; pass++ )
+	{
+__compile:
+
+	// translate all instructions
+	ip = 0;
+	compiledOfs = 0;
+	LastCommand = LAST_COMMAND_NONE;
+
+	proc_base = -1;
+	proc_len = 0;
+
+	Emit4( 0xA9BA0000 | ( R_LR << 10 ) | ( R_SP << 5 ) | R_FP );		// stp x29, x30, [sp, #-96]!
+	Emit4( 0x910003E0 | R_FP );											// mov x29, sp
+	Emit4( 0xA9010000 | ( 20 << 10 ) | ( R_SP << 5 ) | 19 );			// stp x19, x20, [sp, #16]
+	Emit4( 0xA9020000 | ( 22 << 10 ) | ( R_SP << 5 ) | 21 );			// stp x21, x22, [sp, #32]
+	Emit4( 0xA9030000 | ( 24 << 10 ) | ( R_SP << 5 ) | 23 );			// stp x23, x24, [sp, #48]
+	Emit4( 0xA9040000 | ( 26 << 10 ) | ( R_SP << 5 ) | 25 );			// stp x25, x26, [sp, #64]
+	Emit4( 0xA9050000 | ( 28 << 10 ) | ( R_SP << 5 ) | 27 );			// stp x27, x28, [sp, #80]
+
+	EmitMovPtr( R_VM, vm );											// mov x25, vm
+	EmitMovPtr( R_INSTRPTRS, instructionPointers );					// mov x23, vm->instructionPointers
+	EmitLdSt( LDR64, R_DATABASE, R_VM, offsetof( vm_t, dataBase ) );	// ldr x19, [x25, #dataBase]
+	EmitLdSt( LDR32, R_PSTACK, R_VM, offsetof( vm_t, programStack ) );	// ldr w20, [x25, #programStack]
+	EmitLdSt( LDR64, R_OPSTACK, R_VM, offsetof( vm_t, opStack ) );		// ldr x21, [x25, #opStack]
+	EmitLdSt( LDR32, R_DATAMASK, R_VM, offsetof( vm_t, dataMask ) );	// ldr w24, [x25, #dataMask]
+	EmitLdSt( LDR32, R_STACKBTM, R_VM, offsetof( vm_t, stackBottom ) );	// ldr w26, [x25, #stackBottom]
+	EmitLdSt( LDR64, R_OPSTACKTOP, R_VM, offsetof( vm_t, opStackTop ) );	// ldr x27, [x25, #opStackTop]
+
+	EmitCallOffset( FUNC_ENTR );
+
+	EmitLdSt( STR64, R_OPSTACK, R_VM, offsetof( vm_t, opStack ) );		// str x21, [x25, #opStack]
+
+	Emit4( 0xA9450000 | ( 28 << 10 ) | ( R_SP << 5 ) | 27 );			// ldp x27, x28, [sp, #80]
+	Emit4( 0xA9440000 | ( 26 << 10 ) | ( R_SP << 5 ) | 25 );			// ldp x25, x26, [sp, #64]
+	Emit4( 0xA9430000 | ( 24 << 10 ) | ( R_SP << 5 ) | 23 );			// ldp x23, x24, [sp, #48]
+	Emit4( 0xA9420000 | ( 22 << 10 ) | ( R_SP << 5 ) | 21 );			// ldp x21, x22, [sp, #32]
+	Emit4( 0xA9410000 | ( 20 << 10 ) | ( R_SP << 5 ) | 19 );			// ldp x19, x20, [sp, #16]
+	Emit4( 0xA8C60000 | ( R_LR << 10 ) | ( R_SP << 5 ) | R_FP );		// ldp x29, x30, [sp], #96
+	Emit4( 0xD65F03C0 );												// ret
+
+	 // main function entry offset
+	funcOffset[FUNC_ENTR] = compiledOfs;
+
+	while ( ip < instructionCount )
+	{
+		instructionOffsets[ ip ] = compiledOfs;
+
+		ci = &inst[ ip ];
+		ni = &inst[ ip + 1 ];
+		ip++;
+
+		if ( ci->jused ) {
+			LastCommand = LAST_COMMAND_NONE;
+		}
+
+		switch ( ci->op ) {
+
+		case OP_UNDEF:
+		case OP_IGNORE:
+			break;
+
+		case OP_BREAK:
+			Emit4( 0xD4200000 );			// brk #0
+			break;
+
+		case OP_ENTER:
+			Emit4( STR64 | LDST_PRE | ( 0x1F0 << 12 ) | ( R_SP << 5 ) | R_LR );	// str x30, [sp, #-16]!
+			EmitAddSubW( true, R_PSTACK, R_PSTACK, ci->value );				// sub w20, w20, #v
+
+			// locate endproc
+			for ( n = -1, i = ip + 1; i < instructionCount; i++ ) {
+				if ( inst[ i ].op == OP_PUSH && inst[ i + 1 ].op == OP_LEAVE ) {
+					n = i;
+					break;
+				}
+			}
+
+			// should never happen because equal check in VM_LoadInstructions() but anyway
+			if ( n == -1 ) {
+				VM_FreeBuffers();
+				Con_Printf( "VM_CompileARM64 error: %s\n", "missing proc end" );
+				return false;
+			}
+
+			proc_base = ip + 1;
+			proc_len = n - proc_base + 1 ;
+
+			// programStack overflow check
+			if ( (int)vm_rtChecks.value & 1 ) {
+				Emit4( 0x6B00001F | ( R_STACKBTM << 16 ) | ( R_PSTACK << 5 ) );	// cmp w20, w26
+				EmitJumpCond( COND_LO, funcOffset[FUNC_PSOF] );				// b.lo +funcOffset[FUNC_PSOF]
+			}
+
+			// opStack overflow check
+			if ( (int)vm_rtChecks.value & 2 ) {
+				Emit4( 0x91000000 | ( ci->opStack << 10 ) | ( R_OPSTACK << 5 ) | R0 );	// add x0, x21, #opStack
+				Emit4( 0xEB00001F | ( R_OPSTACKTOP << 16 ) | ( R0 << 5 ) );			// cmp x0, x27
+				EmitJumpCond( COND_HI, funcOffset[FUNC_OSOF] );						// b.hi +funcOffset[FUNC_OSOF]
+			}
+
+			Emit4( 0x8B204000 | ( R_PSTACK << 16 ) | ( R_DATABASE << 5 ) | R_PROCBASE );	// add x22, x19, w20, uxtw
+			break;
+
+		case OP_CONST:
+
+			// we can safely perform optimizations only in case if
+			// we are 100% sure that next instruction is not a jump label
+			if ( !ni->jused && ConstOptimize( vm ) )
+				break;
+
+			EmitMovW( R0, ci->value );				// mov w0, #v
+			EmitPushW( R0 );						// str w0, [x21, #4]!
+			break;
+
+		case OP_LOCAL:
+			v = ci->value;
+
+			// optimization: merge OP_LOCAL + OP_LOAD4
+			if ( ni->op == OP_LOAD4 ) {
+				EmitLdSt( LDR32, R0, R_PROCBASE, v );	// ldr w0, [x22, #v]
+				EmitPushW( R0 );
+				ip++;
+				break;
+			}
+
+			// optimization: merge OP_LOCAL + OP_LOAD2
+			if ( ni->op == OP_LOAD2 ) {
+				EmitLdSt( LDRH, R0, R_PROCBASE, v );	// ldrh w0, [x22, #v]
+				EmitPushW( R0 );
+				ip++;
+				break;
+			}
+
+			// optimization: merge OP_LOCAL + OP_LOAD1
+			if ( ni->op == OP_LOAD1 ) {
+				EmitLdSt( LDRB, R0, R_PROCBASE, v );	// ldrb w0, [x22, #v]
+				EmitPushW( R0 );
+				ip++;
+				break;
+			}
+
+			EmitAddSubW( false, R0, R_PSTACK, v );		// add w0, w20, #v
+			EmitPushW( R0 );
+			break;
+
+		case OP_ARG:
+			v = ci->value;
+			if ( LastCommand == LAST_COMMAND_PUSH_FLOAT ) {
+				r = EmitPopS( S0 );
+				EmitLdSt( STRS, r, R_PROCBASE, v );	// str sn, [x22, #v]
+				break;
+			}
+			r = EmitPopW( R0 );
+			EmitLdSt( STR32, r, R_PROCBASE, v );		// str wn, [x22, #v]
+			break;
+
+		case OP_CALL:
+			r = EmitPopW( R0 );
+			if ( r != R0 )
+				EmitMovRegW( R0, r );
+			EmitCallOffset( FUNC_CALL );			// bl +FUNC_CALL
+			break;
+
+		case OP_PUSH:
+			Emit4( 0x91001000 | ( R_OPSTACK << 5 ) | R_OPSTACK );	// add x21, x21, #4
+			break;
+
+		case OP_POP:
+			if ( LastCommand != LAST_COMMAND_NONE ) {
+				// value was never used
+				REWIND( 4 );
+				LastCommand = LAST_COMMAND_NONE;
+				break;
+			}
+			Emit4( 0xD1001000 | ( R_OPSTACK << 5 ) | R_OPSTACK );	// sub x21, x21, #4
+			break;
+
+		case OP_LEAVE:
+			Emit4( LDR64 | LDST_POST | ( 0x010 << 12 ) | ( R_SP << 5 ) | R_LR );	// ldr x30, [sp], #16
+			Emit4( 0xD65F03C0 );												// ret
+			break;
+
+		case OP_LOAD4:
+			r = EmitPopW( R1 );
+			EmitCheckReg( vm, r, 4 );					// range check
+			EmitLdStData( LDR32, R0, r );				// ldr w0, [x19, wn, uxtw]
+			EmitPushW( R0 );
+			break;
+
+		case OP_LOAD2:
+			r = EmitPopW( R1 );
+			EmitCheckReg( vm, r, 2 );					// range check
+			if ( ni->op == OP_SEX16 ) {
+				EmitLdStData( LDRSH, R0, r );			// ldrsh w0, [x19, wn, uxtw]
+				ip++;
+			} else {
+				EmitLdStData( LDRH, R0, r );			// ldrh w0, [x19, wn, uxtw]
+			}
+			EmitPushW( R0 );
+			break;
+
+		case OP_LOAD1:
+			r = EmitPopW( R1 );
+			EmitCheckReg( vm, r, 1 );					// range check
+			if ( ni->op == OP_SEX8 ) {
+				EmitLdStData( LDRSB, R0, r );			// ldrsb w0, [x19, wn, uxtw]
+				ip++;
+			} else {
+				EmitLdStData( LDRB, R0, r );			// ldrb w0, [x19, wn, uxtw]
+			}
+			EmitPushW( R0 );
+			break;
+
+		case OP_STORE4:
+			if ( LastCommand == LAST_COMMAND_PUSH_FLOAT ) {
+				t = EmitPopS( S0 );
+				r = EmitPopW( R1 );
+				EmitCheckReg( vm, r, 4 );				// range check
+				EmitLdStData( STRS, t, r );				// str sn, [x19, wn, uxtw]
+				break;
+			}
+			// fall through
+		case OP_STORE2:
+		case OP_STORE1:
+			t = EmitPopW( R0 );
+			r = EmitPopW( t == R1 ? R0 : R1 );
+			EmitCheckReg( vm, r, ci->op == OP_STORE4 ? 4 : ci->op == OP_STORE2 ? 2 : 1 );
+			EmitLdStData( ci->op == OP_STORE4 ? STR32 : ci->op == OP_STORE2 ? STRH : STRB, t, r );
+			break;
+
+		case OP_EQ:
+		case OP_NE:
+		case OP_LTI:
+		case OP_LEI:
+		case OP_GTI:
+		case OP_GEI:
+		case OP_LTU:
+		case OP_LEU:
+		case OP_GTU:
+		case OP_GEU:
+			t = EmitPopW( R1 );
+			r = EmitPopW( t == R0 ? R1 : R0 );
+			Emit4( 0x6B00001F | ( t << 16 ) | ( r << 5 ) );			// cmp wn, wt
+			EmitJump( vm, IntJumpCond( ci->op ), ci->value );
+			break;
+
+		case OP_EQF:
+		case OP_NEF:
+		case OP_LTF:
+		case OP_LEF:
+		case OP_GTF:
+		case OP_GEF:
+			t = EmitPopS( S1 );
+			r = EmitPopS( t == S0 ? S1 : S0 );
+			Emit4( 0x1E202000 | ( t << 16 ) | ( r << 5 ) );			// fcmp sn, st
+			EmitJump( vm, FloatJumpCond( ci->op ), ci->value );
+			break;
+
+		case OP_NEGI:
+			r = EmitPopW( R0 );
+			Emit4( 0x4B0003E0 | ( r << 16 ) | R0 );					// neg w0, wn
+			EmitPushW( R0 );
+			break;
+
+		case OP_BCOM:
+			r = EmitPopW( R0 );
+			Emit4( 0x2A2003E0 | ( r << 16 ) | R0 );					// mvn w0, wn
+			EmitPushW( R0 );
+			break;
+
+		case OP_ADD:
+		case OP_SUB:
+		case OP_MULI:
+		case OP_MULU:
+		case OP_DIVI:
+		case OP_DIVU:
+		case OP_BAND:
+		case OP_BOR:
+		case OP_BXOR:
+		case OP_LSH:
+		case OP_RSHI:
+		case OP_RSHU:
+			t = EmitPopW( R1 );
+			r = EmitPopW( t == R0 ? R1 : R0 );
+			Emit4( IntOp( ci->op ) | ( t << 16 ) | ( r << 5 ) | R0 );	// op w0, wn, wt
+			EmitPushW( R0 );
+			break;
+
+		case OP_MODI:
+		case OP_MODU:
+			t = EmitPopW( R1 );
+			r = EmitPopW( t == R0 ? R1 : R0 );
+			Emit4( IntOp( ci->op == OP_MODI ? OP_DIVI : OP_DIVU ) | ( t << 16 ) | ( r << 5 ) | R2 );	// sdiv|udiv w2, wn, wt
+			Emit4( 0x1B008000 | ( t << 16 ) | ( r << 10 ) | ( R2 << 5 ) | R0 );	// msub w0, w2, wt, wn
+			EmitPushW( R0 );
+			break;
+
+		case OP_NEGF:
+			r = EmitPopS( S0 );
+			Emit4( 0x1E214000 | ( r << 5 ) | S0 );					// fneg s0, sn
+			EmitPushS( S0 );
+			break;
+
+		case OP_ADDF:
+		case OP_SUBF:
+		case OP_DIVF:
+		case OP_MULF:
+			t = EmitPopS( S1 );
+			r = EmitPopS( t == S0 ? S1 : S0 );
+			Emit4( FloatOp( ci->op ) | ( t << 16 ) | ( r << 5 ) | S0 );	// op s0, sn, st
+			EmitPushS( S0 );
+			break;
+
+		case OP_CVIF:
+			r = EmitPopW( R0 );
+			Emit4( 0x1E220000 | ( r << 5 ) | S0 );					// scvtf s0, wn
+			EmitPushS( S0 );
+			break;
+
+		case OP_CVFI:
+			r = EmitPopS( S0 );
+			Emit4( 0x1E380000 | ( r << 5 ) | R0 );					// fcvtzs w0, sn
+			EmitPushW( R0 );
+			break;
+
+		case OP_SEX8:
+			r = EmitPopW( R0 );
+			Emit4( 0x13001C00 | ( r << 5 ) | R0 );					// sxtb w0, wn
+			EmitPushW( R0 );
+			break;
+
+		case OP_SEX16:
+			r = EmitPopW( R0 );
+			Emit4( 0x13003C00 | ( r << 5 ) | R0 );					// sxth w0, wn
+			EmitPushW( R0 );
+			break;
+
+		case OP_BLOCK_COPY:
+			r = EmitPopW( R3 );										// source
+			if ( r != R3 )
+				EmitMovRegW( R3, r );
+			EmitPopW( R2 );											// destination
+			Emit4( 0xAA0003E0 | ( R_DATABASE << 16 ) | R0 );		// mov x0, x19
+			EmitMovRegW( R1, R_DATAMASK );							// mov w1, w24
+			EmitMovW( R4, ci->value );								// mov w4, #count
+			EmitMovPtr( R16, (void *)BlockCopy );
+			Emit4( 0xD63F0000 | ( R16 << 5 ) );					// blr x16
+			break;
+
+		case OP_JUMP:
+			r = EmitPopW( R0 );
+
+			// jump target range check
+			if ( (int)vm_rtChecks.value & 4 ) {
+				if ( proc_base != -1 ) {
+					// allow jump within local function scope only
+					EmitAddSubW( true, R1, r, proc_base );		// sub w1, wn, #proc_base
+					EmitCmpW( R1, proc_len );					// cmp w1, #proc_len
+				} else {
+					EmitCmpW( r, vm->instructionCount );		// cmp wn, #instructionCount
+				}
+				EmitJumpCond( COND_HS, funcOffset[FUNC_BADJ] );	// b.hs +funcOffset[FUNC_BADJ]
+			}
+			Emit4( 0xF8607800 | ( r << 16 ) | ( R_INSTRPTRS << 5 ) | R16 );	// ldr x16, [x23, xn, lsl #3]
+			Emit4( 0xD61F0000 | ( R16 << 5 ) );							// br x16
+			break;
+
+		case MOP_IGNORE4:
+		case MOP_ADD4:
+		case MOP_SUB4:
+		case MOP_BAND4:
+		case MOP_BOR4:
+			if ( !EmitMOPs( vm, ci->op ) )
+				SV_Error( "VM_CompileARM64: bad opcode %02X", ci->op );
+			break;
+
+		default:
+			SV_Error( "VM_CompileARM64: bad opcode %02X", ci->op );
+			VM_FreeBuffers();
+			return false;
+		}
+	} // while( ip < header->instructionCount )
+
+		// ****************
+		// system functions
+		// ****************
+		funcOffset[FUNC_CALL] = compiledOfs;
+		EmitCallFunc( vm );
+
+		// ***************
+		// error functions
+		// ***************
+
+		// bad jump
+		funcOffset[FUNC_BADJ] = compiledOfs;
+		EmitErrorFunc( BadJump );
+
+		// error jump
+		funcOffset[FUNC_ERRJ] = compiledOfs;
+		EmitErrorFunc( ErrJump );
+
+		// programStack overflow
+		funcOffset[FUNC_PSOF] = compiledOfs;
+		EmitErrorFunc( BadStack );
+
+		// opStack overflow
+		funcOffset[FUNC_OSOF] = compiledOfs;
+		EmitErrorFunc( BadOpStack );
+
+		// read/write access violation
+		funcOffset[FUNC_DATA] = compiledOfs;
+		EmitErrorFunc( BadData );
+
+		if ( pass == 0 ) {
+			shortJumps = ( compiledOfs < MAX_SHORT_JUMP );
+		}
+
+	} // for( pass = 0; pass < n; pass++ )
+
+	n = header->instructionCount * sizeof( intptr_t );
+
+	if ( code == NULL ) {
+		code = (byte*)VM_Alloc_Compiled( vm, PAD(compiledOfs,8), n );
+		if ( code == NULL ) {
+			return false;
+		}
+		instructionPointers = (intptr_t*)(byte*)(code + PAD(compiledOfs,8));
+		pass = NUM_PASSES-1; // repeat last pass
+		goto __compile;
+	}
+
+	if ( jumpOutOfRange ) {
+		VM_FreeBuffers();
+		VM_Destroy_Compiled( vm );
+		Con_Printf( "VM_CompileARM64 error: %s\n", "jump out of range" );
+		return false;
+	}
+
+	// offset all the instruction pointers for the new location
+	for ( i = 0 ; i < header->instructionCount ; i++ ) {
+		if ( !inst[i].jused ) {
+			instructionPointers[ i ] = (intptr_t)BadJump;
+			continue;
+		}
+		instructionPointers[ i ] = (intptr_t)vm->codeBase.ptr + instructionOffsets[ i ];
+	}
+
+	VM_FreeBuffers();
+
+	if ( mprotect( vm->codeBase.ptr, vm->codeSize, PROT_READ|PROT_EXEC ) ) {
+		VM_Destroy_Compiled( vm );
+		Con_Printf( "VM_CompileARM64: mprotect failed\n" );
+		return false;
+	}
+
+	// instruction cache is not coherent with data writes on ARM
+	__builtin___clear_cache( (char *)vm->codeBase.ptr, (char *)vm->codeBase.ptr + compiledOfs );
+
+	vm->destroy = VM_Destroy_Compiled;
+
+	Con_Printf( "VM file %s compiled to %i bytes of code\n", vm->name, compiledOfs );
+
+	return true;
+}
+/*
+=================
+VM_Alloc_Compiled
+=================
+*/
+static void *VM_Alloc_Compiled( vm_t *vm, int codeLength, int tableLength )
+{
+	void	*ptr;
+	int		length;
+
+	length = codeLength + tableLength;
+	ptr = mmap( NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+	if ( ptr == MAP_FAILED ) {
+		SV_Error( "VM_CompileARM64: mmap failed" );
+		return NULL;
+	}
+	vm->codeBase.ptr = (byte*)ptr;
+	vm->codeLength = codeLength;
+	vm->codeSize = length;
+
+	return vm->codeBase.ptr;
+}
+
+
+/*
+==============
+VM_Destroy_Compiled
+==============
+*/
+static void VM_Destroy_Compiled( vm_t* vm )
+{
+	munmap( vm->codeBase.ptr, vm->codeSize );
+	vm->codeBase.ptr = NULL;
+}
+
+/*
+==============
+VM_CallCompiled
+
+This function is called directly by the generated code
+==============
+*/
+int	VM_CallCompiled( vm_t *vm, int nargs, int *args )
+{
+	int		opStack[MAX_OPSTACK_SIZE];
+	unsigned int stackOnEntry;
+	int		*image;
+	int		*oldOpTop;
+	int		i;
+
+	// we might be called recursively, so this might not be the very top
+	stackOnEntry = vm->programStack;
+	oldOpTop = vm->opStackTop;
+
+	vm->programStack -= (MAX_VMMAIN_CALL_ARGS+2)*4;
+
+	// set up the stack frame
+	image = (int*)( vm->dataBase + vm->programStack );
+	for ( i = 0; i < nargs; i++ ) {
+		image[ i + 2 ] = args[ i ];
+	}
+
+	image[1] =  0;	// return stack
+	image[0] = -1;	// will terminate loop on return
+
+	opStack[1] = 0;
+
+	vm->opStack = opStack;
+	vm->opStackTop = opStack + ARRAY_LEN( opStack ) - 1;
+
+	vm->codeBase.func(); // go into generated code
+
+	if ( vm->opStack != &opStack[1] ) {
+		SV_Error( "opStack corrupted in compiled code" );
+	}
+
+	vm->programStack = stackOnEntry;
+	vm->opStackTop = oldOpTop;
+
+	return vm->opStack[0];
+}
+#endif // idarm64
+#endif				/* USE_PR2 */
@@ -49,8 +49,50 @@ typedef enum {
 	MOP_LOCAL_LOAD4_CONST,
 	MOP_LOCAL_LOCAL,
 	MOP_LOCAL_LOCAL_LOAD4,
+	MOP_LOCAL_CONST_STORE4,
+	MOP_LOCAL_LOCAL_LOAD4_STORE4,
+	MOP_ADD4_LOCAL_CONST,
+	MOP_SUB4_LOCAL_CONST,
+	MOP_EQ_LOCAL_CONST,
+	MOP_NE_LOCAL_CONST,
+	MOP_LTI_LOCAL_CONST,
+	MOP_LEI_LOCAL_CONST,
+	MOP_GTI_LOCAL_CONST,
+	MOP_GEI_LOCAL_CONST,
+	MOP_EQ_CONST,
+	MOP_NE_CONST,
+	MOP_MAX
 } macro_op_t;
 
+static const char *mopname[ MOP_MAX - OP_MAX ] = {
+	"MOP_LOCAL_LOAD4",
+	"MOP_LOCAL_LOAD4_CONST",
+	"MOP_LOCAL_LOCAL",
+	"MOP_LOCAL_LOCAL_LOAD4",
+	"MOP_LOCAL_CONST_STORE4",
+	"MOP_LOCAL_LOCAL_LOAD4_STORE4",
+	"MOP_ADD4_LOCAL_CONST",
+	"MOP_SUB4_LOCAL_CONST",
+	"MOP_EQ_LOCAL_CONST",
+	"MOP_NE_LOCAL_CONST",
+	"MOP_LTI_LOCAL_CONST",
+	"MOP_LEI_LOCAL_CONST",
+	"MOP_GTI_LOCAL_CONST",
+	"MOP_GEI_LOCAL_CONST",
+	"MOP_EQ_CONST",
+	"MOP_NE_CONST",
+};
+
+// gcc and clang can jump through a table of labels, one indirect jump per
+// instruction instead of a shared one behind the switch, VM_NO_THREADED_CODE
+// builds the switch on those too
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(VM_NO_THREADED_CODE)
+#define VM_THREADED_CODE
+#endif
+
+// executed pairs of (macro) opcodes, see VM_VmProfile_f
+static qbool vm_op_profiling;
+static unsigned int vm_op_pairs[ MOP_MAX ][ MOP_MAX ];
 
 /*
 =================
@@ -61,7 +103,7 @@ Search for known macro-op sequences
 */
 static void VM_FindMOps( instruction_t *buf, int instructionCount )
 {
-	int i, op0;
+	int i, op0, op3;
 	instruction_t *ci;
 	
 	ci = buf;
@@ -71,6 +113,31 @@ static void VM_FindMOps( instruction_t *buf, int instructionCount )
 	{
 		op0 = ci->op;
 
+		// i = j + const
+		if ( op0 == OP_LOCAL && (ci+1)->op == OP_LOCAL && (ci+2)->op == OP_LOAD4 && (ci+3)->op == OP_CONST
+			&& ((ci+4)->op == OP_ADD || (ci+4)->op == OP_SUB) && (ci+5)->op == OP_STORE4 ) {
+			ci->op = (ci+4)->op == OP_ADD ? MOP_ADD4_LOCAL_CONST : MOP_SUB4_LOCAL_CONST;
+			ci += 6; i += 6;
+			continue;
+		}
+
+		// i = j
+		if ( op0 == OP_LOCAL && (ci+1)->op == OP_LOCAL && (ci+2)->op == OP_LOAD4 && (ci+3)->op == OP_STORE4 ) {
+			ci->op = MOP_LOCAL_LOCAL_LOAD4_STORE4;
+			ci += 4; i += 4;
+			continue;
+		}
+
+		// if ( i <op> const )
+		if ( op0 == OP_LOCAL && (ci+1)->op == OP_LOAD4 && (ci+2)->op == OP_CONST ) {
+			op3 = (ci+3)->op;
+			if ( op3 == OP_EQ || op3 == OP_NE || op3 == OP_LTI || op3 == OP_LEI || op3 == OP_GTI || op3 == OP_GEI ) {
+				ci->op = MOP_EQ_LOCAL_CONST + op3 - OP_EQ;
+				ci += 4; i += 4;
+				continue;
+			}
+		}
+
 		if ( op0 == OP_LOCAL && (ci+1)->op == OP_LOAD4 && (ci+2)->op == OP_CONST ) {
 			ci->op = MOP_LOCAL_LOAD4_CONST;
 			ci += 3; i += 3;
@@ -83,6 +150,13 @@ static void VM_FindMOps( instruction_t *buf, int instructionCount )
 			continue;
 		}
 
+		// i = const
+		if ( op0 == OP_LOCAL && (ci+1)->op == OP_CONST && (ci+2)->op == OP_STORE4 ) {
+			ci->op = MOP_LOCAL_CONST_STORE4;
+			ci += 3; i += 3;
+			continue;
+		}
+
 		if ( op0 == OP_LOCAL && (ci+1)->op == OP_LOCAL && (ci+2)->op == OP_LOAD4 ) {
 			ci->op = MOP_LOCAL_LOCAL_LOAD4;
 			ci += 3; i += 3;
@@ -95,12 +169,91 @@ static void VM_FindMOps( instruction_t *buf, int instructionCount )
 			continue;
 		}
 
+		// switch ( x ) { case const: }
+		if ( op0 == OP_CONST && ((ci+1)->op == OP_EQ || (ci+1)->op == OP_NE) ) {
+			ci->op = (ci+1)->op == OP_EQ ? MOP_EQ_CONST : MOP_NE_CONST;
+			ci += 2; i += 2;
+			continue;
+		}
+
 		ci++;
 		i++;
 	}
 }
 
 
+/*
+=================
+VM_ProfileOpPairs
+
+Starts or stops counting which opcodes follow each other in the interpreter
+=================
+*/
+void VM_ProfileOpPairs( qbool enable )
+{
+	if ( enable && !vm_op_profiling ) {
+		memset( vm_op_pairs, 0, sizeof( vm_op_pairs ) );
+	}
+	vm_op_profiling = enable;
+}
+
+
+static const char *VM_MOpName( int op )
+{
+	return op < OP_MAX ? opname[ op ] : mopname[ op - OP_MAX ];
+}
+
+
+/*
+=================
+VM_PrintOpPairs
+
+Lists the most executed opcode pairs, the candidates for new macro ops,
+and starts counting again
+=================
+*/
+void VM_PrintOpPairs( int count )
+{
+	unsigned int best[ 64 ][ 3 ];
+	double total = 0;
+	int i, j, k, n = 0;
+
+	count = bound( 1, count, (int) ARRAY_LEN( best ) );
+
+	for ( i = 0; i < MOP_MAX; i++ ) {
+		for ( j = 0; j < MOP_MAX; j++ ) {
+			unsigned int c = vm_op_pairs[ i ][ j ];
+
+			total += c;
+			if ( !c || ( n == count && c <= best[ n - 1 ][ 0 ] ) ) {
+				continue;
+			}
+
+			// insertion into the sorted top list
+			for ( k = ( n < count ? n++ : n - 1 ); k > 0 && best[ k - 1 ][ 0 ] < c; k-- ) {
+				memcpy( best[ k ], best[ k - 1 ], sizeof( best[ k ] ) );
+			}
+			best[ k ][ 0 ] = c;
+			best[ k ][ 1 ] = i;
+			best[ k ][ 2 ] = j;
+		}
+	}
+
+	if ( !n ) {
+		Con_Printf( "No opcode pairs counted%s.\n", vm_op_profiling ? " yet" : ", use \"vmprofile on\" first" );
+		return;
+	}
+
+	Con_Printf( "Hot opcode pairs:\n" );
+	for ( k = 0; k < n; k++ ) {
+		Con_Printf( "%5.2f%% %10u %s %s\n", 100 * best[ k ][ 0 ] / total, best[ k ][ 0 ], VM_MOpName( best[ k ][ 1 ] ), VM_MOpName( best[ k ][ 2 ] ) );
+	}
+	Con_Printf( "       %10.0f total\n", total );
+
+	memset( vm_op_pairs, 0, sizeof( vm_op_pairs ) );
+}
+
+
 /*
 ====================
 VM_PrepareInterpreter2
@@ -153,6 +306,27 @@ an OP_ENTER instruction, which will subtract space for
 locals from sp
 ==============
 */
+
+// VM_NEXT reloads the cached top of the opStack before the next instruction,
+// VM_DISPATCH goes on with r0/r1 as they are
+#ifdef VM_THREADED_CODE
+#define VM_OP( op )		op_##op:
+#define VM_DISPATCH()	do { v0 = ci->value; opcode = ci->op; ci++; goto *dispatch[ opcode ]; } while ( 0 )
+#define VM_NEXT()		do { r0.i = opStack[0]; r1.i = opStack[-1]; VM_DISPATCH(); } while ( 0 )
+#else
+#define VM_OP( op )		case op:
+#define VM_DISPATCH()	goto nextInstruction2
+#define VM_NEXT()		goto nextInstruction
+#endif
+
+// if ( local <cmp> const ) goto
+#define VM_BRANCH_LOCAL_CONST( cmp ) \
+	if ( *(int *)&image[ v0 + programStack ] cmp (ci+1)->value ) \
+		ci = inst + (ci+2)->value; \
+	else \
+		ci += 3; \
+	VM_NEXT();
+
 int	VM_CallInterpreted2( vm_t *vm, int nargs, int *args ) {
 	int		stack[MAX_OPSTACK_SIZE];
 	int		*opStack, *opStackTop;
@@ -164,8 +338,39 @@ int	VM_CallInterpreted2( vm_t *vm, int nargs, int *args ) {
 	instruction_t *inst, *ci;
 	floatint_t	r0, r1;
 	int		opcode;
+	int		last_opcode = OP_UNDEF;
 	int		*img;
 	int		i;
+#ifdef VM_THREADED_CODE
+	static const void *dispatch_table[ MOP_MAX ] = {
+		&&op_OP_UNDEF, &&op_OP_IGNORE, &&op_OP_BREAK,
+		&&op_OP_ENTER, &&op_OP_LEAVE, &&op_OP_CALL, &&op_OP_PUSH, &&op_OP_POP,
+		&&op_OP_CONST, &&op_OP_LOCAL, &&op_OP_JUMP,
+		&&op_OP_EQ, &&op_OP_NE, &&op_OP_LTI, &&op_OP_LEI, &&op_OP_GTI, &&op_OP_GEI,
+		&&op_OP_LTU, &&op_OP_LEU, &&op_OP_GTU, &&op_OP_GEU,
+		&&op_OP_EQF, &&op_OP_NEF, &&op_OP_LTF, &&op_OP_LEF, &&op_OP_GTF, &&op_OP_GEF,
+		&&op_OP_LOAD1, &&op_OP_LOAD2, &&op_OP_LOAD4, &&op_OP_STORE1, &&op_OP_STORE2, &&op_OP_STORE4,
+		&&op_OP_ARG, &&op_OP_BLOCK_COPY,
+		&&op_OP_SEX8, &&op_OP_SEX16,
+		&&op_OP_NEGI, &&op_OP_ADD, &&op_OP_SUB, &&op_OP_DIVI, &&op_OP_DIVU,
+		&&op_OP_MODI, &&op_OP_MODU, &&op_OP_MULI, &&op_OP_MULU,
+		&&op_OP_BAND, &&op_OP_BOR, &&op_OP_BXOR, &&op_OP_BCOM,
+		&&op_OP_LSH, &&op_OP_RSHI, &&op_OP_RSHU,
+		&&op_OP_NEGF, &&op_OP_ADDF, &&op_OP_SUBF, &&op_OP_DIVF, &&op_OP_MULF,
+		&&op_OP_CVIF, &&op_OP_CVFI,
+		&&op_MOP_LOCAL_LOAD4, &&op_MOP_LOCAL_LOAD4_CONST, &&op_MOP_LOCAL_LOCAL, &&op_MOP_LOCAL_LOCAL_LOAD4,
+		&&op_MOP_LOCAL_CONST_STORE4, &&op_MOP_LOCAL_LOCAL_LOAD4_STORE4,
+		&&op_MOP_ADD4_LOCAL_CONST, &&op_MOP_SUB4_LOCAL_CONST,
+		&&op_MOP_EQ_LOCAL_CONST, &&op_MOP_NE_LOCAL_CONST, &&op_MOP_LTI_LOCAL_CONST,
+		&&op_MOP_LEI_LOCAL_CONST, &&op_MOP_GTI_LOCAL_CONST, &&op_MOP_GEI_LOCAL_CONST,
+		&&op_MOP_EQ_CONST, &&op_MOP_NE_CONST,
+	};
+	const void *profile_table[ MOP_MAX ];
+	const void * const *dispatch = dispatch_table;
+#else
+	// a local the compiler can keep in a register across syscalls
+	const qbool profiling = vm_op_profiling;
+#endif
 
 	// interpret the code
 	//vm->currentlyInterpreting = true;
@@ -183,6 +388,8 @@ int	VM_CallInterpreted2( vm_t *vm, int nargs, int *args ) {
 	// not corrupt anything
 	opStack = &stack[1];
 	opStackTop = stack + ARRAY_LEN( stack ) - 1;
+	// the first instruction loads r0/r1 from here like every other one
+	stack[0] = stack[1] = 0;
 
 	programStack -= (MAX_VMMAIN_CALL_ARGS+2)*4;
 	img = (int*)&image[ programStack ];
@@ -197,8 +404,24 @@ int	VM_CallInterpreted2( vm_t *vm, int nargs, int *args ) {
 	// main interpreter loop, will exit when a LEAVE instruction
 	// grabs the -1 program counter
 
-	while ( 1 ) {
+#ifdef VM_THREADED_CODE
+	if ( vm_op_profiling ) {
+		// every opcode goes through op_profile first
+		for ( i = 0; i < MOP_MAX; i++ ) {
+			profile_table[ i ] = &&op_profile;
+		}
+		dispatch = profile_table;
+	}
 
+	VM_NEXT();
+	{
+op_profile:
+		vm_op_pairs[ last_opcode ][ opcode ]++;
+		last_opcode = opcode;
+		goto *dispatch_table[ opcode ];
+#else
+	while ( 1 ) {
+nextInstruction:
 		r0.i = opStack[0];
 		r1.i = opStack[-1];
 
@@ -208,13 +431,23 @@ nextInstruction2:
 		opcode = ci->op; 
 		ci++;
 
+		// counting out of line keeps the switch as fast as without it
+		if ( profiling ) {
+			goto profile_op;
+		}
+dispatch_op:
 		switch ( opcode ) {
+#endif
+
+		VM_OP( OP_UNDEF )
+		VM_OP( OP_IGNORE )
+			VM_NEXT();
 
-		case OP_BREAK:
+		VM_OP( OP_BREAK )
 			vm->breakCount++;
-			goto nextInstruction2;
+			VM_DISPATCH();
 
-		case OP_ENTER:
+		VM_OP( OP_ENTER )
 			// get size of stack frame
 			programStack -= v0;
 			if ( programStack <= vm->stackBottom ) {
@@ -225,9 +458,12 @@ nextInstruction2:
                 VM_StackTrace(vm, ci - (instruction_t *)vm->codeBase.ptr, programStack);
 				SV_Error( "VM opStack overflow" );
 			}
-			break;
+			if ( pr_sample_pending ) {
+				PR_SampleVM( vm, ci - 1 - inst, programStack, -1 );
+			}
+			VM_NEXT();
 
-		case OP_LEAVE:
+		VM_OP( OP_LEAVE )
 			// remove our stack frame
 			programStack += v0;
 
@@ -241,9 +477,9 @@ nextInstruction2:
 				SV_Error( "VM program counter out of range in OP_LEAVE" );
 			}
 			ci = inst + v1;
-			break;
+			VM_NEXT();
 
-		case OP_CALL:
+		VM_OP( OP_CALL )
 			// save current program counter
 			*(int *)&image[ programStack ] = ci - inst;
 			
@@ -264,7 +500,6 @@ nextInstruction2:
 					}
 					v0 = vm->systemCall( &argarr[0] );
 				} else {
-                    //VM_LogSyscalls( (int *)&image[ programStack + 4 ] );
 					v0 = vm->systemCall( (intptr_t *)&image[ programStack + 4 ] );
 				}
 
@@ -272,6 +507,9 @@ nextInstruction2:
 				//opStack++;
 				ci = inst + *(int *)&image[ programStack ];
 				*opStack = v0;
+				if ( pr_sample_pending ) {
+					PR_SampleVM( vm, ci - inst, programStack, ~r0.i );
+				}
 			} else if ( r0.u < vm->instructionCount ) {
 				// vm call
 				ci = inst + r0.i;
@@ -280,37 +518,37 @@ nextInstruction2:
                 VM_StackTrace(vm, ci - (instruction_t *)vm->codeBase.ptr, programStack);
 				SV_Error( "VM program counter out of range in OP_CALL" );
 			}
-			break;
+			VM_NEXT();
 
 		// push and pop are only needed for discarded or bad function return values
-		case OP_PUSH:
+		VM_OP( OP_PUSH )
 			opStack++;
-			break;
+			VM_NEXT();
 
-		case OP_POP:
+		VM_OP( OP_POP )
 			opStack--;
-			break;
+			VM_NEXT();
 
-		case OP_CONST:
+		VM_OP( OP_CONST )
 			opStack++;
 			r1.i = r0.i;
 			r0.i = *opStack = v0;
-			goto nextInstruction2;
+			VM_DISPATCH();
 
-		case OP_LOCAL:
+		VM_OP( OP_LOCAL )
 			opStack++;
 			r1.i = r0.i;
 			r0.i = *opStack = v0 + programStack;
-			goto nextInstruction2;
+			VM_DISPATCH();
 
-		case OP_JUMP:
+		VM_OP( OP_JUMP )
 			if ( r0.u >= vm->instructionCount ) {
                 VM_StackTrace(vm, ci - (instruction_t *)vm->codeBase.ptr, programStack);
 				SV_Error( "VM program counter out of range in OP_JUMP" );
 			}
 			ci = inst + r0.i;
 			opStack--;
-			break;
+			VM_NEXT();
 
 		/*
 		===================================================================
@@ -318,138 +556,138 @@ nextInstruction2:
 		===================================================================
 		*/
 
-		case OP_EQ:
+		VM_OP( OP_EQ )
 			opStack -= 2;
 			if ( r1.i == r0.i )
 				ci = inst + v0;
-			break;
+			VM_NEXT();
 
-		case OP_NE:
+		VM_OP( OP_NE )
 			opStack -= 2;
 			if ( r1.i != r0.i )
 				ci = inst + v0;
-			break;
+			VM_NEXT();
 
-		case OP_LTI:
+		VM_OP( OP_LTI )
 			opStack -= 2;
 			if ( r1.i < r0.i )
 				ci = inst + v0;
-			break;
+			VM_NEXT();
 
-		case OP_LEI:
+		VM_OP( OP_LEI )
 			opStack -= 2;
 			if ( r1.i <= r0.i )
 				ci = inst + v0;
-			break;
+			VM_NEXT();
 
-		case OP_GTI:
+		VM_OP( OP_GTI )
 			opStack -= 2;
 			if ( r1.i > r0.i )
 				ci = inst + v0;
-			break;
+			VM_NEXT();
 
-		case OP_GEI:
+		VM_OP( OP_GEI )
 			opStack -= 2;
 			if ( r1.i >= r0.i )
 				ci = inst + v0;
-			break;
+			VM_NEXT();
 
-		case OP_LTU:
+		VM_OP( OP_LTU )
 			opStack -= 2;
 			if ( r1.u < r0.u )
 				ci = inst + v0;
-			break;
+			VM_NEXT();
 
-		case OP_LEU:
+		VM_OP( OP_LEU )
 			opStack -= 2;
 			if ( r1.u <= r0.u )
 				ci = inst + v0;
-			break;
+			VM_NEXT();
 
-		case OP_GTU:
+		VM_OP( OP_GTU )
 			opStack -= 2;
 			if ( r1.u > r0.u )
 				ci = inst + v0;
-			break;
+			VM_NEXT();
 
-		case OP_GEU:
+		VM_OP( OP_GEU )
 			opStack -= 2;
 			if ( r1.u >= r0.u )
 				ci = inst + v0;
-			break;
+			VM_NEXT();
 
-		case OP_EQF:
+		VM_OP( OP_EQF )
 			opStack -= 2;
 			if ( r1.f == r0.f )
 				ci = inst + v0;
-			break;
+			VM_NEXT();
 
-		case OP_NEF:
+		VM_OP( OP_NEF )
 			opStack -= 2;
 			if ( r1.f != r0.f )
 				ci = inst + v0;
-			break;
+			VM_NEXT();
 
-		case OP_LTF:
+		VM_OP( OP_LTF )
 			opStack -= 2;
 			if ( r1.f < r0.f )
 				ci = inst + v0;
-			break;
+			VM_NEXT();
 
-		case OP_LEF:
+		VM_OP( OP_LEF )
 			opStack -= 2;
 			if ( r1.f <= r0.f )
 				ci = inst + v0;
-			break;
+			VM_NEXT();
 
-		case OP_GTF:
+		VM_OP( OP_GTF )
 			opStack -= 2;
 			if ( r1.f > r0.f )
 				ci = inst + v0;
-			break;
+			VM_NEXT();
 
-		case OP_GEF:
+		VM_OP( OP_GEF )
 			opStack -= 2;
 			if ( r1.f >= r0.f )
 				ci = inst + v0;
-			break;
+			VM_NEXT();
 
 		//===================================================================
 
-		case OP_LOAD1:
+		VM_OP( OP_LOAD1 )
 			r0.i = *opStack = image[ r0.i & dataMask ];
-			goto nextInstruction2;
+			VM_DISPATCH();
 
-		case OP_LOAD2:
+		VM_OP( OP_LOAD2 )
 			r0.i = *opStack = *(unsigned short *)&image[ r0.i & dataMask ];
-			goto nextInstruction2;
+			VM_DISPATCH();
 
-		case OP_LOAD4:
+		VM_OP( OP_LOAD4 )
 			r0.i = *opStack = *(int *)&image[ r0.i & dataMask ];
-			goto nextInstruction2;
+			VM_DISPATCH();
 
-		case OP_STORE1:
+		VM_OP( OP_STORE1 )
 			image[ r1.i & dataMask ] = r0.i;
 			opStack -= 2;
-			break;
+			VM_NEXT();
 
-		case OP_STORE2:
+		VM_OP( OP_STORE2 )
 			*(short *)&image[ r1.i & dataMask ] = r0.i;
 			opStack -= 2;
-			break;
+			VM_NEXT();
 
-		case OP_STORE4:
+		VM_OP( OP_STORE4 )
 			*(int *)&image[ r1.i & dataMask ] = r0.i;
 			opStack -= 2;
-			break;
+			VM_NEXT();
 
-		case OP_ARG:
+		VM_OP( OP_ARG )
 			// single byte offset from programStack
 			*(int *)&image[ ( v0 + programStack ) /*& ( dataMask & ~3 ) */ ] = r0.i;
 			opStack--;
-			break;
+			VM_NEXT();
 
-		case OP_BLOCK_COPY:
+		VM_OP( OP_BLOCK_COPY )
 			{
 				int		*src, *dest;
 				int		count, srci, desti;
@@ -467,155 +705,217 @@ nextInstruction2:
 				memcpy( dest, src, count );
 				opStack -= 2;
 			}
-			break;
+			VM_NEXT();
 
-		case OP_SEX8:
+		VM_OP( OP_SEX8 )
 			*opStack = (signed char)*opStack;
-			break;
+			VM_NEXT();
 
-		case OP_SEX16:
+		VM_OP( OP_SEX16 )
 			*opStack = (short)*opStack;
-			break;
+			VM_NEXT();
 
-		case OP_NEGI:
+		VM_OP( OP_NEGI )
 			*opStack = -r0.i;
-			break;
+			VM_NEXT();
 
-		case OP_ADD:
+		VM_OP( OP_ADD )
 			opStack[-1] = r1.i + r0.i;
 			opStack--;
-			break;
+			VM_NEXT();
 
-		case OP_SUB:
+		VM_OP( OP_SUB )
 			opStack[-1] = r1.i - r0.i;
 			opStack--;
-			break;
+			VM_NEXT();
 
-		case OP_DIVI:
+		VM_OP( OP_DIVI )
 			opStack[-1] = r1.i / r0.i;
 			opStack--;
-			break;
+			VM_NEXT();
 
-		case OP_DIVU:
+		VM_OP( OP_DIVU )
 			opStack[-1] = r1.u / r0.u;
 			opStack--;
-			break;
+			VM_NEXT();
 
-		case OP_MODI:
+		VM_OP( OP_MODI )
 			opStack[-1] = r1.i % r0.i;
 			opStack--;
-			break;
+			VM_NEXT();
 
-		case OP_MODU:
+		VM_OP( OP_MODU )
 			opStack[-1] = r1.u % r0.u;
 			opStack--;
-			break;
+			VM_NEXT();
 
-		case OP_MULI:
+		VM_OP( OP_MULI )
 			opStack[-1] = r1.i * r0.i;
 			opStack--;
-			break;
+			VM_NEXT();
 
-		case OP_MULU:
+		VM_OP( OP_MULU )
 			opStack[-1] = r1.u * r0.u;
 			opStack--;
-			break;
+			VM_NEXT();
 
-		case OP_BAND:
+		VM_OP( OP_BAND )
 			opStack[-1] = r1.u & r0.u;
 			opStack--;
-			break;
+			VM_NEXT();
 
-		case OP_BOR:
+		VM_OP( OP_BOR )
 			opStack[-1] = r1.u | r0.u;
 			opStack--;
-			break;
+			VM_NEXT();
 
-		case OP_BXOR:
+		VM_OP( OP_BXOR )
 			opStack[-1] = r1.u ^ r0.u;
 			opStack--;
-			break;
+			VM_NEXT();
 
-		case OP_BCOM:
+		VM_OP( OP_BCOM )
 			*opStack = ~ r0.u;
-			break;
+			VM_NEXT();
 
-		case OP_LSH:
+		VM_OP( OP_LSH )
 			opStack[-1] = r1.i << r0.i;
 			opStack--;
-			break;
+			VM_NEXT();
 
-		case OP_RSHI:
+		VM_OP( OP_RSHI )
 			opStack[-1] = r1.i >> r0.i;
 			opStack--;
-			break;
+			VM_NEXT();
 
-		case OP_RSHU:
+		VM_OP( OP_RSHU )
 			opStack[-1] = r1.u >> r0.i;
 			opStack--;
-			break;
+			VM_NEXT();
 
-		case OP_NEGF:
+		VM_OP( OP_NEGF )
 			*(float *)opStack =  - r0.f;
-			break;
+			VM_NEXT();
 
-		case OP_ADDF:
+		VM_OP( OP_ADDF )
 			*(float *)(opStack-1) = r1.f + r0.f;
 			opStack--;
-			break;
+			VM_NEXT();
 
-		case OP_SUBF:
+		VM_OP( OP_SUBF )
 			*(float *)(opStack-1) = r1.f - r0.f;
 			opStack--;
-			break;
+			VM_NEXT();
 
-		case OP_DIVF:
+		VM_OP( OP_DIVF )
 			*(float *)(opStack-1) = r1.f / r0.f;
 			opStack--;
-			break;
+			VM_NEXT();
 
-		case OP_MULF:
+		VM_OP( OP_MULF )
 			*(float *)(opStack-1) = r1.f * r0.f;
 			opStack--;
-			break;
+			VM_NEXT();
 
-		case OP_CVIF:
+		VM_OP( OP_CVIF )
 			*(float *)opStack = (float) r0.i;
-			break;
+			VM_NEXT();
 
-		case OP_CVFI:
+		VM_OP( OP_CVFI )
 			*opStack = (int) r0.f;
-			break;
+			VM_NEXT();
 
-		case MOP_LOCAL_LOAD4:
+		VM_OP( MOP_LOCAL_LOAD4 )
 			ci++;
 			opStack++;
 			r1.i = r0.i;
 			r0.i = *opStack = *(int *)&image[ v0 + programStack ];
-			goto nextInstruction2;
+			VM_DISPATCH();
 
-		case MOP_LOCAL_LOAD4_CONST:
+		VM_OP( MOP_LOCAL_LOAD4_CONST )
 			r1.i = opStack[1] = *(int *)&image[ v0 + programStack ];
 			r0.i = opStack[2] = (ci+1)->value;
 			opStack += 2;
 			ci += 2;
-			goto nextInstruction2;
+			VM_DISPATCH();
 
-		case MOP_LOCAL_LOCAL:
+		VM_OP( MOP_LOCAL_LOCAL )
 			r1.i = opStack[1] = v0 + programStack;
 			r0.i = opStack[2] = ci->value + programStack;
 			opStack += 2;
 			ci++;
-			goto nextInstruction2;
+			VM_DISPATCH();
 
-		case MOP_LOCAL_LOCAL_LOAD4:
+		VM_OP( MOP_LOCAL_LOCAL_LOAD4 )
 			r1.i = opStack[1] = v0 + programStack;
 			r0.i /*= opStack[2]*/ = ci->value + programStack;
 			r0.i = opStack[2] = *(int *)&image[ r0.i /*& dataMask*/ ];
 			opStack += 2;
 			ci += 2;
-			goto nextInstruction2;
+			VM_DISPATCH();
+
+		// the stored-to local is not range checked on load, unlike the loaded one
+		VM_OP( MOP_LOCAL_CONST_STORE4 )
+			*(int *)&image[ ( v0 + programStack ) & dataMask ] = ci->value;
+			ci += 2;
+			VM_NEXT();
+
+		VM_OP( MOP_LOCAL_LOCAL_LOAD4_STORE4 )
+			*(int *)&image[ ( v0 + programStack ) & dataMask ] = *(int *)&image[ ci->value + programStack ];
+			ci += 3;
+			VM_NEXT();
+
+		VM_OP( MOP_ADD4_LOCAL_CONST )
+			*(int *)&image[ ( v0 + programStack ) & dataMask ] = *(int *)&image[ ci->value + programStack ] + (ci+2)->value;
+			ci += 5;
+			VM_NEXT();
+
+		VM_OP( MOP_SUB4_LOCAL_CONST )
+			*(int *)&image[ ( v0 + programStack ) & dataMask ] = *(int *)&image[ ci->value + programStack ] - (ci+2)->value;
+			ci += 5;
+			VM_NEXT();
+
+		VM_OP( MOP_EQ_LOCAL_CONST )
+			VM_BRANCH_LOCAL_CONST( == )
+
+		VM_OP( MOP_NE_LOCAL_CONST )
+			VM_BRANCH_LOCAL_CONST( != )
+
+		VM_OP( MOP_LTI_LOCAL_CONST )
+			VM_BRANCH_LOCAL_CONST( < )
+
+		VM_OP( MOP_LEI_LOCAL_CONST )
+			VM_BRANCH_LOCAL_CONST( <= )
+
+		VM_OP( MOP_GTI_LOCAL_CONST )
+			VM_BRANCH_LOCAL_CONST( > )
+
+		VM_OP( MOP_GEI_LOCAL_CONST )
+			VM_BRANCH_LOCAL_CONST( >= )
+
+		VM_OP( MOP_EQ_CONST )
+			opStack--;
+			if ( r0.i == v0 )
+				ci = inst + ci->value;
+			else
+				ci++;
+			VM_NEXT();
+
+		VM_OP( MOP_NE_CONST )
+			opStack--;
+			if ( r0.i != v0 )
+				ci = inst + ci->value;
+			else
+				ci++;
+			VM_NEXT();
+
+#ifndef VM_THREADED_CODE
 		}
+profile_op:
+		vm_op_pairs[ last_opcode ][ opcode ]++;
+		last_opcode = opcode;
+		goto dispatch_op;
+#endif
 	}
 
 done:
@@ -236,11 +236,17 @@ int	VM_CallCompiled( vm_t *vm, int nargs, int *args );
 
 qbool VM_PrepareInterpreter2( vm_t *vm, vmHeader_t *header );
 int	VM_CallInterpreted2( vm_t *vm, int nargs, int *args );
+void VM_ProfileOpPairs( qbool enable );
+void VM_PrintOpPairs( int count );
+void PR_SampleVM( vm_t *vm, int pc, unsigned int programStack, int syscall );
 
 vmSymbol_t *VM_ValueToFunctionSymbol( vm_t *vm, int value );
 int VM_SymbolToValue( vm_t *vm, const char *symbol );
 const char *VM_ValueToSymbol( vm_t *vm, int value );
-void VM_LogSyscalls( int *args );
+#define	VM_LOG_SYSCALLS_COUNT	1
+#define	VM_LOG_SYSCALLS_FILE	2
+extern int vm_logSyscalls;
+void VM_LogSyscalls( intptr_t *args, double time );
 
 const char *VM_LoadInstructions( const byte *code_pos, int codeLength, int instructionCount, instruction_t *buf );
 const char *VM_CheckInstructions( instruction_t *buf, int instructionCount, 
@@ -261,6 +267,7 @@ typedef struct opcode_info_s
 } opcode_info_t ;
 
 extern opcode_info_t ops[ OP_MAX ];
+extern const char *opname[ 256 ];
 
 void	VM_Init( void );
 vm_t	*VM_Create( vmIndex_t index, const char* name, syscall_t systemCalls, /*dllSyscall_t dllSyscalls,*/ vmInterpret_t interpret );
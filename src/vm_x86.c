@@ -2960,7 +2960,7 @@ int	VM_CallCompiled( vm_t *vm, int nargs, int *args )
 
 	return vm->opStack[0];
 }
-#else
+#elif !idarm64
 int	VM_CallCompiled( vm_t *vm, int nargs, int *args ) { return 0;}
 qbool VM_Compile( vm_t *vm, vmHeader_t *header ) { return false; }
 #endif